@@ -120,6 +120,12 @@ enum {
 	 * on answer, the recipient must set:
 	 *
 	 * - ARG1 - source user page address
+	 *
+	 * and may set:
+	 *
+	 * - ARG2 - AS_AREA_* flags the page may be shared with or zero if the
+	 *          page may be mapped with any flags; areas with more flags
+	 *          get a private copy of the page
 	 */
 	IPC_M_PAGE_IN,
 
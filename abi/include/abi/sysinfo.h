@@ -70,6 +70,10 @@ typedef struct {
 	uint16_t frequency_mhz;  /**< Frequency in MHz */
 	uint64_t idle_cycles;    /**< Number of idle cycles */
 	uint64_t busy_cycles;    /**< Number of busy cycles */
+	uint64_t frame_cache_hits;    /**< Frame allocations from CPU cache */
+	uint64_t frame_cache_misses;  /**< Frame cache refills from zones */
+	uint64_t idle_steals;         /**< Threads stolen when going idle */
+	uint64_t lb_steals;           /**< Threads migrated by load balancer */
 } stats_cpu_t;
 
 /** Physical memory statistics
@@ -80,6 +84,7 @@ typedef struct {
 	uint64_t unavail;  /**< Unavailable (reserved, firmware) bytes */
 	uint64_t used;     /**< Allocated physical memory (bytes) */
 	uint64_t free;     /**< Free physical memory (bytes) */
+	uint64_t cached;   /**< Free bytes held in per-CPU frame caches */
 } stats_physmem_t;
 
 /** IPC statistics
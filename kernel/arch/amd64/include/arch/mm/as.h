@@ -40,6 +40,7 @@
 
 #define KERNEL_ADDRESS_SPACE_SHADOWED_ARCH  0
 #define KERNEL_SEPARATE_PTL0_ARCH           0
+#define AS_SWITCH_FLUSHES_TLB_ARCH          1
 
 #define KERNEL_ADDRESS_SPACE_START_ARCH  UINT64_C(0xffff800000000000)
 #define KERNEL_ADDRESS_SPACE_END_ARCH    UINT64_C(0xffffffffffffffff)
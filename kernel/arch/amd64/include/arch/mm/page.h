@@ -147,6 +147,14 @@
 #define SET_FRAME_PRESENT_ARCH(ptl3, i) \
 	set_pt_present((pte_t *) (ptl3), (size_t) (i))
 
+/* Large page accessors (a PTL2 entry can map 2 MiB directly). */
+#define LARGE_PAGE_WIDTH_ARCH  21
+
+#define GET_PTL3_LARGE_ARCH(ptl2, i) \
+	(((pte_t *) (ptl2))[(i)].page_size != 0)
+#define SET_PTL3_LARGE_ARCH(ptl2, i, x) \
+	(((pte_t *) (ptl2))[(i)].page_size = ((x) != 0))
+
 /* Macros for querying the last-level PTE entries. */
 #define PTE_VALID_ARCH(p) \
 	((p)->soft_valid != 0)
@@ -197,7 +205,7 @@ typedef struct {
 	unsigned int page_cache_disable : 1;
 	unsigned int accessed : 1;
 	unsigned int dirty : 1;
-	unsigned int unused : 1;
+	unsigned int page_size : 1;  /**< Large page (PTL2 entries only). */
 	unsigned int global : 1;
 	unsigned int soft_valid : 1;  /**< Valid content even if present bit is cleared. */
 	unsigned int avl : 2;
@@ -128,6 +128,15 @@
 #define SET_PTL3_PRESENT(ptl2, i)   SET_PTL3_PRESENT_ARCH(ptl2, i)
 #define SET_FRAME_PRESENT(ptl3, i)  SET_FRAME_PRESENT_ARCH(ptl3, i)
 
+/*
+ * Macros for PTL2 entries which map a large page instead of a PTL3 table.
+ *
+ */
+#ifdef LARGE_PAGE_WIDTH_ARCH
+#define GET_PTL3_LARGE(ptl2, i)     GET_PTL3_LARGE_ARCH(ptl2, i)
+#define SET_PTL3_LARGE(ptl2, i, x)  SET_PTL3_LARGE_ARCH(ptl2, i, x)
+#endif
+
 /*
  * Macros for querying the last-level PTEs.
  *
@@ -56,28 +56,32 @@ static void pt_mapping_remove(as_t *, uintptr_t);
 static bool pt_mapping_find(as_t *, uintptr_t, bool, pte_t *pte);
 static void pt_mapping_update(as_t *, uintptr_t, bool, pte_t *pte);
 static void pt_mapping_make_global(uintptr_t, size_t);
+#ifdef LARGE_PAGE_WIDTH
+static bool pt_mapping_insert_large(as_t *, uintptr_t, uintptr_t, unsigned int);
+static void pt_mapping_split(as_t *, uintptr_t, size_t);
+#endif
 
 page_mapping_operations_t pt_mapping_operations = {
 	.mapping_insert = pt_mapping_insert,
 	.mapping_remove = pt_mapping_remove,
 	.mapping_find = pt_mapping_find,
 	.mapping_update = pt_mapping_update,
-	.mapping_make_global = pt_mapping_make_global
+	.mapping_make_global = pt_mapping_make_global,
+#ifdef LARGE_PAGE_WIDTH
+	.mapping_insert_large = pt_mapping_insert_large,
+	.mapping_split = pt_mapping_split
+#endif
 };
 
-/** Map page to frame using hierarchical page tables.
+/** Get PTL2 covering page, allocating missing PTL1 and PTL2 tables.
  *
- * Map virtual address page to physical address frame
- * using flags.
+ * @param as   Address space to wich page belongs.
+ * @param page Virtual address of the page.
  *
- * @param as    Address space to wich page belongs.
- * @param page  Virtual address of the page to be mapped.
- * @param frame Physical address of memory frame to which the mapping is done.
- * @param flags Flags to be used for mapping.
+ * @return Kernel address of the PTL2 table.
  *
  */
-void pt_mapping_insert(as_t *as, uintptr_t page, uintptr_t frame,
-    unsigned int flags)
+static pte_t *pt_ptl2_get(as_t *as, uintptr_t page)
 {
 	pte_t *ptl0 = (pte_t *) PA2KA((uintptr_t) as->genarch.page_table);
 
@@ -117,7 +121,30 @@ void pt_mapping_insert(as_t *as, uintptr_t page, uintptr_t frame,
 		SET_PTL2_PRESENT(ptl1, PTL1_INDEX(page));
 	}
 
-	pte_t *ptl2 = (pte_t *) PA2KA(GET_PTL2_ADDRESS(ptl1, PTL1_INDEX(page)));
+	return (pte_t *) PA2KA(GET_PTL2_ADDRESS(ptl1, PTL1_INDEX(page)));
+}
+
+/** Map page to frame using hierarchical page tables.
+ *
+ * Map virtual address page to physical address frame
+ * using flags.
+ *
+ * @param as    Address space to wich page belongs.
+ * @param page  Virtual address of the page to be mapped.
+ * @param frame Physical address of memory frame to which the mapping is done.
+ * @param flags Flags to be used for mapping.
+ *
+ */
+void pt_mapping_insert(as_t *as, uintptr_t page, uintptr_t frame,
+    unsigned int flags)
+{
+	assert(page_table_locked(as));
+
+	pte_t *ptl2 = pt_ptl2_get(as, page);
+
+#ifdef LARGE_PAGE_WIDTH
+	assert(!GET_PTL3_LARGE(ptl2, PTL2_INDEX(page)));
+#endif
 
 	if (GET_PTL3_FLAGS(ptl2, PTL2_INDEX(page)) & PAGE_NOT_PRESENT) {
 		pte_t *newpt = (pte_t *)
@@ -145,6 +172,109 @@ void pt_mapping_insert(as_t *as, uintptr_t page, uintptr_t frame,
 	SET_FRAME_PRESENT(ptl3, PTL3_INDEX(page));
 }
 
+#ifdef LARGE_PAGE_WIDTH
+
+/** Map large page to physically contiguous frames.
+ *
+ * The PTL2 entry covering page is made to map the whole large page
+ * directly. The entry is composed aside and published with a single store
+ * so that a concurrent page table walk never sees it half-initialized.
+ *
+ * @param as    Address space to wich page belongs.
+ * @param page  Virtual address of the large page.
+ * @param frame Physical address of the first frame of the large page.
+ * @param flags Flags to be used for mapping.
+ *
+ * @return False if some part of the large page is already mapped.
+ *
+ */
+static bool pt_mapping_insert_large(as_t *as, uintptr_t page, uintptr_t frame,
+    unsigned int flags)
+{
+	assert(IS_ALIGNED(page, LARGE_PAGE_SIZE));
+	assert(IS_ALIGNED(frame, LARGE_PAGE_SIZE));
+
+	pte_t *ptl2 = pt_ptl2_get(as, page);
+	if (PTE_VALID(&ptl2[PTL2_INDEX(page)]))
+		return false;
+
+	pte_t pte[1];
+	memsetb(pte, sizeof(pte), 0);
+	SET_PTL3_ADDRESS(pte, 0, frame);
+	SET_PTL3_FLAGS(pte, 0, flags);
+	SET_PTL3_LARGE(pte, 0, true);
+
+	ptl2[PTL2_INDEX(page)] = pte[0];
+	return true;
+}
+
+/** Replace a large page mapping by a PTL3 with the same translations.
+ *
+ * @param ptl2 PTL2 table containing the large page mapping.
+ * @param i    Index of the large page mapping in ptl2.
+ *
+ */
+static void pt_split_large(pte_t *ptl2, size_t i)
+{
+	uintptr_t frame = PTE_GET_FRAME(&ptl2[i]);
+	unsigned int flags = GET_PTL3_FLAGS(ptl2, i);
+
+	pte_t *newpt = (pte_t *)
+	    PA2KA(frame_alloc(PTL3_FRAMES, FRAME_LOWMEM, PTL3_SIZE - 1));
+	memsetb(newpt, PTL3_SIZE, 0);
+	for (size_t j = 0; j < PTL3_ENTRIES; j++) {
+		SET_FRAME_ADDRESS(newpt, j, frame + P2SZ(j));
+		SET_FRAME_FLAGS(newpt, j, flags);
+	}
+
+	pte_t pte[1];
+	memsetb(pte, sizeof(pte), 0);
+	SET_PTL3_ADDRESS(pte, 0, KA2PA(newpt));
+	SET_PTL3_FLAGS(pte, 0, PAGE_USER | PAGE_EXEC | PAGE_CACHEABLE |
+	    PAGE_WRITE);
+
+	/*
+	 * Make the new PTL3 visible only after it is fully initialized.
+	 * The translations do not change, so stale TLB entries of the large
+	 * page remain correct until they are flushed by the caller's
+	 * shootdown.
+	 */
+	write_barrier();
+	ptl2[i] = pte[0];
+}
+
+/** Split all large page mappings which intersect a range.
+ *
+ * @param as   Address space.
+ * @param base Start of the range.
+ * @param size Size of the range.
+ *
+ */
+static void pt_mapping_split(as_t *as, uintptr_t base, size_t size)
+{
+	assert(page_table_locked(as));
+
+	for (uintptr_t page = ALIGN_DOWN(base, LARGE_PAGE_SIZE);
+	    page - 1 < base + size - 1; page += LARGE_PAGE_SIZE) {
+		pte_t *ptl0 = (pte_t *) PA2KA((uintptr_t) as->genarch.page_table);
+		if (GET_PTL1_FLAGS(ptl0, PTL0_INDEX(page)) & PAGE_NOT_PRESENT)
+			continue;
+
+		pte_t *ptl1 = (pte_t *)
+		    PA2KA(GET_PTL1_ADDRESS(ptl0, PTL0_INDEX(page)));
+		if (GET_PTL2_FLAGS(ptl1, PTL1_INDEX(page)) & PAGE_NOT_PRESENT)
+			continue;
+
+		pte_t *ptl2 = (pte_t *)
+		    PA2KA(GET_PTL2_ADDRESS(ptl1, PTL1_INDEX(page)));
+		if (PTE_VALID(&ptl2[PTL2_INDEX(page)]) &&
+		    GET_PTL3_LARGE(ptl2, PTL2_INDEX(page)))
+			pt_split_large(ptl2, PTL2_INDEX(page));
+	}
+}
+
+#endif /* LARGE_PAGE_WIDTH */
+
 /** Remove mapping of page from hierarchical page tables.
  *
  * Remove any mapping of page within address space as.
@@ -177,6 +307,15 @@ void pt_mapping_remove(as_t *as, uintptr_t page)
 	if (GET_PTL3_FLAGS(ptl2, PTL2_INDEX(page)) & PAGE_NOT_PRESENT)
 		return;
 
+#ifdef LARGE_PAGE_WIDTH
+	/*
+	 * Callers normally split large pages before removing parts of them,
+	 * but do it here as well so that the rest of the large page survives.
+	 */
+	if (GET_PTL3_LARGE(ptl2, PTL2_INDEX(page)))
+		pt_split_large(ptl2, PTL2_INDEX(page));
+#endif
+
 	pte_t *ptl3 = (pte_t *) PA2KA(GET_PTL3_ADDRESS(ptl2, PTL2_INDEX(page)));
 
 	/*
@@ -291,10 +430,13 @@ void pt_mapping_remove(as_t *as, uintptr_t page)
 #endif /* PTL1_ENTRIES != 0 */
 }
 
-static pte_t *pt_mapping_find_internal(as_t *as, uintptr_t page, bool nolock)
+static pte_t *pt_mapping_find_internal(as_t *as, uintptr_t page, bool nolock,
+    bool *large)
 {
 	assert(nolock || page_table_locked(as));
 
+	*large = false;
+
 	pte_t *ptl0 = (pte_t *) PA2KA((uintptr_t) as->genarch.page_table);
 	if (GET_PTL1_FLAGS(ptl0, PTL0_INDEX(page)) & PAGE_NOT_PRESENT)
 		return NULL;
@@ -316,6 +458,13 @@ static pte_t *pt_mapping_find_internal(as_t *as, uintptr_t page, bool nolock)
 	if (GET_PTL3_FLAGS(ptl2, PTL2_INDEX(page)) & PAGE_NOT_PRESENT)
 		return NULL;
 
+#ifdef LARGE_PAGE_WIDTH
+	if (GET_PTL3_LARGE(ptl2, PTL2_INDEX(page))) {
+		*large = true;
+		return &ptl2[PTL2_INDEX(page)];
+	}
+#endif
+
 #if (PTL2_ENTRIES != 0)
 	/*
 	 * Always read ptl3 only after we are sure it is present.
@@ -339,10 +488,26 @@ static pte_t *pt_mapping_find_internal(as_t *as, uintptr_t page, bool nolock)
  */
 bool pt_mapping_find(as_t *as, uintptr_t page, bool nolock, pte_t *pte)
 {
-	pte_t *t = pt_mapping_find_internal(as, page, nolock);
-	if (t)
-		*pte = *t;
-	return t != NULL;
+	bool large;
+	pte_t *t = pt_mapping_find_internal(as, page, nolock, &large);
+	if (!t)
+		return false;
+
+	*pte = *t;
+
+#ifdef LARGE_PAGE_WIDTH
+	if (large) {
+		/*
+		 * Present the base page within the large page as if it was
+		 * mapped by an ordinary last-level PTE.
+		 */
+		SET_FRAME_ADDRESS(pte, 0, PTE_GET_FRAME(t) +
+		    (ALIGN_DOWN(page, PAGE_SIZE) & (LARGE_PAGE_SIZE - 1)));
+		SET_PTL3_LARGE(pte, 0, false);
+	}
+#endif
+
+	return true;
 }
 
 /** Update mapping for virtual page in hierarchical page tables.
@@ -354,10 +519,13 @@ bool pt_mapping_find(as_t *as, uintptr_t page, bool nolock, pte_t *pte)
  */
 void pt_mapping_update(as_t *as, uintptr_t page, bool nolock, pte_t *pte)
 {
-	pte_t *t = pt_mapping_find_internal(as, page, nolock);
+	bool large;
+	pte_t *t = pt_mapping_find_internal(as, page, nolock, &large);
 	if (!t)
 		panic("Updating non-existent PTE");
 
+	assert(!large);
+
 	assert(PTE_VALID(t) == PTE_VALID(pte));
 	assert(PTE_PRESENT(t) == PTE_PRESENT(pte));
 	assert(PTE_GET_FRAME(t) == PTE_GET_FRAME(pte));
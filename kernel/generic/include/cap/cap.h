@@ -38,10 +38,8 @@
 #include <abi/cap.h>
 #include <typedefs.h>
 #include <adt/list.h>
-#include <adt/hash.h>
-#include <adt/hash_table.h>
-#include <lib/ra.h>
 #include <synch/mutex.h>
+#include <synch/spinlock.h>
 #include <atomic.h>
 
 typedef enum {
@@ -96,9 +94,14 @@ typedef struct kobject {
 } kobject_t;
 
 /*
- * A cap_t may only be accessed under the protection of the cap_info_t lock.
+ * A cap_t may only be modified under the protection of the cap_info_t lock.
+ * Changes to the state and kobject members are in addition done under the
+ * capability's own lock, which is enough to read them.
  */
 typedef struct cap {
+	/** Lock protecting state and kobject for lookups without cap_info_t lock */
+	SPINLOCK_DECLARE(lock);
+
 	cap_state_t state;
 
 	struct task *task;
@@ -110,19 +113,41 @@ typedef struct cap {
 	/* Link to the task's capabilities of the same kobject type. */
 	link_t type_link;
 
-	ht_link_t caps_link;
+	/* Link to the task's free capabilities. */
+	link_t free_link;
 
 	/* The underlying kernel object. */
 	kobject_t *kobject;
 } cap_t;
 
+/** Number of capabilities in one chunk of the capability table */
+#define CAPS_CHUNK_WIDTH  6
+#define CAPS_CHUNK_SIZE   (1 << CAPS_CHUNK_WIDTH)
+
+/** Number of entries in each level of the capability table directory */
+#define CAPS_DIR_WIDTH  6
+#define CAPS_DIR_SIZE   (1 << CAPS_DIR_WIDTH)
+
+typedef struct {
+	cap_t caps[CAPS_CHUNK_SIZE];
+} cap_chunk_t;
+
 typedef struct cap_info {
 	mutex_t lock;
 
 	list_t type_list[KOBJECT_TYPE_MAX];
 
-	hash_table_t caps;
-	ra_arena_t *handles;
+	/**
+	 * Two-level directory of capability chunks indexed by handle.
+	 *
+	 * Directory entries and chunks are only ever added until the task is
+	 * destroyed, so a capability can be looked up without any lock.
+	 */
+	cap_chunk_t **dir[CAPS_DIR_SIZE];
+	/** Number of chunks in dir */
+	size_t chunks;
+	/** Free capabilities in the allocated chunks */
+	list_t free_list;
 } cap_info_t;
 
 extern void caps_init(void);
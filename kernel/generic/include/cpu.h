@@ -36,6 +36,7 @@
 #define KERN_CPU_H_
 
 #include <mm/tlb.h>
+#include <mm/frame.h>
 #include <synch/spinlock.h>
 #include <proc/scheduler.h>
 #include <arch/cpu.h>
@@ -45,6 +46,13 @@
 
 #define CPU                  CURRENT->cpu
 
+/** Number of bits of clock tick used to index one level of timing wheel */
+#define TIMEOUT_WHEEL_BITS    6
+#define TIMEOUT_WHEEL_SLOTS   (1 << TIMEOUT_WHEEL_BITS)
+#define TIMEOUT_WHEEL_MASK    (TIMEOUT_WHEEL_SLOTS - 1)
+/** Number of levels of timing wheel */
+#define TIMEOUT_WHEEL_LEVELS  4
+
 /** CPU structure.
  *
  * There is one structure like this for every processor.
@@ -59,10 +67,15 @@ typedef struct cpu {
 
 	atomic_t nrdy;
 	runq_t rq[RQ_COUNT];
+	/** Bitmap of non-empty run queues, bit i is changed under rq[i].lock */
+	atomic_uint rq_ready;
 	volatile size_t needs_relink;
 
 	IRQ_SPINLOCK_DECLARE(timeoutlock);
-	list_t timeout_active_list;
+	/** Hierarchical timing wheel of active timeouts */
+	list_t timeout_wheel[TIMEOUT_WHEEL_LEVELS][TIMEOUT_WHEEL_SLOTS];
+	/** Clock tick which will be processed next by clock() */
+	uint64_t timeout_tick;
 
 	/**
 	 * When system clock loses a tick, it is
@@ -73,6 +86,9 @@ typedef struct cpu {
 	 */
 	size_t missed_clock_ticks;
 
+	/** Cache of free frames for single frame allocations */
+	frame_pcache_t frame_cache;
+
 	/**
 	 * Processor cycle accounting.
 	 */
@@ -81,6 +97,12 @@ typedef struct cpu {
 	uint64_t idle_cycles;
 	uint64_t busy_cycles;
 
+	/**
+	 * Thread migration accounting.
+	 */
+	uint64_t idle_steals;
+	uint64_t lb_steals;
+
 	/**
 	 * Processor ID assigned by kernel.
 	 */
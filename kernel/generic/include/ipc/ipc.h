@@ -165,6 +165,9 @@ typedef struct call {
 
 	/** Buffer for IPC_M_DATA_WRITE and IPC_M_DATA_READ. */
 	uint8_t *buffer;
+
+	/** Pinned destination buffer for direct IPC_M_DATA_READ. */
+	struct ipc_xfer *xfer;
 } call_t;
 
 extern slab_cache_t *phone_cache;
@@ -64,6 +64,17 @@
  */
 #define KERNEL_SEPARATE_PTL0 KERNEL_SEPARATE_PTL0_ARCH
 
+/**
+ * Defined to be true if switching to another address space removes all
+ * TLB entries of the previous one on the processor (i.e. there are no
+ * hardware address space identifiers).
+ */
+#ifdef AS_SWITCH_FLUSHES_TLB_ARCH
+#define AS_SWITCH_FLUSHES_TLB  AS_SWITCH_FLUSHES_TLB_ARCH
+#else
+#define AS_SWITCH_FLUSHES_TLB  0
+#endif
+
 #define KERNEL_ADDRESS_SPACE_START  KERNEL_ADDRESS_SPACE_START_ARCH
 #define KERNEL_ADDRESS_SPACE_END    KERNEL_ADDRESS_SPACE_END_ARCH
 #define USER_ADDRESS_SPACE_START    USER_ADDRESS_SPACE_START_ARCH
@@ -115,6 +126,14 @@ typedef struct as {
 	 */
 	asid_t asid;
 
+	/**
+	 * Processors which may hold TLB entries of this address space and
+	 * therefore need to take part in its TLB shootdowns. NULL for the
+	 * kernel address space, which is present on all processors.
+	 * Modified under asidlock.
+	 */
+	struct cpu_mask *cpu_mask;
+
 	/** Number of references (i.e. tasks that reference this as). */
 	atomic_refcount_t refcount;
 
@@ -336,6 +355,7 @@ extern void as_pagemap_remove(as_page_mapping_t *);
 
 extern unsigned int as_area_get_flags(as_area_t *);
 extern bool as_area_check_access(as_area_t *, pf_access_t);
+extern bool as_area_large_page_fits(as_area_t *, uintptr_t);
 extern size_t as_area_get_size(uintptr_t);
 extern used_space_ival_t *used_space_first(used_space_t *);
 extern used_space_ival_t *used_space_next(used_space_ival_t *);
@@ -117,6 +117,37 @@ typedef struct {
 	frame_t *frames;
 } zone_t;
 
+/** Number of frames held by a per-CPU frame cache of one kind. */
+#define FRAME_PCACHE_SIZE   64
+/** Number of frames moved between a per-CPU frame cache and the zones. */
+#define FRAME_PCACHE_BATCH  32
+
+/** Per-CPU cache of free single frames.
+ *
+ * Cached frames are allocated in their zone's bitmap and keep refcount 1,
+ * so they can be handed out without touching zones.lock. Freed frames are
+ * collected in batches and their references are dropped under zones.lock
+ * once a batch is full. The lock of the cache must be acquired before
+ * zones.lock.
+ */
+typedef struct {
+	IRQ_SPINLOCK_DECLARE(lock);
+	/** Frames from low memory zones (index 0) and high memory zones (1) */
+	pfn_t pfn[2][FRAME_PCACHE_SIZE];
+	/** Number of valid entries in pfn */
+	size_t count[2];
+
+	/** Freed frames without (index 0) and with (1) memory reservation */
+	pfn_t pending[2][FRAME_PCACHE_BATCH];
+	/** Number of valid entries in pending */
+	size_t pending_count[2];
+
+	/** Number of allocations satisfied from the cache */
+	uint64_t hits;
+	/** Number of allocations which had to refill the cache */
+	uint64_t misses;
+} frame_pcache_t;
+
 /*
  * The zoneinfo.lock must be locked when accessing zoneinfo structure.
  * Some of the attributes in zone_t structures are 'read-only'
@@ -138,7 +169,9 @@ extern void frame_free_generic(uintptr_t, size_t, frame_flags_t);
 extern void frame_free(uintptr_t, size_t);
 extern void frame_free_noreserve(uintptr_t, size_t);
 extern void frame_reference_add(pfn_t);
+extern bool frame_reference_try_add(pfn_t);
 extern size_t frame_total_free_get(void);
+extern void frame_pcache_init(frame_pcache_t *);
 
 extern size_t find_zone(pfn_t, size_t, size_t);
 extern size_t zone_create(pfn_t, size_t, pfn_t, zone_flags_t);
@@ -150,7 +183,8 @@ extern pfn_t zone_external_conf_alloc(size_t);
 extern bool zone_merge(size_t, size_t);
 extern void zone_merge_all(void);
 extern uint64_t zones_total_size(void);
-extern void zones_stats(uint64_t *, uint64_t *, uint64_t *, uint64_t *);
+extern void zones_stats(uint64_t *, uint64_t *, uint64_t *, uint64_t *,
+    uint64_t *);
 
 /*
  * Console functions
@@ -43,6 +43,15 @@
 #define P2SZ(pages) \
 	((pages) << PAGE_WIDTH)
 
+#ifdef LARGE_PAGE_WIDTH_ARCH
+
+/** Large pages which can be mapped by a single higher-level entry. */
+#define LARGE_PAGE_WIDTH  LARGE_PAGE_WIDTH_ARCH
+#define LARGE_PAGE_SIZE   (((uintptr_t) 1) << LARGE_PAGE_WIDTH)
+#define LARGE_PAGE_PAGES  (LARGE_PAGE_SIZE >> PAGE_WIDTH)
+
+#endif
+
 /** Operations to manipulate page mappings. */
 typedef struct {
 	void (*mapping_insert)(as_t *, uintptr_t, uintptr_t, unsigned int);
@@ -50,6 +59,10 @@ typedef struct {
 	bool (*mapping_find)(as_t *, uintptr_t, bool, pte_t *);
 	void (*mapping_update)(as_t *, uintptr_t, bool, pte_t *);
 	void (*mapping_make_global)(uintptr_t, size_t);
+	/** Optional, map a large page. */
+	bool (*mapping_insert_large)(as_t *, uintptr_t, uintptr_t, unsigned int);
+	/** Optional, replace large page mappings in a range by base pages. */
+	void (*mapping_split)(as_t *, uintptr_t, size_t);
 } page_mapping_operations_t;
 
 extern page_mapping_operations_t *page_mapping_operations;
@@ -63,6 +76,9 @@ extern void page_mapping_remove(as_t *, uintptr_t);
 extern bool page_mapping_find(as_t *, uintptr_t, bool, pte_t *);
 extern void page_mapping_update(as_t *, uintptr_t, bool, pte_t *);
 extern void page_mapping_make_global(uintptr_t, size_t);
+extern bool page_mapping_insert_large(as_t *, uintptr_t, uintptr_t,
+    unsigned int);
+extern void page_mapping_split(as_t *, uintptr_t, size_t);
 extern pte_t *page_table_create(unsigned int);
 extern void page_table_destroy(pte_t *);
 
@@ -66,14 +66,21 @@ typedef struct {
 
 extern void tlb_init(void);
 
+struct as;
+
 #ifdef CONFIG_SMP
 extern ipl_t tlb_shootdown_start(tlb_invalidate_type_t, asid_t, uintptr_t,
     size_t);
+extern ipl_t tlb_shootdown_start_as(struct as *, tlb_invalidate_type_t,
+    uintptr_t, size_t);
 extern void tlb_shootdown_finalize(ipl_t);
+extern void tlb_shootdown_join(void);
 extern void tlb_shootdown_ipi_recv(void);
 #else
 #define tlb_shootdown_start(w, x, y, z)	interrupts_disable()
+#define tlb_shootdown_start_as(w, x, y, z)	interrupts_disable()
 #define tlb_shootdown_finalize(i)	(interrupts_restore(i));
+#define tlb_shootdown_join()
 #define tlb_shootdown_ipi_recv()
 #endif /* CONFIG_SMP */
 
@@ -44,6 +44,9 @@
 #define RQ_COUNT          16
 #define NEEDS_RELINK_MAX  (HZ)
 
+/** Bit of the i-th run queue in cpu_t.rq_ready */
+#define RQ_BIT(i)  (1U << (i))
+
 /** Scheduler run queue structure. */
 typedef struct {
 	IRQ_SPINLOCK_DECLARE(lock);
@@ -86,16 +86,24 @@
 #include <ipc/ipcrsc.h>
 #include <ipc/ipc.h>
 #include <ipc/irq.h>
+#include <barrier.h>
 
-#include <limits.h>
 #include <stdint.h>
 #include <stdlib.h>
 
 #define CAPS_START	((intptr_t) CAP_NIL + 1)
-#define CAPS_SIZE	(INT_MAX - (int) CAPS_START)
-#define CAPS_LAST	(CAPS_SIZE - 1)
+#define CAPS_SIZE \
+	((intptr_t) CAPS_DIR_SIZE * CAPS_DIR_SIZE * CAPS_CHUNK_SIZE)
+#define CAPS_LAST	(CAPS_START + CAPS_SIZE - 1)
+
+/** Indices into the capability table for a handle's slot number */
+#define CAPS_DIR_IDX(slot) \
+	((slot) >> (CAPS_DIR_WIDTH + CAPS_CHUNK_WIDTH))
+#define CAPS_SUBDIR_IDX(slot) \
+	(((slot) >> CAPS_CHUNK_WIDTH) & (CAPS_DIR_SIZE - 1))
+#define CAPS_CHUNK_IDX(slot) \
+	((slot) & (CAPS_CHUNK_SIZE - 1))
 
-static slab_cache_t *cap_cache;
 static slab_cache_t *kobject_cache;
 
 kobject_ops_t *kobject_ops[KOBJECT_TYPE_MAX] = {
@@ -105,35 +113,8 @@ kobject_ops_t *kobject_ops[KOBJECT_TYPE_MAX] = {
 	[KOBJECT_TYPE_WAITQ] = &waitq_kobject_ops
 };
 
-static size_t caps_hash(const ht_link_t *item)
-{
-	cap_t *cap = hash_table_get_inst(item, cap_t, caps_link);
-	return hash_mix(cap_handle_raw(cap->handle));
-}
-
-static size_t caps_key_hash(const void *key)
-{
-	const cap_handle_t *handle = key;
-	return hash_mix(cap_handle_raw(*handle));
-}
-
-static bool caps_key_equal(const void *key, const ht_link_t *item)
-{
-	const cap_handle_t *handle = key;
-	cap_t *cap = hash_table_get_inst(item, cap_t, caps_link);
-	return *handle == cap->handle;
-}
-
-static hash_table_ops_t caps_ops = {
-	.hash = caps_hash,
-	.key_hash = caps_key_hash,
-	.key_equal = caps_key_equal
-};
-
 void caps_init(void)
 {
-	cap_cache = slab_cache_create("cap_t", sizeof(cap_t), 0, NULL,
-	    NULL, 0);
 	kobject_cache = slab_cache_create("kobject_t", sizeof(kobject_t), 0,
 	    NULL, NULL, 0);
 }
@@ -147,20 +128,10 @@ errno_t caps_task_alloc(task_t *task)
 	task->cap_info = (cap_info_t *) malloc(sizeof(cap_info_t));
 	if (!task->cap_info)
 		return ENOMEM;
-	task->cap_info->handles = ra_arena_create();
-	if (!task->cap_info->handles)
-		goto error_handles;
-	if (!ra_span_add(task->cap_info->handles, CAPS_START, CAPS_SIZE))
-		goto error_span;
-	if (!hash_table_create(&task->cap_info->caps, 0, 0, &caps_ops))
-		goto error_span;
+	for (size_t i = 0; i < CAPS_DIR_SIZE; i++)
+		task->cap_info->dir[i] = NULL;
+	task->cap_info->chunks = 0;
 	return EOK;
-
-error_span:
-	ra_arena_destroy(task->cap_info->handles);
-error_handles:
-	free(task->cap_info);
-	return ENOMEM;
 }
 
 /** Initialize the capability info structure
@@ -173,6 +144,8 @@ void caps_task_init(task_t *task)
 
 	for (kobject_type_t t = 0; t < KOBJECT_TYPE_MAX; t++)
 		list_initialize(&task->cap_info->type_list[t]);
+
+	list_initialize(&task->cap_info->free_list);
 }
 
 /** Deallocate the capability info structure
@@ -181,9 +154,15 @@ void caps_task_init(task_t *task)
  */
 void caps_task_free(task_t *task)
 {
-	hash_table_destroy(&task->cap_info->caps);
-	ra_arena_destroy(task->cap_info->handles);
-	free(task->cap_info);
+	cap_info_t *info = task->cap_info;
+
+	for (size_t i = 0; i < info->chunks; i++) {
+		free(info->dir[CAPS_DIR_IDX(i << CAPS_CHUNK_WIDTH)]
+		    [CAPS_SUBDIR_IDX(i << CAPS_CHUNK_WIDTH)]);
+	}
+	for (size_t i = 0; i < CAPS_DIR_SIZE; i++)
+		free(info->dir[i]);
+	free(info);
 }
 
 /** Invoke callback function on task's capabilites of given type
@@ -222,11 +201,106 @@ bool caps_apply_to_kobject_type(task_t *task, kobject_type_t type,
  */
 static void cap_initialize(cap_t *cap, task_t *task, cap_handle_t handle)
 {
+	spinlock_initialize(&cap->lock, "cap_t.lock");
 	cap->state = CAP_STATE_FREE;
 	cap->task = task;
 	cap->handle = handle;
+	cap->kobject = NULL;
 	link_initialize(&cap->kobj_link);
 	link_initialize(&cap->type_link);
+	link_initialize(&cap->free_link);
+}
+
+/** Look up capability using capability handle
+ *
+ * This function does not need the cap_info_t lock as the capability table
+ * only grows while the task exists. The capability state must be checked
+ * under the capability lock or the cap_info_t lock.
+ *
+ * @param task    Task whose capability to look up.
+ * @param handle  Capability handle of the desired capability.
+ *
+ * @return Address of the capability if handle lies within the table.
+ * @return NULL otherwise.
+ */
+static cap_t *cap_lookup(task_t *task, cap_handle_t handle)
+{
+	cap_info_t *info = task->cap_info;
+
+	if ((cap_handle_raw(handle) < CAPS_START) ||
+	    (cap_handle_raw(handle) > CAPS_LAST))
+		return NULL;
+
+	size_t slot = cap_handle_raw(handle) - CAPS_START;
+
+	cap_chunk_t **subdir = info->dir[CAPS_DIR_IDX(slot)];
+	if (!subdir)
+		return NULL;
+
+	/* Pairs with write_barrier() in caps_grow(). */
+	read_barrier();
+
+	cap_chunk_t *chunk = subdir[CAPS_SUBDIR_IDX(slot)];
+	if (!chunk)
+		return NULL;
+
+	read_barrier();
+
+	return &chunk->caps[CAPS_CHUNK_IDX(slot)];
+}
+
+/** Add a chunk of free capabilities to the capability table
+ *
+ * @param task  Task whose capability table to grow.
+ *
+ * @return An error code in case of error.
+ */
+static errno_t caps_grow(task_t *task)
+{
+	cap_info_t *info = task->cap_info;
+
+	assert(mutex_locked(&info->lock));
+
+	size_t base = info->chunks << CAPS_CHUNK_WIDTH;
+	if (base >= (size_t) CAPS_SIZE)
+		return ENOMEM;
+
+	cap_chunk_t **subdir = info->dir[CAPS_DIR_IDX(base)];
+	if (!subdir) {
+		subdir = malloc(CAPS_DIR_SIZE * sizeof(cap_chunk_t *));
+		if (!subdir)
+			return ENOMEM;
+		for (size_t i = 0; i < CAPS_DIR_SIZE; i++)
+			subdir[i] = NULL;
+	}
+
+	cap_chunk_t *chunk = malloc(sizeof(cap_chunk_t));
+	if (!chunk) {
+		if (!info->dir[CAPS_DIR_IDX(base)])
+			free(subdir);
+		return ENOMEM;
+	}
+
+	for (size_t i = 0; i < CAPS_CHUNK_SIZE; i++) {
+		cap_t *cap = &chunk->caps[i];
+		cap_initialize(cap, task,
+		    (cap_handle_t) (base + i + CAPS_START));
+		list_append(&cap->free_link, &info->free_list);
+	}
+
+	/*
+	 * Make the chunk and the directory visible to cap_lookup() only
+	 * after they are initialized.
+	 */
+	write_barrier();
+	subdir[CAPS_SUBDIR_IDX(base)] = chunk;
+	if (!info->dir[CAPS_DIR_IDX(base)]) {
+		write_barrier();
+		info->dir[CAPS_DIR_IDX(base)] = subdir;
+	}
+	info->chunks++;
+
+	return EOK;
 }
 
 /** Get capability using capability handle
@@ -242,13 +316,9 @@ static cap_t *cap_get(task_t *task, cap_handle_t handle, cap_state_t state)
 {
 	assert(mutex_locked(&task->cap_info->lock));
 
-	if ((cap_handle_raw(handle) < CAPS_START) ||
-	    (cap_handle_raw(handle) > CAPS_LAST))
-		return NULL;
-	ht_link_t *link = hash_table_find(&task->cap_info->caps, &handle);
-	if (!link)
+	cap_t *cap = cap_lookup(task, handle);
+	if (!cap)
 		return NULL;
-	cap_t *cap = hash_table_get_inst(link, cap_t, caps_link);
 	if (cap->state != state)
 		return NULL;
 	return cap;
@@ -265,21 +335,20 @@ static cap_t *cap_get(task_t *task, cap_handle_t handle, cap_state_t state)
 errno_t cap_alloc(task_t *task, cap_handle_t *handle)
 {
 	mutex_lock(&task->cap_info->lock);
-	cap_t *cap = slab_alloc(cap_cache, FRAME_ATOMIC);
-	if (!cap) {
-		mutex_unlock(&task->cap_info->lock);
-		return ENOMEM;
-	}
-	uintptr_t hbase;
-	if (!ra_alloc(task->cap_info->handles, 1, 1, &hbase)) {
-		slab_free(cap_cache, cap);
-		mutex_unlock(&task->cap_info->lock);
-		return ENOMEM;
+	if (list_empty(&task->cap_info->free_list)) {
+		errno_t rc = caps_grow(task);
+		if (rc != EOK) {
+			mutex_unlock(&task->cap_info->lock);
+			return rc;
+		}
 	}
-	cap_initialize(cap, task, (cap_handle_t) hbase);
-	hash_table_insert(&task->cap_info->caps, &cap->caps_link);
+	cap_t *cap = list_get_instance(list_first(&task->cap_info->free_list),
+	    cap_t, free_link);
+	list_remove(&cap->free_link);
 
+	spinlock_lock(&cap->lock);
 	cap->state = CAP_STATE_ALLOCATED;
+	spinlock_unlock(&cap->lock);
 	*handle = cap->handle;
 	mutex_unlock(&task->cap_info->lock);
 
@@ -303,9 +372,11 @@ cap_publish(task_t *task, cap_handle_t handle, kobject_t *kobj)
 	mutex_lock(&task->cap_info->lock);
 	cap_t *cap = cap_get(task, handle, CAP_STATE_ALLOCATED);
 	assert(cap);
+	spinlock_lock(&cap->lock);
 	cap->state = CAP_STATE_PUBLISHED;
 	/* Hand over kobj's reference to cap */
 	cap->kobject = kobj;
+	spinlock_unlock(&cap->lock);
 	list_append(&cap->kobj_link, &kobj->caps_list);
 	list_append(&cap->type_link, &task->cap_info->type_list[kobj->type]);
 	mutex_unlock(&task->cap_info->lock);
@@ -314,10 +385,12 @@ cap_publish(task_t *task, cap_handle_t handle, kobject_t *kobj)
 
 static void cap_unpublish_unsafe(cap_t *cap)
 {
+	spinlock_lock(&cap->lock);
 	cap->kobject = NULL;
+	cap->state = CAP_STATE_ALLOCATED;
+	spinlock_unlock(&cap->lock);
 	list_remove(&cap->kobj_link);
 	list_remove(&cap->type_link);
-	cap->state = CAP_STATE_ALLOCATED;
 }
 
 /** Unpublish published capability
@@ -401,9 +474,11 @@ void cap_free(task_t *task, cap_handle_t handle)
 
 	assert(cap);
 
-	hash_table_remove_item(&task->cap_info->caps, &cap->caps_link);
-	ra_free(task->cap_info->handles, cap_handle_raw(handle), 1);
-	slab_free(cap_cache, cap);
+	spinlock_lock(&cap->lock);
+	cap->state = CAP_STATE_FREE;
+	spinlock_unlock(&cap->lock);
+	/* Reuse recently freed capabilities first, they are cache hot */
+	list_prepend(&cap->free_link, &task->cap_info->free_list);
 	mutex_unlock(&task->cap_info->lock);
 }
 
@@ -441,6 +516,9 @@ void kobject_initialize(kobject_t *kobj, kobject_type_t type, void *raw)
  * @param type    Kernel object type of the object associated with the
  *                capability referenced by handle.
  *
+ * The capability's reference keeps the kernel object alive while its lock is
+ * held, so the task's capability mutex is not needed here.
+ *
  * @return Kernel object with incremented reference count on success.
  * @return NULL if there is no matching capability or kernel object.
  */
@@ -449,15 +527,17 @@ kobject_get(struct task *task, cap_handle_t handle, kobject_type_t type)
 {
 	kobject_t *kobj = NULL;
 
-	mutex_lock(&task->cap_info->lock);
-	cap_t *cap = cap_get(task, handle, CAP_STATE_PUBLISHED);
-	if (cap) {
-		if (cap->kobject->type == type) {
-			kobj = cap->kobject;
-			atomic_inc(&kobj->refcnt);
-		}
+	cap_t *cap = cap_lookup(task, handle);
+	if (!cap)
+		return NULL;
+
+	spinlock_lock(&cap->lock);
+	if ((cap->state == CAP_STATE_PUBLISHED) &&
+	    (cap->kobject->type == type)) {
+		kobj = cap->kobject;
+		atomic_inc(&kobj->refcnt);
 	}
-	mutex_unlock(&task->cap_info->lock);
+	spinlock_unlock(&cap->lock);
 
 	return kobj;
 }
@@ -88,6 +88,8 @@ void cpu_init(void)
 				irq_spinlock_initialize(&cpus[i].rq[j].lock, "cpus[].rq[].lock");
 				list_initialize(&cpus[i].rq[j].rq);
 			}
+
+			frame_pcache_init(&cpus[i].frame_cache);
 		}
 
 #ifdef CONFIG_SMP
@@ -103,6 +105,8 @@ void cpu_init(void)
 	CPU->last_cycle = get_cycle();
 	CPU->idle_cycles = 0;
 	CPU->busy_cycles = 0;
+	CPU->idle_steals = 0;
+	CPU->lb_steals = 0;
 
 	cpu_identify();
 	cpu_arch_init();
@@ -59,6 +59,7 @@
 #include <proc/thread.h>
 #include <arch/interrupt.h>
 #include <ipc/irq.h>
+#include <ipc/xfer.h>
 #include <cap/cap.h>
 #include <stdlib.h>
 
@@ -86,6 +87,7 @@ static void _ipc_call_init(call_t *call)
 	call->sender = NULL;
 	call->callerbox = NULL;
 	call->buffer = NULL;
+	call->xfer = NULL;
 }
 
 static void call_destroy(void *arg)
@@ -94,6 +96,8 @@ static void call_destroy(void *arg)
 
 	if (call->buffer)
 		free(call->buffer);
+	if (call->xfer)
+		ipc_xfer_release(call->xfer);
 	if (call->caller_phone)
 		kobject_put(call->caller_phone->kobject);
 	slab_free(call_cache, call);
@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup kernel_generic_ipc
+ * @{
+ */
+/** @file
+ * @brief Direct copying of large IPC data transfers.
+ *
+ * IPC_M_DATA_READ normally copies the payload from the answering task into a
+ * kernel buffer and later, in the context of the caller, from the buffer into
+ * the caller's destination buffer. For large payloads, the frames backing the
+ * destination buffer are pinned when the request is sent instead, and the
+ * answering task copies the payload straight into them while it is answering
+ * the call. The payload is thus read while its source buffer is guaranteed to
+ * be still valid, which halves the memory traffic and spares the kernel heap.
+ *
+ * IPC_M_DATA_WRITE keeps copying the payload when the request is sent, as the
+ * destination is not known before the recipient accepts the data and the
+ * sender is free to reuse its buffer once the request is sent.
+ */
+
+#include <assert.h>
+#include <ipc/xfer.h>
+#include <mm/as.h>
+#include <mm/frame.h>
+#include <mm/km.h>
+#include <mm/page.h>
+#include <genarch/mm/page_pt.h>
+#include <genarch/mm/page_ht.h>
+#include <syscall/copy.h>
+#include <arch.h>
+#include <abi/errno.h>
+#include <align.h>
+#include <config.h>
+#include <macros.h>
+#include <stdlib.h>
+
+/** Pin the frames of a user destination buffer in the current address space.
+ *
+ * @param dst   Address of the buffer.
+ * @param size  Size of the buffer.
+ * @param xferp Place to store the pinned buffer descriptor.
+ *
+ * @return EOK on success, an error code if the buffer cannot be pinned and
+ *         needs to be copied the usual way.
+ *
+ */
+errno_t ipc_xfer_pin(uspace_addr_t dst, size_t size, ipc_xfer_t **xferp)
+{
+	size_t offset = dst & (PAGE_SIZE - 1);
+	size_t count = SIZE2FRAMES(offset + size);
+
+	ipc_xfer_t *xfer = malloc(sizeof(ipc_xfer_t) +
+	    count * sizeof(uintptr_t));
+	if (!xfer)
+		return ENOMEM;
+
+	xfer->offset = offset;
+	xfer->size = size;
+	xfer->count = 0;
+
+	uspace_addr_t page = ALIGN_DOWN(dst, PAGE_SIZE);
+	for (size_t i = 0; i < count; i++, page += PAGE_SIZE) {
+		/*
+		 * Let the regular copy validate the address and fault the
+		 * page in for writing. The contents of the destination buffer
+		 * are undefined until the transfer completes, so writing back
+		 * the byte just read is harmless.
+		 */
+		uint8_t probe;
+		errno_t rc = copy_from_uspace(&probe, max(page, dst), 1);
+		if (rc == EOK)
+			rc = copy_to_uspace(max(page, dst), &probe, 1);
+		if (rc != EOK) {
+			ipc_xfer_release(xfer);
+			return rc;
+		}
+
+		pte_t pte;
+		uintptr_t frame = 0;
+
+		page_table_lock(AS, true);
+		bool found = page_mapping_find(AS, page, false, &pte);
+		if (found && PTE_VALID(&pte) && PTE_PRESENT(&pte) &&
+		    PTE_WRITABLE(&pte) &&
+		    frame_reference_try_add(ADDR2PFN(PTE_GET_FRAME(&pte))))
+			frame = PTE_GET_FRAME(&pte);
+		page_table_unlock(AS, true);
+
+		if (frame == 0) {
+			/* Not backed by ordinary memory or gone meanwhile. */
+			ipc_xfer_release(xfer);
+			return ENOENT;
+		}
+
+		xfer->frames[xfer->count++] = frame;
+	}
+
+	*xferp = xfer;
+	return EOK;
+}
+
+/** Copy data from the current address space into pinned buffer.
+ *
+ * @param xfer Pinned buffer.
+ * @param src  Source address.
+ * @param size Number of bytes to copy to the beginning of the buffer.
+ *
+ * @return EOK on success or an error code.
+ *
+ */
+errno_t ipc_xfer_copy_from_uspace(ipc_xfer_t *xfer, uspace_addr_t src,
+    size_t size)
+{
+	assert(size <= xfer->size);
+
+	size_t offset = xfer->offset;
+	for (size_t i = 0; size > 0; i++) {
+		assert(i < xfer->count);
+
+		uintptr_t frame = xfer->frames[i];
+		size_t chunk = min(size, PAGE_SIZE - offset);
+
+		uintptr_t page;
+		if (frame >= config.identity_size) {
+			page = km_map(frame, PAGE_SIZE, PAGE_SIZE,
+			    PAGE_READ | PAGE_WRITE | PAGE_CACHEABLE);
+		} else {
+			page = PA2KA(frame);
+		}
+
+		errno_t rc = copy_from_uspace((void *) (page + offset), src,
+		    chunk);
+
+		if (frame >= config.identity_size)
+			km_unmap(page, PAGE_SIZE);
+
+		if (rc != EOK)
+			return rc;
+
+		src += chunk;
+		size -= chunk;
+		offset = 0;
+	}
+
+	return EOK;
+}
+
+/** Unpin and free pinned buffer.
+ *
+ * @param xfer Pinned buffer.
+ *
+ */
+void ipc_xfer_release(ipc_xfer_t *xfer)
+{
+	/*
+	 * The frames are still accounted to the memory reservation of their
+	 * owner, only the reference is given back.
+	 */
+	for (size_t i = 0; i < xfer->count; i++)
+		frame_free_noreserve(xfer->frames[i], 1);
+
+	free(xfer);
+}
+
+/** @}
+ */
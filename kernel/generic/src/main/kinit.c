@@ -58,6 +58,7 @@
 #include <mm/as.h>
 #include <mm/frame.h>
 #include <mm/km.h>
+#include <mm/zpool.h>
 #include <stdio.h>
 #include <log.h>
 #include <mem.h>
@@ -159,6 +160,14 @@ void kinit(void *arg)
 	else
 		log(LF_OTHER, LVL_ERROR, "Unable to create kload thread");
 
+	/* Start thread zeroing free frames in advance */
+	thread = thread_create(kzpool, NULL, TASK, THREAD_FLAG_NONE,
+	    "kzpool");
+	if (thread != NULL)
+		thread_ready(thread);
+	else
+		log(LF_OTHER, LVL_ERROR, "Unable to create kzpool thread");
+
 #ifdef CONFIG_KCONSOLE
 	if (stdin) {
 		/*
@@ -75,6 +75,7 @@
 #include <mm/as.h>
 #include <mm/slab.h>
 #include <mm/reserve.h>
+#include <mm/zpool.h>
 #include <synch/waitq.h>
 #include <synch/syswaitq.h>
 #include <arch/arch.h>
@@ -254,6 +255,7 @@ void main_bsp_separated_stack(void)
 	ddi_init();
 	ARCH_OP(post_mm_init);
 	reserve_init();
+	zpool_init();
 	ARCH_OP(pre_smp_init);
 	smp_init();
 
@@ -53,6 +53,7 @@
 #include <mm/frame.h>
 #include <mm/slab.h>
 #include <mm/tlb.h>
+#include <cpu/cpu_mask.h>
 #include <arch/mm/page.h>
 #include <genarch/mm/page_pt.h>
 #include <genarch/mm/page_ht.h>
@@ -172,6 +173,18 @@ as_t *as_create(unsigned int flags)
 	if (!as)
 		return NULL;
 
+	if (flags & FLAG_AS_KERNEL) {
+		as->cpu_mask = NULL;
+	} else {
+		as->cpu_mask = (cpu_mask_t *) malloc(cpu_mask_size());
+		if (!as->cpu_mask) {
+			slab_free(as_cache, as);
+			return NULL;
+		}
+
+		cpu_mask_none(as->cpu_mask);
+	}
+
 	(void) as_create_arch(as, 0);
 
 	odict_initialize(&as->as_areas, as_areas_getkey, as_areas_cmp);
@@ -243,6 +256,15 @@ retry:
 		asid_put(as->asid);
 	}
 
+	/*
+	 * The address space is not active anywhere and its ASID, if any,
+	 * has been released and will be purged from all TLBs before it is
+	 * reused. Destroying the areas below therefore does not need to
+	 * involve any other processor.
+	 */
+	if (as->cpu_mask)
+		cpu_mask_none(as->cpu_mask);
+
 	spinlock_unlock(&asidlock);
 	interrupts_restore(ipl);
 
@@ -269,6 +291,7 @@ retry:
 	page_table_destroy(NULL);
 #endif
 
+	free(as->cpu_mask);
 	slab_free(as_cache, as);
 }
 
@@ -468,13 +491,15 @@ _NO_TRACE static bool check_area_conflicts(as_t *as, uintptr_t addr,
  * @param bound   Lowest address bound.
  * @param size    Requested size of the allocation.
  * @param guarded True if the allocation must be protected by guard pages.
+ * @param align   Alignment of the area's start address, a power of two
+ *                not smaller than PAGE_SIZE.
  *
  * @return Address of the beginning of unmapped address space area.
  * @return -1 if no suitable address space area was found.
  *
  */
 _NO_TRACE static uintptr_t as_get_unmapped_area(as_t *as, uintptr_t bound,
-    size_t size, bool guarded)
+    size_t size, bool guarded, uintptr_t align)
 {
 	assert(mutex_locked(&as->lock));
 
@@ -505,6 +530,8 @@ _NO_TRACE static uintptr_t as_get_unmapped_area(as_t *as, uintptr_t bound,
 			addr += P2SZ(1);
 		}
 
+		addr = ALIGN_UP(addr, align);
+
 		if (check_area_conflicts(as, addr, pages, guarded, NULL))
 			return addr;
 	}
@@ -524,6 +551,8 @@ _NO_TRACE static uintptr_t as_get_unmapped_area(as_t *as, uintptr_t bound,
 			addr += P2SZ(1);
 		}
 
+		addr = ALIGN_UP(addr, align);
+
 		bool avail =
 		    ((addr >= bound) && (addr >= area->base) &&
 		    (check_area_conflicts(as, addr, pages, guarded, area)));
@@ -761,7 +790,16 @@ as_area_t *as_area_create(as_t *as, unsigned int flags, size_t size,
 	mutex_lock(&as->lock);
 
 	if (*base == (uintptr_t) AS_AREA_ANY) {
-		*base = as_get_unmapped_area(as, bound, size, guarded);
+		uintptr_t align = PAGE_SIZE;
+#ifdef LARGE_PAGE_WIDTH
+		/*
+		 * Give areas which may use large pages a chance to be
+		 * mapped by them from their very beginning.
+		 */
+		if ((flags & AS_AREA_LARGE_PAGES) && (size >= LARGE_PAGE_SIZE))
+			align = LARGE_PAGE_SIZE;
+#endif
+		*base = as_get_unmapped_area(as, bound, size, guarded, align);
 		if (*base == (uintptr_t) -1) {
 			mutex_unlock(&as->lock);
 			return NULL;
@@ -950,12 +988,18 @@ errno_t as_area_resize(as_t *as, uintptr_t address, size_t size, unsigned int fl
 
 		page_table_lock(as, false);
 
+		/*
+		 * Large pages which straddle the new end of the area must be
+		 * broken up before their tail is unmapped.
+		 */
+		page_mapping_split(as, start_free, P2SZ(area->pages - pages));
+
 		/*
 		 * Start TLB shootdown sequence.
 		 */
 
-		ipl_t ipl = tlb_shootdown_start(TLB_INVL_PAGES,
-		    as->asid, area->base + P2SZ(pages),
+		ipl_t ipl = tlb_shootdown_start_as(as,
+		    TLB_INVL_PAGES, area->base + P2SZ(pages),
 		    area->pages - pages);
 
 		/*
@@ -1101,10 +1145,12 @@ errno_t as_area_destroy(as_t *as, uintptr_t address)
 		area->backend->destroy(area);
 
 	page_table_lock(as, false);
+	page_mapping_split(as, area->base, P2SZ(area->pages));
+
 	/*
 	 * Start TLB shootdown sequence.
 	 */
-	ipl_t ipl = tlb_shootdown_start(TLB_INVL_PAGES, as->asid, area->base,
+	ipl_t ipl = tlb_shootdown_start_as(as, TLB_INVL_PAGES, area->base,
 	    area->pages);
 
 	/*
@@ -1320,6 +1366,35 @@ _NO_TRACE bool as_area_check_access(as_area_t *area, pf_access_t access)
 	return true;
 }
 
+/** Check whether a large page can be mapped in address space area.
+ *
+ * @param area  Address space area.
+ * @param lpage Virtual address of the large page.
+ *
+ * @return True if the area allows large pages, lpage lies entirely within
+ *         the area and no page of lpage is in use yet.
+ *
+ */
+_NO_TRACE bool as_area_large_page_fits(as_area_t *area, uintptr_t lpage)
+{
+	assert(mutex_locked(&area->lock));
+
+#ifdef LARGE_PAGE_WIDTH
+	if (!(area->flags & AS_AREA_LARGE_PAGES))
+		return false;
+
+	if (!IS_ALIGNED(lpage, LARGE_PAGE_SIZE) || (lpage < area->base) ||
+	    (lpage + LARGE_PAGE_SIZE - 1 > area->base + P2SZ(area->pages) - 1))
+		return false;
+
+	used_space_ival_t *ival = used_space_find_gteq(&area->used_space,
+	    lpage);
+	return (ival == NULL) || (ival->page >= lpage + LARGE_PAGE_SIZE);
+#else
+	return false;
+#endif
+}
+
 /** Convert address space area flags to page flags.
  *
  * @param aflags Flags of some address space area.
@@ -1400,11 +1475,12 @@ errno_t as_area_change_flags(as_t *as, unsigned int flags, uintptr_t address)
 	}
 
 	page_table_lock(as, false);
+	page_mapping_split(as, area->base, P2SZ(area->pages));
 
 	/*
 	 * Start TLB shootdown sequence.
 	 */
-	ipl_t ipl = tlb_shootdown_start(TLB_INVL_PAGES, as->asid, area->base,
+	ipl_t ipl = tlb_shootdown_start_as(as, TLB_INVL_PAGES, area->base,
 	    area->pages);
 
 	/*
@@ -1645,6 +1721,14 @@ retry:
 	if (old_as) {
 		assert(old_as->cpu_refcount);
 
+		/*
+		 * Without ASIDs, none of the old address space's TLB entries
+		 * survive the switch, so this processor can stop taking part
+		 * in its shootdowns.
+		 */
+		if (AS_SWITCH_FLUSHES_TLB && old_as->cpu_mask)
+			cpu_mask_reset(old_as->cpu_mask, CPU->id);
+
 		if ((--old_as->cpu_refcount == 0) && (old_as != AS_KERNEL)) {
 			/*
 			 * The old address space is no longer active on
@@ -1675,6 +1759,16 @@ retry:
 			new_as->asid = asid_get();
 	}
 
+	/*
+	 * Make sure TLB shootdowns of the new address space reach this
+	 * processor before it starts using translations of the new address
+	 * space.
+	 */
+	if ((new_as->cpu_mask) && (!cpu_mask_is_set(new_as->cpu_mask, CPU->id))) {
+		cpu_mask_set(new_as->cpu_mask, CPU->id);
+		tlb_shootdown_join();
+	}
+
 #ifdef AS_PAGE_TABLE
 	SET_PTL0_ADDRESS(new_as->genarch.page_table);
 #endif
@@ -40,6 +40,7 @@
 #include <mm/as.h>
 #include <mm/page.h>
 #include <mm/reserve.h>
+#include <mm/zpool.h>
 #include <genarch/mm/page_pt.h>
 #include <genarch/mm/page_ht.h>
 #include <mm/frame.h>
@@ -170,6 +171,154 @@ bool anon_is_shareable(as_area_t *area)
 	return !(area->flags & AS_AREA_LATE_RESERVE);
 }
 
+/** Maximum number of pages mapped ahead of a sequential page fault. */
+#define ANON_FAULT_AROUND_PAGES  8
+
+/** Get a zeroed frame for the anonymous backend.
+ *
+ * @param atomic If true, do not block waiting for memory.
+ *
+ * @return Physical address of the zeroed frame or 0 if atomic is true and
+ *         no frame is readily available.
+ *
+ */
+static uintptr_t anon_zeroed_frame(bool atomic)
+{
+	uintptr_t frame = zpool_get();
+	if (frame != 0)
+		return frame;
+
+	if (atomic) {
+		frame = frame_alloc(1, FRAME_LOWMEM | FRAME_ATOMIC |
+		    FRAME_NO_RESERVE | FRAME_NO_RECLAIM, 0);
+		if (frame != 0)
+			memsetb((void *) PA2KA(frame), PAGE_SIZE, 0);
+		return frame;
+	}
+
+	uintptr_t kpage = km_temporary_page_get(&frame, FRAME_NO_RESERVE);
+	memsetb((void *) kpage, PAGE_SIZE, 0);
+	km_temporary_page_put(kpage);
+
+	return frame;
+}
+
+/** Map pages following a sequentially faulted page.
+ *
+ * If the page preceding upage is already in use, the area is likely being
+ * touched sequentially (e.g. a freshly grown heap), so map up to
+ * ANON_FAULT_AROUND_PAGES of the following unused pages right away to save
+ * the subsequent page faults. Nothing is mapped beyond the end of the area
+ * or the next used page and no memory is waited for.
+ *
+ * Late reserve areas are exempt as their memory is meant to be committed
+ * only when really touched.
+ *
+ * The address space area and page tables must be already locked.
+ *
+ * @param area  Pointer to the address space area.
+ * @param upage Faulting virtual page, already mapped.
+ *
+ */
+static void anon_fault_around(as_area_t *area, uintptr_t upage)
+{
+	if (area->flags & AS_AREA_LATE_RESERVE)
+		return;
+
+	if (upage == area->base)
+		return;
+
+	used_space_ival_t *ival = used_space_find_gteq(&area->used_space,
+	    upage - P2SZ(1));
+	assert(ival != NULL);
+
+	/*
+	 * The interval must cover the previous page and end with upage.
+	 */
+	if ((ival->page > upage - P2SZ(1)) ||
+	    (ival->page + P2SZ(ival->count) != upage + P2SZ(1)))
+		return;
+
+	uintptr_t end = area->base + P2SZ(area->pages);
+	used_space_ival_t *next = used_space_next(ival);
+	if ((next != NULL) && (next->page < end))
+		end = next->page;
+
+	size_t count = min(ANON_FAULT_AROUND_PAGES,
+	    (end - (upage + P2SZ(1))) >> PAGE_WIDTH);
+
+	unsigned int flags = as_area_get_flags(area);
+	size_t mapped;
+	for (mapped = 0; mapped < count; mapped++) {
+		uintptr_t frame = anon_zeroed_frame(true);
+		if (frame == 0)
+			break;
+
+		page_mapping_insert(AS, upage + P2SZ(1 + mapped), frame,
+		    flags);
+	}
+
+	if ((mapped > 0) &&
+	    (!used_space_insert(&area->used_space, upage + P2SZ(1), mapped)))
+		panic("Cannot insert used space.");
+}
+
+/** Try to service a page fault by mapping a whole large page.
+ *
+ * The address space area and page tables must be already locked.
+ *
+ * @param area  Pointer to the address space area.
+ * @param upage Faulting virtual page.
+ *
+ * @return True if the large page containing upage was mapped, false if the
+ *         caller should fall back to mapping a single page.
+ *
+ */
+static bool anon_large_page_fault(as_area_t *area, uintptr_t upage)
+{
+#ifdef LARGE_PAGE_WIDTH
+	uintptr_t lpage = ALIGN_DOWN(upage, LARGE_PAGE_SIZE);
+
+	if (!as_area_large_page_fits(area, lpage))
+		return false;
+
+	if (area->flags & AS_AREA_LATE_RESERVE) {
+		if (!reserve_try_alloc(LARGE_PAGE_PAGES))
+			return false;
+	}
+
+	/*
+	 * Do not wait nor reclaim for the sake of a large page, falling back
+	 * to base pages is cheaper.
+	 */
+	uintptr_t frame = frame_alloc(LARGE_PAGE_PAGES, FRAME_LOWMEM |
+	    FRAME_ATOMIC | FRAME_NO_RESERVE | FRAME_NO_RECLAIM,
+	    LARGE_PAGE_SIZE - 1);
+	if (frame == 0)
+		goto fail;
+
+	memsetb((void *) PA2KA(frame), LARGE_PAGE_SIZE, 0);
+
+	if (!page_mapping_insert_large(AS, lpage, frame,
+	    as_area_get_flags(area))) {
+		frame_free_noreserve(frame, LARGE_PAGE_PAGES);
+		goto fail;
+	}
+
+	if (!used_space_insert(&area->used_space, lpage, LARGE_PAGE_PAGES))
+		panic("Cannot insert used space.");
+
+	return true;
+
+fail:
+	if (area->flags & AS_AREA_LATE_RESERVE)
+		reserve_free(LARGE_PAGE_PAGES);
+	return false;
+#else
+	return false;
+#endif
+}
+
 /** Service a page fault in the anonymous memory address space area.
  *
  * The address space area and page tables must be already locked.
@@ -183,7 +332,6 @@ bool anon_is_shareable(as_area_t *area)
  */
 int anon_page_fault(as_area_t *area, uintptr_t upage, pf_access_t access)
 {
-	uintptr_t kpage;
 	uintptr_t frame;
 
 	assert(page_table_locked(AS));
@@ -194,7 +342,8 @@ int anon_page_fault(as_area_t *area, uintptr_t upage, pf_access_t access)
 		return AS_PF_FAULT;
 
 	mutex_lock(&area->sh_info->lock);
-	if (area->sh_info->shared) {
+	bool shared = area->sh_info->shared;
+	if (shared) {
 		/*
 		 * The area is shared, chances are that the mapping can be found
 		 * in the pagemap of the address space area share info
@@ -206,10 +355,7 @@ int anon_page_fault(as_area_t *area, uintptr_t upage, pf_access_t access)
 		    upage - area->base, &frame);
 		if (rc != EOK) {
 			/* Need to allocate the frame */
-			kpage = km_temporary_page_get(&frame,
-			    FRAME_NO_RESERVE);
-			memsetb((void *) kpage, PAGE_SIZE, 0);
-			km_temporary_page_put(kpage);
+			frame = anon_zeroed_frame(false);
 
 			/*
 			 * Insert the address of the newly allocated
@@ -236,6 +382,11 @@ int anon_page_fault(as_area_t *area, uintptr_t upage, pf_access_t access)
 		 *   the different causes
 		 */
 
+		if (anon_large_page_fault(area, upage)) {
+			mutex_unlock(&area->sh_info->lock);
+			return AS_PF_OK;
+		}
+
 		if (area->flags & AS_AREA_LATE_RESERVE) {
 			/*
 			 * Reserve the memory for this page now.
@@ -246,9 +397,7 @@ int anon_page_fault(as_area_t *area, uintptr_t upage, pf_access_t access)
 			}
 		}
 
-		kpage = km_temporary_page_get(&frame, FRAME_NO_RESERVE);
-		memsetb((void *) kpage, PAGE_SIZE, 0);
-		km_temporary_page_put(kpage);
+		frame = anon_zeroed_frame(false);
 	}
 	mutex_unlock(&area->sh_info->lock);
 
@@ -261,6 +410,9 @@ int anon_page_fault(as_area_t *area, uintptr_t upage, pf_access_t access)
 	if (!used_space_insert(&area->used_space, upage, 1))
 		panic("Cannot insert used space.");
 
+	if (!shared)
+		anon_fault_around(area, upage);
+
 	return AS_PF_OK;
 }
 
@@ -139,6 +139,25 @@ int phys_page_fault(as_area_t *area, uintptr_t upage, pf_access_t access)
 		return AS_PF_FAULT;
 
 	assert(upage - area->base < area->backend_data.frames * FRAME_SIZE);
+
+#ifdef LARGE_PAGE_WIDTH
+	uintptr_t lpage = ALIGN_DOWN(upage, LARGE_PAGE_SIZE);
+	uintptr_t lframe = base + (lpage - area->base);
+
+	if ((lpage >= area->base) && IS_ALIGNED(lframe, LARGE_PAGE_SIZE) &&
+	    (lpage - area->base + LARGE_PAGE_SIZE <=
+	    area->backend_data.frames * FRAME_SIZE) &&
+	    as_area_large_page_fits(area, lpage) &&
+	    page_mapping_insert_large(AS, lpage, lframe,
+	    as_area_get_flags(area))) {
+		if (!used_space_insert(&area->used_space, lpage,
+		    LARGE_PAGE_PAGES))
+			panic("Cannot insert used space.");
+
+		return AS_PF_OK;
+	}
+#endif
+
 	page_mapping_insert(AS, upage, base + (upage - area->base),
 	    as_area_get_flags(area));
 
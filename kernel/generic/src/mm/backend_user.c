@@ -39,6 +39,8 @@
 #include <mm/as.h>
 #include <mm/page.h>
 #include <mm/frame.h>
+#include <mm/km.h>
+#include <mm/reserve.h>
 #include <abi/mm/as.h>
 #include <abi/ipc/methods.h>
 #include <ipc/sysipc.h>
@@ -46,8 +48,10 @@
 #include <typedefs.h>
 #include <align.h>
 #include <assert.h>
+#include <config.h>
 #include <errno.h>
 #include <log.h>
+#include <mem.h>
 #include <str.h>
 
 static bool user_create(as_area_t *);
@@ -95,6 +99,41 @@ bool user_is_shareable(as_area_t *area)
 	return false;
 }
 
+/** Replace a frame shared by the pager with a private copy.
+ *
+ * The copy is allocated with memory reservation, which is released
+ * by user_frame_free().
+ *
+ * @param frame Frame shared by the pager, with a reference held.
+ * @param copy  Place to store the private copy of the frame.
+ *
+ * @return EOK on success or ENOMEM if memory cannot be reserved.
+ */
+static errno_t user_frame_copy(uintptr_t frame, uintptr_t *copy)
+{
+	if (!reserve_try_alloc(1))
+		return ENOMEM;
+
+	uintptr_t dst = km_temporary_page_get(copy, FRAME_NO_RESERVE);
+
+	uintptr_t src;
+	if (frame >= config.identity_size)
+		src = km_map(frame, PAGE_SIZE, PAGE_SIZE, PAGE_READ);
+	else
+		src = PA2KA(frame);
+
+	memcpy((void *) dst, (void *) src, PAGE_SIZE);
+
+	if (frame >= config.identity_size)
+		km_unmap(src, PAGE_SIZE);
+	km_temporary_page_put(dst);
+
+	if (find_zone(ADDR2PFN(frame), 1, 0) != (size_t) -1)
+		frame_free_noreserve(frame, 1);
+
+	return EOK;
+}
+
 /** Service a page fault in the user-paged address space area.
  *
  * The address space area and page tables must be already locked.
@@ -145,6 +184,17 @@ int user_page_fault(as_area_t *area, uintptr_t upage, pf_access_t access)
 	 */
 
 	uintptr_t frame = ipc_get_arg1(&data);
+	unsigned int share_flags = ipc_get_arg2(&data);
+
+	if ((share_flags != 0) && ((area->flags & ~share_flags) &
+	    (AS_AREA_WRITE | AS_AREA_EXEC))) {
+		if (user_frame_copy(frame, &frame) != EOK) {
+			if (find_zone(ADDR2PFN(frame), 1, 0) != (size_t) -1)
+				frame_free_noreserve(frame, 1);
+			return AS_PF_FAULT;
+		}
+	}
+
 	page_mapping_insert(AS, upage, frame, as_area_get_flags(area));
 	if (!used_space_insert(&area->used_space, upage, 1))
 		panic("Cannot insert used space.");
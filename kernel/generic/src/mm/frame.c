@@ -39,11 +39,16 @@
  * This file contains the physical frame allocator and memory zone management.
  * The frame allocator is built on top of the two-level bitmap structure.
  *
+ * Single frame allocations are served from per-CPU caches of free frames
+ * which are refilled from and drained to the zones in batches, so that
+ * most of them do not need to take the global zones lock.
+ *
  */
 
 #include <typedefs.h>
 #include <mm/frame.h>
 #include <mm/reserve.h>
+#include <mm/zpool.h>
 #include <mm/as.h>
 #include <panic.h>
 #include <assert.h>
@@ -61,6 +66,7 @@
 #include <config.h>
 #include <str.h>
 #include <proc/thread.h> /* THREAD */
+#include <cpu.h>
 
 zones_t zones;
 
@@ -166,15 +172,41 @@ _NO_TRACE static size_t frame_total_free_get_internal(void)
 	return total;
 }
 
+/** Get number of free frames held in per-CPU frame caches.
+ *
+ * The result is only approximate as the caches are not locked.
+ *
+ * @return Number of cached frames.
+ *
+ */
+_NO_TRACE static size_t frame_pcache_count(void)
+{
+	size_t total = 0;
+
+	if (cpus == NULL)
+		return 0;
+
+	for (size_t i = 0; i < config.cpu_count; i++) {
+		total += cpus[i].frame_cache.count[0] +
+		    cpus[i].frame_cache.count[1];
+	}
+
+	return total;
+}
+
+_NO_TRACE static size_t frame_pcache_flush_all(void);
+
 _NO_TRACE size_t frame_total_free_get(void)
 {
 	size_t total;
 
+	(void) frame_pcache_flush_all();
+
 	irq_spinlock_lock(&zones.lock, true);
 	total = frame_total_free_get_internal();
 	irq_spinlock_unlock(&zones.lock, true);
 
-	return total;
+	return total + frame_pcache_count();
 }
 
 /** Find a zone with a given frames.
@@ -829,6 +861,296 @@ static size_t try_find_zone(size_t count, bool lowmem,
 	    frame_constraint, hint);
 }
 
+/*************************/
+/* Per-CPU frame caches  */
+/*************************/
+
+/** Initialize per-CPU frame cache.
+ *
+ * @param pcache Frame cache to be initialized.
+ *
+ */
+void frame_pcache_init(frame_pcache_t *pcache)
+{
+	irq_spinlock_initialize(&pcache->lock, "frame.pcache.lock");
+	pcache->count[0] = 0;
+	pcache->count[1] = 0;
+	pcache->pending_count[0] = 0;
+	pcache->pending_count[1] = 0;
+	pcache->hits = 0;
+	pcache->misses = 0;
+}
+
+/** Return frames from per-CPU frame cache to their zones.
+ *
+ * Assume interrupts are disabled and both the cache lock and
+ * zones lock are held.
+ *
+ * @param pcache Frame cache.
+ * @param kind   Kind of frames (0 for low memory, 1 for high memory).
+ * @param count  Number of frames to return.
+ *
+ */
+_NO_TRACE static void frame_pcache_drain(frame_pcache_t *pcache,
+    unsigned int kind, size_t count)
+{
+	size_t hint = 0;
+
+	while ((count > 0) && (pcache->count[kind] > 0)) {
+		pfn_t pfn = pcache->pfn[kind][--pcache->count[kind]];
+
+		hint = find_zone(pfn, 1, hint);
+		assert(hint != (size_t) -1);
+
+		(void) zone_frame_free(&zones.info[hint],
+		    pfn - zones.info[hint].base);
+		count--;
+	}
+}
+
+/** Drop references to frames freed to per-CPU frame cache.
+ *
+ * Assume interrupts are disabled and both the cache lock and
+ * zones lock are held.
+ *
+ * @param pcache  Frame cache.
+ * @param reserve Which batch to release (1 for frames freed with memory
+ *                reservation, 0 for the others).
+ * @param keep    Whether frames which are no longer referenced may be
+ *                kept in the cache instead of returning them to the zones.
+ *
+ * @return Number of frames which are no longer referenced.
+ *
+ */
+_NO_TRACE static size_t frame_pcache_release(frame_pcache_t *pcache,
+    unsigned int reserve, bool keep)
+{
+	size_t hint = 0;
+	size_t freed = 0;
+
+	while (pcache->pending_count[reserve] > 0) {
+		pfn_t pfn =
+		    pcache->pending[reserve][--pcache->pending_count[reserve]];
+
+		hint = find_zone(pfn, 1, hint);
+		assert(hint != (size_t) -1);
+
+		zone_t *zone = &zones.info[hint];
+		frame_t *frame = zone_get_frame(zone, pfn - zone->base);
+		unsigned int kind = (zone->flags & ZONE_HIGHMEM) ? 1 : 0;
+
+		assert(frame->refcount > 0);
+
+		if ((keep) && (frame->refcount == 1) &&
+		    (pcache->count[kind] < FRAME_PCACHE_SIZE)) {
+			/* Keep the frame allocated in the zone and cache it. */
+			pcache->pfn[kind][pcache->count[kind]++] = pfn;
+			freed++;
+		} else {
+			freed += zone_frame_free(zone, pfn - zone->base);
+		}
+	}
+
+	return freed;
+}
+
+/** Drop references to frames pending in all per-CPU frame caches.
+ *
+ * Used so that frames freed recently are accounted as free.
+ *
+ * @return Number of frames which are no longer referenced.
+ *
+ */
+_NO_TRACE static size_t frame_pcache_flush_all(void)
+{
+	size_t flushed = 0;
+
+	if (cpus == NULL)
+		return 0;
+
+	for (size_t i = 0; i < config.cpu_count; i++) {
+		frame_pcache_t *pcache = &cpus[i].frame_cache;
+
+		irq_spinlock_lock(&pcache->lock, true);
+		irq_spinlock_lock(&zones.lock, false);
+
+		flushed += frame_pcache_release(pcache, 0, true);
+		size_t unreserved = frame_pcache_release(pcache, 1, true);
+		flushed += unreserved;
+
+		irq_spinlock_unlock(&zones.lock, false);
+		irq_spinlock_unlock(&pcache->lock, true);
+
+		reserve_free(unreserved);
+	}
+
+	return flushed;
+}
+
+/** Return all frames held in per-CPU frame caches to their zones.
+ *
+ * Used when the zones ran out of free frames.
+ *
+ * @return Number of frames returned.
+ *
+ */
+_NO_TRACE static size_t frame_pcache_drain_all(void)
+{
+	size_t drained = 0;
+
+	if (cpus == NULL)
+		return 0;
+
+	for (size_t i = 0; i < config.cpu_count; i++) {
+		frame_pcache_t *pcache = &cpus[i].frame_cache;
+
+		irq_spinlock_lock(&pcache->lock, true);
+		irq_spinlock_lock(&zones.lock, false);
+
+		drained += pcache->count[0] + pcache->count[1];
+		frame_pcache_drain(pcache, 0, FRAME_PCACHE_SIZE);
+		frame_pcache_drain(pcache, 1, FRAME_PCACHE_SIZE);
+
+		drained += frame_pcache_release(pcache, 0, false);
+		size_t unreserved = frame_pcache_release(pcache, 1, false);
+		drained += unreserved;
+
+		irq_spinlock_unlock(&zones.lock, false);
+		irq_spinlock_unlock(&pcache->lock, true);
+
+		reserve_free(unreserved);
+	}
+
+	return drained;
+}
+
+/** Refill per-CPU frame cache from zones.
+ *
+ * Assume interrupts are disabled and both the cache lock and
+ * zones lock are held.
+ *
+ * @param pcache Frame cache.
+ * @param kind   Kind of frames (0 for low memory, 1 for high memory).
+ *
+ */
+_NO_TRACE static void frame_pcache_refill(frame_pcache_t *pcache,
+    unsigned int kind)
+{
+	zone_flags_t flags = ZONE_AVAILABLE |
+	    ((kind == 0) ? ZONE_LOWMEM : ZONE_HIGHMEM);
+	size_t znum = 0;
+
+	while (pcache->count[kind] < FRAME_PCACHE_BATCH) {
+		znum = find_free_zone(1, flags, 0, znum);
+		if (znum == (size_t) -1)
+			break;
+
+		pfn_t pfn = zone_frame_alloc(&zones.info[znum], 1, 0) +
+		    zones.info[znum].base;
+		pcache->pfn[kind][pcache->count[kind]++] = pfn;
+	}
+}
+
+/** Allocate single frame from per-CPU frame cache.
+ *
+ * @param lowmem Whether the frame must come from low memory.
+ *
+ * @return Physical address of the allocated frame or 0 if the cache
+ *         could not be refilled.
+ *
+ */
+_NO_TRACE static uintptr_t frame_pcache_alloc(bool lowmem)
+{
+	ipl_t ipl = interrupts_disable();
+
+	/* Not possible before the CPU structures are set up */
+	if (CPU == NULL) {
+		interrupts_restore(ipl);
+		return 0;
+	}
+
+	frame_pcache_t *pcache = &CPU->frame_cache;
+	pfn_t pfn = 0;
+
+	irq_spinlock_lock(&pcache->lock, false);
+
+	for (unsigned int kind = lowmem ? 0 : 1; ; kind--) {
+		if (pcache->count[kind] == 0) {
+			pcache->misses++;
+
+			irq_spinlock_lock(&zones.lock, false);
+			frame_pcache_refill(pcache, kind);
+			irq_spinlock_unlock(&zones.lock, false);
+		} else {
+			pcache->hits++;
+		}
+
+		if (pcache->count[kind] > 0) {
+			pfn = pcache->pfn[kind][--pcache->count[kind]];
+			break;
+		}
+
+		if (kind == 0)
+			break;
+	}
+
+	irq_spinlock_unlock(&pcache->lock, false);
+	interrupts_restore(ipl);
+
+	return PFN2ADDR(pfn);
+}
+
+/** Free single frame to per-CPU frame cache.
+ *
+ * The reference to the frame is dropped only when the batch of frames
+ * freed on this CPU is full or when somebody waits for memory. Only then
+ * zones.lock is taken.
+ *
+ * @param pfn   Frame number of the frame to be freed.
+ * @param flags Flags to control memory reservation.
+ * @param freed Place to store the number of frames which are no longer
+ *              referenced.
+ *
+ * @return False if the per-CPU frame cache is not available yet.
+ *
+ */
+_NO_TRACE static bool frame_pcache_free(pfn_t pfn, frame_flags_t flags,
+    size_t *freed)
+{
+	ipl_t ipl = interrupts_disable();
+
+	/* Not possible before the CPU structures are set up */
+	if (CPU == NULL) {
+		interrupts_restore(ipl);
+		return false;
+	}
+
+	frame_pcache_t *pcache = &CPU->frame_cache;
+	unsigned int reserve = (flags & FRAME_NO_RESERVE) ? 0 : 1;
+
+	irq_spinlock_lock(&pcache->lock, false);
+
+	pcache->pending[reserve][pcache->pending_count[reserve]++] = pfn;
+	*freed = 0;
+
+	/*
+	 * Reading mem_avail_req without its mutex is only a hint. A thread
+	 * about to wait for memory flushes all batches after announcing its
+	 * request.
+	 */
+	if ((pcache->pending_count[reserve] == FRAME_PCACHE_BATCH) ||
+	    (mem_avail_req > 0)) {
+		irq_spinlock_lock(&zones.lock, false);
+		*freed = frame_pcache_release(pcache, reserve, true);
+		irq_spinlock_unlock(&zones.lock, false);
+	}
+
+	irq_spinlock_unlock(&pcache->lock, false);
+	interrupts_restore(ipl);
+
+	return true;
+}
+
 /** Allocate frames of physical memory.
  *
  * @param count      Number of continuous frames to allocate.
@@ -854,17 +1176,41 @@ uintptr_t frame_alloc_generic(size_t count, frame_flags_t flags,
 	if (!(flags & FRAME_NO_RESERVE))
 		reserve_force_alloc(count);
 
-loop:
-	irq_spinlock_lock(&zones.lock, true);
-
 	// TODO: Print diagnostic if neither is explicitly specified.
 	bool lowmem = (flags & FRAME_LOWMEM) || !(flags & FRAME_HIGHMEM);
 
+	/*
+	 * Single unconstrained frames come from the per-CPU cache.
+	 */
+	if ((count == 1) && (frame_constraint == 0) && (pzone == NULL)) {
+		uintptr_t addr = frame_pcache_alloc(lowmem);
+		if (addr != 0)
+			return addr;
+	}
+
+loop:
+	irq_spinlock_lock(&zones.lock, true);
+
 	/*
 	 * First, find suitable frame zone.
 	 */
 	size_t znum = try_find_zone(count, lowmem, frame_constraint, hint);
 
+	/*
+	 * Frames may be sitting in the pool of zeroed frames or in per-CPU
+	 * caches. The pool is drained first as it frees into the caches.
+	 */
+	if (znum == (size_t) -1) {
+		irq_spinlock_unlock(&zones.lock, true);
+		size_t drained = zpool_drain();
+		drained += frame_pcache_drain_all();
+		irq_spinlock_lock(&zones.lock, true);
+
+		if (drained > 0)
+			znum = try_find_zone(count, lowmem, frame_constraint,
+			    hint);
+	}
+
 	/*
 	 * If no memory, reclaim some slab memory,
 	 * if it does not help, reclaim all.
@@ -931,6 +1277,19 @@ loop:
 
 		size_t gen = mem_avail_gen;
 
+		mutex_unlock(&mem_avail_mtx);
+		interrupts_restore(ipl);
+
+		/*
+		 * Frames freed before the request was announced may still be
+		 * pending in per-CPU batches. Later frees flush their batches.
+		 */
+		if (frame_pcache_drain_all() > 0)
+			goto loop;
+
+		ipl = interrupts_disable();
+		mutex_lock(&mem_avail_mtx);
+
 		while (gen == mem_avail_gen)
 			condvar_wait(&mem_avail_cv, &mem_avail_mtx);
 
@@ -976,22 +1335,25 @@ void frame_free_generic(uintptr_t start, size_t count, frame_flags_t flags)
 {
 	size_t freed = 0;
 
-	irq_spinlock_lock(&zones.lock, true);
+	if ((count != 1) ||
+	    (!frame_pcache_free(ADDR2PFN(start), flags, &freed))) {
+		irq_spinlock_lock(&zones.lock, true);
 
-	for (size_t i = 0; i < count; i++) {
-		/*
-		 * First, find host frame zone for addr.
-		 */
-		pfn_t pfn = ADDR2PFN(start) + i;
-		size_t znum = find_zone(pfn, 1, 0);
+		for (size_t i = 0; i < count; i++) {
+			/*
+			 * First, find host frame zone for addr.
+			 */
+			pfn_t pfn = ADDR2PFN(start) + i;
+			size_t znum = find_zone(pfn, 1, 0);
 
-		assert(znum != (size_t) -1);
+			assert(znum != (size_t) -1);
 
-		freed += zone_frame_free(&zones.info[znum],
-		    pfn - zones.info[znum].base);
-	}
+			freed += zone_frame_free(&zones.info[znum],
+			    pfn - zones.info[znum].base);
+		}
 
-	irq_spinlock_unlock(&zones.lock, true);
+		irq_spinlock_unlock(&zones.lock, true);
+	}
 
 	/*
 	 * Signal that some memory has been freed.
@@ -1052,6 +1414,39 @@ _NO_TRACE void frame_reference_add(pfn_t pfn)
 	irq_spinlock_unlock(&zones.lock, true);
 }
 
+/** Add reference to frame if it is allocated memory.
+ *
+ * Unlike frame_reference_add(), this can be used on frames which
+ * need not belong to any zone, such as device memory.
+ *
+ * @param pfn Frame number of the frame.
+ *
+ * @return True if the reference was added, false if the frame is not
+ *         an allocated frame of an available zone.
+ *
+ */
+_NO_TRACE bool frame_reference_try_add(pfn_t pfn)
+{
+	bool added = false;
+
+	irq_spinlock_lock(&zones.lock, true);
+
+	size_t znum = find_zone(pfn, 1, 0);
+	if ((znum != (size_t) -1) &&
+	    (zones.info[znum].flags & ZONE_AVAILABLE)) {
+		frame_t *frame =
+		    &zones.info[znum].frames[pfn - zones.info[znum].base];
+		if (frame->refcount > 0) {
+			frame->refcount++;
+			added = true;
+		}
+	}
+
+	irq_spinlock_unlock(&zones.lock, true);
+
+	return added;
+}
+
 /** Mark given range unavailable in frame zones.
  *
  */
@@ -1166,12 +1561,15 @@ uint64_t zones_total_size(void)
 }
 
 void zones_stats(uint64_t *total, uint64_t *unavail, uint64_t *busy,
-    uint64_t *free)
+    uint64_t *free, uint64_t *cached)
 {
 	assert(total != NULL);
 	assert(unavail != NULL);
 	assert(busy != NULL);
 	assert(free != NULL);
+	assert(cached != NULL);
+
+	(void) frame_pcache_flush_all();
 
 	irq_spinlock_lock(&zones.lock, true);
 
@@ -1191,6 +1589,12 @@ void zones_stats(uint64_t *total, uint64_t *unavail, uint64_t *busy,
 	}
 
 	irq_spinlock_unlock(&zones.lock, true);
+
+	/* Cached frames are allocated in the zones, but free */
+	*cached = (uint64_t) FRAMES2SIZE(frame_pcache_count());
+	*cached = min(*cached, *busy);
+	*busy -= *cached;
+	*free += *cached;
 }
 
 /** Prints list of zones.
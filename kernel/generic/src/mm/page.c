@@ -189,6 +189,56 @@ void page_mapping_make_global(uintptr_t base, size_t size)
 	return page_mapping_operations->mapping_make_global(base, size);
 }
 
+/** Insert mapping of large page to physically contiguous frames.
+ *
+ * @param as    Address space to which page belongs.
+ * @param page  Virtual address of the large page, aligned to its size.
+ * @param frame Physical address of the first frame, aligned to the size
+ *              of the large page.
+ * @param flags Flags to be used for mapping.
+ *
+ * @return True if the large page was mapped. False if large pages are
+ *         not supported or the range is already partially mapped, in
+ *         which case the caller must fall back to base pages.
+ *
+ */
+_NO_TRACE bool page_mapping_insert_large(as_t *as, uintptr_t page,
+    uintptr_t frame, unsigned int flags)
+{
+	assert(page_table_locked(as));
+	assert(page_mapping_operations);
+
+	if (!page_mapping_operations->mapping_insert_large)
+		return false;
+
+	bool inserted = page_mapping_operations->mapping_insert_large(as, page,
+	    frame, flags);
+
+	/* Repel prefetched accesses to the old mapping. */
+	memory_barrier();
+
+	return inserted;
+}
+
+/** Replace large page mappings in a range by base page mappings.
+ *
+ * The translations do not change, so no TLB shootdown is needed. Must be
+ * done before any page of a large page mapping is removed individually.
+ *
+ * @param as   Address space.
+ * @param base Start of the range.
+ * @param size Size of the range.
+ *
+ */
+_NO_TRACE void page_mapping_split(as_t *as, uintptr_t base, size_t size)
+{
+	assert(page_table_locked(as));
+	assert(page_mapping_operations);
+
+	if (page_mapping_operations->mapping_split)
+		page_mapping_operations->mapping_split(as, base, size);
+}
+
 errno_t page_find_mapping(uintptr_t virt, uintptr_t *phys)
 {
 	page_table_lock(AS, true);
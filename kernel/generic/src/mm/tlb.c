@@ -35,11 +35,14 @@
  * @brief Generic TLB shootdown algorithm.
  *
  * The algorithm implemented here is based on the CMU TLB shootdown
- * algorithm and is further simplified (e.g. all CPUs receive all TLB
- * shootdown messages).
+ * algorithm and is further simplified (e.g. all CPUs receive the TLB
+ * shootdown IPI). Only processors which may hold TLB entries of the
+ * affected address space, as recorded in its cpu_mask, are sent the
+ * shootdown message and waited for.
  */
 
 #include <mm/tlb.h>
+#include <mm/as.h>
 #include <mm/asid.h>
 #include <arch/mm/tlb.h>
 #include <assert.h>
@@ -51,6 +54,8 @@
 #include <arch.h>
 #include <panic.h>
 #include <cpu.h>
+#include <cpu/cpu_mask.h>
+#include <barrier.h>
 
 void tlb_init(void)
 {
@@ -67,11 +72,15 @@ void tlb_init(void)
  */
 IRQ_SPINLOCK_STATIC_INITIALIZE(tlblock);
 
-/** Send TLB shootdown message.
- *
- * This function attempts to deliver TLB shootdown message
- * to all other processors.
+/**
+ * Page count above which a page range shootdown message is turned into
+ * invalidation of the whole address space on the receiving processors.
+ */
+#define TLB_SHOOTDOWN_PAGES_MAX  64
+
+/** Send TLB shootdown message to selected processors.
  *
+ * @param mask  Processors to notify or NULL for all processors.
  * @param type  Type describing scope of shootdown.
  * @param asid  Address space, if required by type.
  * @param page  Virtual page address, if required by type.
@@ -80,19 +89,36 @@ IRQ_SPINLOCK_STATIC_INITIALIZE(tlblock);
  * @return The interrupt priority level as it existed prior to this call.
  *
  */
-ipl_t tlb_shootdown_start(tlb_invalidate_type_t type, asid_t asid,
-    uintptr_t page, size_t count)
+static ipl_t tlb_shootdown_start_mask(cpu_mask_t *mask,
+    tlb_invalidate_type_t type, asid_t asid, uintptr_t page, size_t count)
 {
 	ipl_t ipl = interrupts_disable();
 	CPU->tlb_active = false;
 	irq_spinlock_lock(&tlblock, false);
 
+	/*
+	 * Pairs with the barrier in tlb_shootdown_join(). Either the joining
+	 * processor sees tlblock held, or we see its bit in the mask.
+	 */
+	memory_barrier();
+
+	if ((type == TLB_INVL_PAGES) && (count > TLB_SHOOTDOWN_PAGES_MAX)) {
+		type = TLB_INVL_ASID;
+		page = 0;
+		count = 0;
+	}
+
+	bool notify = false;
 	size_t i;
 	for (i = 0; i < config.cpu_count; i++) {
 		if (i == CPU->id)
 			continue;
 
+		if ((mask) && (!cpu_mask_is_set(mask, i)))
+			continue;
+
 		cpu_t *cpu = &cpus[i];
+		notify = true;
 
 		irq_spinlock_lock(&cpu->lock, false);
 		if (cpu->tlb_messages_count == TLB_MESSAGE_QUEUE_LEN) {
@@ -118,10 +144,17 @@ ipl_t tlb_shootdown_start(tlb_invalidate_type_t type, asid_t asid,
 		irq_spinlock_unlock(&cpu->lock, false);
 	}
 
+	/* Nobody else may hold stale translations */
+	if (!notify)
+		return ipl;
+
 	tlb_shootdown_ipi_send();
 
 busy_wait:
 	for (i = 0; i < config.cpu_count; i++) {
+		if ((mask) && (!cpu_mask_is_set(mask, i)))
+			continue;
+
 		if (cpus[i].tlb_active)
 			goto busy_wait;
 	}
@@ -129,6 +162,65 @@ busy_wait:
 	return ipl;
 }
 
+/** Send TLB shootdown message.
+ *
+ * This function attempts to deliver TLB shootdown message
+ * to all other processors.
+ *
+ * @param type  Type describing scope of shootdown.
+ * @param asid  Address space, if required by type.
+ * @param page  Virtual page address, if required by type.
+ * @param count Number of pages, if required by type.
+ *
+ * @return The interrupt priority level as it existed prior to this call.
+ *
+ */
+ipl_t tlb_shootdown_start(tlb_invalidate_type_t type, asid_t asid,
+    uintptr_t page, size_t count)
+{
+	return tlb_shootdown_start_mask(NULL, type, asid, page, count);
+}
+
+/** Send TLB shootdown message for an address space.
+ *
+ * Only processors which may hold TLB entries of @a as are
+ * sent the message.
+ *
+ * @param as    Address space whose translations changed.
+ * @param type  Type describing scope of shootdown.
+ * @param page  Virtual page address, if required by type.
+ * @param count Number of pages, if required by type.
+ *
+ * @return The interrupt priority level as it existed prior to this call.
+ *
+ */
+ipl_t tlb_shootdown_start_as(as_t *as, tlb_invalidate_type_t type,
+    uintptr_t page, size_t count)
+{
+	return tlb_shootdown_start_mask(as->cpu_mask, type, as->asid, page,
+	    count);
+}
+
+/** Join TLB shootdowns of an address space.
+ *
+ * Called by a processor which has just added itself to the cpu_mask of
+ * an address space it is about to start using. If a shootdown is in
+ * progress which may not have seen the updated mask, wait for it to
+ * finish so that no stale translation can be loaded.
+ *
+ * Interrupts must be disabled.
+ *
+ */
+void tlb_shootdown_join(void)
+{
+	memory_barrier();
+
+	CPU->tlb_active = false;
+	irq_spinlock_lock(&tlblock, false);
+	irq_spinlock_unlock(&tlblock, false);
+	CPU->tlb_active = true;
+}
+
 /** Finish TLB shootdown sequence.
  *
  * @param ipl Previous interrupt priority level.
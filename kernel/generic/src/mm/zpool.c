@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup kernel_generic_mm
+ * @{
+ */
+
+/**
+ * @file
+ * @brief Pool of pre-zeroed frames.
+ *
+ * Anonymous memory must be handed to user space zeroed. Instead of zeroing
+ * each frame in the page fault handler, the kzpool thread zeroes free frames
+ * ahead of time when the processor has nothing better to do and keeps them
+ * in a small pool.
+ *
+ * The frames in the pool are allocated without a reservation, just like the
+ * frames allocated by the anonymous backend, which have been reserved at
+ * area creation time. When the frame allocator runs out of memory, it drains
+ * the pool before it resorts to reclaiming slab memory.
+ */
+
+#include <assert.h>
+#include <mm/zpool.h>
+#include <mm/frame.h>
+#include <mm/page.h>
+#include <synch/spinlock.h>
+#include <synch/waitq.h>
+#include <proc/thread.h>
+#include <atomic.h>
+#include <mem.h>
+#include <cpu.h>
+#include <arch.h>
+
+/** Do not take more free frames than this many times the pool size. */
+#define ZPOOL_FREE_MIN  (4 * ZPOOL_SIZE)
+
+/** How long to step aside when other threads are ready, in microseconds. */
+#define ZPOOL_BACKOFF  1000
+
+IRQ_SPINLOCK_STATIC_INITIALIZE_NAME(zpool_lock, "zpool_lock");
+
+static uintptr_t zpool[ZPOOL_SIZE];
+static size_t zpool_count = 0;
+
+/** True if the zeroing thread has been woken up and not yet gone to sleep. */
+static bool zpool_refilling = false;
+
+static waitq_t zpool_wq;
+
+void zpool_init(void)
+{
+	waitq_initialize(&zpool_wq);
+}
+
+/** Take a zeroed frame from the pool.
+ *
+ * The frame is not reserved, the caller must have reserved the memory
+ * by other means.
+ *
+ * @return Physical address of a zeroed frame or 0 if the pool is empty.
+ *
+ */
+uintptr_t zpool_get(void)
+{
+	uintptr_t frame = 0;
+	bool wakeup = false;
+
+	irq_spinlock_lock(&zpool_lock, true);
+
+	if (zpool_count > 0)
+		frame = zpool[--zpool_count];
+
+	if ((zpool_count < ZPOOL_LOW) && (!zpool_refilling)) {
+		zpool_refilling = true;
+		wakeup = true;
+	}
+
+	irq_spinlock_unlock(&zpool_lock, true);
+
+	if (wakeup)
+		waitq_wakeup(&zpool_wq, WAKEUP_FIRST);
+
+	return frame;
+}
+
+/** Give all frames in the pool back to the frame allocator.
+ *
+ * @return Number of frames released.
+ *
+ */
+size_t zpool_drain(void)
+{
+	size_t drained = 0;
+
+	while (true) {
+		uintptr_t frame = 0;
+
+		irq_spinlock_lock(&zpool_lock, true);
+		if (zpool_count > 0)
+			frame = zpool[--zpool_count];
+		irq_spinlock_unlock(&zpool_lock, true);
+
+		if (frame == 0)
+			break;
+
+		frame_free_noreserve(frame, 1);
+		drained++;
+	}
+
+	return drained;
+}
+
+/** Add a zeroed frame to the pool.
+ *
+ * @param frame Physical address of the frame.
+ *
+ * @return False if the pool is full.
+ *
+ */
+static bool zpool_put(uintptr_t frame)
+{
+	bool added = false;
+
+	irq_spinlock_lock(&zpool_lock, true);
+	if (zpool_count < ZPOOL_SIZE) {
+		zpool[zpool_count++] = frame;
+		added = true;
+	}
+	irq_spinlock_unlock(&zpool_lock, true);
+
+	return added;
+}
+
+/** Frame zeroing thread.
+ *
+ * Refill the pool whenever it drops below the low watermark. The thread
+ * steps aside whenever other threads are ready to run on its processor and
+ * leaves the memory alone when free frames are scarce.
+ *
+ * @param arg Unused.
+ *
+ */
+void kzpool(void *arg)
+{
+	thread_detach(THREAD);
+
+	while (true) {
+		waitq_sleep(&zpool_wq);
+
+		while (true) {
+			if (atomic_load(&CPU->nrdy) > 0) {
+				thread_usleep(ZPOOL_BACKOFF);
+				continue;
+			}
+
+			if (frame_total_free_get() < ZPOOL_FREE_MIN)
+				break;
+
+			uintptr_t frame = frame_alloc(1, FRAME_LOWMEM |
+			    FRAME_ATOMIC | FRAME_NO_RESERVE | FRAME_NO_RECLAIM,
+			    0);
+			if (frame == 0)
+				break;
+
+			memsetb((void *) PA2KA(frame), FRAME_SIZE, 0);
+
+			if (!zpool_put(frame)) {
+				frame_free_noreserve(frame, 1);
+				break;
+			}
+		}
+
+		irq_spinlock_lock(&zpool_lock, true);
+		zpool_refilling = false;
+		irq_spinlock_unlock(&zpool_lock, true);
+	}
+}
+
+/** @}
+ */
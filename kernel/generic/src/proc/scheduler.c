@@ -59,6 +59,7 @@
 #include <halt.h>
 #include <arch.h>
 #include <adt/list.h>
+#include <bitops.h>
 #include <panic.h>
 #include <cpu.h>
 #include <stdio.h>
@@ -172,6 +173,123 @@ void scheduler_init(void)
 {
 }
 
+#ifdef CONFIG_SMP
+
+/** Time in microseconds for which a descheduled thread is cache-hot. */
+#define STEAL_CACHE_HOT_US  500
+
+/** Check whether a ready thread is likely to still have a warm cache.
+ *
+ * @param thread Ready thread, locked.
+ * @param cpu    CPU whose frequency is used to convert cycles to time.
+ *
+ */
+static bool thread_cache_hot(thread_t *thread, cpu_t *cpu)
+{
+	if (cpu->frequency_mhz == 0)
+		return false;
+
+	uint64_t cycle = get_cycle();
+	if (cycle < thread->last_cycle)
+		return false;
+
+	return (cycle - thread->last_cycle <
+	    (uint64_t) cpu->frequency_mhz * STEAL_CACHE_HOT_US);
+}
+
+/** Steal a ready thread from another CPU
+ *
+ * Called when the current CPU runs out of ready threads, so that it
+ * does not have to sleep until kcpulb gets to balance the load. Busy CPUs
+ * are searched in the order of their distance from the current CPU, so
+ * that threads preferably stay close to the caches they last ran on.
+ * Just like kcpulb, the least priority queues are searched first and
+ * each queue is searched from the back. Threads that ran on the victim
+ * very recently are left alone, as they are cheaper to run there.
+ *
+ * interrupts_disable() is assumed.
+ *
+ * @return Stolen thread ready to be run on the current CPU or NULL.
+ *
+ */
+static thread_t *steal_thread(void)
+{
+	/*
+	 * Active CPUs need not have contiguous IDs, so go through all of
+	 * them and skip those which are not active.
+	 */
+	size_t count = config.cpu_count;
+
+	for (size_t dist = 1; dist < count; dist++) {
+		cpu_t *cpu = &cpus[(CPU->id + dist) % count];
+
+		if ((!cpu->active) || (cpu->idle) ||
+		    (atomic_load(&cpu->nrdy) == 0))
+			continue;
+
+		for (int rq = RQ_COUNT - 1; rq >= 0; rq--) {
+			if ((atomic_load_explicit(&cpu->rq_ready,
+			    memory_order_relaxed) & RQ_BIT(rq)) == 0)
+				continue;
+
+			irq_spinlock_lock(&(cpu->rq[rq].lock), false);
+
+			link_t *link = cpu->rq[rq].rq.head.prev;
+			while (link != &(cpu->rq[rq].rq.head)) {
+				thread_t *thread = list_get_instance(link,
+				    thread_t, rq_link);
+
+				irq_spinlock_lock(&thread->lock, false);
+
+				if ((!thread->wired) && (!thread->stolen) &&
+				    (!thread->nomigrate) &&
+				    (!thread->fpu_context_engaged) &&
+				    (!thread_cache_hot(thread, cpu))) {
+					atomic_dec(&cpu->nrdy);
+					atomic_dec(&nrdy);
+					if (--cpu->rq[rq].n == 0) {
+						atomic_fetch_and_explicit(
+						    &cpu->rq_ready, ~RQ_BIT(rq),
+						    memory_order_relaxed);
+					}
+					list_remove(&thread->rq_link);
+
+					irq_spinlock_unlock(&(cpu->rq[rq].lock),
+					    false);
+
+					thread->cpu = CPU;
+					thread->ticks = us2ticks((rq + 1) * 10000);
+					thread->priority = rq;
+
+					/*
+					 * Just like kcpulb does, keep the thread
+					 * on this CPU until it is next taken
+					 * from the local run queue, so that it
+					 * does not bounce between CPUs.
+					 */
+					thread->stolen = true;
+					irq_spinlock_unlock(&thread->lock, false);
+
+					irq_spinlock_lock(&CPU->lock, false);
+					CPU->idle_steals++;
+					irq_spinlock_unlock(&CPU->lock, false);
+
+					return thread;
+				}
+
+				irq_spinlock_unlock(&thread->lock, false);
+				link = link->prev;
+			}
+
+			irq_spinlock_unlock(&(cpu->rq[rq].lock), false);
+		}
+	}
+
+	return NULL;
+}
+
+#endif /* CONFIG_SMP */
+
 /** Get thread to be scheduled
  *
  * Get the optimal thread to be scheduled
@@ -188,6 +306,12 @@ static thread_t *find_best_thread(void)
 loop:
 
 	if (atomic_load(&CPU->nrdy) == 0) {
+#ifdef CONFIG_SMP
+		thread_t *stolen = steal_thread();
+		if (stolen)
+			return stolen;
+#endif
+
 		/*
 		 * For there was nothing to run, the CPU goes to sleep
 		 * until a hardware interrupt or an IPI comes.
@@ -210,20 +334,32 @@ loop:
 
 	assert(!CPU->idle);
 
-	unsigned int i;
-	for (i = 0; i < RQ_COUNT; i++) {
+	/*
+	 * The highest-priority non-empty queue is the least significant bit
+	 * set in the bitmap. The bitmap may be stale until the queue is
+	 * locked, so an empty queue is only dropped from the local copy.
+	 */
+	unsigned int ready = atomic_load_explicit(&CPU->rq_ready,
+	    memory_order_relaxed);
+	while (ready != 0) {
+		unsigned int i = fnzb32(ready & -ready);
+
 		irq_spinlock_lock(&(CPU->rq[i].lock), false);
 		if (CPU->rq[i].n == 0) {
 			/*
 			 * If this queue is empty, try a lower-priority queue.
 			 */
 			irq_spinlock_unlock(&(CPU->rq[i].lock), false);
+			ready &= ~RQ_BIT(i);
 			continue;
 		}
 
 		atomic_dec(&CPU->nrdy);
 		atomic_dec(&nrdy);
-		CPU->rq[i].n--;
+		if (--CPU->rq[i].n == 0) {
+			atomic_fetch_and_explicit(&CPU->rq_ready, ~RQ_BIT(i),
+			    memory_order_relaxed);
+		}
 
 		/*
 		 * Take the first thread from the queue.
@@ -278,6 +414,8 @@ static void relink_rq(int start)
 			list_concat(&list, &CPU->rq[i + 1].rq);
 			size_t n = CPU->rq[i + 1].n;
 			CPU->rq[i + 1].n = 0;
+			atomic_fetch_and_explicit(&CPU->rq_ready,
+			    ~RQ_BIT(i + 1), memory_order_relaxed);
 			irq_spinlock_unlock(&CPU->rq[i + 1].lock, false);
 
 			/* Append rq[i + 1] to rq[i] */
@@ -285,6 +423,10 @@ static void relink_rq(int start)
 			irq_spinlock_lock(&CPU->rq[i].lock, false);
 			list_concat(&CPU->rq[i].rq, &list);
 			CPU->rq[i].n += n;
+			if (CPU->rq[i].n > 0) {
+				atomic_fetch_or_explicit(&CPU->rq_ready,
+				    RQ_BIT(i), memory_order_relaxed);
+			}
 			irq_spinlock_unlock(&CPU->rq[i].lock, false);
 		}
 
@@ -315,8 +457,13 @@ void scheduler(void)
 	if (THREAD) {
 		irq_spinlock_lock(&THREAD->lock, false);
 
-		/* Update thread kernel accounting */
-		THREAD->kcycles += get_cycle() - THREAD->last_cycle;
+		/*
+		 * Update thread kernel accounting and remember when the
+		 * thread stopped running (see steal_thread()).
+		 */
+		uint64_t cycle = get_cycle();
+		THREAD->kcycles += cycle - THREAD->last_cycle;
+		THREAD->last_cycle = cycle;
 
 #if (defined CONFIG_FPU) && (!defined CONFIG_FPU_LAZY)
 		fpu_context_save(THREAD->saved_fpu_context);
@@ -600,6 +747,10 @@ not_satisfied:
 			if (atomic_load(&cpu->nrdy) <= average)
 				continue;
 
+			if ((atomic_load_explicit(&cpu->rq_ready,
+			    memory_order_relaxed) & RQ_BIT(rq)) == 0)
+				continue;
+
 			irq_spinlock_lock(&(cpu->rq[rq].lock), true);
 			if (cpu->rq[rq].n == 0) {
 				irq_spinlock_unlock(&(cpu->rq[rq].lock), true);
@@ -635,7 +786,11 @@ not_satisfied:
 					atomic_dec(&cpu->nrdy);
 					atomic_dec(&nrdy);
 
-					cpu->rq[rq].n--;
+					if (--cpu->rq[rq].n == 0) {
+						atomic_fetch_and_explicit(
+						    &cpu->rq_ready, ~RQ_BIT(rq),
+						    memory_order_relaxed);
+					}
 					list_remove(&thread->rq_link);
 
 					break;
@@ -669,6 +824,10 @@ not_satisfied:
 				irq_spinlock_unlock(&thread->lock, true);
 				thread_ready(thread);
 
+				irq_spinlock_lock(&CPU->lock, true);
+				CPU->lb_steals++;
+				irq_spinlock_unlock(&CPU->lock, true);
+
 				if (--count == 0)
 					goto satisfied;
 
@@ -314,7 +314,10 @@ void thread_ready(thread_t *thread)
 	 */
 
 	list_append(&thread->rq_link, &cpu->rq[i].rq);
-	cpu->rq[i].n++;
+	if (cpu->rq[i].n++ == 0) {
+		atomic_fetch_or_explicit(&cpu->rq_ready, RQ_BIT(i),
+		    memory_order_relaxed);
+	}
 	irq_spinlock_unlock(&(cpu->rq[i].lock), true);
 
 	atomic_inc(&nrdy);
@@ -125,8 +125,15 @@ static void *get_stats_cpus(struct sysinfo_item *item, size_t *size,
 		stats_cpus[i].frequency_mhz = cpus[i].frequency_mhz;
 		stats_cpus[i].busy_cycles = cpus[i].busy_cycles;
 		stats_cpus[i].idle_cycles = cpus[i].idle_cycles;
+		stats_cpus[i].idle_steals = cpus[i].idle_steals;
+		stats_cpus[i].lb_steals = cpus[i].lb_steals;
 
 		irq_spinlock_unlock(&cpus[i].lock, true);
+
+		irq_spinlock_lock(&cpus[i].frame_cache.lock, true);
+		stats_cpus[i].frame_cache_hits = cpus[i].frame_cache.hits;
+		stats_cpus[i].frame_cache_misses = cpus[i].frame_cache.misses;
+		irq_spinlock_unlock(&cpus[i].frame_cache.lock, true);
 	}
 
 	return ((void *) stats_cpus);
@@ -785,7 +792,8 @@ static void *get_stats_physmem(struct sysinfo_item *item, size_t *size,
 	}
 
 	zones_stats(&(stats_physmem->total), &(stats_physmem->unavail),
-	    &(stats_physmem->used), &(stats_physmem->free));
+	    &(stats_physmem->used), &(stats_physmem->free),
+	    &(stats_physmem->cached));
 
 	return ((void *) stats_physmem);
 }
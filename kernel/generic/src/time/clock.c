@@ -163,16 +163,18 @@ void clock(void)
 
 		irq_spinlock_lock(&CPU->timeoutlock, false);
 
+		uint64_t tick = CPU->timeout_tick;
+		if ((tick & TIMEOUT_WHEEL_MASK) == 0)
+			timeout_cascade(tick);
+
+		list_t *slot = &CPU->timeout_wheel[0][tick & TIMEOUT_WHEEL_MASK];
+
 		link_t *cur;
-		while ((cur = list_first(&CPU->timeout_active_list)) != NULL) {
+		while ((cur = list_first(slot)) != NULL) {
 			timeout_t *timeout = list_get_instance(cur, timeout_t,
 			    link);
 
 			irq_spinlock_lock(&timeout->lock, false);
-			if (timeout->ticks-- != 0) {
-				irq_spinlock_unlock(&timeout->lock, false);
-				break;
-			}
 
 			list_remove(cur);
 			timeout_handler_t handler = timeout->handler;
@@ -187,6 +189,7 @@ void clock(void)
 			irq_spinlock_lock(&CPU->timeoutlock, false);
 		}
 
+		CPU->timeout_tick = tick + 1;
 		irq_spinlock_unlock(&CPU->timeoutlock, false);
 	}
 	CPU->missed_clock_ticks = 0;
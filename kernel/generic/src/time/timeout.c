@@ -33,8 +33,16 @@
 /**
  * @file
  * @brief Timeout management functions.
+ *
+ * Active timeouts of each processor are kept in a hierarchical timing
+ * wheel. Level 0 has one slot for each of the next TIMEOUT_WHEEL_SLOTS
+ * clock ticks, each higher level has slots covering TIMEOUT_WHEEL_SLOTS
+ * times more ticks than the level below it. Registering and unregistering
+ * a timeout is O(1). Whenever level 0 wraps around, clock() cascades the
+ * timeouts from the current slot of the next level down to lower levels.
  */
 
+#include <assert.h>
 #include <time/timeout.h>
 #include <typedefs.h>
 #include <config.h>
@@ -53,7 +61,13 @@
 void timeout_init(void)
 {
 	irq_spinlock_initialize(&CPU->timeoutlock, "cpu.timeoutlock");
-	list_initialize(&CPU->timeout_active_list);
+
+	for (unsigned int i = 0; i < TIMEOUT_WHEEL_LEVELS; i++) {
+		for (unsigned int j = 0; j < TIMEOUT_WHEEL_SLOTS; j++)
+			list_initialize(&CPU->timeout_wheel[i][j]);
+	}
+
+	CPU->timeout_tick = 0;
 }
 
 /** Reinitialize timeout
@@ -66,7 +80,7 @@ void timeout_init(void)
 void timeout_reinitialize(timeout_t *timeout)
 {
 	timeout->cpu = NULL;
-	timeout->ticks = 0;
+	timeout->deadline = 0;
 	timeout->handler = NULL;
 	timeout->arg = NULL;
 	link_initialize(&timeout->link);
@@ -85,6 +99,82 @@ void timeout_initialize(timeout_t *timeout)
 	timeout_reinitialize(timeout);
 }
 
+/** Insert timeout into the timing wheel of a processor
+ *
+ * The timeout is placed to the lowest level of the wheel whose range
+ * covers its deadline.
+ *
+ * @param cpu     Processor whose wheel to use, its timeoutlock held.
+ * @param timeout Timeout with deadline set, its lock held.
+ *
+ */
+static void timeout_wheel_insert(cpu_t *cpu, timeout_t *timeout)
+{
+	uint64_t deadline = timeout->deadline;
+	uint64_t delta;
+	unsigned int level;
+
+	assert(irq_spinlock_locked(&cpu->timeoutlock));
+
+	/* Never insert into a slot which has already been processed */
+	if (deadline < cpu->timeout_tick)
+		deadline = cpu->timeout_tick;
+
+	delta = deadline - cpu->timeout_tick;
+	for (level = 0; level < TIMEOUT_WHEEL_LEVELS - 1; level++) {
+		if (delta < ((uint64_t) 1 << ((level + 1) * TIMEOUT_WHEEL_BITS)))
+			break;
+	}
+
+	/*
+	 * Timeouts beyond the range of the wheel wait in the farthest slot
+	 * of the top level and get cascaded until they come into range.
+	 */
+	if (delta >= ((uint64_t) 1 << (TIMEOUT_WHEEL_LEVELS *
+	    TIMEOUT_WHEEL_BITS))) {
+		deadline = cpu->timeout_tick + ((uint64_t) 1 <<
+		    (TIMEOUT_WHEEL_LEVELS * TIMEOUT_WHEEL_BITS)) - 1;
+	}
+
+	size_t slot = (deadline >> (level * TIMEOUT_WHEEL_BITS)) &
+	    TIMEOUT_WHEEL_MASK;
+	list_append(&timeout->link, &cpu->timeout_wheel[level][slot]);
+}
+
+/** Cascade timeouts from higher levels of the timing wheel
+ *
+ * Must be called by clock() with CPU->timeoutlock held whenever level 0
+ * of the wheel wraps around, i.e. before the tick @a tick with zero low
+ * bits is processed.
+ *
+ * @param tick Clock tick which is about to be processed.
+ *
+ */
+void timeout_cascade(uint64_t tick)
+{
+	assert(irq_spinlock_locked(&CPU->timeoutlock));
+
+	for (unsigned int level = 1; level < TIMEOUT_WHEEL_LEVELS; level++) {
+		size_t slot = (tick >> (level * TIMEOUT_WHEEL_BITS)) &
+		    TIMEOUT_WHEEL_MASK;
+		list_t *list = &CPU->timeout_wheel[level][slot];
+
+		while (!list_empty(list)) {
+			timeout_t *timeout = list_get_instance(list_first(list),
+			    timeout_t, link);
+
+			irq_spinlock_lock(&timeout->lock, false);
+			list_remove(&timeout->link);
+			timeout_wheel_insert(CPU, timeout);
+			irq_spinlock_unlock(&timeout->lock, false);
+		}
+
+		/* Higher level only advances when this one wraps around */
+		if (slot != 0)
+			break;
+	}
+}
+
 /** Register timeout
  *
  * Insert timeout handler f (with argument arg)
@@ -107,49 +197,12 @@ void timeout_register(timeout_t *timeout, uint64_t time,
 		panic("Unexpected: timeout->cpu != 0.");
 
 	timeout->cpu = CPU;
-	timeout->ticks = us2ticks(time);
+	timeout->deadline = CPU->timeout_tick + us2ticks(time);
 
 	timeout->handler = handler;
 	timeout->arg = arg;
 
-	/*
-	 * Insert timeout into the active timeouts list according to timeout->ticks.
-	 */
-	uint64_t sum = 0;
-	timeout_t *target = NULL;
-	link_t *cur;
-	for (cur = CPU->timeout_active_list.head.next;
-	    cur != &CPU->timeout_active_list.head; cur = cur->next) {
-		target = list_get_instance(cur, timeout_t, link);
-		irq_spinlock_lock(&target->lock, false);
-
-		if (timeout->ticks < sum + target->ticks) {
-			irq_spinlock_unlock(&target->lock, false);
-			break;
-		}
-
-		sum += target->ticks;
-		irq_spinlock_unlock(&target->lock, false);
-	}
-
-	/* Avoid using cur->prev directly */
-	link_t *prev = cur->prev;
-	list_insert_after(&timeout->link, prev);
-
-	/*
-	 * Adjust timeout->ticks according to ticks
-	 * accumulated in target's predecessors.
-	 */
-	timeout->ticks -= sum;
-
-	/*
-	 * Decrease ticks of timeout's immediate succesor by timeout->ticks.
-	 */
-	if (cur != &CPU->timeout_active_list.head) {
-		irq_spinlock_lock(&target->lock, false);
-		target->ticks -= timeout->ticks;
-		irq_spinlock_unlock(&target->lock, false);
-	}
+	timeout_wheel_insert(CPU, timeout);
 
 	irq_spinlock_unlock(&timeout->lock, false);
 	irq_spinlock_unlock(&CPU->timeoutlock, true);
@@ -183,17 +236,9 @@ grab_locks:
 
 	/*
 	 * Now we know for sure that timeout hasn't been activated yet
-	 * and is lurking in timeout->cpu->timeout_active_list.
+	 * and is lurking in timeout->cpu->timeout_wheel.
 	 */
 
-	link_t *cur = timeout->link.next;
-	if (cur != &timeout->cpu->timeout_active_list.head) {
-		timeout_t *tmp = list_get_instance(cur, timeout_t, link);
-		irq_spinlock_lock(&tmp->lock, false);
-		tmp->ticks += timeout->ticks;
-		irq_spinlock_unlock(&tmp->lock, false);
-	}
-
 	list_remove(&timeout->link);
 	irq_spinlock_unlock(&timeout->cpu->timeoutlock, false);
 
@@ -37,7 +37,6 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
-#include <dirent.h>
 #include <getopt.h>
 #include <vfs/vfs.h>
 #include <str.h>
@@ -69,8 +68,8 @@ static errno_t ls_print(struct dir_elem_t *);
 static errno_t ls_print_single_column(struct dir_elem_t *);
 static int ls_cmp_type_name(const void *, const void *);
 static int ls_cmp_name(const void *, const void *);
-static signed int ls_scan_dir(const char *, DIR *, struct dir_elem_t **);
-static unsigned int ls_recursive(const char *, DIR *);
+static signed int ls_scan_dir(const char *, int, struct dir_elem_t **);
+static unsigned int ls_recursive(const char *, int);
 static unsigned int ls_scope(const char *, struct dir_elem_t *);
 
 static unsigned int ls_start(ls_job_t *ls)
@@ -182,16 +181,53 @@ static int ls_cmp_name(const void *a, const void *b)
 	return str_cmp(da->name, db->name);
 }
 
+/** Open a directory for listing.
+ *
+ * @param path	Name of the directory.
+ * @param fd	Place to store the file handle of the directory.
+ *
+ * @return	EOK on success or an error code.
+ */
+static errno_t ls_open_dir(const char *path, int *fd)
+{
+	return vfs_lookup_open(path, WALK_DIRECTORY, MODE_READ, fd);
+}
+
+/** Fill in the attributes of a directory entry.
+ *
+ * The attributes come along with the entry unless the file system could
+ * not provide them, in which case the entry is looked up separately.
+ *
+ * @param path	Path of the entry.
+ * @param de	Directory entry record.
+ * @param s	Place to store the attributes.
+ *
+ * @return	EOK on success or an error code.
+ */
+static errno_t ls_entry_stat(const char *path, vfs_dirent_t *de,
+    vfs_stat_t *s)
+{
+	if (de->type == VFS_DIRENT_UNKNOWN)
+		return vfs_stat_path(path, s);
+
+	memset(s, 0, sizeof(*s));
+	s->index = de->index;
+	s->is_file = (de->type == VFS_DIRENT_FILE);
+	s->is_directory = (de->type == VFS_DIRENT_DIRECTORY);
+	s->size = de->size;
+	return EOK;
+}
+
 /** Scan a directory.
  *
  * Scan the content of a directory and print it.
  *
  * @param d		Name of the directory.
- * @param dirp	Directory stream.
+ * @param fd	File handle of the open directory.
  * @param sort	1 if the output must be sorted,
  *				0 otherwise.
  */
-static signed int ls_scan_dir(const char *d, DIR *dirp,
+static signed int ls_scan_dir(const char *d, int fd,
     struct dir_elem_t **dir_list_ptr)
 {
 	int alloc_blocks = 20;
@@ -200,11 +236,15 @@ static signed int ls_scan_dir(const char *d, DIR *dirp,
 	errno_t rc;
 	int len;
 	char *buff;
+	uint8_t *dbuf;
+	aoff64_t pos = 0;
+	size_t nread;
+	size_t off;
 	struct dir_elem_t *tmp;
 	struct dir_elem_t *tosort;
-	struct dirent *dp;
+	vfs_dirent_t *dp;
 
-	if (!dirp)
+	if (fd < 0)
 		return -1;
 
 	buff = (char *) malloc(PATH_MAX);
@@ -213,14 +253,33 @@ static signed int ls_scan_dir(const char *d, DIR *dirp,
 		return -1;
 	}
 
+	dbuf = (uint8_t *) malloc(LS_DIRBUF_SIZE);
+	if (!dbuf) {
+		cli_error(CL_ENOMEM, "ls: failed to scan %s", d);
+		free(buff);
+		return -1;
+	}
+
 	tosort = (struct dir_elem_t *) malloc(alloc_blocks * sizeof(*tosort));
 	if (!tosort) {
 		cli_error(CL_ENOMEM, "ls: failed to scan %s", d);
+		free(dbuf);
 		free(buff);
 		return -1;
 	}
 
-	while ((dp = readdir(dirp))) {
+next_batch:
+	rc = vfs_readdir(fd, &pos, VFS_READDIR_ATTRS, dbuf, LS_DIRBUF_SIZE,
+	    &nread);
+	if (rc != EOK) {
+		printf("ls: failed to read %s\n", d);
+		printf("error=%s\n", str_error_name(rc));
+		goto out;
+	}
+
+	for (off = 0; off < nread; off += dp->reclen) {
+		dp = (vfs_dirent_t *) (dbuf + off);
+
 		if (nbdirs + 1 > alloc_blocks) {
 			alloc_blocks += alloc_blocks;
 
@@ -234,17 +293,17 @@ static signed int ls_scan_dir(const char *d, DIR *dirp,
 		}
 
 		/* fill the name field */
-		tosort[nbdirs].name = (char *) malloc(str_size(dp->d_name) + 1);
+		tosort[nbdirs].name = (char *) malloc(str_size(dp->name) + 1);
 		if (!tosort[nbdirs].name) {
 			cli_error(CL_ENOMEM, "ls: failed to scan %s", d);
 			goto out;
 		}
 
-		str_cpy(tosort[nbdirs].name, str_size(dp->d_name) + 1, dp->d_name);
+		str_cpy(tosort[nbdirs].name, str_size(dp->name) + 1, dp->name);
 		len = snprintf(buff, PATH_MAX - 1, "%s/%s", d, tosort[nbdirs].name);
 		buff[len] = '\0';
 
-		rc = vfs_stat_path(buff, &tosort[nbdirs++].s);
+		rc = ls_entry_stat(buff, dp, &tosort[nbdirs++].s);
 		if (rc != EOK) {
 			printf("ls: skipping bogus node %s\n", buff);
 			printf("error=%s\n", str_error_name(rc));
@@ -252,6 +311,9 @@ static signed int ls_scan_dir(const char *d, DIR *dirp,
 		}
 	}
 
+	if (nread > 0)
+		goto next_batch;
+
 	if (ls.sort) {
 		int (*compar)(const void *, const void *);
 		compar = ls.single_column ? ls_cmp_name : ls_cmp_type_name;
@@ -281,6 +343,7 @@ static signed int ls_scan_dir(const char *d, DIR *dirp,
 				cli_error(CL_ENOMEM, "ls: failed to scan %s", d);
 				goto out;
 			}
+			(*dir_list_ptr)[i].s = tosort[i].s;
 		}
 	}
 
@@ -288,6 +351,7 @@ out:
 	for (i = 0; i < nbdirs; i++)
 		free(tosort[i].name);
 	free(tosort);
+	free(dbuf);
 	free(buff);
 
 	return nbdirs;
@@ -299,14 +363,14 @@ out:
  * prints the files and directories in them.
  *
  * @param path	Path the current directory being visited.
- * @param dirp	Directory stream.
+ * @param fd	File handle of the open directory.
  */
-static unsigned int ls_recursive(const char *path, DIR *dirp)
+static unsigned int ls_recursive(const char *path, int fd)
 {
 	int i, nbdirs, ret;
 	unsigned int scope;
 	char *subdir_path;
-	DIR *subdirp;
+	int subfd;
 	struct dir_elem_t *dir_list;
 
 	const char *const trailing_slash = "/";
@@ -322,7 +386,7 @@ static unsigned int ls_recursive(const char *path, DIR *dirp)
 		goto out;
 	}
 
-	nbdirs = ls_scan_dir(path, dirp, &dir_list);
+	nbdirs = ls_scan_dir(path, fd, &dir_list);
 	if (nbdirs == -1) {
 		ret = CMD_FAILURE;
 		goto out;
@@ -340,21 +404,26 @@ static unsigned int ls_recursive(const char *path, DIR *dirp)
 		    str_size(dir_list[i].name) + 1 <= PATH_MAX)
 			str_append(subdir_path, PATH_MAX, dir_list[i].name);
 
-		scope = ls_scope(subdir_path, &dir_list[i]);
+		if (dir_list[i].s.is_file)
+			scope = LS_FILE;
+		else if (dir_list[i].s.is_directory)
+			scope = LS_DIR;
+		else
+			scope = LS_BOGUS;
+
 		switch (scope) {
 		case LS_FILE:
 			break;
 		case LS_DIR:
-			subdirp = opendir(subdir_path);
-			if (!subdirp) {
+			if (ls_open_dir(subdir_path, &subfd) != EOK) {
 				/* May have been deleted between scoping it and opening it */
 				cli_error(CL_EFAIL, "Could not stat %s", dir_list[i].name);
 				ret = CMD_FAILURE;
 				goto out;
 			}
 
-			ret = ls_recursive(subdir_path, subdirp);
-			closedir(subdirp);
+			ret = ls_recursive(subdir_path, subfd);
+			vfs_put(subfd);
 			if (ret == CMD_FAILURE)
 				goto out;
 			break;
@@ -415,7 +484,7 @@ int cmd_ls(char **argv)
 {
 	unsigned int argc;
 	struct dir_elem_t de;
-	DIR *dirp;
+	int fd;
 	int c, opt_ind;
 	int ret = 0;
 	unsigned int scope;
@@ -482,19 +551,18 @@ int cmd_ls(char **argv)
 		}
 		break;
 	case LS_DIR:
-		dirp = opendir(de.name);
-		if (!dirp) {
+		if (ls_open_dir(de.name, &fd) != EOK) {
 			/* May have been deleted between scoping it and opening it */
 			cli_error(CL_EFAIL, "Could not stat %s", de.name);
 			free(de.name);
 			return CMD_FAILURE;
 		}
 		if (ls.recursive)
-			ret = ls_recursive(de.name, dirp);
+			ret = ls_recursive(de.name, fd);
 		else
-			ret = ls_scan_dir(de.name, dirp, NULL);
+			ret = ls_scan_dir(de.name, fd, NULL);
 
-		closedir(dirp);
+		vfs_put(fd);
 		break;
 	case LS_BOGUS:
 		return CMD_FAILURE;
@@ -8,6 +8,9 @@
 #define LS_FILE  1
 #define LS_DIR   2
 
+/* Size of the buffer for batches of directory entries */
+#define LS_DIRBUF_SIZE 4096
+
 /** Structure to represent a directory entry.
  *
  * Useful to keep together important information
@@ -38,11 +38,14 @@
 #include "hbench.h"
 
 benchmark_t *benchmarks[] = {
+	&benchmark_data_read,
+	&benchmark_data_write,
 	&benchmark_dir_read,
 	&benchmark_fibril_mutex,
 	&benchmark_file_read,
 	&benchmark_malloc1,
 	&benchmark_malloc2,
+	&benchmark_malloc3,
 	&benchmark_ns_ping,
 	&benchmark_ping_pong
 };
@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup hbench
+ * @{
+ */
+
+#include <abi/ipc/ipc.h>
+#include <errno.h>
+#include <ipc_test.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <str.h>
+#include <str_error.h>
+#include "../hbench.h"
+
+static ipc_test_t *test = NULL;
+static void *buf = NULL;
+static size_t buf_size;
+
+static bool setup(bench_env_t *env, bench_run_t *run)
+{
+	const char *size_str = bench_env_param_get(env, "size", "65536");
+	uint64_t size;
+
+	errno_t rc = str_uint64_t(size_str, NULL, 10, true, &size);
+	if ((rc != EOK) || (size == 0) || (size > DATA_XFER_LIMIT)) {
+		return bench_run_fail(run,
+		    "invalid transfer size '%s' (must be 1 to %u bytes)",
+		    size_str, DATA_XFER_LIMIT);
+	}
+
+	buf_size = size;
+	buf = calloc(1, buf_size);
+	if (buf == NULL)
+		return bench_run_fail(run, "failed to allocate %zuB buffer",
+		    buf_size);
+
+	rc = ipc_test_create(&test);
+	if (rc != EOK) {
+		free(buf);
+		buf = NULL;
+		return bench_run_fail(run,
+		    "failed contacting IPC test server (have you run /srv/test/ipc-test?): %s (%d)",
+		    str_error(rc), rc);
+	}
+
+	return true;
+}
+
+static bool teardown(bench_env_t *env, bench_run_t *run)
+{
+	ipc_test_destroy(test);
+	free(buf);
+	buf = NULL;
+	return true;
+}
+
+static bool write_runner(bench_env_t *env, bench_run_t *run, uint64_t niter)
+{
+	bench_run_start(run);
+
+	for (uint64_t count = 0; count < niter; count++) {
+		errno_t rc = ipc_test_data_write(test, buf, buf_size);
+
+		if (rc != EOK) {
+			return bench_run_fail(run, "failed writing data: %s (%d)",
+			    str_error(rc), rc);
+		}
+	}
+
+	bench_run_stop(run);
+
+	return true;
+}
+
+static bool read_runner(bench_env_t *env, bench_run_t *run, uint64_t niter)
+{
+	bench_run_start(run);
+
+	for (uint64_t count = 0; count < niter; count++) {
+		errno_t rc = ipc_test_data_read(test, buf, buf_size);
+
+		if (rc != EOK) {
+			return bench_run_fail(run, "failed reading data: %s (%d)",
+			    str_error(rc), rc);
+		}
+	}
+
+	bench_run_stop(run);
+
+	return true;
+}
+
+benchmark_t benchmark_data_write = {
+	.name = "data_write",
+	.desc = "IPC data write throughput (use 'size' param to set bytes per transfer)",
+	.entry = &write_runner,
+	.setup = &setup,
+	.teardown = &teardown
+};
+
+benchmark_t benchmark_data_read = {
+	.name = "data_read",
+	.desc = "IPC data read throughput (use 'size' param to set bytes per transfer)",
+	.entry = &read_runner,
+	.setup = &setup,
+	.teardown = &teardown
+};
+
+/** @}
+ */
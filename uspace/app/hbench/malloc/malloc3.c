@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/** @addtogroup hbench
+ * @{
+ */
+
+#include <fibril.h>
+#include <fibril_synch.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <str.h>
+#include "../hbench.h"
+
+/*
+ * Contended allocator benchmark. Several fibrils running on separate
+ * threads repeatedly allocate and free small blocks of various sizes,
+ * keeping a few of them allocated at any time.
+ */
+
+/** Default number of allocating threads */
+#define MALLOC3_THREADS  4
+
+/** Number of blocks each worker keeps allocated */
+#define MALLOC3_LIVE  16
+
+typedef struct {
+	uint64_t niter;
+	atomic_bool failed;
+	fibril_semaphore_t done;
+} shared_t;
+
+static int runners_spawned = 0;
+
+static errno_t worker(void *arg)
+{
+	shared_t *shared = arg;
+	void *live[MALLOC3_LIVE] = { NULL };
+
+	fibril_detach(fibril_get_id());
+
+	for (uint64_t i = 0; i < shared->niter; i++) {
+		size_t slot = i % MALLOC3_LIVE;
+
+		free(live[slot]);
+		live[slot] = malloc(1 + (i * 7) % 200);
+		if (live[slot] == NULL) {
+			atomic_store(&shared->failed, true);
+			break;
+		}
+	}
+
+	for (size_t i = 0; i < MALLOC3_LIVE; i++)
+		free(live[i]);
+
+	fibril_semaphore_up(&shared->done);
+	return EOK;
+}
+
+static int get_threads(bench_env_t *env)
+{
+	const char *str = bench_env_param_get(env, "threads", NULL);
+	uint32_t threads;
+
+	if (str == NULL || str_uint32_t(str, NULL, 10, true,
+	    &threads) != EOK || threads < 1 || threads > 64)
+		return MALLOC3_THREADS;
+
+	return (int) threads;
+}
+
+static bool setup(bench_env_t *env, bench_run_t *run)
+{
+	int threads = get_threads(env);
+
+	/* Runner threads live until the end of the task, spawn them once. */
+	if (runners_spawned < threads - 1) {
+		runners_spawned += fibril_test_spawn_runners(threads - 1 -
+		    runners_spawned);
+	}
+
+	return true;
+}
+
+static bool runner(bench_env_t *env, bench_run_t *run, uint64_t niter)
+{
+	int threads = get_threads(env);
+	shared_t shared;
+	int started = 0;
+
+	shared.niter = niter / threads;
+	atomic_store(&shared.failed, false);
+	fibril_semaphore_initialize(&shared.done, 0);
+
+	bench_run_start(run);
+
+	for (int i = 0; i < threads; i++) {
+		fid_t fid = fibril_create(worker, &shared);
+		if (fid == 0)
+			break;
+
+		fibril_add_ready(fid);
+		started++;
+	}
+
+	for (int i = 0; i < started; i++)
+		fibril_semaphore_down(&shared.done);
+
+	bench_run_stop(run);
+
+	if (started < threads)
+		return bench_run_fail(run, "failed to create worker fibril");
+
+	if (atomic_load(&shared.failed))
+		return bench_run_fail(run, "failed to allocate memory");
+
+	return true;
+}
+
+benchmark_t benchmark_malloc3 = {
+	.name = "malloc3",
+	.desc = "User-space memory allocator benchmark, contended allocation "
+	    "from multiple threads (param threads)",
+	.entry = &runner,
+	.setup = &setup,
+	.teardown = NULL
+};
+
+/** @}
+ */
@@ -58,6 +58,40 @@
 
 #define MAX_WRITE_RETRIES 10
 
+/** Number of slots in the communication area shared with the device */
+#define COMM_SLOTS 8
+/** Minimum size of one communication area slot */
+#define COMM_SLOT_SIZE_MIN 16384
+
+#define CACHE_LO_WATERMARK	10
+#define CACHE_HI_WATERMARK	20
+
+/** Number of sequential block requests after which read-ahead kicks in */
+#define RA_SEQ_THRESHOLD	2
+/** Default read-ahead window in blocks */
+#define RA_WINDOW_DEFAULT	4
+/**
+ * Maximum read-ahead window in blocks. Blocks read ahead must not push
+ * each other out of the cache before they are consumed.
+ */
+#define RA_WINDOW_MAX		(CACHE_HI_WATERMARK / 2)
+
+/** Interval between write-back flusher runs */
+#define FLUSH_INTERVAL		MSEC2USEC(500)
+/** Age after which the flusher writes back a dirty block */
+#define FLUSH_AGE		SEC2USEC(2)
+/** Maximum number of blocks written back in one batch */
+#define FLUSH_BATCH		32
+/** Number of dirty blocks above which the flusher is woken up */
+#define DIRTY_HI_WATERMARK	(CACHE_HI_WATERMARK / 2)
+/** Number of dirty blocks to which the flusher tries to get down */
+#define DIRTY_LO_WATERMARK	(CACHE_LO_WATERMARK / 2)
+/**
+ * Number of dirty blocks above which block_put() writes back dirty blocks
+ * inline in write-back mode, throttling the writers.
+ */
+#define DIRTY_MAX		(2 * CACHE_HI_WATERMARK)
+
 /** Lock protecting the device connection list */
 static FIBRIL_MUTEX_INITIALIZE(dcl_lock);
 /** Device connection list head. */
@@ -72,6 +106,34 @@ typedef struct {
 	hash_table_t block_hash;
 	list_t free_list;
 	enum cache_mode mode;
+
+	/*
+	 * Sequential access detection and read-ahead. Protected by the
+	 * cache lock unless stated otherwise.
+	 */
+	aoff64_t seq_last;        /**< Last logical block requested. */
+	unsigned seq_count;       /**< Number of sequential requests. */
+	unsigned ra_window;       /**< Read-ahead window in blocks. */
+	aoff64_t ra_next;         /**< First block not yet read ahead. */
+	bool ra_busy;             /**< Read-ahead fibril is running. */
+	fibril_condvar_t ra_cv;   /**< Signalled when read-ahead finishes. */
+	aoff64_t ra_start;        /**< First block being read ahead. */
+	size_t ra_cnt;            /**< Number of blocks being read ahead. */
+	/** Leaf lock protecting ra_pstart, ra_pend and ra_stale. */
+	fibril_mutex_t ra_lock;
+	aoff64_t ra_pstart;       /**< Physical range being read ahead... */
+	aoff64_t ra_pend;         /**< ...exclusive end. */
+	bool ra_stale;            /**< Range was written during read-ahead. */
+
+	/*
+	 * Write-back flusher, protected by the cache lock. The dirty list is
+	 * ordered by the time the blocks became dirty.
+	 */
+	list_t dirty_list;
+	unsigned dirty_count;     /**< Number of blocks on the dirty list. */
+	bool flusher_running;     /**< Flusher fibril is running. */
+	bool flusher_stop;        /**< Flusher fibril should terminate. */
+	fibril_condvar_t flusher_cv;
 } cache_t;
 
 typedef struct {
@@ -89,6 +151,10 @@ typedef struct {
 static errno_t read_blocks(devcon_t *, aoff64_t, size_t, void *, size_t);
 static errno_t write_blocks(devcon_t *, aoff64_t, size_t, void *, size_t);
 static aoff64_t ba_ltop(devcon_t *, aoff64_t);
+static void readahead_update(devcon_t *, aoff64_t);
+static void readahead_invalidate(devcon_t *, aoff64_t, size_t);
+static errno_t cache_flusher(void *);
+static errno_t cache_flush(devcon_t *, bool, aoff64_t, size_t);
 
 static devcon_t *devcon_search(service_id_t service_id)
 {
@@ -160,6 +226,14 @@ errno_t block_init(service_id_t service_id, size_t comm_size)
 		return rc;
 	}
 
+	/*
+	 * Try to set up a shared communication area so that block transfers
+	 * do not need to be copied through the kernel. If the device does not
+	 * support it, we simply fall back to the copying protocol.
+	 */
+	(void) bd_comm_share(bd, max(comm_size, COMM_SLOT_SIZE_MIN),
+	    COMM_SLOTS);
+
 	size_t bsize;
 	rc = bd_get_block_size(bd, &bsize);
 	if (rc != EOK) {
@@ -287,6 +361,23 @@ errno_t block_cache_init(service_id_t service_id, size_t size, unsigned blocks,
 	cache->blocks_cached = 0;
 	cache->mode = mode;
 
+	cache->seq_last = 0;
+	cache->seq_count = 0;
+	cache->ra_window = RA_WINDOW_DEFAULT;
+	cache->ra_next = 0;
+	cache->ra_busy = false;
+	fibril_condvar_initialize(&cache->ra_cv);
+	fibril_mutex_initialize(&cache->ra_lock);
+	cache->ra_pstart = 0;
+	cache->ra_pend = 0;
+	cache->ra_stale = false;
+
+	list_initialize(&cache->dirty_list);
+	cache->dirty_count = 0;
+	cache->flusher_running = false;
+	cache->flusher_stop = false;
+	fibril_condvar_initialize(&cache->flusher_cv);
+
 	/* Allow 1:1 or small-to-large block size translation */
 	if (cache->lblock_size % devcon->pblock_size != 0) {
 		free(cache);
@@ -301,6 +392,38 @@ errno_t block_cache_init(service_id_t service_id, size_t size, unsigned blocks,
 	}
 
 	devcon->cache = cache;
+
+	if (mode == CACHE_MODE_WB) {
+		fid_t fid = fibril_create(cache_flusher, devcon);
+		if (fid != 0) {
+			cache->flusher_running = true;
+			fibril_add_ready(fid);
+		}
+	}
+
+	return EOK;
+}
+
+/** Set read-ahead window of the block cache.
+ *
+ * @param service_id Service ID of the block device.
+ * @param window Number of blocks to read ahead when sequential access is
+ *               detected, zero disables read-ahead. The window is limited
+ *               to RA_WINDOW_MAX blocks.
+ *
+ * @return EOK on success, ENOENT if there is no cache for the device.
+ */
+errno_t block_cache_set_readahead(service_id_t service_id, unsigned window)
+{
+	devcon_t *devcon = devcon_search(service_id);
+
+	if (!devcon || !devcon->cache)
+		return ENOENT;
+
+	fibril_mutex_lock(&devcon->cache->lock);
+	devcon->cache->ra_window = min(window, (unsigned) RA_WINDOW_MAX);
+	fibril_mutex_unlock(&devcon->cache->lock);
+
 	return EOK;
 }
 
@@ -316,6 +439,21 @@ errno_t block_cache_fini(service_id_t service_id)
 		return EOK;
 	cache = devcon->cache;
 
+	/* Stop the flusher and wait for read-ahead in progress to finish. */
+	fibril_mutex_lock(&cache->lock);
+	cache->flusher_stop = true;
+	fibril_condvar_broadcast(&cache->flusher_cv);
+	while (cache->flusher_running)
+		fibril_condvar_wait(&cache->flusher_cv, &cache->lock);
+	while (cache->ra_busy)
+		fibril_condvar_wait(&cache->ra_cv, &cache->lock);
+	fibril_mutex_unlock(&cache->lock);
+
+	/* Write back all dirty blocks using coalesced requests. */
+	rc = cache_flush(devcon, true, 0, 0);
+	if (rc != EOK)
+		return rc;
+
 	/*
 	 * We are expecting to find all blocks for this device handle on the
 	 * free list, i.e. the block reference count should be zero. Do not
@@ -326,6 +464,8 @@ errno_t block_cache_fini(service_id_t service_id)
 		    block_t, free_link);
 
 		list_remove(&b->free_link);
+		if (link_in_use(&b->dirty_link))
+			list_remove(&b->dirty_link);
 		if (b->dirty) {
 			rc = write_blocks(devcon, b->pba, cache->blocks_cluster,
 			    b->data, b->size);
@@ -346,8 +486,6 @@ errno_t block_cache_fini(service_id_t service_id)
 	return EOK;
 }
 
-#define CACHE_LO_WATERMARK	10
-#define CACHE_HI_WATERMARK	20
 static bool cache_can_grow(cache_t *cache)
 {
 	if (cache->blocks_cached < CACHE_LO_WATERMARK)
@@ -364,8 +502,246 @@ static void block_initialize(block_t *b)
 	b->write_failures = 0;
 	b->dirty = false;
 	b->toxic = false;
+	b->noread = false;
 	fibril_rwlock_initialize(&b->contents_lock);
 	link_initialize(&b->free_link);
+	link_initialize(&b->dirty_link);
+}
+
+/** Put a dirty block on the dirty list if it is not there yet.
+ *
+ * Called with the cache lock and the block lock held.
+ *
+ * @param cache Cache
+ * @param b Dirty block
+ */
+static void cache_dirty_add(cache_t *cache, block_t *b)
+{
+	if (link_in_use(&b->dirty_link))
+		return;
+
+	getuptime(&b->dirty_since);
+	list_append(&b->dirty_link, &cache->dirty_list);
+	cache->dirty_count++;
+
+	if (cache->dirty_count > DIRTY_HI_WATERMARK)
+		fibril_condvar_broadcast(&cache->flusher_cv);
+}
+
+/** Remove a block from the dirty list if it is there.
+ *
+ * Called with the cache lock held.
+ *
+ * @param cache Cache
+ * @param b Block
+ */
+static void cache_dirty_remove(cache_t *cache, block_t *b)
+{
+	if (!link_in_use(&b->dirty_link))
+		return;
+
+	list_remove(&b->dirty_link);
+	cache->dirty_count--;
+}
+
+/** Get a clean block structure for read-ahead data.
+ *
+ * Called with the cache lock held. Unlike block_get(), this never writes
+ * back dirty blocks; read-ahead is opportunistic and gives up instead.
+ *
+ * @param cache Cache
+ * @return Block structure removed from the cache or @c NULL
+ */
+static block_t *readahead_block_alloc(cache_t *cache)
+{
+	block_t *b;
+
+	if (cache->blocks_cached < CACHE_HI_WATERMARK) {
+		b = malloc(sizeof(block_t));
+		if (b == NULL)
+			return NULL;
+		b->data = malloc(cache->lblock_size);
+		if (b->data == NULL) {
+			free(b);
+			return NULL;
+		}
+		cache->blocks_cached++;
+		return b;
+	}
+
+	if (list_empty(&cache->free_list))
+		return NULL;
+
+	b = list_get_instance(list_first(&cache->free_list), block_t,
+	    free_link);
+	if (!fibril_mutex_trylock(&b->lock))
+		return NULL;
+	if (b->dirty) {
+		fibril_mutex_unlock(&b->lock);
+		return NULL;
+	}
+	fibril_mutex_unlock(&b->lock);
+
+	list_remove(&b->free_link);
+	cache_dirty_remove(cache, b);
+	hash_table_remove_item(&cache->block_hash, &b->hash_link);
+	return b;
+}
+
+/** Read-ahead fibril.
+ *
+ * Reads the range scheduled by readahead_update() using a single
+ * multi-block request and inserts the blocks which are still not cached
+ * into the cache as unreferenced blocks.
+ *
+ * @param arg Device connection
+ * @return EOK
+ */
+static errno_t readahead_fibril(void *arg)
+{
+	devcon_t *devcon = (devcon_t *) arg;
+	cache_t *cache = devcon->cache;
+	aoff64_t lba = cache->ra_start;
+	size_t cnt = cache->ra_cnt;
+	size_t lbsize = cache->lblock_size;
+	bool stale;
+	size_t i;
+	void *buf;
+	errno_t rc;
+
+	buf = malloc(cnt * lbsize);
+	if (buf != NULL) {
+		/* Failure is not fatal, do not report it. */
+		rc = bd_read_blocks(devcon->bd, ba_ltop(devcon, lba),
+		    cnt * cache->blocks_cluster, buf, cnt * lbsize);
+	} else {
+		rc = ENOMEM;
+	}
+
+	fibril_mutex_lock(&cache->lock);
+
+	fibril_mutex_lock(&cache->ra_lock);
+	stale = cache->ra_stale;
+	cache->ra_pstart = 0;
+	cache->ra_pend = 0;
+	cache->ra_stale = false;
+	fibril_mutex_unlock(&cache->ra_lock);
+
+	for (i = 0; (rc == EOK) && !stale && (i < cnt); i++) {
+		aoff64_t ba = lba + i;
+		block_t *b;
+
+		if (hash_table_find(&cache->block_hash, &ba) != NULL)
+			continue;
+
+		b = readahead_block_alloc(cache);
+		if (b == NULL)
+			break;
+
+		block_initialize(b);
+		b->refcnt = 0;
+		b->service_id = devcon->service_id;
+		b->size = lbsize;
+		b->lba = ba;
+		b->pba = ba_ltop(devcon, ba);
+		memcpy(b->data, buf + i * lbsize, lbsize);
+		hash_table_insert(&cache->block_hash, &b->hash_link);
+		list_append(&b->free_link, &cache->free_list);
+	}
+
+	cache->ra_busy = false;
+	fibril_condvar_broadcast(&cache->ra_cv);
+	fibril_mutex_unlock(&cache->lock);
+
+	free(buf);
+	return EOK;
+}
+
+/** Update sequential access detection and start read-ahead if needed.
+ *
+ * @param devcon Device connection
+ * @param ba Logical block address being requested
+ */
+static void readahead_update(devcon_t *devcon, aoff64_t ba)
+{
+	cache_t *cache = devcon->cache;
+	aoff64_t start;
+	size_t cnt;
+
+	fibril_mutex_lock(&cache->lock);
+
+	if (ba == cache->seq_last + 1) {
+		cache->seq_count++;
+	} else if (ba != cache->seq_last) {
+		cache->seq_count = 0;
+		cache->ra_next = 0;
+	}
+	cache->seq_last = ba;
+
+	if (cache->ra_window == 0 || cache->ra_busy ||
+	    cache->seq_count < RA_SEQ_THRESHOLD) {
+		fibril_mutex_unlock(&cache->lock);
+		return;
+	}
+
+	/* Keep at least half a window ahead of the consumer. */
+	start = max(ba + 1, cache->ra_next);
+	if (start - ba > cache->ra_window / 2 + 1) {
+		fibril_mutex_unlock(&cache->lock);
+		return;
+	}
+
+	/* Do not read beyond the end of the device. */
+	cnt = cache->ra_window;
+	while (cnt > 0 && ba_ltop(devcon, start + cnt) > devcon->pblocks)
+		cnt--;
+	if (cnt == 0) {
+		fibril_mutex_unlock(&cache->lock);
+		return;
+	}
+
+	fid_t fid = fibril_create(readahead_fibril, devcon);
+	if (fid == 0) {
+		fibril_mutex_unlock(&cache->lock);
+		return;
+	}
+
+	cache->ra_busy = true;
+	cache->ra_start = start;
+	cache->ra_cnt = cnt;
+	cache->ra_next = start + cnt;
+
+	fibril_mutex_lock(&cache->ra_lock);
+	cache->ra_pstart = ba_ltop(devcon, start);
+	cache->ra_pend = ba_ltop(devcon, start + cnt);
+	cache->ra_stale = false;
+	fibril_mutex_unlock(&cache->ra_lock);
+
+	fibril_mutex_unlock(&cache->lock);
+
+	fibril_add_ready(fid);
+}
+
+/** Mark read-ahead in progress stale if it overlaps with written blocks.
+ *
+ * Called after writing blocks to the device so that read-ahead which may
+ * have fetched the previous contents does not populate the cache.
+ *
+ * @param devcon Device connection
+ * @param ba Physical address of the first written block
+ * @param cnt Number of written blocks
+ */
+static void readahead_invalidate(devcon_t *devcon, aoff64_t ba, size_t cnt)
+{
+	cache_t *cache = devcon->cache;
+
+	if (cache == NULL)
+		return;
+
+	fibril_mutex_lock(&cache->ra_lock);
+	if (ba < cache->ra_pend && ba + cnt > cache->ra_pstart)
+		cache->ra_stale = true;
+	fibril_mutex_unlock(&cache->ra_lock);
 }
 
 /** Instantiate a block in memory and get a reference to it.
@@ -407,6 +783,9 @@ errno_t block_get(block_t **block, service_id_t service_id, aoff64_t ba, int fla
 		return EIO;
 	}
 
+	if (!(flags & BLOCK_FLAGS_NOREAD))
+		readahead_update(devcon, ba);
+
 retry:
 	rc = EOK;
 	b = NULL;
@@ -459,6 +838,21 @@ retry:
 			link = list_first(&cache->free_list);
 			b = list_get_instance(link, block_t, free_link);
 
+			if (cache->mode == CACHE_MODE_WB) {
+				/*
+				 * Prefer recycling a clean block so that we
+				 * do not have to write back inline. Dirty
+				 * blocks are left to the flusher.
+				 */
+				list_foreach(cache->free_list, free_link,
+				    block_t, fb) {
+					if (!fb->dirty) {
+						b = fb;
+						break;
+					}
+				}
+			}
+
 			fibril_mutex_lock(&b->lock);
 			if (b->dirty) {
 				/*
@@ -496,6 +890,7 @@ retry:
 					b->write_failures = 0;
 
 				b->dirty = false;
+				b->noread = false;
 				if (!fibril_mutex_trylock(&cache->lock)) {
 					/*
 					 * Somebody is probably racing with us.
@@ -527,6 +922,7 @@ retry:
 			 * table.
 			 */
 			list_remove(&b->free_link);
+			cache_dirty_remove(cache, b);
 			hash_table_remove_item(&cache->block_hash, &b->hash_link);
 		}
 
@@ -554,8 +950,10 @@ retry:
 			    b->data, cache->lblock_size);
 			if (rc != EOK)
 				b->toxic = true;
-		} else
+		} else {
+			b->noread = true;
 			rc = EOK;
+		}
 
 		fibril_mutex_unlock(&b->lock);
 	}
@@ -582,6 +980,7 @@ errno_t block_put(block_t *block)
 	devcon_t *devcon = devcon_search(block->service_id);
 	cache_t *cache;
 	unsigned blocks_cached;
+	unsigned dirty_count;
 	enum cache_mode mode;
 	errno_t rc = EOK;
 
@@ -594,6 +993,7 @@ errno_t block_put(block_t *block)
 retry:
 	fibril_mutex_lock(&cache->lock);
 	blocks_cached = cache->blocks_cached;
+	dirty_count = cache->dirty_count;
 	mode = cache->mode;
 	fibril_mutex_unlock(&cache->lock);
 
@@ -601,32 +1001,42 @@ retry:
 	 * Determine whether to sync the block. Syncing the block is best done
 	 * when not holding the cache lock as it does not impede concurrency.
 	 * Since the situation may have changed when we unlocked the cache, the
-	 * blocks_cached and mode variables are mere hints. We will recheck the
-	 * conditions later when the cache lock is held again.
+	 * blocks_cached, dirty_count and mode variables are mere hints. We will
+	 * recheck the conditions later when the cache lock is held again.
+	 *
+	 * In write-back mode, dirty blocks are normally left to the flusher.
+	 * They are only written back here if there are too many of them.
 	 */
 	fibril_mutex_lock(&block->lock);
 	if (block->toxic)
 		block->dirty = false;	/* will not write back toxic block */
 	if (block->dirty && (block->refcnt == 1) &&
-	    (blocks_cached > CACHE_HI_WATERMARK || mode != CACHE_MODE_WB)) {
+	    ((blocks_cached > CACHE_HI_WATERMARK && dirty_count > DIRTY_MAX) ||
+	    mode != CACHE_MODE_WB)) {
 		rc = write_blocks(devcon, block->pba, cache->blocks_cluster,
 		    block->data, block->size);
 		if (rc == EOK)
 			block->write_failures = 0;
 		block->dirty = false;
+		block->noread = false;
 	}
 	fibril_mutex_unlock(&block->lock);
 
 	fibril_mutex_lock(&cache->lock);
 	fibril_mutex_lock(&block->lock);
+	if (cache->mode == CACHE_MODE_WB && block->dirty)
+		cache_dirty_add(cache, block);
 	if (!--block->refcnt) {
 		/*
 		 * Last reference to the block was dropped. Either free the
 		 * block or put it on the free list. In case of an I/O error,
-		 * free the block.
+		 * free the block. A dirty block in write-back mode stays
+		 * cached until the flusher writes it back, unless there are
+		 * too many dirty blocks.
 		 */
-		if ((cache->blocks_cached > CACHE_HI_WATERMARK) ||
-		    (rc != EOK)) {
+		if (((cache->blocks_cached > CACHE_HI_WATERMARK) &&
+		    !(cache->mode == CACHE_MODE_WB && block->dirty &&
+		    cache->dirty_count <= DIRTY_MAX)) || (rc != EOK)) {
 			/*
 			 * Currently there are too many cached blocks or there
 			 * was an I/O error when writing the block back to the
@@ -654,6 +1064,7 @@ retry:
 			/*
 			 * Take the block out of the cache and free it.
 			 */
+			cache_dirty_remove(cache, block);
 			hash_table_remove_item(&cache->block_hash, &block->hash_link);
 			fibril_mutex_unlock(&block->lock);
 			free(block->data);
@@ -683,6 +1094,313 @@ retry:
 	return rc;
 }
 
+static int flush_cmp(const void *a, const void *b)
+{
+	const block_t *ba = *(block_t * const *) a;
+	const block_t *bb = *(block_t * const *) b;
+
+	if (ba->pba < bb->pba)
+		return -1;
+	if (ba->pba > bb->pba)
+		return 1;
+	return 0;
+}
+
+/** Write back a run of blocks with consecutive addresses.
+ *
+ * If possible, the blocks are written with a single request.
+ *
+ * @param devcon Device connection
+ * @param blocks Blocks sorted by address
+ * @param cnt Number of blocks
+ * @return EOK on success or an error code
+ */
+static errno_t cache_flush_run(devcon_t *devcon, block_t **blocks, size_t cnt)
+{
+	cache_t *cache = devcon->cache;
+	size_t lbsize = cache->lblock_size;
+	void *buf;
+	size_t i;
+	errno_t rc;
+
+	if (cnt == 1) {
+		return write_blocks(devcon, blocks[0]->pba,
+		    cache->blocks_cluster, blocks[0]->data, lbsize);
+	}
+
+	buf = malloc(cnt * lbsize);
+	if (buf == NULL) {
+		/* Fall back to writing the blocks one by one. */
+		errno_t rc2 = EOK;
+
+		for (i = 0; i < cnt; i++) {
+			rc = write_blocks(devcon, blocks[i]->pba,
+			    cache->blocks_cluster, blocks[i]->data, lbsize);
+			if (rc != EOK)
+				rc2 = rc;
+		}
+
+		return rc2;
+	}
+
+	for (i = 0; i < cnt; i++)
+		memcpy(buf + i * lbsize, blocks[i]->data, lbsize);
+
+	rc = write_blocks(devcon, blocks[0]->pba, cnt * cache->blocks_cluster,
+	    buf, cnt * lbsize);
+	free(buf);
+	return rc;
+}
+
+/** Write back dirty blocks.
+ *
+ * Walks the dirty list only. Blocks are taken in batches, sorted by
+ * address and runs of adjacent blocks are coalesced into single write
+ * requests.
+ *
+ * @param devcon Device connection
+ * @param all If true, write back all dirty blocks (within the range, if
+ *            specified). If false, only write back blocks which are old
+ *            enough or enough of them to get below the dirty watermark.
+ *            Blocks which are referenced are never written back, as their
+ *            holders may be modifying them. They are written back once
+ *            they are released.
+ * @param ba Physical address of the first block of the range
+ * @param cnt Number of blocks in the range or zero for the whole device
+ *
+ * @return EOK on success or an error code
+ */
+static errno_t cache_flush(devcon_t *devcon, bool all, aoff64_t ba,
+    size_t cnt)
+{
+	cache_t *cache = devcon->cache;
+	block_t *batch[FLUSH_BATCH];
+	struct timespec now;
+	size_t n;
+	size_t i, j;
+	errno_t rc;
+	errno_t retval = EOK;
+
+	while (true) {
+		n = 0;
+		getuptime(&now);
+
+		fibril_mutex_lock(&cache->lock);
+
+		list_foreach_safe(cache->dirty_list, cur, next) {
+			block_t *b = list_get_instance(cur, block_t,
+			    dirty_link);
+
+			fibril_mutex_lock(&b->lock);
+			if (!b->dirty) {
+				/* Already written back by someone else. */
+				cache_dirty_remove(cache, b);
+				fibril_mutex_unlock(&b->lock);
+				continue;
+			}
+
+			if (b->refcnt > 0) {
+				fibril_mutex_unlock(&b->lock);
+				continue;
+			}
+
+			if (all) {
+				if (cnt != 0 && (b->pba < ba ||
+				    b->pba >= ba + cnt)) {
+					fibril_mutex_unlock(&b->lock);
+					continue;
+				}
+			} else {
+				if (cache->dirty_count <= DIRTY_LO_WATERMARK &&
+				    NSEC2USEC(ts_sub_diff(&now,
+				    &b->dirty_since)) < FLUSH_AGE) {
+					/* The rest of the list is younger. */
+					fibril_mutex_unlock(&b->lock);
+					break;
+				}
+			}
+
+			/*
+			 * Take a reference so that the block cannot be
+			 * recycled while we write it back. It is marked clean
+			 * before its contents are copied so that modifications
+			 * by fibrils which get the block meanwhile make it
+			 * dirty again.
+			 */
+			b->refcnt++;
+			list_remove(&b->free_link);
+			b->dirty = false;
+			b->noread = false;
+			cache_dirty_remove(cache, b);
+			fibril_mutex_unlock(&b->lock);
+
+			batch[n++] = b;
+			if (n == FLUSH_BATCH)
+				break;
+		}
+
+		fibril_mutex_unlock(&cache->lock);
+
+		if (n == 0)
+			break;
+
+		qsort(batch, n, sizeof(block_t *), flush_cmp);
+
+		for (i = 0; i < n; i = j) {
+			j = i + 1;
+			while (j < n && batch[j]->pba ==
+			    batch[j - 1]->pba + cache->blocks_cluster)
+				j++;
+
+			rc = cache_flush_run(devcon, &batch[i], j - i);
+			if (rc != EOK)
+				retval = rc;
+
+			for (; i < j; i++) {
+				fibril_mutex_lock(&batch[i]->lock);
+				if (rc == EOK) {
+					batch[i]->write_failures = 0;
+				} else if (++batch[i]->write_failures <
+				    MAX_WRITE_RETRIES) {
+					/* Try again later. */
+					batch[i]->dirty = true;
+				} else {
+					printf("Too many errors writing block %"
+					    PRIuOFF64 "from device handle %" PRIun "\n"
+					    "SEVERE DATA LOSS POSSIBLE\n",
+					    batch[i]->lba, devcon->service_id);
+				}
+				fibril_mutex_unlock(&batch[i]->lock);
+				(void) block_put(batch[i]);
+			}
+		}
+
+		if (retval != EOK)
+			break;
+	}
+
+	return retval;
+}
+
+/** Arguments of held_collect(). */
+typedef struct {
+	aoff64_t ba;
+	size_t cnt;
+	block_t **held;
+	size_t n;
+	size_t max;
+} held_collect_t;
+
+static bool held_collect(ht_link_t *item, void *arg)
+{
+	held_collect_t *hc = (held_collect_t *) arg;
+	block_t *b = hash_table_get_inst(item, block_t, hash_link);
+
+	fibril_mutex_lock(&b->lock);
+	if (b->refcnt > 0 && b->dirty && !b->toxic && (hc->cnt == 0 ||
+	    (b->pba >= hc->ba && b->pba < hc->ba + hc->cnt))) {
+		b->refcnt++;
+		hc->held[hc->n++] = b;
+	}
+	fibril_mutex_unlock(&b->lock);
+
+	return hc->n < hc->max;
+}
+
+/** Write back dirty blocks which are in use.
+ *
+ * cache_flush() skips these blocks. They are written under the block lock,
+ * as block_put() does, but stay dirty since their holders may still modify
+ * them.
+ *
+ * @param devcon Device connection.
+ * @param ba Address of first block (physical).
+ * @param cnt Number of blocks, zero to write back all held blocks.
+ *
+ * @return EOK on success or an error code
+ */
+static errno_t cache_flush_held(devcon_t *devcon, aoff64_t ba, size_t cnt)
+{
+	cache_t *cache = devcon->cache;
+	held_collect_t hc;
+	errno_t rc;
+	errno_t retval = EOK;
+	size_t i;
+
+	fibril_mutex_lock(&cache->lock);
+	if (cache->blocks_cached == 0) {
+		fibril_mutex_unlock(&cache->lock);
+		return EOK;
+	}
+
+	hc.ba = ba;
+	hc.cnt = cnt;
+	hc.n = 0;
+	hc.max = cache->blocks_cached;
+	hc.held = malloc(hc.max * sizeof(block_t *));
+	if (!hc.held) {
+		fibril_mutex_unlock(&cache->lock);
+		return ENOMEM;
+	}
+
+	hash_table_apply(&cache->block_hash, held_collect, &hc);
+	fibril_mutex_unlock(&cache->lock);
+
+	for (i = 0; i < hc.n; i++) {
+		block_t *b = hc.held[i];
+
+		fibril_mutex_lock(&b->lock);
+		if (b->dirty && !b->toxic) {
+			rc = write_blocks(devcon, b->pba, cache->blocks_cluster,
+			    b->data, b->size);
+			if (rc != EOK)
+				retval = rc;
+		}
+		fibril_mutex_unlock(&b->lock);
+		(void) block_put(b);
+	}
+
+	free(hc.held);
+	return retval;
+}
+
+/** Write-back flusher fibril.
+ *
+ * Periodically writes back dirty blocks of a write-back cache which are
+ * old enough. It is also woken up early when the number of dirty blocks
+ * exceeds DIRTY_HI_WATERMARK.
+ *
+ * @param arg Device connection
+ * @return EOK
+ */
+static errno_t cache_flusher(void *arg)
+{
+	devcon_t *devcon = (devcon_t *) arg;
+	cache_t *cache = devcon->cache;
+
+	fibril_mutex_lock(&cache->lock);
+
+	while (!cache->flusher_stop) {
+		(void) fibril_condvar_wait_timeout(&cache->flusher_cv,
+		    &cache->lock, FLUSH_INTERVAL);
+		if (cache->flusher_stop)
+			break;
+
+		if (list_empty(&cache->dirty_list))
+			continue;
+
+		fibril_mutex_unlock(&cache->lock);
+		(void) cache_flush(devcon, false, 0, 0);
+		fibril_mutex_lock(&cache->lock);
+	}
+
+	cache->flusher_running = false;
+	fibril_condvar_broadcast(&cache->flusher_cv);
+	fibril_mutex_unlock(&cache->lock);
+
+	return EOK;
+}
+
 /** Read sequential data from a block device.
  *
  * @param service_id	Service ID of the block device.
@@ -713,6 +1431,28 @@ errno_t block_seqread(service_id_t service_id, void *buf, size_t *bufpos,
 	while (left > 0) {
 		size_t rd;
 
+		if (*bufpos == *buflen && left >= block_size &&
+		    *pos % block_size == 0) {
+			/*
+			 * The communication buffer is empty and the request
+			 * covers whole blocks. Read them directly into the
+			 * destination buffer, as many as fit in one request.
+			 */
+			size_t nblocks = min(left / block_size,
+			    max(DATA_XFER_LIMIT / block_size, (size_t) 1));
+			errno_t rc;
+
+			rc = read_blocks(devcon, *pos / block_size, nblocks,
+			    dst + offset, nblocks * block_size);
+			if (rc != EOK)
+				return rc;
+
+			offset += nblocks * block_size;
+			*pos += nblocks * block_size;
+			left -= nblocks * block_size;
+			continue;
+		}
+
 		if (*bufpos + left < *buflen)
 			rd = left;
 		else
@@ -767,6 +1507,70 @@ errno_t block_read_direct(service_id_t service_id, aoff64_t ba, size_t cnt, void
 	return read_blocks(devcon, ba, cnt, buf, devcon->pblock_size * cnt);
 }
 
+/** Read a run of blocks using as few requests as possible.
+ *
+ * Unlike block_read_direct(), the result is coherent with the cache. Dirty
+ * blocks in the range are written back first. As blocks may be modified and
+ * written back while the device is being read, the data of every block in the
+ * range which is cached with valid contents is copied from the cache.
+ *
+ * @param service_id	Service ID of the block device.
+ * @param ba		Address of first block (logical).
+ * @param cnt		Number of blocks.
+ * @param buf		Buffer for storing the data.
+ *
+ * @return		EOK on success or an error code on failure.
+ */
+errno_t block_read_run(service_id_t service_id, aoff64_t ba, size_t cnt,
+    void *buf)
+{
+	devcon_t *devcon;
+	cache_t *cache;
+	size_t lbsize;
+	size_t max_cnt;
+	size_t i, n;
+	errno_t rc;
+
+	devcon = devcon_search(service_id);
+	assert(devcon);
+	assert(devcon->cache);
+
+	cache = devcon->cache;
+	lbsize = cache->lblock_size;
+
+	rc = cache_flush(devcon, true, ba_ltop(devcon, ba),
+	    cnt * cache->blocks_cluster);
+	if (rc != EOK)
+		return rc;
+
+	max_cnt = max(DATA_XFER_LIMIT / lbsize, (size_t) 1);
+	for (i = 0; i < cnt; i += n) {
+		n = min(cnt - i, max_cnt);
+		rc = read_blocks(devcon, ba_ltop(devcon, ba + i),
+		    n * cache->blocks_cluster, (uint8_t *) buf + i * lbsize,
+		    n * lbsize);
+		if (rc != EOK)
+			return rc;
+	}
+
+	fibril_mutex_lock(&cache->lock);
+	for (i = 0; i < cnt; i++) {
+		aoff64_t lba = ba + i;
+		ht_link_t *hlink = hash_table_find(&cache->block_hash, &lba);
+		if (hlink == NULL)
+			continue;
+
+		block_t *b = hash_table_get_inst(hlink, block_t, hash_link);
+		fibril_mutex_lock(&b->lock);
+		if (!b->toxic && (b->dirty || !b->noread))
+			memcpy((uint8_t *) buf + i * lbsize, b->data, lbsize);
+		fibril_mutex_unlock(&b->lock);
+	}
+	fibril_mutex_unlock(&cache->lock);
+
+	return EOK;
+}
+
 /** Write blocks directly to device (bypass cache).
  *
  * @param service_id	Service ID of the block device.
@@ -788,6 +1592,9 @@ errno_t block_write_direct(service_id_t service_id, aoff64_t ba, size_t cnt,
 }
 
 /** Synchronize blocks to persistent storage.
+ *
+ * Dirty cached blocks in the range are written back first, including the
+ * blocks which are in use.
  *
  * @param service_id	Service ID of the block device.
  * @param ba		Address of first block (physical).
@@ -799,9 +1606,21 @@ errno_t block_sync_cache(service_id_t service_id, aoff64_t ba, size_t cnt)
 {
 	devcon_t *devcon;
 
+	errno_t rc;
+
 	devcon = devcon_search(service_id);
 	assert(devcon);
 
+	if (devcon->cache != NULL) {
+		rc = cache_flush(devcon, true, ba, cnt);
+		if (rc != EOK)
+			return rc;
+
+		rc = cache_flush_held(devcon, ba, cnt);
+		if (rc != EOK)
+			return rc;
+	}
+
 	return bd_sync_cache(devcon->bd, ba, cnt);
 }
 
@@ -949,6 +1768,7 @@ static errno_t write_blocks(devcon_t *devcon, aoff64_t ba, size_t cnt, void *dat
 	assert(devcon);
 
 	errno_t rc = bd_write_blocks(devcon->bd, ba, cnt, data, size);
+	readahead_invalidate(devcon, ba, cnt);
 	if (rc != EOK) {
 		printf("Error %s writing %zu blocks starting at block %" PRIuOFF64
 		    " to device handle %" PRIun "\n", str_error_name(rc), cnt, ba, devcon->service_id);
@@ -44,6 +44,7 @@
 #include <adt/hash_table.h>
 #include <adt/list.h>
 #include <loc.h>
+#include <time.h>
 
 /*
  * Flags that can be used with block_get().
@@ -70,6 +71,11 @@ typedef struct block {
 	bool dirty;
 	/** If true, the blcok does not contain valid data. */
 	bool toxic;
+	/**
+	 * If true, the block was not read from the device and its data is not
+	 * valid until it is made dirty.
+	 */
+	bool noread;
 	/** Readers / Writer lock protecting the contents of the block. */
 	fibril_rwlock_t contents_lock;
 	/** Service ID of service providing the block device. */
@@ -84,6 +90,10 @@ typedef struct block {
 	int write_failures;
 	/** Link for placing the block into the free block list. */
 	link_t free_link;
+	/** Link for placing the block into the dirty block list. */
+	link_t dirty_link;
+	/** Time when the block was put on the dirty block list. */
+	struct timespec dirty_since;
 	/** Link for placing the block into the block hash table. */
 	ht_link_t hash_link;
 	/** Buffer with the block data. */
@@ -106,6 +116,7 @@ extern void *block_bb_get(service_id_t);
 
 extern errno_t block_cache_init(service_id_t, size_t, unsigned, enum cache_mode);
 extern errno_t block_cache_fini(service_id_t);
+extern errno_t block_cache_set_readahead(service_id_t, unsigned);
 
 extern errno_t block_get(block_t **, service_id_t, aoff64_t, int);
 extern errno_t block_put(block_t *);
@@ -117,6 +128,7 @@ extern errno_t block_get_bsize(service_id_t, size_t *);
 extern errno_t block_get_nblocks(service_id_t, aoff64_t *);
 extern errno_t block_read_toc(service_id_t, uint8_t, void *, size_t);
 extern errno_t block_read_direct(service_id_t, aoff64_t, size_t, void *);
+extern errno_t block_read_run(service_id_t, aoff64_t, size_t, void *);
 extern errno_t block_read_bytes_direct(service_id_t, aoff64_t, size_t, void *);
 extern errno_t block_write_direct(service_id_t, aoff64_t, size_t, const void *);
 extern errno_t block_sync_cache(service_id_t, aoff64_t, size_t);
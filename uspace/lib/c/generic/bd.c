@@ -34,6 +34,8 @@
  * @brief Block device client interface
  */
 
+#include <align.h>
+#include <as.h>
 #include <async.h>
 #include <assert.h>
 #include <bd.h>
@@ -42,6 +44,7 @@
 #include <ipc/services.h>
 #include <loc.h>
 #include <macros.h>
+#include <mem.h>
 #include <stdlib.h>
 #include <offset.h>
 
@@ -54,6 +57,9 @@ errno_t bd_open(async_sess_t *sess, bd_t **rbd)
 		return ENOMEM;
 
 	bd->sess = sess;
+	fibril_mutex_initialize(&bd->comm_lock);
+	fibril_condvar_initialize(&bd->comm_cv);
+	bd->comm_area = NULL;
 
 	async_exch_t *exch = async_exchange_begin(sess);
 
@@ -79,11 +85,158 @@ error:
 void bd_close(bd_t *bd)
 {
 	/* XXX Synchronize with bd_cb_conn */
+	if (bd->comm_area != NULL)
+		as_area_destroy(bd->comm_area);
 	free(bd);
 }
 
+/** Share a communication area with the block device server.
+ *
+ * The area is divided into @a slots slots used as a ring. Transfers which
+ * fit into one slot then only pass the slot descriptor over IPC while the
+ * data itself is exchanged through the shared memory. This saves copying
+ * the data through a kernel buffer on every request.
+ *
+ * @param bd Block device
+ * @param slot_size Size of one slot in bytes (will be rounded up to pages)
+ * @param slots Number of slots (at most BD_COMM_SLOTS_MAX)
+ *
+ * @return EOK on success, EEXIST if the area has already been shared,
+ *         EINVAL if the number of slots is invalid or an error code
+ *         reported by the server (e.g. if it does not support the protocol).
+ *         On failure the transfers continue to use the copying protocol.
+ */
+errno_t bd_comm_share(bd_t *bd, size_t slot_size, size_t slots)
+{
+	if (bd->comm_area != NULL)
+		return EEXIST;
+
+	if ((slots == 0) || (slots > BD_COMM_SLOTS_MAX) || (slot_size == 0))
+		return EINVAL;
+
+	slot_size = ALIGN_UP(slot_size, PAGE_SIZE);
+
+	void *area = as_area_create(AS_AREA_ANY, slot_size * slots,
+	    AS_AREA_READ | AS_AREA_WRITE | AS_AREA_CACHEABLE, AS_AREA_UNPAGED);
+	if (area == AS_MAP_FAILED)
+		return ENOMEM;
+
+	async_exch_t *exch = async_exchange_begin(bd->sess);
+
+	ipc_call_t answer;
+	aid_t req = async_send_0(exch, BD_COMM_SHARE, &answer);
+	errno_t rc = async_share_out_start(exch, area, AS_AREA_READ |
+	    AS_AREA_WRITE | AS_AREA_CACHEABLE);
+	async_exchange_end(exch);
+
+	if (rc != EOK) {
+		async_forget(req);
+		as_area_destroy(area);
+		return rc;
+	}
+
+	errno_t retval;
+	async_wait_for(req, &retval);
+
+	if (retval != EOK) {
+		as_area_destroy(area);
+		return retval;
+	}
+
+	bd->comm_slot_size = slot_size;
+	bd->comm_slots = slots;
+	bd->comm_busy = 0;
+	bd->comm_next = 0;
+	bd->comm_area = area;
+
+	return EOK;
+}
+
+/** Allocate a slot in the communication area.
+ *
+ * Blocks until a slot becomes available.
+ *
+ * @param bd Block device
+ * @return Slot number
+ */
+static size_t bd_comm_slot_get(bd_t *bd)
+{
+	size_t i;
+	size_t slot;
+
+	fibril_mutex_lock(&bd->comm_lock);
+
+	while (true) {
+		for (i = 0; i < bd->comm_slots; i++) {
+			slot = (bd->comm_next + i) % bd->comm_slots;
+			if ((bd->comm_busy & (1U << slot)) == 0) {
+				bd->comm_busy |= 1U << slot;
+				bd->comm_next = (slot + 1) % bd->comm_slots;
+				fibril_mutex_unlock(&bd->comm_lock);
+				return slot;
+			}
+		}
+
+		fibril_condvar_wait(&bd->comm_cv, &bd->comm_lock);
+	}
+}
+
+/** Release a slot in the communication area.
+ *
+ * @param bd Block device
+ * @param slot Slot number
+ */
+static void bd_comm_slot_put(bd_t *bd, size_t slot)
+{
+	fibril_mutex_lock(&bd->comm_lock);
+	assert((bd->comm_busy & (1U << slot)) != 0);
+	bd->comm_busy &= ~(1U << slot);
+	fibril_condvar_signal(&bd->comm_cv);
+	fibril_mutex_unlock(&bd->comm_lock);
+}
+
+/** Read blocks through the shared communication area. */
+static errno_t bd_read_blocks_comm(bd_t *bd, aoff64_t ba, size_t cnt,
+    void *data, size_t size)
+{
+	size_t slot = bd_comm_slot_get(bd);
+	size_t offs = slot * bd->comm_slot_size;
+
+	async_exch_t *exch = async_exchange_begin(bd->sess);
+	errno_t rc = async_req_5_0(exch, BD_READ_BLOCKS_COMM, LOWER32(ba),
+	    UPPER32(ba), cnt, offs, size);
+	async_exchange_end(exch);
+
+	if (rc == EOK)
+		memcpy(data, bd->comm_area + offs, size);
+
+	bd_comm_slot_put(bd, slot);
+	return rc;
+}
+
+/** Write blocks through the shared communication area. */
+static errno_t bd_write_blocks_comm(bd_t *bd, aoff64_t ba, size_t cnt,
+    const void *data, size_t size)
+{
+	size_t slot = bd_comm_slot_get(bd);
+	size_t offs = slot * bd->comm_slot_size;
+
+	memcpy(bd->comm_area + offs, data, size);
+
+	async_exch_t *exch = async_exchange_begin(bd->sess);
+	errno_t rc = async_req_5_0(exch, BD_WRITE_BLOCKS_COMM, LOWER32(ba),
+	    UPPER32(ba), cnt, offs, size);
+	async_exchange_end(exch);
+
+	bd_comm_slot_put(bd, slot);
+	return rc;
+}
+
 errno_t bd_read_blocks(bd_t *bd, aoff64_t ba, size_t cnt, void *data, size_t size)
 {
+	if ((bd->comm_area != NULL) && (size <= bd->comm_slot_size))
+		return bd_read_blocks_comm(bd, ba, cnt, data, size);
+
 	async_exch_t *exch = async_exchange_begin(bd->sess);
 
 	ipc_call_t answer;
@@ -132,6 +285,9 @@ errno_t bd_read_toc(bd_t *bd, uint8_t session, void *buf, size_t size)
 errno_t bd_write_blocks(bd_t *bd, aoff64_t ba, size_t cnt, const void *data,
     size_t size)
 {
+	if ((bd->comm_area != NULL) && (size <= bd->comm_slot_size))
+		return bd_write_blocks_comm(bd, ba, cnt, data, size);
+
 	async_exch_t *exch = async_exchange_begin(bd->sess);
 
 	ipc_call_t answer;
@@ -33,6 +33,7 @@
  * @file
  * @brief Block device server stub
  */
+#include <as.h>
 #include <errno.h>
 #include <ipc/bd.h>
 #include <macros.h>
@@ -175,6 +176,112 @@ static void bd_write_blocks_srv(bd_srv_t *srv, ipc_call_t *call)
 	async_answer_0(call, rc);
 }
 
+static void bd_comm_share_srv(bd_srv_t *srv, ipc_call_t *call)
+{
+	ipc_call_t scall;
+	size_t size;
+	unsigned int flags;
+	void *area;
+	errno_t rc;
+
+	if (!async_share_out_receive(&scall, &size, &flags)) {
+		async_answer_0(call, EINVAL);
+		return;
+	}
+
+	if (srv->comm_area != NULL) {
+		async_answer_0(&scall, EEXIST);
+		async_answer_0(call, EEXIST);
+		return;
+	}
+
+	if ((flags & (AS_AREA_READ | AS_AREA_WRITE)) !=
+	    (AS_AREA_READ | AS_AREA_WRITE)) {
+		async_answer_0(&scall, EINVAL);
+		async_answer_0(call, EINVAL);
+		return;
+	}
+
+	rc = async_share_out_finalize(&scall, &area);
+	if ((rc != EOK) || (area == AS_MAP_FAILED)) {
+		async_answer_0(call, ENOMEM);
+		return;
+	}
+
+	srv->comm_area = area;
+	srv->comm_size = size;
+	async_answer_0(call, EOK);
+}
+
+/** Get pointer to a region of the communication area.
+ *
+ * @param srv Server structure
+ * @param offs Offset of the region
+ * @param size Size of the region
+ * @return Pointer to the region or @c NULL if it is not within the area
+ */
+static void *bd_comm_region(bd_srv_t *srv, size_t offs, size_t size)
+{
+	if (srv->comm_area == NULL)
+		return NULL;
+
+	if ((offs > srv->comm_size) || (size > srv->comm_size - offs))
+		return NULL;
+
+	return srv->comm_area + offs;
+}
+
+static void bd_read_blocks_comm_srv(bd_srv_t *srv, ipc_call_t *call)
+{
+	aoff64_t ba;
+	size_t cnt;
+	void *buf;
+	errno_t rc;
+
+	ba = MERGE_LOUP32(ipc_get_arg1(call), ipc_get_arg2(call));
+	cnt = ipc_get_arg3(call);
+
+	buf = bd_comm_region(srv, ipc_get_arg4(call), ipc_get_arg5(call));
+	if (buf == NULL) {
+		async_answer_0(call, EINVAL);
+		return;
+	}
+
+	if (srv->srvs->ops->read_blocks == NULL) {
+		async_answer_0(call, ENOTSUP);
+		return;
+	}
+
+	rc = srv->srvs->ops->read_blocks(srv, ba, cnt, buf, ipc_get_arg5(call));
+	async_answer_0(call, rc);
+}
+
+static void bd_write_blocks_comm_srv(bd_srv_t *srv, ipc_call_t *call)
+{
+	aoff64_t ba;
+	size_t cnt;
+	void *data;
+	errno_t rc;
+
+	ba = MERGE_LOUP32(ipc_get_arg1(call), ipc_get_arg2(call));
+	cnt = ipc_get_arg3(call);
+
+	data = bd_comm_region(srv, ipc_get_arg4(call), ipc_get_arg5(call));
+	if (data == NULL) {
+		async_answer_0(call, EINVAL);
+		return;
+	}
+
+	if (srv->srvs->ops->write_blocks == NULL) {
+		async_answer_0(call, ENOTSUP);
+		return;
+	}
+
+	rc = srv->srvs->ops->write_blocks(srv, ba, cnt, data,
+	    ipc_get_arg5(call));
+	async_answer_0(call, rc);
+}
+
 static void bd_get_block_size_srv(bd_srv_t *srv, ipc_call_t *call)
 {
 	errno_t rc;
@@ -273,12 +380,24 @@ errno_t bd_conn(ipc_call_t *icall, bd_srvs_t *srvs)
 		case BD_GET_NUM_BLOCKS:
 			bd_get_num_blocks_srv(srv, &call);
 			break;
+		case BD_COMM_SHARE:
+			bd_comm_share_srv(srv, &call);
+			break;
+		case BD_READ_BLOCKS_COMM:
+			bd_read_blocks_comm_srv(srv, &call);
+			break;
+		case BD_WRITE_BLOCKS_COMM:
+			bd_write_blocks_comm_srv(srv, &call);
+			break;
 		default:
 			async_answer_0(&call, EINVAL);
 		}
 	}
 
 	rc = srvs->ops->close(srv);
+
+	if (srv->comm_area != NULL)
+		as_area_destroy(srv->comm_area);
 	free(srv);
 
 	return rc;
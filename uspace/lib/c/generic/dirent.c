@@ -39,11 +39,23 @@
 #include <errno.h>
 #include <assert.h>
 #include <string.h>
+#include <str.h>
+
+/** Size of the buffer for batches of directory entries */
+#define DIR_BUF_SIZE  4096
 
 struct __dirstream {
 	int fd;
 	struct dirent res;
 	aoff64_t pos;
+	/** Batch of vfs_dirent_t records read from VFS */
+	void *buf;
+	/** Number of valid bytes in @c buf */
+	size_t buf_len;
+	/** Offset of the next record in @c buf */
+	size_t buf_off;
+	/** File system does not support batched reading */
+	bool no_batch;
 };
 
 /** Open directory.
@@ -78,9 +90,42 @@ DIR *opendir(const char *dirname)
 
 	dirp->fd = fd;
 	dirp->pos = 0;
+	dirp->buf = NULL;
+	dirp->buf_len = 0;
+	dirp->buf_off = 0;
+	dirp->no_batch = false;
 	return dirp;
 }
 
+/** Read the next batch of directory entries into the directory buffer.
+ *
+ * @param dirp Open directory
+ * @return EOK on success, ENOENT at the end of the directory, ENOTSUP if
+ *         the file system cannot list directories in batches or another
+ *         error code.
+ */
+static errno_t readdir_batch(DIR *dirp)
+{
+	if (dirp->buf == NULL) {
+		dirp->buf = malloc(DIR_BUF_SIZE);
+		if (dirp->buf == NULL)
+			return ENOMEM;
+	}
+
+	size_t len;
+	errno_t rc = vfs_readdir(dirp->fd, &dirp->pos, 0, dirp->buf,
+	    DIR_BUF_SIZE, &len);
+	if (rc != EOK)
+		return rc;
+
+	if (len == 0)
+		return ENOENT;
+
+	dirp->buf_len = len;
+	dirp->buf_off = 0;
+	return EOK;
+}
+
 /** Read directory entry.
  *
  * @param dirp Open directory
@@ -92,6 +137,28 @@ struct dirent *readdir(DIR *dirp)
 	errno_t rc;
 	ssize_t len = 0;
 
+	if (!dirp->no_batch) {
+		if (dirp->buf_off >= dirp->buf_len) {
+			rc = readdir_batch(dirp);
+			if (rc == ENOTSUP) {
+				dirp->no_batch = true;
+				goto single;
+			}
+			if (rc != EOK) {
+				errno = rc;
+				return NULL;
+			}
+		}
+
+		vfs_dirent_t *de = (vfs_dirent_t *) ((uint8_t *) dirp->buf +
+		    dirp->buf_off);
+		dirp->buf_off += de->reclen;
+
+		str_cpy(dirp->res.d_name, sizeof(dirp->res.d_name), de->name);
+		return &dirp->res;
+	}
+
+single:
 	rc = vfs_read_short(dirp->fd, dirp->pos, dirp->res.d_name,
 	    sizeof(dirp->res.d_name), &len);
 	if (rc != EOK) {
@@ -113,6 +180,8 @@ struct dirent *readdir(DIR *dirp)
 void rewinddir(DIR *dirp)
 {
 	dirp->pos = 0;
+	dirp->buf_len = 0;
+	dirp->buf_off = 0;
 }
 
 /** Close directory.
@@ -123,6 +192,7 @@ void rewinddir(DIR *dirp)
 int closedir(DIR *dirp)
 {
 	errno_t rc = vfs_put(dirp->fd);
+	free(dirp->buf);
 	free(dirp);
 
 	if (rc == EOK) {
@@ -220,5 +220,65 @@ errno_t ipc_test_share_in_rw(ipc_test_t *test, size_t size, void **rptr)
 	return EOK;
 }
 
+/** Test data write.
+ *
+ * @param test IPC test service
+ * @param data Data to send
+ * @param size Size of the data, at most DATA_XFER_LIMIT
+ * @return EOK on success or an error code
+ */
+errno_t ipc_test_data_write(ipc_test_t *test, const void *data, size_t size)
+{
+	async_exch_t *exch;
+	ipc_call_t answer;
+	aid_t req;
+	errno_t retval;
+	errno_t rc;
+
+	exch = async_exchange_begin(test->sess);
+	req = async_send_0(exch, IPC_TEST_DATA_WRITE, &answer);
+
+	rc = async_data_write_start(exch, data, size);
+	if (rc != EOK) {
+		async_exchange_end(exch);
+		async_forget(req);
+		return rc;
+	}
+
+	async_exchange_end(exch);
+	async_wait_for(req, &retval);
+	return retval;
+}
+
+/** Test data read.
+ *
+ * @param test IPC test service
+ * @param buf Buffer for the received data
+ * @param size Number of bytes to read, at most DATA_XFER_LIMIT
+ * @return EOK on success or an error code
+ */
+errno_t ipc_test_data_read(ipc_test_t *test, void *buf, size_t size)
+{
+	async_exch_t *exch;
+	ipc_call_t answer;
+	aid_t req;
+	errno_t retval;
+	errno_t rc;
+
+	exch = async_exchange_begin(test->sess);
+	req = async_send_0(exch, IPC_TEST_DATA_READ, &answer);
+
+	rc = async_data_read_start(exch, buf, size);
+	if (rc != EOK) {
+		async_exchange_end(exch);
+		async_forget(req);
+		return rc;
+	}
+
+	async_exchange_end(exch);
+	async_wait_for(req, &retval);
+	return retval;
+}
+
 /** @}
  */
@@ -45,6 +45,7 @@
 #include <mem.h>
 #include <stdlib.h>
 #include <adt/gcdlcm.h>
+#include <adt/list.h>
 
 #include "private/malloc.h"
 #include "private/fibril.h"
@@ -120,6 +121,12 @@
 	((heap_block_head_t *) \
 	    (((uintptr_t) (foot)) + sizeof(heap_block_foot_t) - (foot)->size))
 
+/** Get header of heap block from the address of its payload.
+ *
+ */
+#define ADDR_BLOCK_HEAD(addr) \
+	((heap_block_head_t *) (((uintptr_t) (addr)) - sizeof(heap_block_head_t)))
+
 /** Get footer in heap block.
  *
  */
@@ -166,6 +173,9 @@ typedef struct {
 	/* Indication of a free block */
 	bool free;
 
+	/* Indication of a used block kept in an allocation cache */
+	bool cached;
+
 	/** Heap area this block belongs to */
 	heap_area_t *area;
 
@@ -190,12 +200,104 @@ static heap_area_t *first_heap_area = NULL;
 /** Last heap area */
 static heap_area_t *last_heap_area = NULL;
 
-/** Next heap block to examine (next fit algorithm) */
-static heap_block_head_t *next_fit = NULL;
+/** Number of bits of the size used to select the second-level bin */
+#define BIN_SL_BITS  2
+
+/** Number of second-level bins per power of two */
+#define BIN_SL_COUNT  (1 << BIN_SL_BITS)
+
+/** Total number of free block bins */
+#define BIN_COUNT  (sizeof(size_t) * 8 * BIN_SL_COUNT)
+
+/** Number of bits in one word of the bin bitmap */
+#define BIN_MAP_BITS  (sizeof(size_t) * 8)
+
+/** Get the free list link stored in the payload of a free block. */
+#define FREE_LINK(head) \
+	((link_t *) (((uintptr_t) (head)) + sizeof(heap_block_head_t)))
+
+/** Get the free block containing a free list link. */
+#define FREE_LINK_HEAD(link) \
+	((heap_block_head_t *) \
+	    (((uintptr_t) (link)) - sizeof(heap_block_head_t)))
+
+/** Smallest free block which can be kept on a free list.
+ *
+ * Smaller free blocks cannot hold the free list link. They are
+ * not available for allocation until they are merged with a
+ * neighbouring block.
+ *
+ */
+#define FREE_MIN_SIZE  GROSS_SIZE(ALIGN_UP(sizeof(link_t), BASE_ALIGN))
+
+/** Segregated free lists
+ *
+ * Free blocks are kept in bins according to their size. The first
+ * level is the position of the most significant bit of the size,
+ * the second level subdivides each power of two linearly.
+ *
+ */
+static list_t free_bins[BIN_COUNT];
+
+/** Bitmap of non-empty bins */
+static size_t free_bin_map[BIN_COUNT / BIN_MAP_BITS];
 
 /** Futex for thread-safe heap manipulation */
 static fibril_rmutex_t malloc_mutex;
 
+/** Number of size classes served by the allocation caches.
+ *
+ * Size class N holds blocks with net size of N * BASE_ALIGN bytes.
+ *
+ */
+#define CACHE_CLASSES  16
+
+/** Largest allocation size served by the allocation caches. */
+#define CACHE_MAX_SIZE  ((CACHE_CLASSES - 1) * BASE_ALIGN)
+
+/** Number of blocks in one magazine. */
+#define MAGAZINE_SIZE  16
+
+/** Number of blocks moved between a magazine and the heap at once. */
+#define MAGAZINE_BATCH  (MAGAZINE_SIZE / 2)
+
+/** Number of allocation caches.
+ *
+ * Each thread prefers one of the caches, so this should be
+ * at least the number of threads allocating concurrently.
+ *
+ */
+#define CACHE_COUNT  8
+
+/** Magazine of free blocks of one size class */
+typedef struct {
+	/** Number of blocks in the magazine */
+	size_t count;
+
+	/** Blocks in the magazine (the last one is used first) */
+	void *blocks[MAGAZINE_SIZE];
+} magazine_t;
+
+/** Allocation cache
+ *
+ * Small blocks are allocated from and freed to the magazines
+ * of an allocation cache without taking the heap lock. The
+ * magazines are refilled from and drained to the heap in
+ * batches. Blocks in the magazines appear as used blocks
+ * to the rest of the heap allocator.
+ *
+ */
+typedef struct {
+	/** Futex protecting the magazines */
+	fibril_rmutex_t lock;
+
+	/** Magazines for the individual size classes */
+	magazine_t mag[CACHE_CLASSES];
+} malloc_cache_t;
+
+/** Allocation caches */
+static malloc_cache_t malloc_caches[CACHE_COUNT];
+
 #define malloc_assert(expr) safe_assert(expr)
 
 /** Serializes access to the heap from multiple threads. */
@@ -228,6 +330,7 @@ static void block_init(void *addr, size_t size, bool free, heap_area_t *area)
 
 	head->size = size;
 	head->free = free;
+	head->cached = false;
 	head->area = area;
 	head->magic = HEAP_BLOCK_HEAD_MAGIC;
 
@@ -258,6 +361,88 @@ static void block_check(void *addr)
 	malloc_assert(head->size == foot->size);
 }
 
+/** Get the bin for a free block of a given size
+ *
+ * @param size Gross size of the block.
+ *
+ * @return Bin index.
+ *
+ */
+static size_t bin_index(size_t size)
+{
+	unsigned int fl = fnzb(size);
+	size_t sl = (size >> (fl - BIN_SL_BITS)) & (BIN_SL_COUNT - 1);
+
+	return fl * BIN_SL_COUNT + sl;
+}
+
+/** Find the first non-empty bin starting at a given bin
+ *
+ * @param bin First bin to consider.
+ *
+ * @return Index of a non-empty bin or BIN_COUNT if there is none.
+ *
+ */
+static size_t bin_next(size_t bin)
+{
+	while (bin < BIN_COUNT) {
+		size_t word = free_bin_map[bin / BIN_MAP_BITS] &
+		    ~BIT_RRANGE(size_t, bin % BIN_MAP_BITS);
+
+		if (word != 0) {
+			return ALIGN_DOWN(bin, BIN_MAP_BITS) +
+			    fnzb(word & -word);
+		}
+
+		bin = ALIGN_DOWN(bin, BIN_MAP_BITS) + BIN_MAP_BITS;
+	}
+
+	return BIN_COUNT;
+}
+
+/** Put a free block on its free list
+ *
+ * Should be called only inside the critical section.
+ *
+ * @param head Free block.
+ *
+ */
+static void free_list_insert(heap_block_head_t *head)
+{
+	malloc_assert(head->free);
+
+	if (head->size < FREE_MIN_SIZE)
+		return;
+
+	size_t bin = bin_index(head->size);
+
+	link_initialize(FREE_LINK(head));
+	list_prepend(FREE_LINK(head), &free_bins[bin]);
+	free_bin_map[bin / BIN_MAP_BITS] |= BIT_V(size_t, bin % BIN_MAP_BITS);
+}
+
+/** Remove a free block from its free list
+ *
+ * Should be called only inside the critical section
+ * and before the size of the block is changed.
+ *
+ * @param head Free block.
+ *
+ */
+static void free_list_remove(heap_block_head_t *head)
+{
+	malloc_assert(head->free);
+
+	if (head->size < FREE_MIN_SIZE)
+		return;
+
+	size_t bin = bin_index(head->size);
+
+	list_remove(FREE_LINK(head));
+	if (list_empty(&free_bins[bin]))
+		free_bin_map[bin / BIN_MAP_BITS] &= ~BIT_V(size_t, bin % BIN_MAP_BITS);
+}
+
 /** Check a heap area structure
  *
  * Should be called only inside the critical section.
@@ -304,6 +489,7 @@ static bool area_create(size_t size)
 	size_t bsize = (size_t) (area->end - block);
 
 	block_init(block, bsize, true, area);
+	free_list_insert(block);
 
 	if (last_heap_area == NULL) {
 		first_heap_area = area;
@@ -355,12 +541,16 @@ static bool area_grow(heap_area_t *area, size_t size)
 		/* Add the new space to the last block. */
 		size_t net_size = (size_t) (end - area->end) + last_head->size;
 		malloc_assert(net_size > 0);
+		free_list_remove(last_head);
 		block_init(last_head, net_size, true, area);
+		free_list_insert(last_head);
 	} else {
 		/* Add new free block */
 		size_t net_size = (size_t) (end - area->end);
-		if (net_size > 0)
+		if (net_size > 0) {
 			block_init(area->end, net_size, true, area);
+			free_list_insert(area->end);
+		}
 	}
 
 	/* Update heap area parameters */
@@ -372,7 +562,6 @@ static bool area_grow(heap_area_t *area, size_t size)
 /** Try to shrink heap
  *
  * Should be called only inside the critical section.
- * In all cases the next pointer is reset.
  *
  * @param area Last modified heap area.
  *
@@ -403,6 +592,15 @@ static void heap_shrink(heap_area_t *area)
 
 		size_t shrink_size = ALIGN_DOWN(last_head->size, PAGE_SIZE);
 
+		/*
+		 * The used block before the last one cannot be enlarged, as
+		 * its owner may be looking at its header without holding the
+		 * heap lock. Leave enough space for a free block instead.
+		 */
+		size_t rest = last_head->size - shrink_size;
+		if ((rest > 0) && (rest < STRUCT_OVERHEAD))
+			shrink_size -= min(shrink_size, PAGE_SIZE);
+
 		if (first_head == last_head) {
 			/*
 			 * The entire heap area consists of a single
@@ -413,6 +611,8 @@ static void heap_shrink(heap_area_t *area)
 			heap_area_t *prev = area->prev;
 			heap_area_t *next = area->next;
 
+			free_list_remove(last_head);
+
 			if (prev != NULL) {
 				area_check(prev);
 				prev->next = next;
@@ -436,6 +636,8 @@ static void heap_shrink(heap_area_t *area)
 			size_t asize = (size_t) (area->end - area->start) - shrink_size;
 			void *end = (void *) ((uintptr_t) area->start + asize);
 
+			free_list_remove(last_head);
+
 			/* Resize the address space area */
 			errno_t ret = as_area_resize(area->start, asize, 0);
 			if (ret != EOK)
@@ -446,32 +648,17 @@ static void heap_shrink(heap_area_t *area)
 			size_t excess = ((size_t) area->end) - ((size_t) last_head);
 
 			if (excess > 0) {
-				if (excess >= STRUCT_OVERHEAD) {
-					/*
-					 * The previous block cannot be free and there
-					 * is enough free space left in the area to
-					 * create a new free block.
-					 */
-					block_init((void *) last_head, excess, true, area);
-				} else {
-					/*
-					 * The excess is small. Therefore just enlarge
-					 * the previous block.
-					 */
-					heap_block_foot_t *prev_foot = (heap_block_foot_t *)
-					    (((uintptr_t) last_head) - sizeof(heap_block_foot_t));
-					heap_block_head_t *prev_head = BLOCK_HEAD(prev_foot);
-
-					block_check((void *) prev_head);
-
-					block_init(prev_head, prev_head->size + excess,
-					    prev_head->free, area);
-				}
+				/*
+				 * The previous block cannot be free and there
+				 * is enough free space left in the area to
+				 * create a new free block.
+				 */
+				malloc_assert(excess >= STRUCT_OVERHEAD);
+				block_init((void *) last_head, excess, true, area);
+				free_list_insert(last_head);
 			}
 		}
 	}
-
-	next_fit = NULL;
 }
 
 /** Initialize the heap allocator
@@ -486,18 +673,31 @@ void __malloc_init(void)
 	if (fibril_rmutex_initialize(&malloc_mutex) != EOK)
 		abort();
 
+	for (size_t i = 0; i < CACHE_COUNT; i++) {
+		if (fibril_rmutex_initialize(&malloc_caches[i].lock) != EOK)
+			abort();
+	}
+
+	for (size_t i = 0; i < BIN_COUNT; i++)
+		list_initialize(&free_bins[i]);
+
 	if (!area_create(PAGE_SIZE))
 		abort();
 }
 
 void __malloc_fini(void)
 {
+	for (size_t i = 0; i < CACHE_COUNT; i++)
+		fibril_rmutex_destroy(&malloc_caches[i].lock);
+
 	fibril_rmutex_destroy(&malloc_mutex);
 }
 
 /** Split heap block and mark it as used.
  *
  * Should be called only inside the critical section.
+ * The block must not be on a free list. The remainder
+ * of the block (if any) is put on a free list.
  *
  * @param cur  Heap block to split.
  * @param size Number of bytes to split and mark from the beginning
@@ -516,142 +716,155 @@ static void split_mark(heap_block_head_t *cur, const size_t size)
 		void *next = ((void *) cur) + size;
 		block_init(next, cur->size - size, true, cur->area);
 		block_init(cur, size, false, cur->area);
+		free_list_insert(next);
 	} else {
 		/* Block too small -> use as is. */
 		cur->free = false;
 	}
 }
 
-/** Allocate memory from heap area starting from given block
+/** Allocate memory from a free heap block
  *
  * Should be called only inside the critical section.
- * As a side effect this function also sets the current
- * pointer on successful allocation.
+ * The block is taken off its free list if it is used.
  *
- * @param area        Heap area where to allocate from.
- * @param first_block Starting heap block.
- * @param final_block Heap block where to finish the search
- *                    (may be NULL).
- * @param real_size   Gross number of bytes to allocate.
- * @param falign      Physical alignment of the block.
+ * @param cur       Free heap block to allocate from.
+ * @param real_size Gross number of bytes to allocate.
+ * @param falign    Physical alignment of the block.
  *
- * @return Address of the allocated block or NULL on not enough memory.
+ * @return Address of the allocated block or NULL if the block
+ *         is not large enough.
  *
  */
-static void *malloc_area(heap_area_t *area, heap_block_head_t *first_block,
-    heap_block_head_t *final_block, size_t real_size, size_t falign)
+static void *malloc_block(heap_block_head_t *cur, size_t real_size,
+    size_t falign)
 {
+	heap_area_t *area = cur->area;
+
 	area_check((void *) area);
-	malloc_assert((void *) first_block >= (void *) AREA_FIRST_BLOCK_HEAD(area));
-	malloc_assert((void *) first_block < area->end);
+	block_check(cur);
+	malloc_assert(cur->free);
+	malloc_assert((void *) cur >= (void *) AREA_FIRST_BLOCK_HEAD(area));
+	malloc_assert((void *) cur < area->end);
 
-	for (heap_block_head_t *cur = first_block; (void *) cur < area->end;
-	    cur = (heap_block_head_t *) (((void *) cur) + cur->size)) {
-		block_check(cur);
+	if (cur->size < real_size)
+		return NULL;
 
-		/* Finish searching on the final block */
-		if ((final_block != NULL) && (cur == final_block))
-			break;
+	/*
+	 * We have found a suitable block.
+	 * Check for alignment properties.
+	 */
+	void *addr = (void *)
+	    ((uintptr_t) cur + sizeof(heap_block_head_t));
+	void *aligned = (void *)
+	    ALIGN_UP((uintptr_t) addr, falign);
 
-		/* Try to find a block that is free and large enough. */
-		if ((cur->free) && (cur->size >= real_size)) {
-			/*
-			 * We have found a suitable block.
-			 * Check for alignment properties.
-			 */
-			void *addr = (void *)
-			    ((uintptr_t) cur + sizeof(heap_block_head_t));
-			void *aligned = (void *)
-			    ALIGN_UP((uintptr_t) addr, falign);
+	if (addr == aligned) {
+		/* Exact block start including alignment. */
+		free_list_remove(cur);
+		split_mark(cur, real_size);
+
+		return addr;
+	}
+
+	/* Block start has to be aligned */
+	size_t excess = (size_t) (aligned - addr);
+
+	if (cur->size < real_size + excess)
+		return NULL;
+
+	/*
+	 * The current block is large enough to fit
+	 * data in (including alignment).
+	 */
+	if ((void *) cur > (void *) AREA_FIRST_BLOCK_HEAD(area)) {
+		/*
+		 * There is a block before the current block.
+		 * If it is free, it can be enlarged to
+		 * compensate for the alignment excess.
+		 */
+		heap_block_foot_t *prev_foot = (heap_block_foot_t *)
+		    ((void *) cur - sizeof(heap_block_foot_t));
+
+		heap_block_head_t *prev_head = (heap_block_head_t *)
+		    ((void *) cur - prev_foot->size);
+
+		block_check(prev_head);
 
-			if (addr == aligned) {
-				/* Exact block start including alignment. */
-				split_mark(cur, real_size);
+		if (prev_head->free) {
+			size_t reduced_size = cur->size - excess;
+			heap_block_head_t *next_head = ((void *) cur) + excess;
 
-				next_fit = cur;
+			free_list_remove(cur);
+			free_list_remove(prev_head);
+
+			block_init(prev_head, prev_head->size + excess,
+			    true, area);
+			free_list_insert(prev_head);
+
+			block_init(next_head, reduced_size, true, area);
+			split_mark(next_head, real_size);
+
+			return aligned;
+		}
+	}
+
+	/*
+	 * A used block is never enlarged, as its owner may be
+	 * looking at its header without holding the heap lock.
+	 * We have to make sure that the alignment excess is
+	 * large enough to fit a new free block just before the
+	 * current block.
+	 */
+	while (excess < STRUCT_OVERHEAD) {
+		aligned += falign;
+		excess += falign;
+	}
+
+	/* Check for current block size again */
+	if (cur->size < real_size + excess)
+		return NULL;
+
+	size_t reduced_size = cur->size - excess;
+	heap_block_head_t *first = cur;
+
+	free_list_remove(cur);
+
+	cur = (heap_block_head_t *) ((void *) first + excess);
+
+	block_init(first, excess, true, area);
+	free_list_insert(first);
+	block_init(cur, reduced_size, true, area);
+	split_mark(cur, real_size);
+
+	return aligned;
+}
+
+/** Allocate memory from the free lists
+ *
+ * Should be called only inside the critical section.
+ * The bin which may contain blocks smaller than the request
+ * is searched first-fit, any block in the bins above is
+ * large enough. Empty bins are skipped using the bitmap.
+ *
+ * @param real_size Gross number of bytes to allocate.
+ * @param falign    Physical alignment of the block.
+ *
+ * @return Address of the allocated block or NULL if no free
+ *         block is suitable.
+ *
+ */
+static void *malloc_bins(size_t real_size, size_t falign)
+{
+	for (size_t bin = bin_next(bin_index(real_size)); bin < BIN_COUNT;
+	    bin = bin_next(bin + 1)) {
+		for (link_t *link = list_first(&free_bins[bin]); link != NULL;
+		    link = list_next(link, &free_bins[bin])) {
+			heap_block_head_t *cur = FREE_LINK_HEAD(link);
+
+			void *addr = malloc_block(cur, real_size, falign);
+			if (addr != NULL)
 				return addr;
-			} else {
-				/* Block start has to be aligned */
-				size_t excess = (size_t) (aligned - addr);
-
-				if (cur->size >= real_size + excess) {
-					/*
-					 * The current block is large enough to fit
-					 * data in (including alignment).
-					 */
-					if ((void *) cur > (void *) AREA_FIRST_BLOCK_HEAD(area)) {
-						/*
-						 * There is a block before the current block.
-						 * This previous block can be enlarged to
-						 * compensate for the alignment excess.
-						 */
-						heap_block_foot_t *prev_foot = (heap_block_foot_t *)
-						    ((void *) cur - sizeof(heap_block_foot_t));
-
-						heap_block_head_t *prev_head = (heap_block_head_t *)
-						    ((void *) cur - prev_foot->size);
-
-						block_check(prev_head);
-
-						size_t reduced_size = cur->size - excess;
-						heap_block_head_t *next_head = ((void *) cur) + excess;
-
-						if ((!prev_head->free) &&
-						    (excess >= STRUCT_OVERHEAD)) {
-							/*
-							 * The previous block is not free and there
-							 * is enough free space left to fill in
-							 * a new free block between the previous
-							 * and current block.
-							 */
-							block_init(cur, excess, true, area);
-						} else {
-							/*
-							 * The previous block is free (thus there
-							 * is no need to induce additional
-							 * fragmentation to the heap) or the
-							 * excess is small. Therefore just enlarge
-							 * the previous block.
-							 */
-							block_init(prev_head, prev_head->size + excess,
-							    prev_head->free, area);
-						}
-
-						block_init(next_head, reduced_size, true, area);
-						split_mark(next_head, real_size);
-
-						next_fit = next_head;
-						return aligned;
-					} else {
-						/*
-						 * The current block is the first block
-						 * in the heap area. We have to make sure
-						 * that the alignment excess is large enough
-						 * to fit a new free block just before the
-						 * current block.
-						 */
-						while (excess < STRUCT_OVERHEAD) {
-							aligned += falign;
-							excess += falign;
-						}
-
-						/* Check for current block size again */
-						if (cur->size >= real_size + excess) {
-							size_t reduced_size = cur->size - excess;
-							cur = (heap_block_head_t *)
-							    (AREA_FIRST_BLOCK_HEAD(area) + excess);
-
-							block_init((void *) AREA_FIRST_BLOCK_HEAD(area),
-							    excess, true, area);
-							block_init(cur, reduced_size, true, area);
-							split_mark(cur, real_size);
-
-							next_fit = cur;
-							return aligned;
-						}
-					}
-				}
-			}
 		}
 	}
 
@@ -680,11 +893,10 @@ static void *heap_grow_and_alloc(size_t size, size_t align)
 	    area = area->next) {
 
 		if (area_grow(area, size + align)) {
-			heap_block_head_t *first =
+			heap_block_head_t *last =
 			    (heap_block_head_t *) AREA_LAST_BLOCK_HEAD(area);
 
-			void *addr =
-			    malloc_area(area, first, NULL, size, align);
+			void *addr = malloc_block(last, size, align);
 			malloc_assert(addr != NULL);
 			return addr;
 		}
@@ -695,8 +907,7 @@ static void *heap_grow_and_alloc(size_t size, size_t align)
 		heap_block_head_t *first =
 		    (heap_block_head_t *) AREA_FIRST_BLOCK_HEAD(last_heap_area);
 
-		void *addr =
-		    malloc_area(last_heap_area, first, NULL, size, align);
+		void *addr = malloc_block(first, size, align);
 		malloc_assert(addr != NULL);
 		return addr;
 	}
@@ -735,32 +946,201 @@ static void *malloc_internal(const size_t size, const size_t align)
 	 */
 	size_t gross_size = GROSS_SIZE(ALIGN_UP(size, BASE_ALIGN));
 
-	/* Try the next fit approach */
-	heap_block_head_t *split = next_fit;
+	/* Check for integer overflow. */
+	if (gross_size < size)
+		return NULL;
 
-	if (split != NULL) {
-		void *addr = malloc_area(split->area, split, NULL, gross_size,
-		    falign);
+	/* Look for a suitable free block */
+	void *addr = malloc_bins(gross_size, falign);
+	if (addr != NULL)
+		return addr;
 
-		if (addr != NULL)
-			return addr;
+	/* Finally, try to grow heap space and allocate in the new area. */
+	return heap_grow_and_alloc(gross_size, falign);
+}
+
+/** Free a memory block
+ *
+ * Should be called only inside the critical section.
+ *
+ * @param addr The address of the block.
+ *
+ */
+static void free_internal(void *const addr)
+{
+	/* Calculate the position of the header. */
+	heap_block_head_t *head =
+	    (heap_block_head_t *) (addr - sizeof(heap_block_head_t));
+
+	block_check(head);
+	malloc_assert(!head->free);
+	malloc_assert(!head->cached);
+
+	heap_area_t *area = head->area;
+
+	area_check(area);
+	malloc_assert((void *) head >= (void *) AREA_FIRST_BLOCK_HEAD(area));
+	malloc_assert((void *) head < area->end);
+
+	/* Mark the block itself as free. */
+	head->free = true;
+
+	/* Look at the next block. If it is free, merge the two. */
+	heap_block_head_t *next_head =
+	    (heap_block_head_t *) (((void *) head) + head->size);
+
+	if ((void *) next_head < area->end) {
+		block_check(next_head);
+		if (next_head->free) {
+			free_list_remove(next_head);
+			block_init(head, head->size + next_head->size, true, area);
+		}
 	}
 
-	/* Search the entire heap */
-	for (heap_area_t *area = first_heap_area; area != NULL;
-	    area = area->next) {
-		heap_block_head_t *first = (heap_block_head_t *)
-		    AREA_FIRST_BLOCK_HEAD(area);
+	/* Look at the previous block. If it is free, merge the two. */
+	if ((void *) head > (void *) AREA_FIRST_BLOCK_HEAD(area)) {
+		heap_block_foot_t *prev_foot =
+		    (heap_block_foot_t *) (((void *) head) - sizeof(heap_block_foot_t));
 
-		void *addr = malloc_area(area, first, split, gross_size,
-		    falign);
+		heap_block_head_t *prev_head =
+		    (heap_block_head_t *) (((void *) head) - prev_foot->size);
 
-		if (addr != NULL)
-			return addr;
+		block_check(prev_head);
+
+		if (prev_head->free) {
+			free_list_remove(prev_head);
+			block_init(prev_head, prev_head->size + head->size, true,
+			    area);
+			head = prev_head;
+		}
 	}
 
-	/* Finally, try to grow heap space and allocate in the new area. */
-	return heap_grow_and_alloc(gross_size, falign);
+	free_list_insert(head);
+	heap_shrink(area);
+}
+
+/** Lock an allocation cache
+ *
+ * The cache preferred by the current thread is used unless
+ * it is busy, in which case any other free cache is used.
+ * This keeps threads allocating concurrently from contending
+ * on the same lock.
+ *
+ * @return Locked allocation cache.
+ *
+ */
+static malloc_cache_t *cache_lock(void)
+{
+	fibril_t *self = fibril_self();
+	fibril_t *ctx = (self->thread_ctx != NULL) ? self->thread_ctx : self;
+	size_t first = ((uintptr_t) ctx / sizeof(fibril_t)) % CACHE_COUNT;
+
+	for (size_t i = 0; i < CACHE_COUNT; i++) {
+		malloc_cache_t *cache = &malloc_caches[(first + i) % CACHE_COUNT];
+		if (fibril_rmutex_trylock(&cache->lock))
+			return cache;
+	}
+
+	fibril_rmutex_lock(&malloc_caches[first].lock);
+	return &malloc_caches[first];
+}
+
+/** Unlock an allocation cache
+ *
+ * @param cache Allocation cache locked by cache_lock().
+ *
+ */
+static void cache_unlock(malloc_cache_t *cache)
+{
+	fibril_rmutex_unlock(&cache->lock);
+}
+
+/** Allocate a small block from an allocation cache
+ *
+ * @param size Number of bytes to allocate (at most CACHE_MAX_SIZE).
+ *
+ * @return Allocated memory or NULL.
+ *
+ */
+static void *cache_alloc(const size_t size)
+{
+	size_t cls = ALIGN_UP(size, BASE_ALIGN) / BASE_ALIGN;
+	malloc_cache_t *cache = cache_lock();
+	magazine_t *mag = &cache->mag[cls];
+
+	if (mag->count == 0) {
+		/* Refill the magazine from the heap. */
+		heap_lock();
+
+		while (mag->count < MAGAZINE_BATCH) {
+			void *block = malloc_internal(cls * BASE_ALIGN,
+			    BASE_ALIGN);
+			if (block == NULL)
+				break;
+
+			ADDR_BLOCK_HEAD(block)->cached = true;
+			mag->blocks[mag->count++] = block;
+		}
+
+		heap_unlock();
+	}
+
+	void *block = NULL;
+	if (mag->count > 0) {
+		block = mag->blocks[--mag->count];
+		ADDR_BLOCK_HEAD(block)->cached = false;
+	}
+
+	cache_unlock(cache);
+	return block;
+}
+
+/** Free a small block to an allocation cache
+ *
+ * @param addr The address of the block.
+ *
+ * @return True if the block has been cached, false if it
+ *         is not of any cached size class.
+ *
+ */
+static bool cache_free(void *const addr)
+{
+	heap_block_head_t *head = ADDR_BLOCK_HEAD(addr);
+
+	/*
+	 * The header of a used block is not modified by anyone
+	 * else but its owner, thus it is safe to look at it
+	 * without holding the heap lock.
+	 */
+	block_check(head);
+	malloc_assert(!head->free);
+	malloc_assert(!head->cached);
+
+	size_t net_size = NET_SIZE(head->size);
+	if ((net_size % BASE_ALIGN) != 0 || net_size > CACHE_MAX_SIZE)
+		return false;
+
+	malloc_cache_t *cache = cache_lock();
+	magazine_t *mag = &cache->mag[net_size / BASE_ALIGN];
+
+	if (mag->count == MAGAZINE_SIZE) {
+		/* Drain the magazine to the heap. */
+		heap_lock();
+
+		while (mag->count > MAGAZINE_SIZE - MAGAZINE_BATCH) {
+			void *block = mag->blocks[--mag->count];
+			ADDR_BLOCK_HEAD(block)->cached = false;
+			free_internal(block);
+		}
+
+		heap_unlock();
+	}
+
+	head->cached = true;
+	mag->blocks[mag->count++] = addr;
+
+	cache_unlock(cache);
+	return true;
 }
 
 /** Allocate memory by number of elements
@@ -792,6 +1172,12 @@ void *calloc(const size_t nmemb, const size_t size)
  */
 void *malloc(const size_t size)
 {
+	if (size <= CACHE_MAX_SIZE) {
+		void *block = cache_alloc(size);
+		if (block != NULL)
+			return block;
+	}
+
 	heap_lock();
 	void *block = malloc_internal(size, BASE_ALIGN);
 	heap_unlock();
@@ -848,6 +1234,7 @@ void *realloc(void *const addr, const size_t size)
 
 	block_check(head);
 	malloc_assert(!head->free);
+	malloc_assert(!head->cached);
 
 	heap_area_t *area = head->area;
 
@@ -870,6 +1257,7 @@ void *realloc(void *const addr, const size_t size)
 			block_init((void *) head, real_size, false, area);
 			block_init((void *) head + real_size,
 			    orig_size - real_size, true, area);
+			free_list_insert((void *) head + real_size);
 			heap_shrink(area);
 		}
 
@@ -915,12 +1303,12 @@ void *realloc(void *const addr, const size_t size)
 		if (have_next && (head->size + next_head->size >= real_size) &&
 		    next_head->free) {
 			block_check(next_head);
+			free_list_remove(next_head);
 			block_init(head, head->size + next_head->size, false,
 			    area);
 			split_mark(head, real_size);
 
 			ptr = ((void *) head) + sizeof(heap_block_head_t);
-			next_fit = NULL;
 		} else {
 			reloc = true;
 		}
@@ -949,51 +1337,11 @@ void free(void *const addr)
 	if (addr == NULL)
 		return;
 
-	heap_lock();
-
-	/* Calculate the position of the header. */
-	heap_block_head_t *head =
-	    (heap_block_head_t *) (addr - sizeof(heap_block_head_t));
-
-	block_check(head);
-	malloc_assert(!head->free);
-
-	heap_area_t *area = head->area;
-
-	area_check(area);
-	malloc_assert((void *) head >= (void *) AREA_FIRST_BLOCK_HEAD(area));
-	malloc_assert((void *) head < area->end);
-
-	/* Mark the block itself as free. */
-	head->free = true;
-
-	/* Look at the next block. If it is free, merge the two. */
-	heap_block_head_t *next_head =
-	    (heap_block_head_t *) (((void *) head) + head->size);
-
-	if ((void *) next_head < area->end) {
-		block_check(next_head);
-		if (next_head->free)
-			block_init(head, head->size + next_head->size, true, area);
-	}
-
-	/* Look at the previous block. If it is free, merge the two. */
-	if ((void *) head > (void *) AREA_FIRST_BLOCK_HEAD(area)) {
-		heap_block_foot_t *prev_foot =
-		    (heap_block_foot_t *) (((void *) head) - sizeof(heap_block_foot_t));
-
-		heap_block_head_t *prev_head =
-		    (heap_block_head_t *) (((void *) head) - prev_foot->size);
-
-		block_check(prev_head);
-
-		if (prev_head->free)
-			block_init(prev_head, prev_head->size + head->size, true,
-			    area);
-	}
-
-	heap_shrink(area);
+	if (cache_free(addr))
+		return;
 
+	heap_lock();
+	free_internal(addr);
 	heap_unlock();
 }
 
@@ -1041,6 +1389,20 @@ void *heap_check(void)
 		}
 	}
 
+	/* Walk all free lists */
+	for (size_t bin = 0; bin < BIN_COUNT; bin++) {
+		list_foreach_safe(free_bins[bin], link, next) {
+			heap_block_head_t *head = FREE_LINK_HEAD(link);
+
+			/* Check that the block is a free block of the right size */
+			if ((head->magic != HEAP_BLOCK_HEAD_MAGIC) ||
+			    (!head->free) || (bin_index(head->size) != bin)) {
+				heap_unlock();
+				return (void *) head;
+			}
+		}
+	}
+
 	heap_unlock();
 
 	return NULL;
@@ -61,6 +61,11 @@ struct fibril {
 	errno_t retval;
 
 	fibril_t *thread_ctx;
+	/**
+	 * Runner which the fibril last ran on, or which the fibril serves
+	 * in case of a helper fibril.
+	 */
+	struct fibril_runner *runner;
 
 	bool is_running : 1;
 	bool is_writer : 1;
@@ -35,6 +35,7 @@
  */
 
 #include <adt/list.h>
+#include <adt/odict.h>
 #include <fibril.h>
 #include <stack.h>
 #include <tls.h>
@@ -56,13 +57,33 @@
 #define DPRINTF(...) ((void)0)
 #undef READY_DEBUG
 
-/** Member of timeout_list. */
+/** Member of a runner's timeouts. */
 typedef struct {
-	link_t link;
+	odlink_t link;
 	struct timespec expires;
 	fibril_event_t *event;
 } _timeout_t;
 
+/**
+ * State of a thread running fibrils.
+ *
+ * Each runner has its own queue of ready fibrils and its own timeouts.
+ * A woken up fibril is queued on the runner it last ran on, and runners
+ * that find their own queue empty steal fibrils from the other runners.
+ */
+typedef struct fibril_runner {
+	/** Link in runner_list or runner_free_list. */
+	link_t link;
+	/** Protects ready_list and exited. */
+	futex_t lock;
+	/** Fibrils ready to run. */
+	list_t ready_list;
+	/** The thread of this runner exited, queue fibrils elsewhere. */
+	bool exited;
+	/** Timeouts of fibrils that went to sleep on this runner. */
+	odict_t timeouts;
+} _runner_t;
+
 typedef struct {
 	errno_t rc;
 	link_t link;
@@ -85,14 +106,27 @@ typedef enum {
 
 static bool multithreaded = false;
 
-/* This futex serializes access to global data. */
+/*
+ * This futex serializes access to global data, event state and timeouts.
+ * It is held across fibril switches.
+ */
 static futex_t fibril_futex;
 static futex_t ready_semaphore;
 static long ready_st_count;
 
-static LIST_INITIALIZE(ready_list);
+/* This futex protects the runner lists and main_runner_claimed. */
+static futex_t runners_futex;
+static LIST_INITIALIZE(runner_list);
+/*
+ * Runners of exited threads. These are reused rather than freed, because
+ * sleeping fibrils may still refer to them.
+ */
+static LIST_INITIALIZE(runner_free_list);
 static LIST_INITIALIZE(fibril_list);
-static LIST_INITIALIZE(timeout_list);
+
+/** Runner of the first thread that needs one, usually the main thread. */
+static _runner_t main_runner;
+static bool main_runner_claimed = false;
 
 static futex_t ipc_lists_futex;
 static LIST_INITIALIZE(ipc_waiter_list);
@@ -110,8 +144,9 @@ static inline void _ready_debug_check(void)
 {
 #ifdef READY_DEBUG
 	assert(!multithreaded);
-	long count = (long) list_count(&ready_list) +
-	    (long) list_count(&ipc_buffer_free_list);
+	long count = (long) list_count(&ipc_buffer_free_list);
+	list_foreach(runner_list, link, _runner_t, runner)
+		count += (long) list_count(&runner->ready_list);
 	assert(ready_st_count == count);
 #endif
 }
@@ -138,6 +173,174 @@ static inline errno_t _ready_down(const struct timespec *expires)
 
 static atomic_int threads_in_ipc_wait;
 
+static void *_timeout_getkey(odlink_t *odlink)
+{
+	return &odict_get_instance(odlink, _timeout_t, link)->expires;
+}
+
+static int _timeout_cmp(void *a, void *b)
+{
+	struct timespec *ta = (struct timespec *) a;
+	struct timespec *tb = (struct timespec *) b;
+
+	if (ts_gt(ta, tb))
+		return 1;
+	if (ts_gt(tb, ta))
+		return -1;
+	return 0;
+}
+
+static errno_t _runner_initialize(_runner_t *runner)
+{
+	errno_t rc = futex_initialize(&runner->lock, 1);
+	if (rc != EOK)
+		return rc;
+
+	link_initialize(&runner->link);
+	list_initialize(&runner->ready_list);
+	runner->exited = false;
+	odict_initialize(&runner->timeouts, _timeout_getkey, _timeout_cmp);
+	return EOK;
+}
+
+/** Allocate state for a new runner and make it visible to other runners. */
+static _runner_t *_runner_create(void)
+{
+	_runner_t *runner = malloc(sizeof(_runner_t));
+	if (!runner)
+		return NULL;
+
+	if (_runner_initialize(runner) != EOK) {
+		free(runner);
+		return NULL;
+	}
+
+	futex_lock(&runners_futex);
+	list_append(&runner->link, &runner_list);
+	futex_unlock(&runners_futex);
+
+	return runner;
+}
+
+/** Destroy state of a runner that has never been used. */
+static void _runner_destroy(_runner_t *runner)
+{
+	futex_lock(&runners_futex);
+	assert(list_empty(&runner->ready_list));
+	assert(odict_empty(&runner->timeouts));
+	list_remove(&runner->link);
+	futex_unlock(&runners_futex);
+
+	futex_destroy(&runner->lock);
+	free(runner);
+}
+
+/** Get runner state for a thread which does not have a helper fibril yet. */
+static _runner_t *_runner_get(void)
+{
+	futex_lock(&runners_futex);
+
+	if (!main_runner_claimed) {
+		main_runner_claimed = true;
+		futex_unlock(&runners_futex);
+		return &main_runner;
+	}
+
+	_runner_t *runner = list_pop(&runner_free_list, _runner_t, link);
+	if (runner) {
+		futex_lock(&runner->lock);
+		runner->exited = false;
+		futex_unlock(&runner->lock);
+		list_append(&runner->link, &runner_list);
+	}
+
+	futex_unlock(&runners_futex);
+
+	return runner ? runner : _runner_create();
+}
+
+/**
+ * Release runner state of an exiting thread. Its ready fibrils and
+ * timeouts are handed over to the main runner.
+ */
+static void _runner_put(_runner_t *runner)
+{
+	futex_assert_is_locked(&fibril_futex);
+
+	futex_lock(&runners_futex);
+
+	if (runner == &main_runner) {
+		/* Its queue stays visible to the other runners. */
+		main_runner_claimed = false;
+		futex_unlock(&runners_futex);
+		return;
+	}
+
+	list_remove(&runner->link);
+
+	futex_lock(&runner->lock);
+	futex_lock(&main_runner.lock);
+	list_concat(&main_runner.ready_list, &runner->ready_list);
+	futex_unlock(&main_runner.lock);
+	runner->exited = true;
+	futex_unlock(&runner->lock);
+
+	odlink_t *odlink;
+	while ((odlink = odict_first(&runner->timeouts)) != NULL) {
+		odict_remove(odlink);
+		odict_insert(odlink, &main_runner.timeouts, NULL);
+	}
+
+	list_append(&runner->link, &runner_free_list);
+	futex_unlock(&runners_futex);
+}
+
+/** @return Runner of the current thread or NULL if it has none yet. */
+static _runner_t *_runner_self(void)
+{
+	fibril_t *helper = fibril_self()->thread_ctx;
+	return helper ? helper->runner : NULL;
+}
+
+/**
+ * Take a ready fibril out of the runners' queues. The current runner's
+ * queue is preferred, otherwise the oldest fibril of another runner is
+ * stolen.
+ *
+ * A fibril taken here may still be switching away on another thread.
+ * This is fine, because switching to it requires fibril_futex, which
+ * is held until that switch completes.
+ */
+static fibril_t *_ready_fibril_take(void)
+{
+	_runner_t *self = _runner_self();
+	fibril_t *f = NULL;
+
+	if (self) {
+		futex_lock(&self->lock);
+		f = list_pop(&self->ready_list, fibril_t, link);
+		futex_unlock(&self->lock);
+		if (f)
+			return f;
+	}
+
+	futex_lock(&runners_futex);
+
+	list_foreach(runner_list, link, _runner_t, runner) {
+		if (runner == self)
+			continue;
+
+		futex_lock(&runner->lock);
+		f = list_pop(&runner->ready_list, fibril_t, link);
+		futex_unlock(&runner->lock);
+		if (f)
+			break;
+	}
+
+	futex_unlock(&runners_futex);
+	return f;
+}
+
 /** Function that spans the whole life-cycle of a fibril.
  *
  * Each fibril begins execution in this function. Then the function implementing
@@ -191,10 +394,18 @@ void fibril_setup(fibril_t *f)
 
 void fibril_teardown(fibril_t *fibril)
 {
+	fibril_t *helper = fibril->thread_ctx;
+
 	futex_lock(&fibril_futex);
 	list_remove(&fibril->all_link);
+	/* A fibril that owns a thread context is torn down as the thread exits. */
+	if (helper)
+		_runner_put(helper->runner);
 	futex_unlock(&fibril_futex);
 
+	if (helper && helper != fibril && helper->stack)
+		fibril_destroy((fid_t) helper);
+
 	if (fibril->is_freeable) {
 		tls_free(fibril->tcb);
 		free(fibril);
@@ -282,17 +493,19 @@ static fibril_t *_ready_list_pop(const struct timespec *expires, bool locked)
 	 * for each entry of the call buffer.
 	 */
 
-	if (!locked)
-		futex_lock(&fibril_futex);
-	fibril_t *f = list_pop(&ready_list, fibril_t, link);
-	if (!f)
-		atomic_fetch_add_explicit(&threads_in_ipc_wait, 1,
-		    memory_order_relaxed);
-	if (!locked)
-		futex_unlock(&fibril_futex);
+	/*
+	 * Announce the IPC wait before looking at the queues, so that a
+	 * fibril readied concurrently is either found, or the pusher sees
+	 * the announcement and pokes us.
+	 */
+	atomic_fetch_add(&threads_in_ipc_wait, 1);
 
-	if (f)
+	fibril_t *f = _ready_fibril_take();
+	if (f) {
+		atomic_fetch_sub_explicit(&threads_in_ipc_wait, 1,
+		    memory_order_relaxed);
 		return f;
+	}
 
 	if (!multithreaded)
 		assert(list_empty(&ipc_buffer_list));
@@ -364,13 +577,25 @@ static void _ready_list_push(fibril_t *f)
 	if (!f)
 		return;
 
-	futex_assert_is_locked(&fibril_futex);
+	/* Prefer the runner on which the fibril ran last. */
+	_runner_t *runner = f->runner;
+	if (!runner)
+		runner = _runner_self();
+	if (!runner)
+		runner = &main_runner;
+
+	futex_lock(&runner->lock);
+	if (runner->exited) {
+		futex_unlock(&runner->lock);
+		runner = &main_runner;
+		futex_lock(&runner->lock);
+	}
+	list_append(&f->link, &runner->ready_list);
+	futex_unlock(&runner->lock);
 
-	/* Enqueue in ready_list. */
-	list_append(&f->link, &ready_list);
 	_ready_up();
 
-	if (atomic_load_explicit(&threads_in_ipc_wait, memory_order_relaxed)) {
+	if (atomic_load(&threads_in_ipc_wait)) {
 		DPRINTF("Poking.\n");
 		/* Wakeup one thread sleeping in SYS_IPC_WAIT. */
 		ipc_poke();
@@ -414,32 +639,45 @@ static errno_t _wait_ipc(ipc_call_t *call, const struct timespec *expires)
 	return rc;
 }
 
-/** Fire all timeouts that expired. */
+/**
+ * Fire all timeouts that expired. Timeouts of all runners are checked, so
+ * that an idle runner fires the timeouts of a runner which is busy.
+ */
 static struct timespec *_handle_expired_timeouts(struct timespec *next_timeout)
 {
 	struct timespec ts;
 	getuptime(&ts);
 
+	struct timespec *next = NULL;
+
 	futex_lock(&fibril_futex);
+	futex_lock(&runners_futex);
 
-	while (!list_empty(&timeout_list)) {
-		link_t *cur = list_first(&timeout_list);
-		_timeout_t *to = list_get_instance(cur, _timeout_t, link);
+	list_foreach(runner_list, link, _runner_t, runner) {
+		odlink_t *odlink;
 
-		if (ts_gt(&to->expires, &ts)) {
-			*next_timeout = to->expires;
-			futex_unlock(&fibril_futex);
-			return next_timeout;
-		}
+		while ((odlink = odict_first(&runner->timeouts)) != NULL) {
+			_timeout_t *to = odict_get_instance(odlink,
+			    _timeout_t, link);
+
+			if (ts_gt(&to->expires, &ts)) {
+				if (!next || ts_gt(next, &to->expires)) {
+					*next_timeout = to->expires;
+					next = next_timeout;
+				}
+				break;
+			}
 
-		list_remove(&to->link);
+			odict_remove(&to->link);
 
-		_ready_list_push(_fibril_trigger_internal(
-		    to->event, _EVENT_TIMED_OUT));
+			_ready_list_push(_fibril_trigger_internal(
+			    to->event, _EVENT_TIMED_OUT));
+		}
 	}
 
+	futex_unlock(&runners_futex);
 	futex_unlock(&fibril_futex);
-	return NULL;
+	return next;
 }
 
 /**
@@ -488,6 +726,9 @@ static void _fibril_switch_to(_switch_type_t type, fibril_t *dstf, bool locked)
 	dstf->thread_ctx = srcf->thread_ctx;
 	srcf->thread_ctx = NULL;
 
+	if (dstf->thread_ctx)
+		dstf->runner = dstf->thread_ctx->runner;
+
 	/* Just some bookkeeping to allow better debugging of futex locks. */
 	futex_give_to(&fibril_futex, dstf);
 
@@ -600,17 +841,10 @@ static void _insert_timeout(_timeout_t *timeout)
 	futex_assert_is_locked(&fibril_futex);
 	assert(timeout);
 
-	link_t *tmp = timeout_list.head.next;
-	while (tmp != &timeout_list.head) {
-		_timeout_t *cur = list_get_instance(tmp, _timeout_t, link);
-
-		if (ts_gteq(&cur->expires, &timeout->expires))
-			break;
+	_runner_t *runner = _runner_self();
+	assert(runner);
 
-		tmp = tmp->next;
-	}
-
-	list_insert_before(&timeout->link, tmp);
+	odict_insert(&timeout->link, &runner->timeouts, NULL);
 }
 
 /**
@@ -631,10 +865,18 @@ errno_t fibril_wait_timeout(fibril_event_t *event,
 	DPRINTF("### Fibril %p sleeping on event %p.\n", fibril_self(), event);
 
 	if (!fibril_self()->thread_ctx) {
-		fibril_self()->thread_ctx =
+		fibril_t *helper = (fibril_t *)
 		    fibril_create_generic(_helper_fibril_fn, NULL, PAGE_SIZE);
-		if (!fibril_self()->thread_ctx)
+		if (!helper)
 			return ENOMEM;
+
+		helper->runner = _runner_get();
+		if (!helper->runner) {
+			fibril_destroy((fid_t) helper);
+			return ENOMEM;
+		}
+
+		fibril_self()->thread_ctx = helper;
 	}
 
 	futex_lock(&fibril_futex);
@@ -678,6 +920,7 @@ errno_t fibril_wait_timeout(fibril_event_t *event,
 	}
 
 	_timeout_t timeout = { 0 };
+	odlink_initialize(&timeout.link);
 	if (expires) {
 		timeout.expires = *expires;
 		timeout.event = event;
@@ -697,7 +940,8 @@ errno_t fibril_wait_timeout(fibril_event_t *event,
 	assert(event->fibril != _EVENT_INITIAL);
 	assert(event->fibril == _EVENT_TIMED_OUT || event->fibril == _EVENT_TRIGGERED);
 
-	list_remove(&timeout.link);
+	if (odlink_used(&timeout.link))
+		odict_remove(&timeout.link);
 	errno_t rc = (event->fibril == _EVENT_TIMED_OUT) ? ETIMEOUT : EOK;
 	event->fibril = _EVENT_INITIAL;
 
@@ -722,8 +966,11 @@ void fibril_wait_for(fibril_event_t *event)
 void fibril_notify(fibril_event_t *event)
 {
 	futex_lock(&fibril_futex);
-	_ready_list_push(_fibril_trigger_internal(event, _EVENT_TRIGGERED));
+	fibril_t *f = _fibril_trigger_internal(event, _EVENT_TRIGGERED);
 	futex_unlock(&fibril_futex);
+
+	/* The woken fibril is not reachable through the event any more. */
+	_ready_list_push(f);
 }
 
 /** Start a fibril that has not been running yet. */
@@ -736,9 +983,9 @@ void fibril_start(fibril_t *fibril)
 	if (!link_in_use(&fibril->all_link))
 		list_append(&fibril->all_link, &fibril_list);
 
-	_ready_list_push(fibril);
-
 	futex_unlock(&fibril_futex);
+
+	_ready_list_push(fibril);
 }
 
 /** Start a fibril that has not been running yet. (obsolete) */
@@ -782,7 +1029,8 @@ void fibril_yield(void)
 
 static void _runner_fn(void *arg)
 {
-	_helper_fibril_fn(arg);
+	fibril_self()->runner = (_runner_t *) arg;
+	_helper_fibril_fn(NULL);
 }
 
 /**
@@ -807,10 +1055,16 @@ int fibril_test_spawn_runners(int n)
 	errno_t rc;
 
 	for (int i = 0; i < n; i++) {
+		_runner_t *runner = _runner_create();
+		if (!runner)
+			return i;
+
 		thread_id_t tid;
-		rc = thread_create(_runner_fn, NULL, "fibril runner", &tid);
-		if (rc != EOK)
+		rc = thread_create(_runner_fn, runner, "fibril runner", &tid);
+		if (rc != EOK) {
+			_runner_destroy(runner);
 			return i;
+		}
 		thread_detach(tid);
 	}
 
@@ -869,6 +1123,12 @@ void __fibrils_init(void)
 		abort();
 	if (futex_initialize(&ipc_lists_futex, 1) != EOK)
 		abort();
+	if (futex_initialize(&runners_futex, 1) != EOK)
+		abort();
+
+	if (_runner_initialize(&main_runner) != EOK)
+		abort();
+	list_append(&main_runner.link, &runner_list);
 
 	/*
 	 * We allow a fixed, small amount of parallelism for IPC reads, but
@@ -889,6 +1149,8 @@ void __fibrils_fini(void)
 {
 	futex_destroy(&fibril_futex);
 	futex_destroy(&ipc_lists_futex);
+	futex_destroy(&runners_futex);
+	futex_destroy(&main_runner.lock);
 }
 
 void fibril_usleep(usec_t timeout)
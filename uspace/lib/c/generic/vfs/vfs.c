@@ -906,6 +906,55 @@ errno_t vfs_read_short(int file, aoff64_t pos, void *buf, size_t nbyte,
 	return EOK;
 }
 
+/** Read a batch of directory entries
+ *
+ * Fill @a buf with as many vfs_dirent_t records as fit, starting at the
+ * directory position @a pos. The records are laid out back to back, each
+ * one @c reclen bytes long. On return @a pos holds the position of the
+ * first entry not returned. Zero bytes read means the end of the directory.
+ *
+ * @param file          Directory handle to read from
+ * @param[in,out] pos   Directory position
+ * @param flags         VFS_READDIR_ATTRS to also fill in type and size
+ * @param buf           Buffer to read to
+ * @param size          Size of the buffer
+ * @param[out] nread    Number of bytes of records read (0 or more)
+ *
+ * @return              EOK on success or an error code. ENOTSUP means the
+ *                      file system cannot list directories in batches,
+ *                      EOVERFLOW that @a buf cannot hold even one entry.
+ */
+errno_t vfs_readdir(int file, aoff64_t *pos, unsigned int flags, void *buf,
+    size_t size, size_t *nread)
+{
+	errno_t rc;
+	ipc_call_t answer;
+	aid_t req;
+
+	if (size > DATA_XFER_LIMIT)
+		size = DATA_XFER_LIMIT;
+
+	async_exch_t *exch = vfs_exchange_begin();
+
+	req = async_send_4(exch, VFS_IN_READDIR, file, LOWER32(*pos),
+	    UPPER32(*pos), flags, &answer);
+	rc = async_data_read_start(exch, buf, size);
+
+	vfs_exchange_end(exch);
+
+	if (rc == EOK)
+		async_wait_for(req, &rc);
+	else
+		async_forget(req);
+
+	if (rc != EOK)
+		return rc;
+
+	*nread = ipc_get_arg1(&answer);
+	*pos = MERGE_LOUP32(ipc_get_arg2(&answer), ipc_get_arg3(&answer));
+	return EOK;
+}
+
 /** Rename a file or directory
  *
  * There is no file-handle-based variant to disallow attempts to introduce loops
@@ -36,14 +36,33 @@
 #define _LIBC_BD_H_
 
 #include <async.h>
+#include <fibril_synch.h>
 #include <offset.h>
 
+/** Maximum number of slots in the shared communication area */
+#define BD_COMM_SLOTS_MAX	32
+
 typedef struct {
 	async_sess_t *sess;
+	/** Lock protecting the communication area slot allocation */
+	fibril_mutex_t comm_lock;
+	/** Signalled when a communication area slot is released */
+	fibril_condvar_t comm_cv;
+	/** Area shared with the server or @c NULL if not negotiated */
+	void *comm_area;
+	/** Size of one communication area slot in bytes */
+	size_t comm_slot_size;
+	/** Number of slots in the communication area */
+	size_t comm_slots;
+	/** Bitmap of busy slots */
+	uint32_t comm_busy;
+	/** Next slot to try (the slots are used as a ring) */
+	size_t comm_next;
 } bd_t;
 
 extern errno_t bd_open(async_sess_t *, bd_t **);
 extern void bd_close(bd_t *);
+extern errno_t bd_comm_share(bd_t *, size_t, size_t);
 extern errno_t bd_read_blocks(bd_t *, aoff64_t, size_t, void *, size_t);
 extern errno_t bd_read_toc(bd_t *, uint8_t, void *, size_t);
 extern errno_t bd_write_blocks(bd_t *, aoff64_t, size_t, const void *, size_t);
@@ -53,6 +53,10 @@ typedef struct {
 typedef struct {
 	bd_srvs_t *srvs;
 	async_sess_t *client_sess;
+	/** Communication area shared by the client or @c NULL */
+	void *comm_area;
+	/** Size of the communication area */
+	size_t comm_size;
 	void *carg;
 } bd_srv_t;
 
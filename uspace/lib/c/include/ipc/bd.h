@@ -43,7 +43,10 @@ typedef enum {
 	BD_READ_BLOCKS,
 	BD_SYNC_CACHE,
 	BD_WRITE_BLOCKS,
-	BD_READ_TOC
+	BD_READ_TOC,
+	BD_COMM_SHARE,
+	BD_READ_BLOCKS_COMM,
+	BD_WRITE_BLOCKS_COMM
 } bd_request_t;
 
 #endif
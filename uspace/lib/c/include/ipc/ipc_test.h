@@ -42,7 +42,9 @@ typedef enum {
 	IPC_TEST_GET_RO_AREA_SIZE,
 	IPC_TEST_GET_RW_AREA_SIZE,
 	IPC_TEST_SHARE_IN_RO,
-	IPC_TEST_SHARE_IN_RW
+	IPC_TEST_SHARE_IN_RW,
+	IPC_TEST_DATA_WRITE,
+	IPC_TEST_DATA_READ
 } ipc_test_request_t;
 
 #endif
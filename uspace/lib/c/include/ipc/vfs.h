@@ -61,6 +61,14 @@ typedef struct {
 	unsigned int instance;
 	bool concurrent_read_write;
 	bool write_retains_size;
+	/** File contents change only through VFS and may be cached by it. */
+	bool page_cache;
+	/**
+	 * Directory entries change only through VFS and may be cached by it.
+	 * Names must match exactly, case-insensitive file systems cannot use
+	 * the cache.
+	 */
+	bool name_cache;
 } vfs_info_t;
 
 /** Data returned by filesystem probe regarding a specific volume. */
@@ -77,6 +85,7 @@ typedef enum {
 	VFS_IN_OPEN,
 	VFS_IN_PUT,
 	VFS_IN_READ,
+	VFS_IN_READDIR,
 	VFS_IN_REGISTER,
 	VFS_IN_RENAME,
 	VFS_IN_RESIZE,
@@ -100,6 +109,7 @@ typedef enum {
 	VFS_OUT_MOUNTED,
 	VFS_OUT_OPEN_NODE,
 	VFS_OUT_READ,
+	VFS_OUT_READDIR,
 	VFS_OUT_STAT,
 	VFS_OUT_STATFS,
 	VFS_OUT_SYNC,
@@ -183,6 +193,39 @@ enum {
 	VFS_MOUNT_NO_REF = 4,
 };
 
+enum {
+	/** Fill in the type and size of each returned directory entry. */
+	VFS_READDIR_ATTRS = 1,
+};
+
+typedef enum {
+	VFS_DIRENT_UNKNOWN = 0,
+	VFS_DIRENT_FILE,
+	VFS_DIRENT_DIRECTORY,
+} vfs_dirent_type_t;
+
+/** Directory entry record as returned by VFS_IN_READDIR.
+ *
+ * Records are packed one after another in the reply buffer, each starting
+ * at a multiple of VFS_DIRENT_ALIGN. The type and size are only valid if
+ * VFS_READDIR_ATTRS was requested; they describe the node in the file
+ * system holding the directory, i.e. a mount point is not crossed.
+ */
+typedef struct {
+	/** Size of the node. */
+	uint64_t size;
+	/** Index of the node within its file system. */
+	fs_index_t index;
+	/** Size of the whole record including the name and padding. */
+	uint16_t reclen;
+	/** One of vfs_dirent_type_t. */
+	uint8_t type;
+	/** Zero-terminated entry name. */
+	char name[];
+} vfs_dirent_t;
+
+#define VFS_DIRENT_ALIGN  8
+
 enum {
 	MODE_READ = 1,
 	MODE_WRITE = 2,
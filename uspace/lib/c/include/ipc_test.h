@@ -49,6 +49,8 @@ extern errno_t ipc_test_get_ro_area_size(ipc_test_t *, size_t *);
 extern errno_t ipc_test_get_rw_area_size(ipc_test_t *, size_t *);
 extern errno_t ipc_test_share_in_ro(ipc_test_t *, size_t, const void **);
 extern errno_t ipc_test_share_in_rw(ipc_test_t *, size_t, void **);
+extern errno_t ipc_test_data_write(ipc_test_t *, const void *, size_t);
+extern errno_t ipc_test_data_read(ipc_test_t *, void *, size_t);
 
 #endif
 
@@ -102,6 +102,8 @@ extern errno_t vfs_pass_handle(async_exch_t *, int, async_exch_t *);
 extern errno_t vfs_put(int);
 extern errno_t vfs_read(int, aoff64_t *, void *, size_t, size_t *);
 extern errno_t vfs_read_short(int, aoff64_t, void *, size_t, ssize_t *);
+extern errno_t vfs_readdir(int, aoff64_t *, unsigned int, void *, size_t,
+    size_t *);
 extern errno_t vfs_receive_handle(bool, int *);
 extern errno_t vfs_rename_path(const char *, const char *);
 extern errno_t vfs_resize(int, aoff64_t);
@@ -76,6 +76,7 @@ static errno_t ext4_destroy_node(fs_node_t *);
 static errno_t ext4_link(fs_node_t *, fs_node_t *, const char *);
 static errno_t ext4_unlink(fs_node_t *, fs_node_t *, const char *);
 static errno_t ext4_has_children(bool *, fs_node_t *);
+static errno_t ext4_readdir(fs_node_t *, aoff64_t, libfs_dirent_fn_t, void *);
 static fs_index_t ext4_index_get(fs_node_t *);
 static aoff64_t ext4_size_get(fs_node_t *);
 static unsigned ext4_lnkcnt_get(fs_node_t *);
@@ -727,6 +728,53 @@ errno_t ext4_has_children(bool *has_children, fs_node_t *fn)
 	return EOK;
 }
 
+/** Iterate over directory entries.
+ *
+ * @param fn  Directory node
+ * @param pos Byte offset of the first entry to visit
+ * @param cb  Callback to invoke for each entry
+ * @param arg Argument for the callback
+ *
+ * @return Error code
+ *
+ */
+errno_t ext4_readdir(fs_node_t *fn, aoff64_t pos, libfs_dirent_fn_t cb,
+    void *arg)
+{
+	ext4_node_t *enode = EXT4_NODE(fn);
+	ext4_superblock_t *sb = enode->instance->filesystem->superblock;
+	char name[EXT4_DIRECTORY_FILENAME_LEN + 1];
+
+	ext4_directory_iterator_t it;
+	errno_t rc = ext4_directory_iterator_init(&it, enode->inode_ref, pos);
+	if (rc != EOK)
+		return rc;
+
+	while (it.current != NULL) {
+		uint32_t inode = it.current->inode;
+		uint16_t name_size =
+		    ext4_directory_entry_ll_get_name_length(sb, it.current);
+		bool skip = (inode == 0) ||
+		    ext4_is_dots(it.current->name, name_size);
+
+		if (!skip) {
+			/* The on-disk name is not zero-terminated */
+			memcpy(name, &it.current->name, name_size);
+			name[name_size] = 0;
+		}
+
+		rc = ext4_directory_iterator_next(&it);
+		if (rc != EOK)
+			break;
+
+		if (!skip && !cb(arg, name, inode, it.current_offset))
+			break;
+	}
+
+	errno_t rc2 = ext4_directory_iterator_fini(&it);
+	return rc != EOK ? rc : rc2;
+}
+
 /** Unpack index number from node.
  *
  * @param fn Node to load index from
@@ -881,6 +929,7 @@ libfs_ops_t ext4_libfs_ops = {
 	.link = ext4_link,
 	.unlink = ext4_unlink,
 	.has_children = ext4_has_children,
+	.readdir = ext4_readdir,
 	.index_get = ext4_index_get,
 	.size_get = ext4_size_get,
 	.lnkcnt_get = ext4_lnkcnt_get,
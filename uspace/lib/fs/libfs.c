@@ -35,6 +35,7 @@
  */
 
 #include "libfs.h"
+#include <align.h>
 #include <macros.h>
 #include <errno.h>
 #include <async.h>
@@ -73,6 +74,7 @@ static char fs_name[FS_NAME_MAXLEN + 1];
 static void libfs_link(libfs_ops_t *, fs_handle_t, ipc_call_t *);
 static void libfs_lookup(libfs_ops_t *, fs_handle_t, ipc_call_t *);
 static void libfs_stat(libfs_ops_t *, fs_handle_t, ipc_call_t *);
+static void libfs_readdir(libfs_ops_t *, fs_handle_t, ipc_call_t *);
 static void libfs_open_node(libfs_ops_t *, fs_handle_t, ipc_call_t *);
 static void libfs_statfs(libfs_ops_t *, fs_handle_t, ipc_call_t *);
 
@@ -166,6 +168,11 @@ static void vfs_out_read(ipc_call_t *req)
 		async_answer_0(req, rc);
 }
 
+static void vfs_out_readdir(ipc_call_t *req)
+{
+	libfs_readdir(libfs_ops, reg.fs_handle, req);
+}
+
 static void vfs_out_write(ipc_call_t *req)
 {
 	service_id_t service_id = (service_id_t) ipc_get_arg1(req);
@@ -313,6 +320,9 @@ static void vfs_connection(ipc_call_t *icall, void *arg)
 		case VFS_OUT_READ:
 			vfs_out_read(&call);
 			break;
+		case VFS_OUT_READDIR:
+			vfs_out_readdir(&call);
+			break;
 		case VFS_OUT_WRITE:
 			vfs_out_write(&call);
 			break;
@@ -750,6 +760,151 @@ void libfs_stat(libfs_ops_t *ops, fs_handle_t fs_handle, ipc_call_t *req)
 	async_answer_0(req, EOK);
 }
 
+typedef struct {
+	libfs_ops_t *ops;
+	service_id_t service_id;
+	bool attrs;
+	uint8_t *buf;
+	size_t size;
+	size_t used;
+	aoff64_t pos;
+	bool full;
+	errno_t rc;
+} readdir_ctx_t;
+
+/** Append one directory entry to the reply buffer. */
+static bool readdir_entry(void *arg, const char *name, fs_index_t index,
+    aoff64_t next)
+{
+	readdir_ctx_t *ctx = (readdir_ctx_t *) arg;
+	size_t nsize = str_size(name) + 1;
+	size_t reclen = ALIGN_UP(sizeof(vfs_dirent_t) + nsize,
+	    VFS_DIRENT_ALIGN);
+
+	if (ctx->used + reclen > ctx->size) {
+		ctx->full = true;
+		return false;
+	}
+
+	vfs_dirent_t *de = (vfs_dirent_t *) (ctx->buf + ctx->used);
+	memset(de, 0, sizeof(vfs_dirent_t));
+	de->index = index;
+	de->reclen = reclen;
+	de->type = VFS_DIRENT_UNKNOWN;
+
+	if (ctx->attrs) {
+		fs_node_t *fn;
+		errno_t rc = ctx->ops->node_get(&fn, ctx->service_id, index);
+		if (rc != EOK) {
+			ctx->rc = rc;
+			return false;
+		}
+
+		if (fn != NULL) {
+			de->type = ctx->ops->is_directory(fn) ?
+			    VFS_DIRENT_DIRECTORY : VFS_DIRENT_FILE;
+			de->size = ctx->ops->size_get(fn);
+			(void) ctx->ops->node_put(fn);
+		}
+	}
+
+	memcpy(de->name, name, nsize);
+	ctx->used += reclen;
+	ctx->pos = next;
+	return true;
+}
+
+/** Read a batch of directory entries.
+ *
+ * The entries are packed as vfs_dirent_t records into a buffer of the size
+ * requested by VFS. If an error occurs after some entries have already been
+ * gathered, these are returned and the error is left for the next call.
+ *
+ * @param ops       libfs operations structure with function pointers to
+ *                  file system implementation
+ * @param fs_handle File system handle of the file system where to perform
+ *                  the operation.
+ * @param req       VFS_OUT_READDIR request data itself.
+ *
+ */
+void libfs_readdir(libfs_ops_t *ops, fs_handle_t fs_handle, ipc_call_t *req)
+{
+	service_id_t service_id = (service_id_t) ipc_get_arg1(req);
+	fs_index_t index = (fs_index_t) ipc_get_arg2(req);
+	aoff64_t pos = (aoff64_t) MERGE_LOUP32(ipc_get_arg3(req),
+	    ipc_get_arg4(req));
+	unsigned int flags = (unsigned int) ipc_get_arg5(req);
+
+	ipc_call_t call;
+	size_t size;
+	if (!async_data_read_receive(&call, &size)) {
+		async_answer_0(&call, EINVAL);
+		async_answer_0(req, EINVAL);
+		return;
+	}
+
+	if (ops->readdir == NULL) {
+		async_answer_0(&call, ENOTSUP);
+		async_answer_0(req, ENOTSUP);
+		return;
+	}
+
+	fs_node_t *fn;
+	errno_t rc = ops->node_get(&fn, service_id, index);
+	if (rc == EOK && fn == NULL)
+		rc = ENOENT;
+	if (rc == EOK && !ops->is_directory(fn)) {
+		(void) ops->node_put(fn);
+		rc = ENOTDIR;
+	}
+	if (rc != EOK) {
+		async_answer_0(&call, rc);
+		async_answer_0(req, rc);
+		return;
+	}
+
+	readdir_ctx_t ctx = {
+		.ops = ops,
+		.service_id = service_id,
+		.attrs = (flags & VFS_READDIR_ATTRS) != 0,
+		.buf = malloc(size),
+		.size = size,
+		.used = 0,
+		.pos = pos,
+		.full = false,
+		.rc = EOK
+	};
+
+	if (ctx.buf == NULL) {
+		(void) ops->node_put(fn);
+		async_answer_0(&call, ENOMEM);
+		async_answer_0(req, ENOMEM);
+		return;
+	}
+
+	rc = ops->readdir(fn, pos, readdir_entry, &ctx);
+	(void) ops->node_put(fn);
+
+	if (ctx.used == 0) {
+		rc = combine_rc(rc, ctx.rc);
+		if (rc == EOK && ctx.full)
+			rc = EOVERFLOW;
+	} else {
+		rc = EOK;
+	}
+
+	if (rc != EOK) {
+		free(ctx.buf);
+		async_answer_0(&call, rc);
+		async_answer_0(req, rc);
+		return;
+	}
+
+	(void) async_data_read_finalize(&call, ctx.buf, ctx.used);
+	free(ctx.buf);
+	async_answer_3(req, EOK, ctx.used, LOWER32(ctx.pos), UPPER32(ctx.pos));
+}
+
 void libfs_statfs(libfs_ops_t *ops, fs_handle_t fs_handle, ipc_call_t *req)
 {
 	service_id_t service_id = (service_id_t) ipc_get_arg1(req);
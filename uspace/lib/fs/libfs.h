@@ -58,6 +58,13 @@ typedef struct {
 	void *data;         /**< Data of the file system implementation. */
 } fs_node_t;
 
+/** Directory entry callback for libfs_ops_t.readdir.
+ *
+ * Called with the entry name, the index of its node and the directory
+ * position following the entry. Returning false stops the iteration.
+ */
+typedef bool (*libfs_dirent_fn_t)(void *, const char *, fs_index_t, aoff64_t);
+
 typedef struct {
 	/*
 	 * The first set of methods are functions that return an integer error
@@ -74,6 +81,7 @@ typedef struct {
 	errno_t (*link)(fs_node_t *, fs_node_t *, const char *);
 	errno_t (*unlink)(fs_node_t *, fs_node_t *, const char *);
 	errno_t (*has_children)(bool *, fs_node_t *);
+	errno_t (*readdir)(fs_node_t *, aoff64_t, libfs_dirent_fn_t, void *);
 	/*
 	 * The second set of methods are usually mere getters that do not
 	 * return an integer error code.
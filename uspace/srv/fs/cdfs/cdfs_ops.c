@@ -770,6 +770,29 @@ static errno_t cdfs_has_children(bool *has_children, fs_node_t *fn)
 	return EOK;
 }
 
+static errno_t cdfs_list_dir(fs_node_t *fn, aoff64_t pos,
+    libfs_dirent_fn_t cb, void *arg)
+{
+	cdfs_node_t *node = CDFS_NODE(fn);
+
+	if (!node->processed) {
+		errno_t rc = cdfs_readdir(node->fs, fn);
+		if (rc != EOK)
+			return rc;
+	}
+
+	link_t *link = list_nth(&node->cs_list, pos);
+	while (link != NULL) {
+		cdfs_dentry_t *dentry =
+		    list_get_instance(link, cdfs_dentry_t, link);
+		if (!cb(arg, dentry->name, dentry->index, ++pos))
+			break;
+		link = list_next(link, &node->cs_list);
+	}
+
+	return EOK;
+}
+
 static fs_index_t cdfs_index_get(fs_node_t *fn)
 {
 	cdfs_node_t *node = CDFS_NODE(fn);
@@ -837,6 +860,7 @@ libfs_ops_t cdfs_libfs_ops = {
 	.link = cdfs_link_node,
 	.unlink = cdfs_unlink_node,
 	.has_children = cdfs_has_children,
+	.readdir = cdfs_list_dir,
 	.index_get = cdfs_index_get,
 	.size_get = cdfs_size_get,
 	.lnkcnt_get = cdfs_lnkcnt_get,
@@ -45,195 +45,584 @@
 #include <assert.h>
 #include <fibril_synch.h>
 #include <mem.h>
+#include <macros.h>
+#include <stdlib.h>
+#include <adt/list.h>
 
-errno_t exfat_bitmap_is_free(exfat_bs_t *bs, service_id_t service_id,
-    exfat_cluster_t clst)
+/** Number of clusters tracked by one word of the in-memory bitmap. */
+#define BMAP_WORD_BITS	64
+
+/** Number of bitmap words summarized by one entry of the free index. */
+#define BMAP_GROUP_WORDS	64
+
+/**
+ * In-memory copy of the Allocation Bitmap of one file system instance.
+ *
+ * The bitmap is loaded on first use and kept in sync with the on-disk
+ * bitmap by every update. Bit set means the cluster is in use, bit @c i
+ * describes cluster <tt>EXFAT_CLST_FIRST + i</tt>. Padding bits past the
+ * last cluster are marked as used so that they are never allocated.
+ */
+typedef struct {
+	link_t link;
+	service_id_t service_id;
+
+	/** Number of clusters described by the bitmap. */
+	exfat_cluster_t clusters;
+	/** Number of clusters that are currently free. */
+	exfat_cluster_t free;
+
+	/** Bitmap words. */
+	uint64_t *words;
+	size_t nwords;
+
+	/** Number of free clusters in each group of BMAP_GROUP_WORDS words. */
+	uint32_t *group_free;
+	size_t ngroups;
+
+	/** Word where the next allocation search starts. */
+	size_t hint;
+} bmap_t;
+
+/** Mutex protecting the list of bitmaps and their contents. */
+static FIBRIL_MUTEX_INITIALIZE(bmap_lock);
+
+/** List of loaded bitmaps. */
+static LIST_INITIALIZE(bmap_list);
+
+static void bmap_destroy(bmap_t *bm)
+{
+	free(bm->words);
+	free(bm->group_free);
+	free(bm);
+}
+
+/** Read the on-disk Allocation Bitmap into a new in-memory bitmap. */
+static errno_t bmap_load(exfat_bs_t *bs, service_id_t service_id,
+    bmap_t **rbm)
 {
 	fs_node_t *fn;
-	block_t *b = NULL;
 	exfat_node_t *bitmapp;
-	uint8_t *bitmap;
+	block_t *b;
+	bmap_t *bm;
+	size_t bytes, i;
 	errno_t rc;
-	bool alloc;
 
-	clst -= EXFAT_CLST_FIRST;
+	bm = calloc(1, sizeof(bmap_t));
+	if (bm == NULL)
+		return ENOMEM;
+
+	link_initialize(&bm->link);
+	bm->service_id = service_id;
+	bm->clusters = DATA_CNT(bs);
+	bm->nwords = ROUND_UP(bm->clusters, BMAP_WORD_BITS) / BMAP_WORD_BITS;
+	bm->ngroups = ROUND_UP(bm->nwords, BMAP_GROUP_WORDS) / BMAP_GROUP_WORDS;
+	bm->words = calloc(bm->nwords, sizeof(uint64_t));
+	bm->group_free = calloc(bm->ngroups, sizeof(uint32_t));
+	if (bm->words == NULL || bm->group_free == NULL) {
+		bmap_destroy(bm);
+		return ENOMEM;
+	}
 
 	rc = exfat_bitmap_get(&fn, service_id);
-	if (rc != EOK)
+	if (rc != EOK) {
+		bmap_destroy(bm);
 		return rc;
+	}
 	bitmapp = EXFAT_NODE(fn);
 
-	aoff64_t offset = clst / 8;
-	rc = exfat_block_get(&b, bs, bitmapp, offset / BPS(bs), BLOCK_FLAGS_NONE);
-	if (rc != EOK) {
-		(void) exfat_node_put(fn);
-		return rc;
+	bytes = ROUND_UP(bm->clusters, 8) / 8;
+	for (i = 0; i * BPS(bs) < bytes; i++) {
+		rc = exfat_block_get(&b, bs, bitmapp, i, BLOCK_FLAGS_NONE);
+		if (rc != EOK) {
+			(void) exfat_node_put(fn);
+			bmap_destroy(bm);
+			return rc;
+		}
+		memcpy((uint8_t *) bm->words + i * BPS(bs), b->data,
+		    min(BPS(bs), bytes - i * BPS(bs)));
+		rc = block_put(b);
+		if (rc != EOK) {
+			(void) exfat_node_put(fn);
+			bmap_destroy(bm);
+			return rc;
+		}
 	}
-	bitmap = (uint8_t *)b->data;
-	alloc = bitmap[offset % BPS(bs)] & (1 << (clst % 8));
 
-	rc = block_put(b);
+	rc = exfat_node_put(fn);
 	if (rc != EOK) {
-		(void) exfat_node_put(fn);
+		bmap_destroy(bm);
 		return rc;
 	}
-	rc = exfat_node_put(fn);
-	if (rc != EOK)
-		return rc;
 
-	if (alloc)
-		return ENOENT;
+	for (i = 0; i < bm->nwords; i++)
+		bm->words[i] = uint64_t_le2host(bm->words[i]);
+
+	if (bm->clusters % BMAP_WORD_BITS != 0) {
+		bm->words[bm->nwords - 1] |=
+		    UINT64_MAX << (bm->clusters % BMAP_WORD_BITS);
+	}
 
+	for (i = 0; i < bm->nwords; i++) {
+		unsigned nfree = BMAP_WORD_BITS - __builtin_popcountll(bm->words[i]);
+		bm->group_free[i / BMAP_GROUP_WORDS] += nfree;
+		bm->free += nfree;
+	}
+
+	*rbm = bm;
 	return EOK;
 }
 
-errno_t exfat_bitmap_set_cluster(exfat_bs_t *bs, service_id_t service_id,
-    exfat_cluster_t clst)
+/** Find the in-memory bitmap of a file system, loading it if needed.
+ *
+ * Must be called with bmap_lock held.
+ */
+static errno_t bmap_get(exfat_bs_t *bs, service_id_t service_id,
+    bmap_t **rbm)
 {
-	fs_node_t *fn;
-	block_t *b = NULL;
-	exfat_node_t *bitmapp;
-	uint8_t *bitmap;
+	bmap_t *bm;
 	errno_t rc;
 
-	clst -= EXFAT_CLST_FIRST;
+	list_foreach(bmap_list, link, bmap_t, cur) {
+		if (cur->service_id == service_id) {
+			*rbm = cur;
+			return EOK;
+		}
+	}
 
-	rc = exfat_bitmap_get(&fn, service_id);
+	rc = bmap_load(bs, service_id, &bm);
 	if (rc != EOK)
 		return rc;
-	bitmapp = EXFAT_NODE(fn);
 
-	aoff64_t offset = clst / 8;
-	rc = exfat_block_get(&b, bs, bitmapp, offset / BPS(bs), BLOCK_FLAGS_NONE);
-	if (rc != EOK) {
-		(void) exfat_node_put(fn);
-		return rc;
+	list_append(&bm->link, &bmap_list);
+	*rbm = bm;
+	return EOK;
+}
+
+/** Mark a range of bitmap bits as used or free in memory. */
+static void bmap_mark(bmap_t *bm, size_t first, size_t count, bool alloc)
+{
+	while (count > 0) {
+		size_t w = first / BMAP_WORD_BITS;
+		unsigned bit = first % BMAP_WORD_BITS;
+		unsigned n = min(count, (size_t) (BMAP_WORD_BITS - bit));
+		uint64_t mask = (n == BMAP_WORD_BITS) ? UINT64_MAX :
+		    ((UINT64_C(1) << n) - 1) << bit;
+		unsigned changed;
+
+		if (alloc) {
+			changed = __builtin_popcountll(~bm->words[w] & mask);
+			bm->words[w] |= mask;
+			bm->group_free[w / BMAP_GROUP_WORDS] -= changed;
+			bm->free -= changed;
+		} else {
+			changed = __builtin_popcountll(bm->words[w] & mask);
+			bm->words[w] &= ~mask;
+			bm->group_free[w / BMAP_GROUP_WORDS] += changed;
+			bm->free += changed;
+		}
+
+		first += n;
+		count -= n;
 	}
-	bitmap = (uint8_t *)b->data;
-	bitmap[offset % BPS(bs)] |= (1 << (clst % 8));
+}
 
-	b->dirty = true;
-	rc = block_put(b);
-	if (rc != EOK) {
-		(void) exfat_node_put(fn);
-		return rc;
+/** Check whether all bits in a range are free. */
+static bool bmap_range_free(bmap_t *bm, size_t first, size_t count)
+{
+	if (first >= bm->clusters || count > bm->clusters - first)
+		return false;
+
+	while (count > 0) {
+		size_t w = first / BMAP_WORD_BITS;
+		unsigned bit = first % BMAP_WORD_BITS;
+		unsigned n = min(count, (size_t) (BMAP_WORD_BITS - bit));
+		uint64_t mask = (n == BMAP_WORD_BITS) ? UINT64_MAX :
+		    ((UINT64_C(1) << n) - 1) << bit;
+
+		if (bm->words[w] & mask)
+			return false;
+
+		first += n;
+		count -= n;
 	}
 
-	return exfat_node_put(fn);
+	return true;
 }
 
-errno_t exfat_bitmap_clear_cluster(exfat_bs_t *bs, service_id_t service_id,
-    exfat_cluster_t clst)
+/** Find a run of free bits within words [start, end).
+ *
+ * Groups without any free cluster are skipped using the free index, fully
+ * used and fully free words are handled as a whole and mixed words are
+ * walked run by run.
+ *
+ * @return		True if a run was found, its first bit is stored in
+ *			@a rfirst.
+ */
+static bool bmap_find_run(bmap_t *bm, size_t start, size_t end, size_t count,
+    size_t *rfirst)
+{
+	size_t run = 0;
+	size_t runstart = 0;
+	size_t w = start;
+
+	while (w < end) {
+		if (w % BMAP_GROUP_WORDS == 0 &&
+		    bm->group_free[w / BMAP_GROUP_WORDS] == 0) {
+			run = 0;
+			w += BMAP_GROUP_WORDS;
+			continue;
+		}
+
+		uint64_t used = bm->words[w];
+		if (used == UINT64_MAX) {
+			run = 0;
+		} else if (used == 0) {
+			if (run == 0)
+				runstart = w * BMAP_WORD_BITS;
+			run += BMAP_WORD_BITS;
+		} else {
+			unsigned bit = 0;
+
+			while (bit < BMAP_WORD_BITS) {
+				uint64_t rest = used >> bit;
+				unsigned n;
+
+				if (rest & 1) {
+					/* Skip a run of used clusters. */
+					run = 0;
+					bit += __builtin_ctzll(~rest);
+					continue;
+				}
+
+				n = (rest != 0) ? (unsigned) __builtin_ctzll(rest) :
+				    BMAP_WORD_BITS - bit;
+				if (run == 0)
+					runstart = w * BMAP_WORD_BITS + bit;
+				run += n;
+				if (run >= count)
+					break;
+				bit += n;
+			}
+		}
+
+		if (run >= count) {
+			*rfirst = runstart;
+			return true;
+		}
+		w++;
+	}
+
+	return false;
+}
+
+/** Update a range of the Allocation Bitmap both on disk and in memory.
+ *
+ * The on-disk bitmap is updated one block at a time and the in-memory copy
+ * follows each block that was written successfully.
+ *
+ * Must be called with bmap_lock held.
+ *
+ * @param rdone		Output argument holding the number of clusters that
+ *			were updated before an error occured.
+ */
+static errno_t bmap_update(exfat_bs_t *bs, service_id_t service_id,
+    bmap_t *bm, exfat_cluster_t firstc, exfat_cluster_t count, bool alloc,
+    exfat_cluster_t *rdone)
 {
 	fs_node_t *fn;
-	block_t *b = NULL;
 	exfat_node_t *bitmapp;
-	uint8_t *bitmap;
+	block_t *b;
+	size_t first = firstc - EXFAT_CLST_FIRST;
+	size_t bpb = BPS(bs) * 8;
 	errno_t rc;
 
-	clst -= EXFAT_CLST_FIRST;
+	*rdone = 0;
+	if (firstc < EXFAT_CLST_FIRST || first >= bm->clusters ||
+	    count > bm->clusters - first)
+		return EINVAL;
 
 	rc = exfat_bitmap_get(&fn, service_id);
 	if (rc != EOK)
 		return rc;
 	bitmapp = EXFAT_NODE(fn);
 
-	aoff64_t offset = clst / 8;
-	rc = exfat_block_get(&b, bs, bitmapp, offset / BPS(bs),
-	    BLOCK_FLAGS_NONE);
-	if (rc != EOK) {
-		(void) exfat_node_put(fn);
-		return rc;
+	while (count > 0) {
+		size_t bit = first % bpb;
+		size_t n = min((size_t) count, bpb - bit);
+		size_t end = bit + n;
+		uint8_t *bitmap;
+
+		rc = exfat_block_get(&b, bs, bitmapp, first / bpb,
+		    BLOCK_FLAGS_NONE);
+		if (rc != EOK) {
+			(void) exfat_node_put(fn);
+			return rc;
+		}
+		bitmap = (uint8_t *) b->data;
+
+		while (bit < end) {
+			if (bit % 8 == 0 && end - bit >= 8) {
+				bitmap[bit / 8] = alloc ? 0xff : 0;
+				bit += 8;
+			} else {
+				if (alloc)
+					bitmap[bit / 8] |= (1 << (bit % 8));
+				else
+					bitmap[bit / 8] &= ~(1 << (bit % 8));
+				bit++;
+			}
+		}
+
+		b->dirty = true;
+		rc = block_put(b);
+		if (rc != EOK) {
+			(void) exfat_node_put(fn);
+			return rc;
+		}
+
+		bmap_mark(bm, first, n, alloc);
+		first += n;
+		count -= n;
+		*rdone += n;
 	}
-	bitmap = (uint8_t *)b->data;
-	bitmap[offset % BPS(bs)] &= ~(1 << (clst % 8));
 
-	b->dirty = true;
-	rc = block_put(b);
+	return exfat_node_put(fn);
+}
+
+/** Mark clusters as used, rolling back on failure.
+ *
+ * Must be called with bmap_lock held.
+ */
+static errno_t bmap_set(exfat_bs_t *bs, service_id_t service_id, bmap_t *bm,
+    exfat_cluster_t firstc, exfat_cluster_t count)
+{
+	exfat_cluster_t done, undone;
+	errno_t rc;
+
+	rc = bmap_update(bs, service_id, bm, firstc, count, true, &done);
+	if (rc != EOK && done > 0) {
+		(void) bmap_update(bs, service_id, bm, firstc, done, false,
+		    &undone);
+	}
+
+	return rc;
+}
+
+/** Drop the in-memory bitmap of a file system instance.
+ *
+ * @param service_id	Service ID of the file system.
+ */
+void exfat_bitmap_fini_by_service_id(service_id_t service_id)
+{
+	fibril_mutex_lock(&bmap_lock);
+	list_foreach_safe(bmap_list, cur, next) {
+		bmap_t *bm = list_get_instance(cur, bmap_t, link);
+
+		if (bm->service_id == service_id) {
+			list_remove(&bm->link);
+			bmap_destroy(bm);
+			break;
+		}
+	}
+	fibril_mutex_unlock(&bmap_lock);
+}
+
+/** Get the number of free clusters.
+ *
+ * @param bs		Buffer holding the boot sector of the file system.
+ * @param service_id	Service ID of the file system.
+ * @param count		Output argument holding the number of free clusters.
+ *
+ * @return		EOK on success or an error code.
+ */
+errno_t exfat_bitmap_free_count(exfat_bs_t *bs, service_id_t service_id,
+    uint64_t *count)
+{
+	bmap_t *bm;
+	errno_t rc;
+
+	fibril_mutex_lock(&bmap_lock);
+	rc = bmap_get(bs, service_id, &bm);
+	if (rc == EOK)
+		*count = bm->free;
+	fibril_mutex_unlock(&bmap_lock);
+	return rc;
+}
+
+/** Find the first free cluster at or after a given cluster.
+ *
+ * @param bs		Buffer holding the boot sector of the file system.
+ * @param service_id	Service ID of the file system.
+ * @param clst		Cluster to start the search at. On success, the free
+ *			cluster found is stored here.
+ *
+ * @return		EOK on success, ENOENT if there is no free cluster
+ *			at or after @a clst or another error code.
+ */
+errno_t exfat_bitmap_find_free(exfat_bs_t *bs, service_id_t service_id,
+    exfat_cluster_t *clst)
+{
+	bmap_t *bm;
+	size_t first;
+	errno_t rc;
+
+	fibril_mutex_lock(&bmap_lock);
+	rc = bmap_get(bs, service_id, &bm);
 	if (rc != EOK) {
-		(void) exfat_node_put(fn);
+		fibril_mutex_unlock(&bmap_lock);
 		return rc;
 	}
 
-	return exfat_node_put(fn);
+	rc = ENOENT;
+	first = max(*clst, EXFAT_CLST_FIRST) - EXFAT_CLST_FIRST;
+	while (first < bm->clusters) {
+		size_t w = first / BMAP_WORD_BITS;
+		uint64_t avail;
+
+		if (w % BMAP_GROUP_WORDS == 0 &&
+		    bm->group_free[w / BMAP_GROUP_WORDS] == 0) {
+			first = (w + BMAP_GROUP_WORDS) * BMAP_WORD_BITS;
+			continue;
+		}
+
+		avail = ~bm->words[w] & (UINT64_MAX << (first % BMAP_WORD_BITS));
+		if (avail != 0) {
+			*clst = w * BMAP_WORD_BITS + __builtin_ctzll(avail) +
+			    EXFAT_CLST_FIRST;
+			rc = EOK;
+			break;
+		}
+		first = (w + 1) * BMAP_WORD_BITS;
+	}
+
+	fibril_mutex_unlock(&bmap_lock);
+	return rc;
+}
+
+errno_t exfat_bitmap_is_free(exfat_bs_t *bs, service_id_t service_id,
+    exfat_cluster_t clst)
+{
+	bmap_t *bm;
+	errno_t rc;
+
+	fibril_mutex_lock(&bmap_lock);
+	rc = bmap_get(bs, service_id, &bm);
+	if (rc == EOK && !bmap_range_free(bm, clst - EXFAT_CLST_FIRST, 1))
+		rc = ENOENT;
+	fibril_mutex_unlock(&bmap_lock);
+	return rc;
+}
+
+errno_t exfat_bitmap_set_cluster(exfat_bs_t *bs, service_id_t service_id,
+    exfat_cluster_t clst)
+{
+	return exfat_bitmap_set_clusters(bs, service_id, clst, 1);
+}
+
+errno_t exfat_bitmap_clear_cluster(exfat_bs_t *bs, service_id_t service_id,
+    exfat_cluster_t clst)
+{
+	return exfat_bitmap_clear_clusters(bs, service_id, clst, 1);
 }
 
 errno_t exfat_bitmap_set_clusters(exfat_bs_t *bs, service_id_t service_id,
     exfat_cluster_t firstc, exfat_cluster_t count)
 {
+	bmap_t *bm;
 	errno_t rc;
-	exfat_cluster_t clst;
-	clst = firstc;
 
-	while (clst < firstc + count) {
-		rc = exfat_bitmap_set_cluster(bs, service_id, clst);
-		if (rc != EOK) {
-			if (clst - firstc > 0)
-				(void) exfat_bitmap_clear_clusters(bs, service_id,
-				    firstc, clst - firstc);
-			return rc;
-		}
-		clst++;
-	}
-	return EOK;
+	fibril_mutex_lock(&bmap_lock);
+	rc = bmap_get(bs, service_id, &bm);
+	if (rc == EOK)
+		rc = bmap_set(bs, service_id, bm, firstc, count);
+	fibril_mutex_unlock(&bmap_lock);
+	return rc;
 }
 
 errno_t exfat_bitmap_clear_clusters(exfat_bs_t *bs, service_id_t service_id,
     exfat_cluster_t firstc, exfat_cluster_t count)
 {
+	exfat_cluster_t done;
+	bmap_t *bm;
 	errno_t rc;
-	exfat_cluster_t clst;
-	clst = firstc;
 
-	while (clst < firstc + count) {
-		rc = exfat_bitmap_clear_cluster(bs, service_id, clst);
-		if (rc != EOK)
-			return rc;
-		clst++;
+	fibril_mutex_lock(&bmap_lock);
+	rc = bmap_get(bs, service_id, &bm);
+	if (rc == EOK) {
+		rc = bmap_update(bs, service_id, bm, firstc, count, false,
+		    &done);
 	}
-	return EOK;
+	fibril_mutex_unlock(&bmap_lock);
+	return rc;
 }
 
+/** Allocate a run of contiguous clusters.
+ *
+ * The search starts where the previous allocation ended and wraps around
+ * to the beginning of the volume.
+ */
 errno_t exfat_bitmap_alloc_clusters(exfat_bs_t *bs, service_id_t service_id,
     exfat_cluster_t *firstc, exfat_cluster_t count)
 {
-	exfat_cluster_t startc, endc;
-	startc = EXFAT_CLST_FIRST;
-
-	while (startc < DATA_CNT(bs) + 2) {
-		endc = startc;
-		while (exfat_bitmap_is_free(bs, service_id, endc) == EOK) {
-			if ((endc - startc) + 1 == count) {
-				*firstc = startc;
-				return exfat_bitmap_set_clusters(bs, service_id, startc, count);
-			} else
-				endc++;
-		}
-		startc = endc + 1;
+	bmap_t *bm;
+	size_t first;
+	errno_t rc;
+
+	if (count == 0)
+		return EINVAL;
+
+	fibril_mutex_lock(&bmap_lock);
+	rc = bmap_get(bs, service_id, &bm);
+	if (rc != EOK) {
+		fibril_mutex_unlock(&bmap_lock);
+		return rc;
+	}
+
+	if (bm->free < count ||
+	    (!bmap_find_run(bm, bm->hint, bm->nwords, count, &first) &&
+	    !bmap_find_run(bm, 0, bm->nwords, count, &first))) {
+		fibril_mutex_unlock(&bmap_lock);
+		return ENOSPC;
+	}
+
+	rc = bmap_set(bs, service_id, bm, first + EXFAT_CLST_FIRST, count);
+	if (rc == EOK) {
+		*firstc = first + EXFAT_CLST_FIRST;
+		bm->hint = (first + count) / BMAP_WORD_BITS;
+		if (bm->hint >= bm->nwords)
+			bm->hint = 0;
 	}
-	return ENOSPC;
+
+	fibril_mutex_unlock(&bmap_lock);
+	return rc;
 }
 
 errno_t exfat_bitmap_append_clusters(exfat_bs_t *bs, exfat_node_t *nodep,
     exfat_cluster_t count)
 {
+	service_id_t service_id = nodep->idx->service_id;
+	exfat_cluster_t lastc;
+	bmap_t *bm;
+	errno_t rc;
+
 	if (nodep->firstc == 0) {
-		return exfat_bitmap_alloc_clusters(bs, nodep->idx->service_id,
+		return exfat_bitmap_alloc_clusters(bs, service_id,
 		    &nodep->firstc, count);
-	} else {
-		exfat_cluster_t lastc, clst;
-		lastc = nodep->firstc + ROUND_UP(nodep->size, BPC(bs)) / BPC(bs) - 1;
-
-		clst = lastc + 1;
-		while (exfat_bitmap_is_free(bs, nodep->idx->service_id, clst) == EOK) {
-			if (clst - lastc == count) {
-				return exfat_bitmap_set_clusters(bs, nodep->idx->service_id,
-				    lastc + 1, count);
-			} else
-				clst++;
-		}
-		return ENOSPC;
 	}
+
+	lastc = nodep->firstc + ROUND_UP(nodep->size, BPC(bs)) / BPC(bs) - 1;
+
+	fibril_mutex_lock(&bmap_lock);
+	rc = bmap_get(bs, service_id, &bm);
+	if (rc == EOK) {
+		if (bmap_range_free(bm, lastc + 1 - EXFAT_CLST_FIRST, count))
+			rc = bmap_set(bs, service_id, bm, lastc + 1, count);
+		else
+			rc = ENOSPC;
+	}
+	fibril_mutex_unlock(&bmap_lock);
+	return rc;
 }
 
 errno_t exfat_bitmap_free_clusters(exfat_bs_t *bs, exfat_node_t *nodep,
@@ -59,6 +59,12 @@ extern errno_t exfat_bitmap_set_clusters(struct exfat_bs *, service_id_t,
 extern errno_t exfat_bitmap_clear_clusters(struct exfat_bs *, service_id_t,
     exfat_cluster_t, exfat_cluster_t);
 
+extern errno_t exfat_bitmap_find_free(struct exfat_bs *, service_id_t,
+    exfat_cluster_t *);
+extern errno_t exfat_bitmap_free_count(struct exfat_bs *, service_id_t,
+    uint64_t *);
+extern void exfat_bitmap_fini_by_service_id(service_id_t);
+
 #endif
 
 /**
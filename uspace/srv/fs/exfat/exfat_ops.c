@@ -82,6 +82,8 @@ static errno_t exfat_destroy_node(fs_node_t *);
 static errno_t exfat_link(fs_node_t *, fs_node_t *, const char *);
 static errno_t exfat_unlink(fs_node_t *, fs_node_t *, const char *);
 static errno_t exfat_has_children(bool *, fs_node_t *);
+static errno_t exfat_readdir(fs_node_t *, aoff64_t, libfs_dirent_fn_t,
+    void *);
 static fs_index_t exfat_index_get(fs_node_t *);
 static aoff64_t exfat_size_get(fs_node_t *);
 static unsigned exfat_lnkcnt_get(fs_node_t *);
@@ -881,6 +883,57 @@ exit:
 	return rc;
 }
 
+errno_t exfat_readdir(fs_node_t *fn, aoff64_t pos, libfs_dirent_fn_t cb,
+    void *arg)
+{
+	exfat_node_t *nodep = EXFAT_NODE(fn);
+	char name[EXFAT_FILENAME_LEN + 1];
+	exfat_file_dentry_t df;
+	exfat_stream_dentry_t ds;
+	service_id_t service_id;
+	errno_t rc;
+
+	fibril_mutex_lock(&nodep->idx->lock);
+	service_id = nodep->idx->service_id;
+	fibril_mutex_unlock(&nodep->idx->lock);
+
+	exfat_directory_t di;
+	rc = exfat_directory_open(nodep, &di);
+	if (rc != EOK)
+		return rc;
+	rc = exfat_directory_seek(&di, pos);
+	if (rc != EOK) {
+		(void) exfat_directory_close(&di);
+		return rc;
+	}
+
+	while ((rc = exfat_directory_read_file(&di, name, EXFAT_FILENAME_LEN,
+	    &df, &ds)) == EOK) {
+		aoff64_t o = di.pos % (BPS(di.bs) / sizeof(exfat_dentry_t));
+		exfat_idx_t *idx = exfat_idx_get_by_pos(service_id,
+		    nodep->firstc, di.bnum * DPS(di.bs) + o);
+		if (!idx) {
+			rc = ENOMEM;
+			break;
+		}
+		fs_index_t index = idx->index;
+		fibril_mutex_unlock(&idx->lock);
+
+		if (!cb(arg, name, index, di.pos + 1))
+			break;
+
+		rc = exfat_directory_next(&di);
+		if (rc != EOK)
+			break;
+	}
+
+	if (rc == ENOENT)
+		rc = EOK;
+
+	errno_t rc2 = exfat_directory_close(&di);
+	return rc != EOK ? rc : rc2;
+}
+
 fs_index_t exfat_index_get(fs_node_t *fn)
 {
 	return EXFAT_NODE(fn)->idx->index;
@@ -931,60 +984,14 @@ errno_t exfat_total_block_count(service_id_t service_id, uint64_t *count)
 
 errno_t exfat_free_block_count(service_id_t service_id, uint64_t *count)
 {
-	fs_node_t *node = NULL;
-	exfat_node_t *bmap_node;
 	exfat_bs_t *bs;
-	uint64_t free_block_count = 0;
-	uint64_t block_count;
-	unsigned sector;
 	errno_t rc;
 
-	rc = exfat_total_block_count(service_id, &block_count);
-	if (rc != EOK)
-		goto exit;
-
 	bs = block_bb_get(service_id);
-	rc = exfat_bitmap_get(&node, service_id);
+	rc = exfat_bitmap_free_count(bs, service_id, count);
 	if (rc != EOK)
-		goto exit;
-
-	bmap_node = (exfat_node_t *) node->data;
-
-	unsigned const bmap_sectors = ROUND_UP(bmap_node->size, BPS(bs)) /
-	    BPS(bs);
+		*count = 0;
 
-	for (sector = 0; sector < bmap_sectors; ++sector) {
-
-		block_t *block;
-		uint8_t *bitmap;
-		unsigned bit;
-
-		rc = exfat_block_get(&block, bs, bmap_node, sector,
-		    BLOCK_FLAGS_NONE);
-		if (rc != EOK) {
-			free_block_count = 0;
-			goto exit;
-		}
-
-		bitmap = (uint8_t *) block->data;
-
-		for (bit = 0; bit < BPS(bs) * 8 && block_count > 0;
-		    ++bit, --block_count) {
-			if (!(bitmap[bit / 8] & (1 << (bit % 8))))
-				++free_block_count;
-		}
-
-		block_put(block);
-
-		if (block_count == 0) {
-			/* Reached the end of the bitmap */
-			goto exit;
-		}
-	}
-
-exit:
-	exfat_node_put(node);
-	*count = free_block_count;
 	return rc;
 }
 
@@ -1000,6 +1007,7 @@ libfs_ops_t exfat_libfs_ops = {
 	.link = exfat_link,
 	.unlink = exfat_unlink,
 	.has_children = exfat_has_children,
+	.readdir = exfat_readdir,
 	.index_get = exfat_index_get,
 	.size_get = exfat_size_get,
 	.lnkcnt_get = exfat_lnkcnt_get,
@@ -1223,6 +1231,7 @@ static void exfat_fs_close(service_id_t service_id, fs_node_t *rfn)
 	 * stop using libblock for this instance.
 	 */
 	(void) exfat_node_fini_by_service_id(service_id);
+	exfat_bitmap_fini_by_service_id(service_id);
 	exfat_idx_fini_by_service_id(service_id);
 	(void) block_cache_fini(service_id);
 	block_fini(service_id);
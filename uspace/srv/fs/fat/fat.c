@@ -55,6 +55,8 @@ vfs_info_t fat_vfs_info = {
 	.name = NAME,
 	.concurrent_read_write = false,
 	.write_retains_size = false,
+	.page_cache = true,
+	.name_cache = false,
 	.instance = 0,
 };
 
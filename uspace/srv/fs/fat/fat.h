@@ -221,6 +221,16 @@ typedef struct {
 	struct fat_node	*nodep;
 } fat_idx_t;
 
+/** Run of physically contiguous clusters of a node. */
+typedef struct {
+	/** Logical number of the first cluster within the node. */
+	uint32_t	lclst;
+	/** Physical number of the first cluster. */
+	fat_cluster_t	pclst;
+	/** Number of clusters in the run. */
+	uint32_t	count;
+} fat_extent_t;
+
 /** FAT in-core node. */
 typedef struct fat_node {
 	/** Back pointer to the FS node. */
@@ -243,20 +253,39 @@ typedef struct fat_node {
 	bool			dirty;
 
 	/*
-	 * Cache of the node's last and "current" cluster to avoid some
-	 * unnecessary FAT walks.
+	 * Cache of the node's last cluster to avoid some unnecessary FAT
+	 * walks.
 	 */
-	/* Node's last cluster in FAT. */
 	bool		lastc_cached_valid;
 	fat_cluster_t	lastc_cached_value;
-	/* Node's "current" cluster, i.e. where the last I/O took place. */
-	bool		currc_cached_valid;
-	aoff64_t	currc_cached_bn;
-	fat_cluster_t	currc_cached_value;
+
+	/*
+	 * Cache of the node's cluster chain in the form of a sorted array of
+	 * extents. It is built lazily as the node is accessed and describes
+	 * the first ext_clusters clusters of the node. If ext_eof is true, the
+	 * extents describe the whole cluster chain.
+	 */
+	fat_extent_t	*extents;
+	size_t		ext_count;
+	size_t		ext_alloc;
+	uint32_t	ext_clusters;
+	bool		ext_eof;
 } fat_node_t;
 
 typedef struct {
 	bool lfn_enabled;
+
+	/*
+	 * In-memory map of free clusters in FAT1 (one bit per cluster, set if
+	 * the cluster is free). The map is populated on the first allocation
+	 * and kept up to date by fat_set_cluster().
+	 */
+	fibril_mutex_t	free_lock;
+	uint32_t	*free_map;
+	/* Number of free clusters recorded in free_map. */
+	uint32_t	free_count;
+	/* Cluster where the next allocation will start searching. */
+	fat_cluster_t	next_free;
 } fat_instance_t;
 
 extern vfs_out_ops_t fat_ops;
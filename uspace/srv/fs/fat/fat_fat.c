@@ -46,12 +46,21 @@
 #include <byteorder.h>
 #include <align.h>
 #include <assert.h>
+#include <bitops.h>
 #include <fibril_synch.h>
 #include <mem.h>
 #include <stdlib.h>
 
 #define IS_ODD(number)	(number & 0x1)
 
+/** Initial and maximum number of extents cached per node. */
+#define FAT_EXTENTS_INITIAL	4
+#define FAT_EXTENTS_MAX		4096
+
+#define FREE_MAP_BITS		32
+#define FREE_MAP_WORDS(bs)	((CC(bs) + FAT_CLST_FIRST + FREE_MAP_BITS - 1) / \
+    FREE_MAP_BITS)
+
 /**
  * The fat_alloc_lock mutex protects all copies of the File Allocation Table
  * during allocation of clusters. The lock does not have to be held durring
@@ -112,6 +121,154 @@ fat_cluster_walk(fat_bs_t *bs, service_id_t service_id, fat_cluster_t firstc,
 	return EOK;
 }
 
+/** Drop the extent cache of a node.
+ *
+ * @param nodep		FAT node.
+ */
+void fat_extents_clear(fat_node_t *nodep)
+{
+	free(nodep->extents);
+	nodep->extents = NULL;
+	nodep->ext_count = 0;
+	nodep->ext_alloc = 0;
+	nodep->ext_clusters = 0;
+	nodep->ext_eof = false;
+}
+
+/** Extend the extent cache of a node by one more cluster.
+ *
+ * @param bs		Buffer holding the boot sector of the file system.
+ * @param nodep		FAT node.
+ *
+ * @return		EOK on success or an error code. If the end of the
+ *			cluster chain has been reached, nodep->ext_eof is set.
+ */
+static errno_t fat_extents_extend(fat_bs_t *bs, fat_node_t *nodep)
+{
+	fat_extent_t *ext = NULL;
+	fat_cluster_t clst;
+	errno_t rc;
+
+	if (nodep->ext_count == 0) {
+		clst = nodep->firstc;
+	} else {
+		ext = &nodep->extents[nodep->ext_count - 1];
+		rc = fat_get_cluster(bs, nodep->idx->service_id, FAT1,
+		    ext->pclst + ext->count - 1, &clst);
+		if (rc != EOK)
+			return rc;
+	}
+
+	if (clst == FAT_CLST_RES0 || clst >= FAT_CLST_LAST1(bs)) {
+		nodep->ext_eof = true;
+		return EOK;
+	}
+	assert(clst >= FAT_CLST_FIRST && clst != FAT_CLST_BAD(bs));
+
+	if (nodep->ext_count > 0 && clst == ext->pclst + ext->count) {
+		/* The chain continues physically contiguous. */
+		ext->count++;
+		nodep->ext_clusters++;
+		return EOK;
+	}
+
+	if (nodep->ext_count == nodep->ext_alloc) {
+		size_t nalloc = nodep->ext_alloc ? 2 * nodep->ext_alloc :
+		    FAT_EXTENTS_INITIAL;
+		ext = realloc(nodep->extents, nalloc * sizeof(fat_extent_t));
+		if (ext == NULL)
+			return ENOMEM;
+		nodep->extents = ext;
+		nodep->ext_alloc = nalloc;
+	}
+
+	ext = &nodep->extents[nodep->ext_count++];
+	ext->lclst = nodep->ext_clusters;
+	ext->pclst = clst;
+	ext->count = 1;
+	nodep->ext_clusters++;
+
+	return EOK;
+}
+
+/** Translate logical cluster of a node to a physical cluster.
+ *
+ * The extent cache of the node is extended as necessary and then searched
+ * by bisection.
+ *
+ * @param bs		Buffer holding the boot sector of the file system.
+ * @param nodep		FAT node.
+ * @param lclst		Logical cluster number within the node.
+ * @param pclst		Output argument holding the physical cluster number.
+ * @param run		If non-NULL, output argument holding the number of
+ *			physically contiguous clusters starting with pclst
+ *			known to belong to the node.
+ *
+ * @return		EOK on success, ELIMIT if the node has no such cluster
+ *			or another error code.
+ */
+errno_t fat_extents_lookup(fat_bs_t *bs, fat_node_t *nodep, uint32_t lclst,
+    fat_cluster_t *pclst, uint32_t *run)
+{
+	fat_extent_t *ext;
+	size_t lo, hi, mid;
+	errno_t rc;
+
+	while (lclst >= nodep->ext_clusters && !nodep->ext_eof &&
+	    nodep->ext_count < FAT_EXTENTS_MAX) {
+		rc = fat_extents_extend(bs, nodep);
+		if (rc != EOK)
+			return rc;
+	}
+
+	if (lclst >= nodep->ext_clusters) {
+		fat_cluster_t clst;
+		uint32_t i;
+
+		if (nodep->ext_eof || nodep->ext_count == 0)
+			return ELIMIT;
+
+		/*
+		 * The node is too fragmented to be described by the cache
+		 * completely. Walk the rest of the chain starting from the
+		 * last cached cluster.
+		 */
+		ext = &nodep->extents[nodep->ext_count - 1];
+		clst = ext->pclst + ext->count - 1;
+		for (i = nodep->ext_clusters; i <= lclst; i++) {
+			rc = fat_get_cluster(bs, nodep->idx->service_id, FAT1,
+			    clst, &clst);
+			if (rc != EOK)
+				return rc;
+			if (clst == FAT_CLST_RES0 || clst >= FAT_CLST_LAST1(bs))
+				return ELIMIT;
+		}
+
+		*pclst = clst;
+		if (run)
+			*run = 1;
+		return EOK;
+	}
+
+	lo = 0;
+	hi = nodep->ext_count;
+	while (hi - lo > 1) {
+		mid = lo + (hi - lo) / 2;
+		if (nodep->extents[mid].lclst <= lclst)
+			lo = mid;
+		else
+			hi = mid;
+	}
+
+	ext = &nodep->extents[lo];
+	assert(lclst >= ext->lclst && lclst < ext->lclst + ext->count);
+	*pclst = ext->pclst + (lclst - ext->lclst);
+	if (run)
+		*run = ext->count - (lclst - ext->lclst);
+
+	return EOK;
+}
+
 /** Read block from file located on a FAT file system.
  *
  * @param block		Pointer to a block pointer for storing result.
@@ -126,16 +283,16 @@ errno_t
 fat_block_get(block_t **block, struct fat_bs *bs, fat_node_t *nodep,
     aoff64_t bn, int flags)
 {
-	fat_cluster_t firstc = nodep->firstc;
-	fat_cluster_t currc = 0;
-	aoff64_t relbn = bn;
+	fat_cluster_t clst;
 	errno_t rc;
 
 	if (!nodep->size)
 		return ELIMIT;
 
-	if (!FAT_IS_FAT32(bs) && nodep->firstc == FAT_CLST_ROOT)
-		goto fall_through;
+	if (!FAT_IS_FAT32(bs) && nodep->firstc == FAT_CLST_ROOT) {
+		return _fat_block_get(block, bs, nodep->idx->service_id,
+		    nodep->firstc, NULL, bn, flags);
+	}
 
 	if (((((nodep->size - 1) / BPS(bs)) / SPC(bs)) == bn / SPC(bs)) &&
 	    nodep->lastc_cached_valid) {
@@ -147,29 +304,47 @@ fat_block_get(block_t **block, struct fat_bs *bs, fat_node_t *nodep,
 		    CLBN2PBN(bs, nodep->lastc_cached_value, bn), flags);
 	}
 
-	if (nodep->currc_cached_valid && bn >= nodep->currc_cached_bn) {
-		/*
-		 * We can start with the cluster cached by the previous call to
-		 * fat_block_get().
-		 */
-		firstc = nodep->currc_cached_value;
-		relbn -= (nodep->currc_cached_bn / SPC(bs)) * SPC(bs);
+	rc = fat_extents_lookup(bs, nodep, bn / SPC(bs), &clst, NULL);
+	if (rc != EOK)
+		return rc;
+
+	return block_get(block, nodep->idx->service_id,
+	    CLBN2PBN(bs, clst, bn), flags);
+}
+
+/** Find a run of physically contiguous blocks of a node.
+ *
+ * @param bs		Buffer holding the boot sector of the file system.
+ * @param nodep		FAT node.
+ * @param bn		Logical number of the first block of the run.
+ * @param pbn		Output argument holding the physical number of bn.
+ * @param cnt		Output argument holding the number of physically
+ *			contiguous blocks starting with bn.
+ *
+ * @return		EOK on success or an error code.
+ */
+errno_t
+fat_block_run(struct fat_bs *bs, fat_node_t *nodep, aoff64_t bn,
+    aoff64_t *pbn, aoff64_t *cnt)
+{
+	fat_cluster_t clst;
+	uint32_t run;
+	errno_t rc;
+
+	if (!FAT_IS_FAT32(bs) && nodep->firstc == FAT_CLST_ROOT) {
+		*pbn = RSCNT(bs) + FATCNT(bs) * SF(bs) + bn;
+		*cnt = RDS(bs) - bn;
+		return EOK;
 	}
 
-fall_through:
-	rc = _fat_block_get(block, bs, nodep->idx->service_id, firstc,
-	    &currc, relbn, flags);
+	rc = fat_extents_lookup(bs, nodep, bn / SPC(bs), &clst, &run);
 	if (rc != EOK)
 		return rc;
 
-	/*
-	 * Update the "current" cluster cache.
-	 */
-	nodep->currc_cached_valid = true;
-	nodep->currc_cached_bn = bn;
-	nodep->currc_cached_value = currc;
+	*pbn = CLBN2PBN(bs, clst, bn);
+	*cnt = (aoff64_t) run * SPC(bs) - bn % SPC(bs);
 
-	return rc;
+	return EOK;
 }
 
 /** Read block from file located on a FAT file system.
@@ -597,6 +772,279 @@ fat_set_cluster_fat32(fat_bs_t *bs, service_id_t service_id, unsigned fatno,
 	return rc;
 }
 
+/** Get the mounted FAT instance, if any.
+ *
+ * The file system is not registered as an instance while it is only being
+ * probed, in which case there is no free cluster map to maintain.
+ *
+ * @param service_id	Service ID of the file system.
+ *
+ * @return		FAT instance or NULL.
+ */
+static fat_instance_t *fat_instance_get(service_id_t service_id)
+{
+	void *data;
+
+	if (fs_instance_get(service_id, &data) != EOK)
+		return NULL;
+	return (fat_instance_t *) data;
+}
+
+static inline bool free_map_test(uint32_t *map, fat_cluster_t clst)
+{
+	return (map[clst / FREE_MAP_BITS] >> (clst % FREE_MAP_BITS)) & 1;
+}
+
+/** Record a change of a FAT1 entry in the free cluster map.
+ *
+ * @param instance	FAT instance.
+ * @param clst		Cluster whose entry has changed.
+ * @param value		New value of the entry.
+ */
+static void fat_free_map_update(fat_instance_t *instance, fat_cluster_t clst,
+    fat_cluster_t value)
+{
+	uint32_t *map;
+	uint32_t bit = 1U << (clst % FREE_MAP_BITS);
+
+	fibril_mutex_lock(&instance->free_lock);
+	map = instance->free_map;
+	if (map != NULL) {
+		if (value == FAT_CLST_RES0) {
+			if (!(map[clst / FREE_MAP_BITS] & bit)) {
+				map[clst / FREE_MAP_BITS] |= bit;
+				instance->free_count++;
+			}
+		} else {
+			if (map[clst / FREE_MAP_BITS] & bit) {
+				map[clst / FREE_MAP_BITS] &= ~bit;
+				instance->free_count--;
+			}
+		}
+	}
+	fibril_mutex_unlock(&instance->free_lock);
+}
+
+/** Read the hint of the next free cluster from the FAT32 FS info sector.
+ *
+ * @param bs		Buffer holding the boot sector of the file system.
+ * @param service_id	Service ID of the file system.
+ *
+ * @return		Hinted cluster or FAT_CLST_FIRST if there is no usable
+ *			hint.
+ */
+static fat_cluster_t fat_fsinfo_next_free(fat_bs_t *bs, service_id_t service_id)
+{
+	fat32_fsinfo_t *info;
+	fat_cluster_t clst = FAT_CLST_FIRST;
+	block_t *b;
+
+	if (!FAT_IS_FAT32(bs))
+		return clst;
+
+	if (block_get(&b, service_id, uint16_t_le2host(bs->fat32.fsinfo_sec),
+	    BLOCK_FLAGS_NONE) != EOK)
+		return clst;
+
+	info = (fat32_fsinfo_t *) b->data;
+	if (memcmp(info->sig1, FAT32_FSINFO_SIG1, sizeof(info->sig1)) == 0 &&
+	    memcmp(info->sig2, FAT32_FSINFO_SIG2, sizeof(info->sig2)) == 0) {
+		clst = uint32_t_le2host(info->last_allocated_cluster);
+		if (clst < FAT_CLST_FIRST || clst >= CC(bs) + FAT_CLST_FIRST)
+			clst = FAT_CLST_FIRST;
+	}
+
+	(void) block_put(b);
+	return clst;
+}
+
+/** Populate the free cluster map by scanning FAT1.
+ *
+ * FAT16 and FAT32 tables are scanned sector by sector. FAT12 entries can span
+ * sector boundaries and are therefore read one by one.
+ *
+ * Must be called with fat_alloc_lock held.
+ *
+ * @param bs		Buffer holding the boot sector of the file system.
+ * @param service_id	Service ID of the file system.
+ * @param instance	FAT instance.
+ *
+ * @return		EOK on success or an error code.
+ */
+static errno_t fat_free_map_init(fat_bs_t *bs, service_id_t service_id,
+    fat_instance_t *instance)
+{
+	fat_cluster_t clst, value;
+	fat_cluster_t clsts = CC(bs) + FAT_CLST_FIRST;
+	uint32_t count = 0;
+	uint32_t *map;
+	block_t *b;
+	errno_t rc = EOK;
+
+	assert(fibril_mutex_is_locked(&fat_alloc_lock));
+
+	if (instance->free_map != NULL)
+		return EOK;
+
+	map = calloc(FREE_MAP_WORDS(bs), sizeof(uint32_t));
+	if (map == NULL)
+		return ENOMEM;
+
+	/*
+	 * Hold the map lock during the whole scan so that entries freed
+	 * concurrently after we have read them are recorded once the map
+	 * is published.
+	 */
+	fibril_mutex_lock(&instance->free_lock);
+
+	if (FAT_IS_FAT12(bs)) {
+		for (clst = FAT_CLST_FIRST; clst < clsts; clst++) {
+			rc = fat_get_cluster(bs, service_id, FAT1, clst, &value);
+			if (rc != EOK)
+				break;
+			if (value == FAT_CLST_RES0) {
+				map[clst / FREE_MAP_BITS] |=
+				    1U << (clst % FREE_MAP_BITS);
+				count++;
+			}
+		}
+	} else {
+		size_t esize = FAT_CLST_SIZE(bs);
+		size_t per_sector = BPS(bs) / esize;
+		aoff64_t sec;
+		size_t i;
+
+		clst = 0;
+		for (sec = 0; clst < clsts && sec < SF(bs); sec++) {
+			rc = block_get(&b, service_id, RSCNT(bs) + sec,
+			    BLOCK_FLAGS_NONE);
+			if (rc != EOK)
+				break;
+
+			for (i = 0; i < per_sector && clst < clsts;
+			    i++, clst++) {
+				if (esize == FAT32_CLST_SIZE) {
+					value = uint32_t_le2host(
+					    ((uint32_t *) b->data)[i]) &
+					    FAT32_MASK;
+				} else {
+					value = uint16_t_le2host(
+					    ((uint16_t *) b->data)[i]);
+				}
+				if (clst >= FAT_CLST_FIRST &&
+				    value == FAT_CLST_RES0) {
+					map[clst / FREE_MAP_BITS] |=
+					    1U << (clst % FREE_MAP_BITS);
+					count++;
+				}
+			}
+
+			rc = block_put(b);
+			if (rc != EOK)
+				break;
+		}
+	}
+
+	if (rc != EOK) {
+		fibril_mutex_unlock(&instance->free_lock);
+		free(map);
+		return rc;
+	}
+
+	instance->free_map = map;
+	instance->free_count = count;
+	instance->next_free = fat_fsinfo_next_free(bs, service_id);
+	fibril_mutex_unlock(&instance->free_lock);
+
+	return EOK;
+}
+
+/** Find the first free cluster in the free cluster map.
+ *
+ * @param map		Free cluster map.
+ * @param clst		First cluster to consider.
+ * @param end		Cluster where to stop the search.
+ *
+ * @return		First free cluster in <clst, end) or end if there is
+ *			no such cluster.
+ */
+static fat_cluster_t fat_free_map_find(uint32_t *map, fat_cluster_t clst,
+    fat_cluster_t end)
+{
+	uint32_t word;
+
+	while (clst < end) {
+		word = map[clst / FREE_MAP_BITS] >> (clst % FREE_MAP_BITS);
+		if (word != 0) {
+			clst += fnzb32(word & -word);
+			return min(clst, end);
+		}
+		clst = ALIGN_DOWN(clst, FREE_MAP_BITS) + FREE_MAP_BITS;
+	}
+
+	return end;
+}
+
+/** Measure a run of free clusters in the free cluster map.
+ *
+ * @param map		Free cluster map.
+ * @param clst		First cluster of the run.
+ * @param end		Cluster where to stop.
+ * @param max		Maximum length of the run that is of interest.
+ *
+ * @return		Number of consecutive free clusters starting at clst.
+ */
+static unsigned fat_free_map_run(uint32_t *map, fat_cluster_t clst,
+    fat_cluster_t end, unsigned max)
+{
+	unsigned run = 0;
+
+	while (clst < end && run < max) {
+		if (clst % FREE_MAP_BITS == 0 && end - clst >= FREE_MAP_BITS &&
+		    map[clst / FREE_MAP_BITS] == UINT32_MAX) {
+			/* Skip whole free words. */
+			clst += FREE_MAP_BITS;
+			run += FREE_MAP_BITS;
+			continue;
+		}
+		if (!free_map_test(map, clst))
+			break;
+		clst++;
+		run++;
+	}
+
+	return min(run, max);
+}
+
+/** Find a run of free clusters of the requested length.
+ *
+ * @param map		Free cluster map.
+ * @param start		First cluster to consider.
+ * @param end		Cluster where to stop the search.
+ * @param nclsts	Requested length of the run.
+ *
+ * @return		First cluster of the run or end if there is no
+ *			sufficiently long run in <start, end).
+ */
+static fat_cluster_t fat_free_map_find_run(uint32_t *map, fat_cluster_t start,
+    fat_cluster_t end, unsigned nclsts)
+{
+	fat_cluster_t clst = start;
+	unsigned run;
+
+	while (clst < end) {
+		clst = fat_free_map_find(map, clst, end);
+		if (clst == end)
+			break;
+		run = fat_free_map_run(map, clst, end, nclsts);
+		if (run == nclsts)
+			return clst;
+		clst += run;
+	}
+
+	return end;
+}
+
 /** Set cluster in one instance of FAT.
  *
  * @param bs		Buffer holding the boot sector for the file system.
@@ -622,6 +1070,12 @@ fat_set_cluster(fat_bs_t *bs, service_id_t service_id, unsigned fatno,
 	else
 		rc = fat_set_cluster_fat32(bs, service_id, fatno, clst, value);
 
+	if (rc == EOK && fatno == FAT1) {
+		fat_instance_t *instance = fat_instance_get(service_id);
+		if (instance != NULL)
+			fat_free_map_update(instance, clst, value);
+	}
+
 	return rc;
 }
 
@@ -654,6 +1108,69 @@ errno_t fat_alloc_shadow_clusters(fat_bs_t *bs, service_id_t service_id,
 	return EOK;
 }
 
+/** Pick free clusters for a new cluster chain.
+ *
+ * A contiguous run of clusters starting at or after the next free cluster
+ * hint is preferred. If there is none, the first free clusters following the
+ * hint are taken.
+ *
+ * Must be called with fat_alloc_lock held.
+ *
+ * @param bs		Buffer holding the boot sector of the file system.
+ * @param instance	FAT instance with populated free cluster map.
+ * @param nclsts	Number of clusters to pick.
+ * @param lifo		Array where the picked clusters will be stored in
+ *			descending order of their position in the chain.
+ *
+ * @return		EOK on success or ENOSPC.
+ */
+static errno_t fat_alloc_pick(fat_bs_t *bs, fat_instance_t *instance,
+    unsigned nclsts, fat_cluster_t *lifo)
+{
+	uint32_t *map = instance->free_map;
+	fat_cluster_t end = CC(bs) + FAT_CLST_FIRST;
+	fat_cluster_t hint = instance->next_free;
+	fat_cluster_t clst;
+	unsigned found;
+
+	if (instance->free_count < nclsts)
+		return ENOSPC;
+
+	if (hint < FAT_CLST_FIRST || hint >= end)
+		hint = FAT_CLST_FIRST;
+
+	clst = fat_free_map_find_run(map, hint, end, nclsts);
+	if (clst == end && hint > FAT_CLST_FIRST) {
+		clst = fat_free_map_find_run(map, FAT_CLST_FIRST,
+		    min(hint + nclsts - 1, end), nclsts);
+		if (clst == min(hint + nclsts - 1, end))
+			clst = end;
+	}
+
+	if (clst != end) {
+		for (found = 0; found < nclsts; found++)
+			lifo[nclsts - 1 - found] = clst + found;
+		return EOK;
+	}
+
+	/* No contiguous run is available, gather scattered clusters. */
+	found = 0;
+	clst = hint;
+	while (found < nclsts) {
+		clst = fat_free_map_find(map, clst, end);
+		if (clst == end) {
+			if (hint == FAT_CLST_FIRST)
+				return ENOSPC;
+			end = hint;
+			clst = hint = FAT_CLST_FIRST;
+			continue;
+		}
+		lifo[nclsts - 1 - found++] = clst++;
+	}
+
+	return EOK;
+}
+
 /** Allocate clusters in all copies of FAT.
  *
  * This function will attempt to allocate the requested number of clusters in
@@ -661,6 +1178,9 @@ errno_t fat_alloc_shadow_clusters(fat_bs_t *bs, service_id_t service_id,
  * clusters form an independent chain (i.e. a chain which does not belong to any
  * file yet).
  *
+ * Free clusters are looked up in the in-memory free cluster map of the
+ * instance, which is populated by scanning FAT1 on the first allocation.
+ *
  * @param bs		Buffer holding the boot sector of the file system.
  * @param service_id	Device service ID of the file system.
  * @param nclsts	Number of clusters to allocate.
@@ -675,47 +1195,56 @@ errno_t
 fat_alloc_clusters(fat_bs_t *bs, service_id_t service_id, unsigned nclsts,
     fat_cluster_t *mcl, fat_cluster_t *lcl)
 {
+	fat_instance_t *instance;
 	fat_cluster_t *lifo;    /* stack for storing free cluster numbers */
 	unsigned found = 0;     /* top of the free cluster number stack */
-	fat_cluster_t clst;
-	fat_cluster_t value = 0;
 	fat_cluster_t clst_last1 = FAT_CLST_LAST1(bs);
 	errno_t rc = EOK;
 
+	if (nclsts == 0)
+		return EINVAL;
+
+	instance = fat_instance_get(service_id);
+	if (instance == NULL)
+		return ENOENT;
+
 	lifo = (fat_cluster_t *) malloc(nclsts * sizeof(fat_cluster_t));
 	if (!lifo)
 		return ENOMEM;
 
+	fibril_mutex_lock(&fat_alloc_lock);
+
+	rc = fat_free_map_init(bs, service_id, instance);
+	if (rc != EOK) {
+		free(lifo);
+		fibril_mutex_unlock(&fat_alloc_lock);
+		return rc;
+	}
+
+	rc = fat_alloc_pick(bs, instance, nclsts, lifo);
+	if (rc != EOK) {
+		free(lifo);
+		fibril_mutex_unlock(&fat_alloc_lock);
+		return ENOSPC;
+	}
+
 	/*
-	 * Search FAT1 for unused clusters.
+	 * Link the picked clusters in FAT1. This also marks them as non-free
+	 * in the free cluster map.
 	 */
-	fibril_mutex_lock(&fat_alloc_lock);
-	for (clst = FAT_CLST_FIRST; clst < CC(bs) + 2 && found < nclsts;
-	    clst++) {
-		rc = fat_get_cluster(bs, service_id, FAT1, clst, &value);
+	for (found = 0; found < nclsts; found++) {
+		rc = fat_set_cluster(bs, service_id, FAT1, lifo[found],
+		    (found == 0) ?  clst_last1 : lifo[found - 1]);
 		if (rc != EOK)
 			break;
-
-		if (value == FAT_CLST_RES0) {
-			/*
-			 * The cluster is free. Put it into our stack
-			 * of found clusters and mark it as non-free.
-			 */
-			lifo[found] = clst;
-			rc = fat_set_cluster(bs, service_id, FAT1, clst,
-			    (found == 0) ?  clst_last1 : lifo[found - 1]);
-			if (rc != EOK)
-				break;
-
-			found++;
-		}
 	}
 
-	if (rc == EOK && found == nclsts) {
+	if (rc == EOK) {
 		rc = fat_alloc_shadow_clusters(bs, service_id, lifo, nclsts);
 		if (rc == EOK) {
 			*mcl = lifo[found - 1];
 			*lcl = lifo[0];
+			instance->next_free = lifo[0] + 1;
 			free(lifo);
 			fibril_mutex_unlock(&fat_alloc_lock);
 			return EOK;
@@ -734,6 +1263,37 @@ fat_alloc_clusters(fat_bs_t *bs, service_id_t service_id, unsigned nclsts,
 	return ENOSPC;
 }
 
+/** Count free clusters of the file system.
+ *
+ * @param bs		Buffer holding the boot sector of the file system.
+ * @param service_id	Device service ID of the file system.
+ * @param count		Output parameter where the number of free clusters
+ *			will be returned.
+ *
+ * @return		EOK on success or an error code.
+ */
+errno_t
+fat_count_free_clusters(fat_bs_t *bs, service_id_t service_id, uint32_t *count)
+{
+	fat_instance_t *instance;
+	errno_t rc;
+
+	instance = fat_instance_get(service_id);
+	if (instance == NULL)
+		return ENOENT;
+
+	fibril_mutex_lock(&fat_alloc_lock);
+	rc = fat_free_map_init(bs, service_id, instance);
+	if (rc == EOK) {
+		fibril_mutex_lock(&instance->free_lock);
+		*count = instance->free_count;
+		fibril_mutex_unlock(&instance->free_lock);
+	}
+	fibril_mutex_unlock(&fat_alloc_lock);
+
+	return rc;
+}
+
 /** Free clusters forming a cluster chain in all copies of FAT.
  *
  * @param bs		Buffer hodling the boot sector of the file system.
@@ -788,8 +1348,15 @@ errno_t fat_append_clusters(fat_bs_t *bs, fat_node_t *nodep, fat_cluster_t mcl,
 	uint8_t fatno;
 	errno_t rc;
 
+	/*
+	 * The cached extents remain valid, but they no longer describe the
+	 * whole cluster chain.
+	 */
+	nodep->ext_eof = false;
+
 	if (nodep->firstc == FAT_CLST_RES0) {
 		/* No clusters allocated to the node yet. */
+		fat_extents_clear(nodep);
 		nodep->firstc = mcl;
 		nodep->dirty = true;	/* need to sync node */
 	} else {
@@ -837,8 +1404,7 @@ errno_t fat_chop_clusters(fat_bs_t *bs, fat_node_t *nodep, fat_cluster_t lcl)
 	 * Invalidate cached cluster numbers.
 	 */
 	nodep->lastc_cached_valid = false;
-	if (nodep->currc_cached_value != lcl)
-		nodep->currc_cached_valid = false;
+	fat_extents_clear(nodep);
 
 	if (lcl == FAT_CLST_RES0) {
 		/* The node will have zero size and no clusters allocated. */
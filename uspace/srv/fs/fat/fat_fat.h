@@ -112,6 +112,11 @@ extern errno_t fat_cluster_walk(struct fat_bs *, service_id_t, fat_cluster_t,
 
 extern errno_t fat_block_get(block_t **, struct fat_bs *, struct fat_node *,
     aoff64_t, int);
+extern errno_t fat_block_run(struct fat_bs *, struct fat_node *, aoff64_t,
+    aoff64_t *, aoff64_t *);
+extern errno_t fat_extents_lookup(struct fat_bs *, struct fat_node *, uint32_t,
+    fat_cluster_t *, uint32_t *);
+extern void fat_extents_clear(struct fat_node *);
 extern errno_t _fat_block_get(block_t **, struct fat_bs *, service_id_t,
     fat_cluster_t, fat_cluster_t *, aoff64_t, int);
 
@@ -122,6 +127,8 @@ extern errno_t fat_chop_clusters(struct fat_bs *, struct fat_node *,
 extern errno_t fat_alloc_clusters(struct fat_bs *, service_id_t, unsigned,
     fat_cluster_t *, fat_cluster_t *);
 extern errno_t fat_free_clusters(struct fat_bs *, service_id_t, fat_cluster_t);
+extern errno_t fat_count_free_clusters(struct fat_bs *, service_id_t,
+    uint32_t *);
 extern errno_t fat_alloc_shadow_clusters(struct fat_bs *, service_id_t,
     fat_cluster_t *, unsigned);
 extern errno_t fat_get_cluster(struct fat_bs *, service_id_t, unsigned,
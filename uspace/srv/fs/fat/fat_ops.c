@@ -56,6 +56,7 @@
 #include <fibril_synch.h>
 #include <align.h>
 #include <stdlib.h>
+#include <mem.h>
 
 #define FAT_NODE(node)	((node) ? (fat_node_t *) (node)->data : NULL)
 #define FS_NODE(node)	((node) ? (node)->bp : NULL)
@@ -63,6 +64,9 @@
 #define DPS(bs)		(BPS((bs)) / sizeof(fat_dentry_t))
 #define BPC(bs)		(BPS((bs)) * SPC((bs)))
 
+/** Maximum number of bytes returned by a single multi-block file read. */
+#define FAT_READ_RUN_MAX	(64 * 1024)
+
 /** Mutex protecting the list of cached free FAT nodes. */
 static FIBRIL_MUTEX_INITIALIZE(ffn_mutex);
 
@@ -82,6 +86,7 @@ static errno_t fat_destroy_node(fs_node_t *);
 static errno_t fat_link(fs_node_t *, fs_node_t *, const char *);
 static errno_t fat_unlink(fs_node_t *, fs_node_t *, const char *);
 static errno_t fat_has_children(bool *, fs_node_t *);
+static errno_t fat_readdir(fs_node_t *, aoff64_t, libfs_dirent_fn_t, void *);
 static fs_index_t fat_index_get(fs_node_t *);
 static aoff64_t fat_size_get(fs_node_t *);
 static unsigned fat_lnkcnt_get(fs_node_t *);
@@ -108,9 +113,11 @@ static void fat_node_initialize(fat_node_t *node)
 	node->dirty = false;
 	node->lastc_cached_valid = false;
 	node->lastc_cached_value = 0;
-	node->currc_cached_valid = false;
-	node->currc_cached_bn = 0;
-	node->currc_cached_value = 0;
+	node->extents = NULL;
+	node->ext_count = 0;
+	node->ext_alloc = 0;
+	node->ext_clusters = 0;
+	node->ext_eof = false;
 }
 
 static errno_t fat_node_sync(fat_node_t *node)
@@ -192,6 +199,7 @@ restart:
 				return rc;
 		}
 		nodep->idx->nodep = NULL;
+		fat_extents_clear(nodep);
 		free(nodep->bp);
 		free(nodep);
 
@@ -230,6 +238,7 @@ static errno_t fat_node_get_new(fat_node_t **nodepp)
 				idxp_tmp->nodep = NULL;
 				fibril_mutex_unlock(&nodep->lock);
 				fibril_mutex_unlock(&idxp_tmp->lock);
+				fat_extents_clear(nodep);
 				free(nodep->bp);
 				free(nodep);
 				return rc;
@@ -238,6 +247,7 @@ static errno_t fat_node_get_new(fat_node_t **nodepp)
 		idxp_tmp->nodep = NULL;
 		fibril_mutex_unlock(&nodep->lock);
 		fibril_mutex_unlock(&idxp_tmp->lock);
+		fat_extents_clear(nodep);
 		fn = FS_NODE(nodep);
 	} else {
 	skip_cache:
@@ -476,6 +486,7 @@ errno_t fat_node_put(fs_node_t *fn)
 	}
 	fibril_mutex_unlock(&nodep->lock);
 	if (destroy) {
+		fat_extents_clear(nodep);
 		free(nodep->bp);
 		free(nodep);
 	}
@@ -569,6 +580,7 @@ errno_t fat_destroy_node(fs_node_t *fn)
 	}
 
 	fat_idx_destroy(nodep->idx);
+	fat_extents_clear(nodep);
 	free(nodep->bp);
 	free(nodep);
 	return rc;
@@ -811,6 +823,55 @@ errno_t fat_has_children(bool *has_children, fs_node_t *fn)
 	return EOK;
 }
 
+errno_t fat_readdir(fs_node_t *fn, aoff64_t pos, libfs_dirent_fn_t cb,
+    void *arg)
+{
+	fat_node_t *nodep = FAT_NODE(fn);
+	char name[FAT_LFN_NAME_SIZE];
+	fat_dentry_t *d;
+	service_id_t service_id;
+	errno_t rc;
+
+	fibril_mutex_lock(&nodep->idx->lock);
+	service_id = nodep->idx->service_id;
+	fibril_mutex_unlock(&nodep->idx->lock);
+
+	fat_directory_t di;
+	rc = fat_directory_open(nodep, &di);
+	if (rc != EOK)
+		return rc;
+	rc = fat_directory_seek(&di, pos);
+	if (rc != EOK) {
+		(void) fat_directory_close(&di);
+		return rc;
+	}
+
+	while ((rc = fat_directory_read(&di, name, &d)) == EOK) {
+		aoff64_t o = di.pos % (BPS(di.bs) / sizeof(fat_dentry_t));
+		fat_idx_t *idx = fat_idx_get_by_pos(service_id, nodep->firstc,
+		    di.bnum * DPS(di.bs) + o);
+		if (!idx) {
+			rc = ENOMEM;
+			break;
+		}
+		fs_index_t index = idx->index;
+		fibril_mutex_unlock(&idx->lock);
+
+		if (!cb(arg, name, index, di.pos + 1))
+			break;
+
+		rc = fat_directory_next(&di);
+		if (rc != EOK)
+			break;
+	}
+
+	if (rc == ENOENT)
+		rc = EOK;
+
+	errno_t rc2 = fat_directory_close(&di);
+	return rc != EOK ? rc : rc2;
+}
+
 fs_index_t fat_index_get(fs_node_t *fn)
 {
 	return FAT_NODE(fn)->idx->index;
@@ -864,23 +925,15 @@ errno_t fat_total_block_count(service_id_t service_id, uint64_t *count)
 errno_t fat_free_block_count(service_id_t service_id, uint64_t *count)
 {
 	fat_bs_t *bs;
-	fat_cluster_t e0;
-	uint64_t block_count;
+	uint32_t clusters;
 	errno_t rc;
-	uint32_t cluster_no, clusters;
 
-	block_count = 0;
 	bs = block_bb_get(service_id);
-	clusters = (SPC(bs)) ? TS(bs) / SPC(bs) : 0;
-	for (cluster_no = 0; cluster_no < clusters; cluster_no++) {
-		rc = fat_get_cluster(bs, service_id, FAT1, cluster_no, &e0);
-		if (rc != EOK)
-			return EIO;
+	rc = fat_count_free_clusters(bs, service_id, &clusters);
+	if (rc != EOK)
+		return EIO;
 
-		if (e0 == FAT_CLST_RES0)
-			block_count++;
-	}
-	*count = block_count;
+	*count = clusters;
 
 	return EOK;
 }
@@ -897,6 +950,7 @@ libfs_ops_t fat_libfs_ops = {
 	.link = fat_link,
 	.unlink = fat_unlink,
 	.has_children = fat_has_children,
+	.readdir = fat_readdir,
 	.index_get = fat_index_get,
 	.size_get = fat_size_get,
 	.lnkcnt_get = fat_lnkcnt_get,
@@ -941,6 +995,9 @@ static errno_t fat_fs_open(service_id_t service_id, enum cache_mode cmode,
 		return rc;
 	}
 
+	/* Read ahead the rest of a cluster when reading sequentially. */
+	(void) block_cache_set_readahead(service_id, SPC(bs));
+
 	/* Do some simple sanity checks on the file system. */
 	rc = fat_sanity_check(bs, service_id);
 	if (rc != EOK) {
@@ -1024,6 +1081,7 @@ static errno_t fat_fs_open(service_id_t service_id, enum cache_mode cmode,
 
 static void fat_fs_close(service_id_t service_id, fs_node_t *rfn)
 {
+	fat_extents_clear(FAT_NODE(rfn));
 	free(rfn->data);
 	free(rfn);
 	(void) block_cache_fini(service_id);
@@ -1088,6 +1146,10 @@ fat_mounted(service_id_t service_id, const char *opts, fs_index_t *index,
 	if (!instance)
 		return ENOMEM;
 	instance->lfn_enabled = true;
+	fibril_mutex_initialize(&instance->free_lock);
+	instance->free_map = NULL;
+	instance->free_count = 0;
+	instance->next_free = FAT_CLST_FIRST;
 
 	/* Parse mount options. */
 	char *mntopts = (char *) opts;
@@ -1123,7 +1185,8 @@ fat_mounted(service_id_t service_id, const char *opts, fs_index_t *index,
 	return EOK;
 }
 
-static errno_t fat_update_fat32_fsinfo(service_id_t service_id)
+static errno_t fat_update_fat32_fsinfo(service_id_t service_id,
+    fat_instance_t *instance)
 {
 	fat_bs_t *bs;
 	fat32_fsinfo_t *info;
@@ -1147,8 +1210,15 @@ static errno_t fat_update_fat32_fsinfo(service_id_t service_id)
 		return EINVAL;
 	}
 
-	/* For now, invalidate the counter. */
-	info->free_clusters = host2uint16_t_le(-1);
+	if (instance != NULL && instance->free_map != NULL) {
+		/* The free cluster map is authoritative, store its state. */
+		info->free_clusters = host2uint32_t_le(instance->free_count);
+		info->last_allocated_cluster =
+		    host2uint32_t_le(instance->next_free);
+	} else {
+		/* We do not know the number of free clusters. */
+		info->free_clusters = host2uint32_t_le(-1);
+	}
 
 	b->dirty = true;
 	return block_put(b);
@@ -1158,11 +1228,16 @@ static errno_t fat_unmounted(service_id_t service_id)
 {
 	fs_node_t *fn;
 	fat_node_t *nodep;
+	fat_instance_t *instance = NULL;
 	fat_bs_t *bs;
+	void *data;
 	errno_t rc;
 
 	bs = block_bb_get(service_id);
 
+	if (fs_instance_get(service_id, &data) == EOK)
+		instance = (fat_instance_t *) data;
+
 	rc = fat_root_get(&fn, service_id);
 	if (rc != EOK)
 		return rc;
@@ -1181,7 +1256,7 @@ static errno_t fat_unmounted(service_id_t service_id)
 		/*
 		 * Attempt to update the FAT32 FS info.
 		 */
-		(void) fat_update_fat32_fsinfo(service_id);
+		(void) fat_update_fat32_fsinfo(service_id, instance);
 	}
 
 	/*
@@ -1197,15 +1272,62 @@ static errno_t fat_unmounted(service_id_t service_id)
 	(void) fat_node_fini_by_service_id(service_id);
 	fat_fs_close(service_id, fn);
 
-	void *data;
-	if (fs_instance_get(service_id, &data) == EOK) {
+	if (instance != NULL) {
 		fs_instance_destroy(service_id);
-		free(data);
+		free(instance->free_map);
+		free(instance);
 	}
 
 	return EOK;
 }
 
+/** Read a run of physically contiguous blocks of a file.
+ *
+ * @param bs		Buffer holding the boot sector of the file system.
+ * @param nodep		FAT node.
+ * @param pos		Position where to start reading.
+ * @param len		Maximum number of bytes to read.
+ * @param call		Data read call to answer.
+ * @param rbytes	Output argument holding the number of bytes read.
+ *
+ * @return		EOK on success or an error code. On error, the call is
+ *			left unanswered.
+ */
+static errno_t fat_read_run(fat_bs_t *bs, fat_node_t *nodep, aoff64_t pos,
+    size_t len, ipc_call_t *call, size_t *rbytes)
+{
+	aoff64_t pbn, cnt;
+	size_t bytes, boff, nblocks;
+	uint8_t *buf;
+	errno_t rc;
+
+	rc = fat_block_run(bs, nodep, pos / BPS(bs), &pbn, &cnt);
+	if (rc != EOK)
+		return rc;
+
+	boff = pos % BPS(bs);
+	bytes = min(len, FAT_READ_RUN_MAX - boff);
+	if (cnt * BPS(bs) - boff < bytes)
+		bytes = cnt * BPS(bs) - boff;
+	nblocks = (boff + bytes + BPS(bs) - 1) / BPS(bs);
+
+	buf = malloc(nblocks * BPS(bs));
+	if (buf == NULL)
+		return ENOMEM;
+
+	rc = block_read_run(nodep->idx->service_id, pbn, nblocks, buf);
+	if (rc != EOK) {
+		free(buf);
+		return rc;
+	}
+
+	(void) async_data_read_finalize(call, buf + boff, bytes);
+	free(buf);
+
+	*rbytes = bytes;
+	return EOK;
+}
+
 static errno_t
 fat_read(service_id_t service_id, fs_index_t index, aoff64_t pos,
     size_t *rbytes)
@@ -1236,14 +1358,24 @@ fat_read(service_id_t service_id, fs_index_t index, aoff64_t pos,
 
 	if (nodep->type == FAT_FILE) {
 		/*
-		 * Our strategy for regular file reads is to read one block at
-		 * most and make use of the possibility to return less data than
-		 * requested. This keeps the code very simple.
+		 * Our strategy for regular file reads is to read at most one
+		 * run of physically contiguous blocks and make use of the
+		 * possibility to return less data than requested. This keeps
+		 * the code very simple.
 		 */
 		if (pos >= nodep->size) {
 			/* reading beyond the EOF */
 			bytes = 0;
 			(void) async_data_read_finalize(&call, NULL, 0);
+		} else if (pos % BPS(bs) + min(len, nodep->size - pos) >
+		    BPS(bs)) {
+			rc = fat_read_run(bs, nodep, pos, min(len,
+			    nodep->size - pos), &call, &bytes);
+			if (rc != EOK) {
+				fat_node_put(fn);
+				async_answer_0(&call, rc);
+				return rc;
+			}
 		} else {
 			bytes = min(len, BPS(bs) - pos % BPS(bs));
 			bytes = min(bytes, nodep->size - pos);
@@ -383,6 +383,56 @@ static errno_t locfs_has_children(bool *has_children, fs_node_t *fn)
 	return EOK;
 }
 
+static errno_t locfs_readdir(fs_node_t *fn, aoff64_t pos,
+    libfs_dirent_fn_t cb, void *arg)
+{
+	locfs_node_t *node = (locfs_node_t *) fn->data;
+	service_id_t namespace = node->service_id;
+	loc_sdesc_t *desc;
+	size_t count;
+	size_t i;
+	aoff64_t cur = 0;
+
+	if (node->service_id == 0) {
+		count = loc_get_namespaces(&desc);
+
+		for (i = 0; i < count; i++) {
+			/* Get rid of root namespace */
+			if (str_cmp(desc[i].name, "") == 0)
+				continue;
+
+			if (cur++ < pos)
+				continue;
+
+			if (!cb(arg, desc[i].name, desc[i].id, cur)) {
+				free(desc);
+				return EOK;
+			}
+		}
+
+		free(desc);
+
+		/* Continue with the root namespace */
+		if (loc_namespace_get_id("", &namespace, 0) != EOK)
+			return EOK;
+	} else if (node->type != LOC_OBJECT_NAMESPACE) {
+		return ENOTDIR;
+	}
+
+	count = loc_get_services(namespace, &desc);
+
+	for (i = 0; i < count; i++) {
+		if (cur++ < pos)
+			continue;
+
+		if (!cb(arg, desc[i].name, desc[i].id, cur))
+			break;
+	}
+
+	free(desc);
+	return EOK;
+}
+
 static fs_index_t locfs_index_get(fs_node_t *fn)
 {
 	locfs_node_t *node = (locfs_node_t *) fn->data;
@@ -440,6 +490,7 @@ libfs_ops_t locfs_libfs_ops = {
 	.link = locfs_link_node,
 	.unlink = locfs_unlink_node,
 	.has_children = locfs_has_children,
+	.readdir = locfs_readdir,
 	.index_get = locfs_index_get,
 	.size_get = locfs_size_get,
 	.lnkcnt_get = locfs_lnkcnt_get,
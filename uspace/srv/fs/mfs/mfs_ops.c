@@ -49,6 +49,8 @@ static unsigned mfs_lnkcnt_get(fs_node_t *fsnode);
 static bool mfs_is_directory(fs_node_t *fsnode);
 static bool mfs_is_file(fs_node_t *fsnode);
 static errno_t mfs_has_children(bool *has_children, fs_node_t *fsnode);
+static errno_t mfs_readdir(fs_node_t *fsnode, aoff64_t pos,
+    libfs_dirent_fn_t cb, void *arg);
 static errno_t mfs_root_get(fs_node_t **rfn, service_id_t service_id);
 static service_id_t mfs_service_get(fs_node_t *fsnode);
 static aoff64_t mfs_size_get(fs_node_t *node);
@@ -86,6 +88,7 @@ libfs_ops_t mfs_libfs_ops = {
 	.unlink = mfs_unlink,
 	.destroy = mfs_destroy_node,
 	.has_children = mfs_has_children,
+	.readdir = mfs_readdir,
 	.lnkcnt_get = mfs_lnkcnt_get,
 	.size_block = mfs_size_block,
 	.total_block_count = mfs_total_block_count,
@@ -819,6 +822,32 @@ out:
 	return EOK;
 }
 
+static errno_t
+mfs_readdir(fs_node_t *fsnode, aoff64_t pos, libfs_dirent_fn_t cb, void *arg)
+{
+	struct mfs_node *mnode = fsnode->data;
+	struct mfs_sb_info *sbi = mnode->instance->sbi;
+	struct mfs_dentry_info d_info;
+	errno_t r;
+
+	if (pos < 2) {
+		/* Skip the first two dentries ('.' and '..') */
+		pos = 2;
+	}
+
+	for (; pos < mnode->ino_i->i_size / sbi->dirsize; ++pos) {
+		r = mfs_read_dentry(mnode, &d_info, pos);
+		if (r != EOK)
+			return r;
+
+		if (d_info.d_inum && !cb(arg, d_info.d_name, d_info.d_inum,
+		    pos + 1))
+			break;
+	}
+
+	return EOK;
+}
+
 static errno_t
 mfs_read(service_id_t service_id, fs_index_t index, aoff64_t pos,
     size_t *rbytes)
@@ -34,6 +34,7 @@
 #define TMPFS_TMPFS_H_
 
 #include <libfs.h>
+#include <as.h>
 #include <stddef.h>
 #include <stdbool.h>
 #include <adt/hash_table.h>
@@ -41,6 +42,13 @@
 #define TMPFS_NODE(node)	((node) ? (tmpfs_node_t *)(node)->data : NULL)
 #define FS_NODE(node)		((node) ? (node)->bp : NULL)
 
+/** Size of one chunk of file contents. */
+#define TMPFS_CHUNK_SIZE	PAGE_SIZE
+
+/** Number of bits of the chunk number resolved by one radix tree level. */
+#define TMPFS_RADIX_WIDTH	9
+#define TMPFS_RADIX_FANOUT	(1 << TMPFS_RADIX_WIDTH)
+
 typedef enum {
 	TMPFS_NONE,
 	TMPFS_FILE,
@@ -52,10 +60,24 @@ struct tmpfs_node;
 
 typedef struct tmpfs_dentry {
 	link_t link;		/**< Linkage for the list of siblings. */
+	ht_link_t dh_link;	/**< Dentries hash table link. */
+	struct tmpfs_node *parent;/**< Directory containing the dentry. */
 	struct tmpfs_node *node;/**< Back pointer to TMPFS node. */
 	char *name;		/**< Name of dentry. */
 } tmpfs_dentry_t;
 
+/** Radix tree of the page-sized chunks holding the contents of a file.
+ *
+ * Each level resolves TMPFS_RADIX_WIDTH bits of the chunk number, the
+ * bottom level points to the chunks themselves. A tree of height 0 holds
+ * only the first chunk, which is the root itself. Missing chunks are holes
+ * and read as zeroes.
+ */
+typedef struct {
+	void *root;		/**< Root of the tree or NULL if empty. */
+	unsigned int height;	/**< Number of levels of the tree. */
+} tmpfs_chunks_t;
+
 typedef struct tmpfs_node {
 	fs_node_t *bp;		/**< Back pointer to the FS node. */
 	fs_index_t index;	/**< TMPFS node index. */
@@ -63,8 +85,8 @@ typedef struct tmpfs_node {
 	ht_link_t nh_link;		/**< Nodes hash table link. */
 	tmpfs_dentry_type_t type;
 	unsigned lnkcnt;	/**< Link count. */
-	size_t size;		/**< File size if type is TMPFS_FILE. */
-	void *data;		/**< File content's if type is TMPFS_FILE. */
+	aoff64_t size;		/**< File size if type is TMPFS_FILE. */
+	tmpfs_chunks_t chunks;	/**< File contents if type is TMPFS_FILE. */
 	list_t cs_list;		/**< Child's siblings list. */
 } tmpfs_node_t;
 
@@ -73,6 +95,11 @@ extern libfs_ops_t tmpfs_libfs_ops;
 
 extern bool tmpfs_init(void);
 
+extern void tmpfs_chunks_initialize(tmpfs_chunks_t *);
+extern const void *tmpfs_chunks_read(tmpfs_chunks_t *, aoff64_t);
+extern errno_t tmpfs_chunks_write(tmpfs_chunks_t *, aoff64_t, void **);
+extern void tmpfs_chunks_truncate(tmpfs_chunks_t *, aoff64_t);
+
 #endif
 
 /**
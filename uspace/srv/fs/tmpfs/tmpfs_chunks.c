@@ -0,0 +1,221 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup tmpfs
+ * @{
+ */
+
+/**
+ * @file	tmpfs_chunks.c
+ * @brief	Chunked storage of TMPFS file contents.
+ *
+ * File contents are kept in page-sized, page-aligned chunks indexed by a
+ * radix tree. Growing a file therefore never copies the data already
+ * written, a page-in request is served from a single chunk and chunks
+ * that were never written to take up no memory at all.
+ */
+
+#include "tmpfs.h"
+#include <errno.h>
+#include <malloc.h>
+#include <mem.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/** Contents of holes. */
+static const uint8_t zero_chunk[TMPFS_CHUNK_SIZE];
+
+/** Return the number of the tree slot at the given level for a chunk. */
+static size_t chunks_slot(aoff64_t idx, unsigned int level)
+{
+	return (idx >> ((level - 1) * TMPFS_RADIX_WIDTH)) &
+	    (TMPFS_RADIX_FANOUT - 1);
+}
+
+/** Check whether a tree of the given height can hold a chunk. */
+static bool chunks_covers(unsigned int height, aoff64_t idx)
+{
+	if (height * TMPFS_RADIX_WIDTH >= sizeof(aoff64_t) * 8)
+		return true;
+
+	return (idx >> (height * TMPFS_RADIX_WIDTH)) == 0;
+}
+
+/** Find a chunk, return NULL if there is a hole. */
+static void *chunks_lookup(tmpfs_chunks_t *chunks, aoff64_t idx)
+{
+	if (!chunks_covers(chunks->height, idx))
+		return NULL;
+
+	void *node = chunks->root;
+	for (unsigned int level = chunks->height; level > 0; level--) {
+		if (node == NULL)
+			return NULL;
+		node = ((void **) node)[chunks_slot(idx, level)];
+	}
+
+	return node;
+}
+
+/** Free chunks starting at a given chunk number within a subtree.
+ *
+ * @param slots Subtree
+ * @param level Level of the subtree, 1 being the bottom level
+ * @param first First chunk number, relative to the subtree, to free
+ */
+static void chunks_prune(void **slots, unsigned int level, aoff64_t first)
+{
+	aoff64_t span = (aoff64_t) 1 << ((level - 1) * TMPFS_RADIX_WIDTH);
+
+	for (size_t i = 0; i < TMPFS_RADIX_FANOUT; i++) {
+		aoff64_t base = i * span;
+
+		if (slots[i] == NULL || base + span <= first)
+			continue;
+
+		if (level > 1)
+			chunks_prune(slots[i], level - 1,
+			    base >= first ? 0 : first - base);
+
+		if (base >= first) {
+			free(slots[i]);
+			slots[i] = NULL;
+		}
+	}
+}
+
+void tmpfs_chunks_initialize(tmpfs_chunks_t *chunks)
+{
+	chunks->root = NULL;
+	chunks->height = 0;
+}
+
+/** Get a chunk for reading.
+ *
+ * @param chunks Chunks of the file
+ * @param idx    Chunk number
+ *
+ * @return The chunk or an all-zero chunk if there is a hole.
+ */
+const void *tmpfs_chunks_read(tmpfs_chunks_t *chunks, aoff64_t idx)
+{
+	void *chunk = chunks_lookup(chunks, idx);
+	return chunk != NULL ? chunk : zero_chunk;
+}
+
+/** Get a chunk for writing, allocating it if needed.
+ *
+ * Newly allocated chunks are zeroed.
+ *
+ * @param chunks Chunks of the file
+ * @param idx    Chunk number
+ * @param rchunk Place to store the chunk
+ *
+ * @return EOK on success or ENOMEM.
+ */
+errno_t tmpfs_chunks_write(tmpfs_chunks_t *chunks, aoff64_t idx,
+    void **rchunk)
+{
+	/* An empty tree starts out just tall enough to hold the chunk. */
+	if (chunks->root == NULL) {
+		chunks->height = 0;
+		while (!chunks_covers(chunks->height, idx))
+			chunks->height++;
+	}
+
+	/* Add levels on top until the tree covers the chunk. */
+	while (!chunks_covers(chunks->height, idx)) {
+		void **root = calloc(TMPFS_RADIX_FANOUT, sizeof(void *));
+		if (root == NULL)
+			return ENOMEM;
+
+		root[0] = chunks->root;
+		chunks->root = root;
+		chunks->height++;
+	}
+
+	void **slot = &chunks->root;
+	for (unsigned int level = chunks->height; level > 0; level--) {
+		if (*slot == NULL) {
+			*slot = calloc(TMPFS_RADIX_FANOUT, sizeof(void *));
+			if (*slot == NULL)
+				return ENOMEM;
+		}
+		slot = &((void **) *slot)[chunks_slot(idx, level)];
+	}
+
+	if (*slot == NULL) {
+		void *chunk = memalign(TMPFS_CHUNK_SIZE, TMPFS_CHUNK_SIZE);
+		if (chunk == NULL)
+			return ENOMEM;
+
+		memset(chunk, 0, TMPFS_CHUNK_SIZE);
+		*slot = chunk;
+	}
+
+	*rchunk = *slot;
+	return EOK;
+}
+
+/** Drop file contents beyond a given size.
+ *
+ * Chunks lying entirely past @a size are freed and the tail of the last
+ * chunk is cleared so that the file reads as zeroes if it grows again.
+ * Truncating to zero releases all memory held by the tree.
+ *
+ * @param chunks Chunks of the file
+ * @param size   New size of the file
+ */
+void tmpfs_chunks_truncate(tmpfs_chunks_t *chunks, aoff64_t size)
+{
+	if (chunks->root == NULL)
+		return;
+
+	aoff64_t first = size / TMPFS_CHUNK_SIZE +
+	    (size % TMPFS_CHUNK_SIZE != 0 ? 1 : 0);
+
+	if (chunks->height > 0 && chunks_covers(chunks->height, first))
+		chunks_prune(chunks->root, chunks->height, first);
+
+	if (first == 0) {
+		free(chunks->root);
+		tmpfs_chunks_initialize(chunks);
+		return;
+	}
+
+	size_t tail = size % TMPFS_CHUNK_SIZE;
+	if (tail != 0) {
+		uint8_t *chunk = chunks_lookup(chunks, size / TMPFS_CHUNK_SIZE);
+		if (chunk != NULL)
+			memset(chunk + tail, 0, TMPFS_CHUNK_SIZE - tail);
+	}
+}
+
+/**
+ * @}
+ */
@@ -84,6 +84,23 @@ static errno_t tmpfs_has_children(bool *has_children, fs_node_t *fn)
 	return EOK;
 }
 
+static errno_t tmpfs_readdir(fs_node_t *fn, aoff64_t pos,
+    libfs_dirent_fn_t cb, void *arg)
+{
+	tmpfs_node_t *nodep = TMPFS_NODE(fn);
+	link_t *lnk = list_nth(&nodep->cs_list, pos);
+
+	while (lnk != NULL) {
+		tmpfs_dentry_t *dentryp = list_get_instance(lnk, tmpfs_dentry_t,
+		    link);
+		if (!cb(arg, dentryp->name, dentryp->node->index, ++pos))
+			break;
+		lnk = list_next(lnk, &nodep->cs_list);
+	}
+
+	return EOK;
+}
+
 static fs_index_t tmpfs_index_get(fs_node_t *fn)
 {
 	return TMPFS_NODE(fn)->index;
@@ -126,6 +143,7 @@ libfs_ops_t tmpfs_libfs_ops = {
 	.link = tmpfs_link_node,
 	.unlink = tmpfs_unlink_node,
 	.has_children = tmpfs_has_children,
+	.readdir = tmpfs_readdir,
 	.index_get = tmpfs_index_get,
 	.size_get = tmpfs_size_get,
 	.lnkcnt_get = tmpfs_lnkcnt_get,
@@ -166,6 +184,83 @@ static bool nodes_key_equal(const void *key_arg, const ht_link_t *item)
 	return key->service_id == node->service_id && key->index == node->index;
 }
 
+/** Hash table of all TMPFS dentries. */
+hash_table_t dentries;
+
+/*
+ * Implementation of hash table interface for the dentries hash table.
+ */
+
+typedef struct {
+	tmpfs_node_t *parent;
+	const char *name;
+} dentry_key_t;
+
+static size_t dentry_hash(tmpfs_node_t *parent, const char *name)
+{
+	size_t hash = hash_combine(0, (uintptr_t) parent);
+
+	for (const char *c = name; *c != '\0'; c++)
+		hash = hash_combine(hash, (uint8_t) *c);
+
+	return hash;
+}
+
+static size_t dentries_key_hash(const void *k)
+{
+	const dentry_key_t *key = k;
+	return dentry_hash(key->parent, key->name);
+}
+
+static size_t dentries_hash(const ht_link_t *item)
+{
+	tmpfs_dentry_t *dentryp = hash_table_get_inst(item, tmpfs_dentry_t,
+	    dh_link);
+	return dentry_hash(dentryp->parent, dentryp->name);
+}
+
+static bool dentries_key_equal(const void *key_arg, const ht_link_t *item)
+{
+	tmpfs_dentry_t *dentryp = hash_table_get_inst(item, tmpfs_dentry_t,
+	    dh_link);
+	const dentry_key_t *key = key_arg;
+
+	return key->parent == dentryp->parent &&
+	    str_cmp(key->name, dentryp->name) == 0;
+}
+
+/** TMPFS dentries hash table operations. */
+hash_table_ops_t dentries_ops = {
+	.hash = dentries_hash,
+	.key_hash = dentries_key_hash,
+	.key_equal = dentries_key_equal,
+	.equal = NULL,
+	.remove_callback = NULL
+};
+
+static tmpfs_dentry_t *tmpfs_dentry_find(tmpfs_node_t *parentp,
+    const char *name)
+{
+	dentry_key_t key = {
+		.parent = parentp,
+		.name = name
+	};
+
+	ht_link_t *lnk = hash_table_find(&dentries, &key);
+	if (!lnk)
+		return NULL;
+
+	return hash_table_get_inst(lnk, tmpfs_dentry_t, dh_link);
+}
+
+static void tmpfs_dentry_remove(tmpfs_dentry_t *dentryp)
+{
+	hash_table_remove_item(&dentries, &dentryp->dh_link);
+	list_remove(&dentryp->link);
+	free(dentryp->name);
+	free(dentryp);
+}
+
 static void nodes_remove_callback(ht_link_t *item)
 {
 	tmpfs_node_t *nodep = hash_table_get_inst(item, tmpfs_node_t, nh_link);
@@ -175,14 +270,10 @@ static void nodes_remove_callback(ht_link_t *item)
 		    list_first(&nodep->cs_list), tmpfs_dentry_t, link);
 
 		assert(nodep->type == TMPFS_DIRECTORY);
-		list_remove(&dentryp->link);
-		free(dentryp);
+		tmpfs_dentry_remove(dentryp);
 	}
 
-	if (nodep->data) {
-		assert(nodep->type == TMPFS_FILE);
-		free(nodep->data);
-	}
+	tmpfs_chunks_truncate(&nodep->chunks, 0);
 	free(nodep->bp);
 	free(nodep);
 }
@@ -204,7 +295,7 @@ static void tmpfs_node_initialize(tmpfs_node_t *nodep)
 	nodep->type = TMPFS_NONE;
 	nodep->lnkcnt = 0;
 	nodep->size = 0;
-	nodep->data = NULL;
+	tmpfs_chunks_initialize(&nodep->chunks);
 	list_initialize(&nodep->cs_list);
 }
 
@@ -212,6 +303,7 @@ static void tmpfs_dentry_initialize(tmpfs_dentry_t *dentryp)
 {
 	link_initialize(&dentryp->link);
 	dentryp->name = NULL;
+	dentryp->parent = NULL;
 	dentryp->node = NULL;
 }
 
@@ -219,6 +311,8 @@ bool tmpfs_init(void)
 {
 	if (!hash_table_create(&nodes, 0, 0, &nodes_ops))
 		return false;
+	if (!hash_table_create(&dentries, 0, 0, &dentries_ops))
+		return false;
 
 	return true;
 }
@@ -253,16 +347,10 @@ static void tmpfs_instance_done(service_id_t service_id)
 
 errno_t tmpfs_match(fs_node_t **rfn, fs_node_t *pfn, const char *component)
 {
-	tmpfs_node_t *parentp = TMPFS_NODE(pfn);
+	tmpfs_dentry_t *dentryp = tmpfs_dentry_find(TMPFS_NODE(pfn),
+	    component);
 
-	list_foreach(parentp->cs_list, link, tmpfs_dentry_t, dentryp) {
-		if (!str_cmp(dentryp->name, component)) {
-			*rfn = FS_NODE(dentryp->node);
-			return EOK;
-		}
-	}
-
-	*rfn = NULL;
+	*rfn = dentryp ? FS_NODE(dentryp->node) : NULL;
 	return EOK;
 }
 
@@ -362,10 +450,8 @@ errno_t tmpfs_link_node(fs_node_t *pfn, fs_node_t *cfn, const char *nm)
 	assert(parentp->type == TMPFS_DIRECTORY);
 
 	/* Check for duplicit entries. */
-	list_foreach(parentp->cs_list, link, tmpfs_dentry_t, dp) {
-		if (!str_cmp(dp->name, nm))
-			return EEXIST;
-	}
+	if (tmpfs_dentry_find(parentp, nm))
+		return EEXIST;
 
 	/* Allocate and initialize the dentry. */
 	dentryp = malloc(sizeof(tmpfs_dentry_t));
@@ -381,9 +467,11 @@ errno_t tmpfs_link_node(fs_node_t *pfn, fs_node_t *cfn, const char *nm)
 		return ENOMEM;
 	}
 	str_cpy(dentryp->name, size + 1, nm);
+	dentryp->parent = parentp;
 	dentryp->node = childp;
 	childp->lnkcnt++;
 	list_append(&dentryp->link, &parentp->cs_list);
+	hash_table_insert(&dentries, &dentryp->dh_link);
 
 	return EOK;
 }
@@ -391,29 +479,23 @@ errno_t tmpfs_link_node(fs_node_t *pfn, fs_node_t *cfn, const char *nm)
 errno_t tmpfs_unlink_node(fs_node_t *pfn, fs_node_t *cfn, const char *nm)
 {
 	tmpfs_node_t *parentp = TMPFS_NODE(pfn);
-	tmpfs_node_t *childp = NULL;
+	tmpfs_node_t *childp;
 	tmpfs_dentry_t *dentryp;
 
 	if (!parentp)
 		return EBUSY;
 
-	list_foreach(parentp->cs_list, link, tmpfs_dentry_t, dp) {
-		if (!str_cmp(dp->name, nm)) {
-			dentryp = dp;
-			childp = dentryp->node;
-			assert(FS_NODE(childp) == cfn);
-			break;
-		}
-	}
-
-	if (!childp)
+	dentryp = tmpfs_dentry_find(parentp, nm);
+	if (!dentryp)
 		return ENOENT;
 
+	childp = dentryp->node;
+	assert(FS_NODE(childp) == cfn);
+
 	if ((childp->lnkcnt == 1) && !list_empty(&childp->cs_list))
 		return ENOTEMPTY;
 
-	list_remove(&dentryp->link);
-	free(dentryp);
+	tmpfs_dentry_remove(dentryp);
 	childp->lnkcnt--;
 
 	return EOK;
@@ -491,20 +573,28 @@ static errno_t tmpfs_read(service_id_t service_id, fs_index_t index, aoff64_t po
 
 	size_t bytes;
 	if (nodep->type == TMPFS_FILE) {
-		bytes = min(nodep->size - pos, size);
-		(void) async_data_read_finalize(&call, nodep->data + pos,
-		    bytes);
+		/*
+		 * Read at most up to the end of the chunk holding the position.
+		 * Page-sized reads from the pager are thus served straight
+		 * from a single chunk.
+		 */
+		size_t offset = pos % TMPFS_CHUNK_SIZE;
+
+		bytes = 0;
+		if (pos < nodep->size) {
+			bytes = min(nodep->size - pos, size);
+			bytes = min(bytes, TMPFS_CHUNK_SIZE - offset);
+		}
+
+		const uint8_t *chunk = tmpfs_chunks_read(&nodep->chunks,
+		    pos / TMPFS_CHUNK_SIZE);
+		(void) async_data_read_finalize(&call, chunk + offset, bytes);
 	} else {
 		tmpfs_dentry_t *dentryp;
 		link_t *lnk;
 
 		assert(nodep->type == TMPFS_DIRECTORY);
 
-		/*
-		 * Yes, we really use O(n) algorithm here.
-		 * If it bothers someone, it could be fixed by introducing a
-		 * hash table.
-		 */
 		lnk = list_nth(&nodep->cs_list, pos);
 
 		if (lnk == NULL) {
@@ -553,35 +643,25 @@ tmpfs_write(service_id_t service_id, fs_index_t index, aoff64_t pos,
 	}
 
 	/*
-	 * Check whether the file needs to grow.
+	 * Write at most up to the end of the chunk holding the position. The
+	 * client is told how much was written and carries on with the rest.
+	 * Any gap before the position stays a hole which reads as zeroes.
 	 */
-	if (pos + size <= nodep->size) {
-		/* The file size is not changing. */
-		(void) async_data_write_finalize(&call, nodep->data + pos,
-		    size);
-		goto out;
+	size_t offset = pos % TMPFS_CHUNK_SIZE;
+	size = min(size, TMPFS_CHUNK_SIZE - offset);
+
+	uint8_t *chunk;
+	errno_t rc = tmpfs_chunks_write(&nodep->chunks, pos / TMPFS_CHUNK_SIZE,
+	    (void **) &chunk);
+	if (rc != EOK) {
+		async_answer_0(&call, rc);
+		return rc;
 	}
-	size_t delta = (pos + size) - nodep->size;
-	/*
-	 * At this point, we are deliberately extremely straightforward and
-	 * simply realloc the contents of the file on every write that grows the
-	 * file. In the end, the situation might not be as bad as it may look:
-	 * our heap allocator can save us and just grow the block whenever
-	 * possible.
-	 */
-	void *newdata = realloc(nodep->data, nodep->size + delta);
-	if (!newdata) {
-		async_answer_0(&call, ENOMEM);
-		size = 0;
-		goto out;
-	}
-	/* Clear any newly allocated memory in order to emulate gaps. */
-	memset(newdata + nodep->size, 0, delta);
-	nodep->size += delta;
-	nodep->data = newdata;
-	(void) async_data_write_finalize(&call, nodep->data + pos, size);
 
-out:
+	(void) async_data_write_finalize(&call, chunk + offset, size);
+	if (pos + size > nodep->size)
+		nodep->size = pos + size;
+
 	*wbytes = size;
 	*nsize = nodep->size;
 	return EOK;
@@ -606,20 +686,11 @@ static errno_t tmpfs_truncate(service_id_t service_id, fs_index_t index,
 	if (size == nodep->size)
 		return EOK;
 
-	if (size > SIZE_MAX)
-		return ENOMEM;
-
-	void *newdata = realloc(nodep->data, size);
-	if (!newdata && size)
-		return ENOMEM;
-
-	if (size > nodep->size) {
-		size_t delta = size - nodep->size;
-		memset(newdata + nodep->size, 0, delta);
-	}
+	/* Growing the file only extends the trailing hole. */
+	if (size < nodep->size)
+		tmpfs_chunks_truncate(&nodep->chunks, size);
 
 	nodep->size = size;
-	nodep->data = newdata;
 	return EOK;
 }
 
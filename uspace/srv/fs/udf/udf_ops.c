@@ -199,6 +199,41 @@ static errno_t udf_has_children(bool *has_children, fs_node_t *fn)
 	return EOK;
 }
 
+static errno_t udf_readdir(fs_node_t *fn, aoff64_t pos, libfs_dirent_fn_t cb,
+    void *arg)
+{
+	udf_node_t *node = UDF_NODE(fn);
+	char *name = malloc(MAX_FILE_NAME_LEN + 1);
+	if (name == NULL)
+		return ENOMEM;
+
+	block_t *block = NULL;
+	udf_file_identifier_descriptor_t *fid = NULL;
+	errno_t rc;
+
+	while ((rc = udf_get_fid(&fid, &block, node, pos)) == EOK) {
+		udf_long_ad_t long_ad = fid->icb;
+
+		udf_to_unix_name(name, MAX_FILE_NAME_LEN,
+		    (char *) fid->implementation_use + FLE16(fid->length_iu),
+		    fid->length_file_id, &node->instance->charset);
+
+		if (block != NULL) {
+			rc = block_put(block);
+			if (rc != EOK)
+				break;
+		}
+
+		pos++;
+		if (!cb(arg, name, udf_long_ad_to_pos(node->instance, &long_ad),
+		    pos))
+			break;
+	}
+
+	free(name);
+	return rc == ENOENT ? EOK : rc;
+}
+
 static fs_index_t udf_index_get(fs_node_t *fn)
 {
 	udf_node_t *node = UDF_NODE(fn);
@@ -284,6 +319,7 @@ libfs_ops_t udf_libfs_ops = {
 	.link = udf_link,
 	.unlink = udf_unlink,
 	.has_children = udf_has_children,
+	.readdir = udf_readdir,
 	.index_get = udf_index_get,
 	.size_get = udf_size_get,
 	.lnkcnt_get = udf_lnkcnt_get,
@@ -87,8 +87,12 @@ static errno_t inet_init(void)
 {
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "inet_init()");
 
+	errno_t rc = inet_sroute_init();
+	if (rc != EOK)
+		return rc;
+
 	port_id_t port;
-	errno_t rc = async_create_port(INTERFACE_INET,
+	rc = async_create_port(INTERFACE_INET,
 	    inet_default_conn, NULL, &port);
 	if (rc != EOK)
 		return rc;
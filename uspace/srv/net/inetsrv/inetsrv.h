@@ -37,6 +37,7 @@
 #ifndef INETSRV_H_
 #define INETSRV_H_
 
+#include <adt/hash_table.h>
 #include <adt/list.h>
 #include <stdbool.h>
 #include <inet/addr.h>
@@ -123,6 +124,8 @@ typedef struct {
 /** Static route configuration */
 typedef struct {
 	link_t sroute_list;
+	/** Link in table of routes by destination prefix */
+	ht_link_t prefix_link;
 	sysarg_t id;
 	/** Destination network */
 	inet_naddr_t dest;
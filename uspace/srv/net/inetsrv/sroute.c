@@ -31,24 +31,239 @@
  */
 /**
  * @file
- * @brief
+ * @brief Static routes
+ *
+ * Routes are kept in a list (for enumeration and lookup by name or ID)
+ * and in a hash table keyed by (IP version, prefix length, masked
+ * destination). Longest prefix match probes the hash table once for each
+ * prefix length that has at least one route, from the longest one down,
+ * so the cost does not depend on the number of routes.
+ *
+ * Results are further remembered in a small direct-mapped per-destination
+ * cache, which is invalidated as a whole by bumping a generation number
+ * whenever the table changes.
+ *
+ * The route list lock protects the list, the hash table and the cache.
  */
 
+#include <adt/hash.h>
+#include <adt/hash_table.h>
 #include <bitops.h>
 #include <errno.h>
 #include <fibril_synch.h>
 #include <io/log.h>
 #include <ipc/loc.h>
+#include <mem.h>
 #include <stdlib.h>
 #include <str.h>
 #include "sroute.h"
 #include "inetsrv.h"
 #include "inet_link.h"
 
+/** Number of entries in route cache (must be power of two) */
+#define SROUTE_CACHE_SIZE 64
+
+/** Route lookup key */
+typedef struct {
+	/** IP version */
+	ip_ver_t ver;
+	/** Prefix length */
+	uint8_t bits;
+	/** Destination masked to prefix length, in network byte order */
+	addr128_t addr;
+} inet_sroute_key_t;
+
+/** Route cache entry */
+typedef struct {
+	/** Destination address */
+	inet_addr_t addr;
+	/** Route to use, @c NULL if there is none */
+	inet_sroute_t *sroute;
+	/** Value of sroute_gen when entry was filled in */
+	unsigned gen;
+} inet_sroute_cache_entry_t;
+
+static size_t sroute_ht_hash(const ht_link_t *);
+static size_t sroute_ht_key_hash(const void *);
+static bool sroute_ht_equal(const ht_link_t *, const ht_link_t *);
+static bool sroute_ht_key_equal(const void *, const ht_link_t *);
+
+static hash_table_ops_t sroute_ht_ops = {
+	.hash = sroute_ht_hash,
+	.key_hash = sroute_ht_key_hash,
+	.equal = sroute_ht_equal,
+	.key_equal = sroute_ht_key_equal,
+	.remove_callback = NULL
+};
+
 static FIBRIL_MUTEX_INITIALIZE(sroute_list_lock);
 static LIST_INITIALIZE(sroute_list);
 static sysarg_t sroute_id = 0;
 
+/** Routes by destination prefix */
+static hash_table_t sroute_ht;
+/** Number of routes with each prefix length, for IPv4 and IPv6 */
+static size_t sroute_plen_cnt[2][128 + 1];
+/** Route table generation, changes whenever routes are added or removed */
+static unsigned sroute_gen = 1;
+/** Per-destination route cache */
+static inet_sroute_cache_entry_t sroute_cache[SROUTE_CACHE_SIZE];
+
+/** Initialize static route table. */
+errno_t inet_sroute_init(void)
+{
+	if (!hash_table_create(&sroute_ht, 0, 0, &sroute_ht_ops))
+		return ENOMEM;
+
+	return EOK;
+}
+
+/** Set up route lookup key.
+ *
+ * @param ver	IP version
+ * @param addr	Address, in network byte order
+ * @param bits	Prefix length
+ * @param key	Place to store key
+ */
+static void inet_sroute_key_init(ip_ver_t ver, const addr128_t addr,
+    uint8_t bits, inet_sroute_key_t *key)
+{
+	size_t nbytes = bits / 8;
+
+	memset(key, 0, sizeof(inet_sroute_key_t));
+	key->ver = ver;
+	key->bits = bits;
+	memcpy(key->addr, addr, nbytes);
+	if (bits % 8 != 0)
+		key->addr[nbytes] = addr[nbytes] & (0xff << (8 - bits % 8));
+}
+
+/** Get IP version and address in network byte order.
+ *
+ * @param addr	Address
+ * @param baddr	Place to store address bytes (IPv4 uses first four)
+ * @return	IP version
+ */
+static ip_ver_t inet_sroute_addr_bytes(const inet_addr_t *addr,
+    addr128_t baddr)
+{
+	addr32_t a4;
+	addr128_t a6;
+	ip_ver_t ver;
+
+	memset(baddr, 0, sizeof(addr128_t));
+	ver = inet_addr_get(addr, &a4, &a6);
+	if (ver == ip_v6) {
+		memcpy(baddr, a6, sizeof(addr128_t));
+	} else if (ver == ip_v4) {
+		baddr[0] = a4 >> 24;
+		baddr[1] = (a4 >> 16) & 0xff;
+		baddr[2] = (a4 >> 8) & 0xff;
+		baddr[3] = a4 & 0xff;
+	}
+
+	return ver;
+}
+
+/** Get route lookup key of a static route.
+ *
+ * @param sroute	Static route
+ * @param key		Place to store key
+ * @return		EOK on success, EINVAL if the route can never match
+ */
+static errno_t inet_sroute_key(inet_sroute_t *sroute, inet_sroute_key_t *key)
+{
+	inet_addr_t dest;
+	addr128_t baddr;
+	ip_ver_t ver;
+
+	inet_naddr_addr(&sroute->dest, &dest);
+	ver = inet_sroute_addr_bytes(&dest, baddr);
+
+	switch (ver) {
+	case ip_v4:
+		if (sroute->dest.prefix > 32)
+			return EINVAL;
+		break;
+	case ip_v6:
+		if (sroute->dest.prefix > 128)
+			return EINVAL;
+		break;
+	default:
+		return EINVAL;
+	}
+
+	inet_sroute_key_init(ver, baddr, sroute->dest.prefix, key);
+	return EOK;
+}
+
+static size_t inet_sroute_key_hash(const inet_sroute_key_t *key)
+{
+	size_t hash;
+	size_t i;
+
+	hash = hash_combine(key->ver, key->bits);
+	for (i = 0; i < sizeof(addr128_t); i += sizeof(uint32_t)) {
+		hash = hash_combine(hash, ((uint32_t) key->addr[i] << 24) |
+		    ((uint32_t) key->addr[i + 1] << 16) |
+		    ((uint32_t) key->addr[i + 2] << 8) | key->addr[i + 3]);
+	}
+
+	return hash;
+}
+
+static bool inet_sroute_key_equal(const inet_sroute_key_t *a,
+    const inet_sroute_key_t *b)
+{
+	return a->ver == b->ver && a->bits == b->bits &&
+	    memcmp(a->addr, b->addr, sizeof(addr128_t)) == 0;
+}
+
+static size_t sroute_ht_hash(const ht_link_t *item)
+{
+	inet_sroute_t *sroute = hash_table_get_inst(item, inet_sroute_t,
+	    prefix_link);
+	inet_sroute_key_t key;
+
+	(void) inet_sroute_key(sroute, &key);
+	return inet_sroute_key_hash(&key);
+}
+
+static size_t sroute_ht_key_hash(const void *key)
+{
+	return inet_sroute_key_hash((const inet_sroute_key_t *) key);
+}
+
+static bool sroute_ht_equal(const ht_link_t *item1, const ht_link_t *item2)
+{
+	inet_sroute_key_t key1, key2;
+
+	(void) inet_sroute_key(hash_table_get_inst(item1, inet_sroute_t,
+	    prefix_link), &key1);
+	(void) inet_sroute_key(hash_table_get_inst(item2, inet_sroute_t,
+	    prefix_link), &key2);
+	return inet_sroute_key_equal(&key1, &key2);
+}
+
+static bool sroute_ht_key_equal(const void *key, const ht_link_t *item)
+{
+	inet_sroute_key_t ikey;
+
+	(void) inet_sroute_key(hash_table_get_inst(item, inet_sroute_t,
+	    prefix_link), &ikey);
+	return inet_sroute_key_equal((const inet_sroute_key_t *) key, &ikey);
+}
+
+/** Route table has changed, invalidate route cache. */
+static void inet_sroute_table_changed(void)
+{
+	if (++sroute_gen == 0) {
+		/* Wrapped around, make sure no stale entry looks valid */
+		memset(sroute_cache, 0, sizeof(sroute_cache));
+		sroute_gen = 1;
+	}
+}
+
 inet_sroute_t *inet_sroute_new(void)
 {
 	inet_sroute_t *sroute = calloc(1, sizeof(inet_sroute_t));
@@ -76,57 +291,114 @@ void inet_sroute_delete(inet_sroute_t *sroute)
 
 void inet_sroute_add(inet_sroute_t *sroute)
 {
+	inet_sroute_key_t key;
+
 	fibril_mutex_lock(&sroute_list_lock);
 	list_append(&sroute->sroute_list, &sroute_list);
+
+	if (inet_sroute_key(sroute, &key) == EOK) {
+		hash_table_insert(&sroute_ht, &sroute->prefix_link);
+		sroute_plen_cnt[key.ver == ip_v4 ? 0 : 1][key.bits]++;
+	} else {
+		log_msg(LOG_DEFAULT, LVL_WARN, "Static route %zu has invalid "
+		    "destination, it will not be used.", (size_t) sroute->id);
+	}
+
+	inet_sroute_table_changed();
 	fibril_mutex_unlock(&sroute_list_lock);
 }
 
 void inet_sroute_remove(inet_sroute_t *sroute)
 {
+	inet_sroute_key_t key;
+
 	fibril_mutex_lock(&sroute_list_lock);
 	list_remove(&sroute->sroute_list);
+
+	if (inet_sroute_key(sroute, &key) == EOK) {
+		hash_table_remove_item(&sroute_ht, &sroute->prefix_link);
+		sroute_plen_cnt[key.ver == ip_v4 ? 0 : 1][key.bits]--;
+	}
+
+	inet_sroute_table_changed();
 	fibril_mutex_unlock(&sroute_list_lock);
 }
 
+/** Find most specific static route for address in route table.
+ *
+ * @param ver	IP version
+ * @param baddr	Address bytes in network byte order
+ * @return	Static route or @c NULL if not found
+ */
+static inet_sroute_t *inet_sroute_lookup(ip_ver_t ver, const addr128_t baddr)
+{
+	inet_sroute_key_t key;
+	ht_link_t *link;
+	size_t *plen_cnt;
+	int bits;
+
+	plen_cnt = sroute_plen_cnt[ver == ip_v4 ? 0 : 1];
+
+	for (bits = (ver == ip_v4) ? 32 : 128; bits >= 0; bits--) {
+		if (plen_cnt[bits] == 0)
+			continue;
+
+		inet_sroute_key_init(ver, baddr, bits, &key);
+		link = hash_table_find(&sroute_ht, &key);
+		if (link != NULL) {
+			return hash_table_get_inst(link, inet_sroute_t,
+			    prefix_link);
+		}
+	}
+
+	return NULL;
+}
+
 /** Find static route object matching address @a addr.
  *
  * @param addr	Address
+ * @return	Most specific matching route or @c NULL if not found
  */
 inet_sroute_t *inet_sroute_find(inet_addr_t *addr)
 {
-	ip_ver_t addr_ver = inet_addr_get(addr, NULL, NULL);
+	inet_sroute_cache_entry_t *entry;
+	inet_sroute_t *best;
+	addr128_t baddr;
+	ip_ver_t ver;
+	size_t hash;
+	size_t i;
+
+	ver = inet_sroute_addr_bytes(addr, baddr);
+	if (ver != ip_v4 && ver != ip_v6)
+		return NULL;
 
-	inet_sroute_t *best = NULL;
-	uint8_t best_bits = 0;
+	hash = ver;
+	for (i = 0; i < sizeof(addr128_t); i++)
+		hash = hash_combine(hash, baddr[i]);
 
 	fibril_mutex_lock(&sroute_list_lock);
 
-	list_foreach(sroute_list, sroute_list, inet_sroute_t, sroute) {
-		uint8_t dest_bits;
-		ip_ver_t dest_ver = inet_naddr_get(&sroute->dest, NULL, NULL,
-		    &dest_bits);
-
-		/* Skip comparison with different address family */
-		if (addr_ver != dest_ver)
-			continue;
+	entry = &sroute_cache[hash & (SROUTE_CACHE_SIZE - 1)];
+	if (entry->gen == sroute_gen && inet_addr_compare(&entry->addr, addr)) {
+		best = entry->sroute;
+		fibril_mutex_unlock(&sroute_list_lock);
+		return best;
+	}
 
-		/* Look for the most specific route */
-		if ((best != NULL) && (best_bits >= dest_bits))
-			continue;
+	best = inet_sroute_lookup(ver, baddr);
 
-		if (inet_naddr_compare_mask(&sroute->dest, addr)) {
-			log_msg(LOG_DEFAULT, LVL_DEBUG, "inet_sroute_find: found candidate %p",
-			    sroute);
+	entry->addr = *addr;
+	entry->sroute = best;
+	entry->gen = sroute_gen;
 
-			best = sroute;
-			best_bits = dest_bits;
-		}
-	}
+	fibril_mutex_unlock(&sroute_list_lock);
 
-	if (best == NULL)
+	if (best != NULL) {
+		log_msg(LOG_DEFAULT, LVL_DEBUG, "inet_sroute_find: found %p",
+		    best);
+	} else {
 		log_msg(LOG_DEFAULT, LVL_DEBUG, "inet_sroute_find: Not found");
-
-	fibril_mutex_unlock(&sroute_list_lock);
+	}
 
 	return best;
 }
@@ -41,6 +41,7 @@
 #include <stdint.h>
 #include "inetsrv.h"
 
+extern errno_t inet_sroute_init(void);
 extern inet_sroute_t *inet_sroute_new(void);
 extern void inet_sroute_delete(inet_sroute_t *);
 extern void inet_sroute_add(inet_sroute_t *);
@@ -0,0 +1,215 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup tcp
+ * @{
+ */
+
+/**
+ * @file TCP congestion control
+ *
+ * Congestion control algorithms are implemented as instances of
+ * tcp_cc_ops_t. Each connection is assigned the default algorithm
+ * when it is created.
+ */
+
+#include <errno.h>
+#include <io/log.h>
+#include <macros.h>
+#include <str.h>
+#include "cc.h"
+#include "tcp_type.h"
+
+/** Available congestion control algorithms */
+static tcp_cc_ops_t *tcp_cc_algs[] = {
+	&tcp_cc_newreno,
+	NULL
+};
+
+/** Algorithm used for new connections */
+static tcp_cc_ops_t *tcp_cc_default = &tcp_cc_newreno;
+
+/** Find congestion control algorithm by name.
+ *
+ * @param name	Algorithm name
+ * @return	Algorithm or @c NULL if not found
+ */
+tcp_cc_ops_t *tcp_cc_find(const char *name)
+{
+	tcp_cc_ops_t **alg;
+
+	for (alg = tcp_cc_algs; *alg != NULL; alg++) {
+		if (str_cmp((*alg)->name, name) == 0)
+			return *alg;
+	}
+
+	return NULL;
+}
+
+/** Set congestion control algorithm used for new connections.
+ *
+ * @param name	Algorithm name
+ * @return	EOK on success, ENOENT if there is no such algorithm
+ */
+errno_t tcp_cc_set_default(const char *name)
+{
+	tcp_cc_ops_t *alg;
+
+	alg = tcp_cc_find(name);
+	if (alg == NULL)
+		return ENOENT;
+
+	tcp_cc_default = alg;
+	return EOK;
+}
+
+/** Set up congestion control for a connection.
+ *
+ * Uses the algorithm already assigned to the connection or the default
+ * algorithm if none is assigned. This is called again when the maximum
+ * segment size is determined during connection establishment.
+ *
+ * @param conn	Connection
+ */
+void tcp_cc_init(tcp_conn_t *conn)
+{
+	if (conn->cc == NULL)
+		conn->cc = tcp_cc_default;
+	else if (conn->cc->fini != NULL)
+		conn->cc->fini(conn);
+
+	conn->cwnd_acked = 0;
+	conn->cc->init(conn);
+
+	log_msg(LOG_DEFAULT, LVL_DEBUG, "%s: congestion control %s, "
+	    "cwnd=%" PRIu32, conn->name, conn->cc->name, conn->cwnd);
+}
+
+/** Release congestion control state of a connection.
+ *
+ * @param conn	Connection
+ */
+void tcp_cc_fini(tcp_conn_t *conn)
+{
+	if (conn->cc != NULL && conn->cc->fini != NULL)
+		conn->cc->fini(conn);
+	conn->cc_data = NULL;
+}
+
+/** New data has been acknowledged.
+ *
+ * @param conn	Connection
+ * @param acked	Number of newly acknowledged bytes (sequence numbers)
+ */
+void tcp_cc_ack_received(tcp_conn_t *conn, uint32_t acked)
+{
+	conn->cc->ack_received(conn, acked);
+}
+
+/** Retransmission timer expired.
+ *
+ * @param conn	Connection
+ */
+void tcp_cc_timeout(tcp_conn_t *conn)
+{
+	conn->cc->timeout(conn);
+	log_msg(LOG_DEFAULT, LVL_DEBUG, "%s: retransmission timeout, "
+	    "cwnd=%" PRIu32 " ssthresh=%" PRIu32, conn->name, conn->cwnd,
+	    conn->ssthresh);
+}
+
+/** Third duplicate ACK has been received, entering fast recovery.
+ *
+ * @param conn	Connection
+ */
+void tcp_cc_fast_retransmit(tcp_conn_t *conn)
+{
+	conn->cc->fast_retransmit(conn);
+	log_msg(LOG_DEFAULT, LVL_DEBUG, "%s: fast retransmit, "
+	    "cwnd=%" PRIu32 " ssthresh=%" PRIu32, conn->name, conn->cwnd,
+	    conn->ssthresh);
+}
+
+/** Additional duplicate ACK has been received during fast recovery.
+ *
+ * @param conn	Connection
+ */
+void tcp_cc_dup_ack(tcp_conn_t *conn)
+{
+	conn->cc->dup_ack(conn);
+}
+
+/** Part of the outstanding data has been acknowledged during fast recovery.
+ *
+ * @param conn	Connection
+ * @param acked	Number of newly acknowledged bytes
+ */
+void tcp_cc_partial_ack(tcp_conn_t *conn, uint32_t acked)
+{
+	conn->cc->partial_ack(conn, acked);
+}
+
+/** Fast recovery has finished.
+ *
+ * @param conn	Connection
+ */
+void tcp_cc_recovery_exit(tcp_conn_t *conn)
+{
+	conn->cc->recovery_exit(conn);
+	log_msg(LOG_DEFAULT, LVL_DEBUG, "%s: fast recovery done, "
+	    "cwnd=%" PRIu32, conn->name, conn->cwnd);
+}
+
+/** Compute initial congestion window (RFC 5681, section 3.1).
+ *
+ * @param conn	Connection
+ * @return	Initial window in bytes
+ */
+uint32_t tcp_cc_initial_window(tcp_conn_t *conn)
+{
+	uint32_t mss = conn->snd_mss;
+
+	if (mss > 2190)
+		return 2 * mss;
+	if (mss > 1095)
+		return 3 * mss;
+	return 4 * mss;
+}
+
+/** Amount of data that has been sent but not yet acknowledged.
+ *
+ * @param conn	Connection
+ * @return	Flight size in bytes (sequence numbers)
+ */
+uint32_t tcp_cc_flight_size(tcp_conn_t *conn)
+{
+	return conn->snd_nxt - conn->snd_una;
+}
+
+/** @}
+ */
@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup tcp
+ * @{
+ */
+
+/**
+ * @file NewReno congestion control
+ *
+ * Slow start and congestion avoidance as described in RFC 5681. Congestion
+ * avoidance uses appropriate byte counting (RFC 3465) so that the window grows
+ * by one segment per window of acknowledged data regardless of how the peer
+ * paces its acknowledgements. Fast recovery follows RFC 6582.
+ */
+
+#include <macros.h>
+#include <stdint.h>
+#include "cc.h"
+#include "tcp_type.h"
+
+static void tcp_newreno_init(tcp_conn_t *);
+static void tcp_newreno_ack_received(tcp_conn_t *, uint32_t);
+static void tcp_newreno_timeout(tcp_conn_t *);
+static void tcp_newreno_fast_retransmit(tcp_conn_t *);
+static void tcp_newreno_dup_ack(tcp_conn_t *);
+static void tcp_newreno_partial_ack(tcp_conn_t *, uint32_t);
+static void tcp_newreno_recovery_exit(tcp_conn_t *);
+
+tcp_cc_ops_t tcp_cc_newreno = {
+	.name = "newreno",
+	.init = tcp_newreno_init,
+	.ack_received = tcp_newreno_ack_received,
+	.timeout = tcp_newreno_timeout,
+	.fast_retransmit = tcp_newreno_fast_retransmit,
+	.dup_ack = tcp_newreno_dup_ack,
+	.partial_ack = tcp_newreno_partial_ack,
+	.recovery_exit = tcp_newreno_recovery_exit
+};
+
+/** Set up initial congestion state.
+ *
+ * @param conn	Connection
+ */
+static void tcp_newreno_init(tcp_conn_t *conn)
+{
+	conn->cwnd = tcp_cc_initial_window(conn);
+	/* Arbitrarily high, so that slow start is ended by loss only */
+	conn->ssthresh = UINT32_MAX;
+}
+
+/** New data has been acknowledged.
+ *
+ * @param conn	Connection
+ * @param acked	Number of newly acknowledged bytes
+ */
+static void tcp_newreno_ack_received(tcp_conn_t *conn, uint32_t acked)
+{
+	if (conn->cwnd < conn->ssthresh) {
+		/* Slow start */
+		conn->cwnd += min(acked, conn->snd_mss);
+		return;
+	}
+
+	/* Congestion avoidance */
+	conn->cwnd_acked += acked;
+	if (conn->cwnd_acked >= conn->cwnd) {
+		conn->cwnd_acked -= conn->cwnd;
+		conn->cwnd += conn->snd_mss;
+	}
+}
+
+/** Retransmission timer has expired.
+ *
+ * @param conn	Connection
+ */
+static void tcp_newreno_timeout(tcp_conn_t *conn)
+{
+	conn->ssthresh = max(tcp_cc_flight_size(conn) / 2, 2 * conn->snd_mss);
+	/* Loss window */
+	conn->cwnd = conn->snd_mss;
+	conn->cwnd_acked = 0;
+}
+
+/** Enter fast recovery.
+ *
+ * @param conn	Connection
+ */
+static void tcp_newreno_fast_retransmit(tcp_conn_t *conn)
+{
+	conn->ssthresh = max(tcp_cc_flight_size(conn) / 2, 2 * conn->snd_mss);
+	/* Inflate by the three segments that have left the network */
+	conn->cwnd = conn->ssthresh + 3 * conn->snd_mss;
+	conn->cwnd_acked = 0;
+}
+
+/** Duplicate ACK during fast recovery.
+ *
+ * @param conn	Connection
+ */
+static void tcp_newreno_dup_ack(tcp_conn_t *conn)
+{
+	/* Another segment has left the network */
+	conn->cwnd += conn->snd_mss;
+}
+
+/** Partial ACK during fast recovery.
+ *
+ * @param conn	Connection
+ * @param acked	Number of newly acknowledged bytes
+ */
+static void tcp_newreno_partial_ack(tcp_conn_t *conn, uint32_t acked)
+{
+	/* Deflate by the amount acked, add back one segment if possible */
+	conn->cwnd -= min(acked, conn->cwnd);
+	if (acked >= conn->snd_mss)
+		conn->cwnd += conn->snd_mss;
+	conn->cwnd = max(conn->cwnd, conn->snd_mss);
+}
+
+/** Leave fast recovery.
+ *
+ * @param conn	Connection
+ */
+static void tcp_newreno_recovery_exit(tcp_conn_t *conn)
+{
+	conn->cwnd = min(conn->ssthresh,
+	    max(tcp_cc_flight_size(conn), conn->snd_mss) + conn->snd_mss);
+}
+
+/** @}
+ */
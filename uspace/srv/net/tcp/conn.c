@@ -42,19 +42,20 @@
 #include <nettl/amap.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include "cc.h"
 #include "conn.h"
 #include "inet.h"
 #include "iqueue.h"
+#include "ncsim.h"
 #include "pdu.h"
 #include "rqueue.h"
 #include "segment.h"
 #include "seq_no.h"
+#include "std.h"
 #include "tcp_type.h"
 #include "tqueue.h"
 #include "ucall.h"
 
-#define RCV_BUF_SIZE 4096/*2*/
-#define SND_BUF_SIZE 4096
 
 #define MAX_SEGMENT_LIFETIME	(15*1000*1000) //(2*60*1000*1000)
 #define TIME_WAIT_TIMEOUT	(2*MAX_SEGMENT_LIFETIME)
@@ -71,6 +72,13 @@ static FIBRIL_MUTEX_INITIALIZE(amap_lock);
 /** Internal loopback configuration */
 tcp_lb_t tcp_conn_lb = tcp_lb_none;
 
+/** Initial receive buffer size */
+size_t tcp_conn_rcv_buf_size = 64 * 1024;
+/** Maximum size the receive buffer can be auto-tuned to */
+size_t tcp_conn_rcv_buf_max = 1024 * 1024;
+/** Send buffer size */
+size_t tcp_conn_snd_buf_size = 64 * 1024;
+
 static void tcp_conn_seg_process(tcp_conn_t *, tcp_segment_t *);
 static void tcp_conn_tw_timer_set(tcp_conn_t *);
 static void tcp_conn_tw_timer_clear(tcp_conn_t *);
@@ -132,7 +140,8 @@ tcp_conn_t *tcp_conn_new(inet_ep2_t *epp)
 
 	/* Allocate receive buffer */
 	fibril_condvar_initialize(&conn->rcv_buf_cv);
-	conn->rcv_buf_size = RCV_BUF_SIZE;
+	conn->rcv_buf_size = tcp_conn_rcv_buf_size;
+	conn->rcv_buf_max = max(tcp_conn_rcv_buf_max, conn->rcv_buf_size);
 	conn->rcv_buf_used = 0;
 	conn->rcv_buf_fin = false;
 
@@ -142,7 +151,7 @@ tcp_conn_t *tcp_conn_new(inet_ep2_t *epp)
 
 	/** Allocate send buffer */
 	fibril_condvar_initialize(&conn->snd_buf_cv);
-	conn->snd_buf_size = SND_BUF_SIZE;
+	conn->snd_buf_size = tcp_conn_snd_buf_size;
 	conn->snd_buf_used = 0;
 	conn->snd_buf_fin = false;
 	conn->snd_buf = calloc(1, conn->snd_buf_size);
@@ -152,6 +161,22 @@ tcp_conn_t *tcp_conn_new(inet_ep2_t *epp)
 	/* Set up receive window. */
 	conn->rcv_wnd = conn->rcv_buf_size;
 
+	/*
+	 * Choose window scale so that the receive window can cover the
+	 * buffer even after it has been grown to the maximum size.
+	 */
+	conn->rcv_wscale = 0;
+	while (conn->rcv_wscale < TCP_WSCALE_MAX &&
+	    (conn->rcv_buf_max >> conn->rcv_wscale) > 0xffff)
+		++conn->rcv_wscale;
+	conn->wscale_ok = true;
+	conn->snd_wscale = 0;
+	conn->sack_ok = true;
+
+	/* Set up congestion control until the peer's MSS is known */
+	conn->snd_mss = TCP_MSS_DEFAULT;
+	tcp_cc_init(conn);
+
 	/* Initialize incoming segment queue */
 	tcp_iqueue_init(&conn->incoming, conn);
 
@@ -216,6 +241,7 @@ static void tcp_conn_free(tcp_conn_t *conn)
 
 	assert(conn->mapped == false);
 	tcp_tqueue_fini(&conn->retransmit);
+	tcp_cc_fini(conn);
 
 	fibril_mutex_lock(&conn_list_lock);
 	list_remove(&conn->link);
@@ -511,6 +537,46 @@ bool tcp_conn_got_syn(tcp_conn_t *conn)
 	assert(false);
 }
 
+/** Process options in a received SYN segment.
+ *
+ * Window scaling and SACK are only used if both sides have sent
+ * the respective option in their SYN segments (RFC 7323, RFC 2018).
+ *
+ * @param conn		Connection
+ * @param seg		SYN segment
+ */
+static void tcp_conn_syn_opts(tcp_conn_t *conn, tcp_segment_t *seg)
+{
+	if (conn->wscale_ok && seg->wscale_present) {
+		conn->snd_wscale = min(seg->wscale, TCP_WSCALE_MAX);
+	} else {
+		conn->wscale_ok = false;
+		conn->snd_wscale = 0;
+		conn->rcv_wscale = 0;
+		/* Without scaling we cannot advertise more than 64 KiB */
+		conn->rcv_buf_max = min(conn->rcv_buf_max, 0xffff);
+		if (conn->rcv_buf_size > conn->rcv_buf_max) {
+			conn->rcv_wnd -= min(conn->rcv_wnd,
+			    conn->rcv_buf_size - conn->rcv_buf_max);
+			conn->rcv_buf_size = conn->rcv_buf_max;
+		}
+	}
+
+	if (!seg->sack_permitted)
+		conn->sack_ok = false;
+
+	conn->snd_mss = seg->mss != 0 ? min(seg->mss, TCP_MSS_LOCAL) :
+	    TCP_MSS_DEFAULT;
+
+	log_msg(LOG_DEFAULT, LVL_DEBUG, "%s: SND.MSS=%" PRIu32 ", "
+	    "Snd.Wind.Shift=%u, Rcv.Wind.Shift=%u, SACK=%d", conn->name,
+	    conn->snd_mss, conn->snd_wscale, conn->rcv_wscale,
+	    (int) conn->sack_ok);
+
+	/* Restart congestion control with the negotiated MSS */
+	tcp_cc_init(conn);
+}
+
 /** Segment arrived in Listen state.
  *
  * @param conn		Connection
@@ -540,6 +606,7 @@ static void tcp_conn_sa_listen(tcp_conn_t *conn, tcp_segment_t *seg)
 
 	conn->rcv_nxt = seg->seq + 1;
 	conn->irs = seg->seq;
+	tcp_conn_syn_opts(conn, seg);
 
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "rcv_nxt=%u", conn->rcv_nxt);
 
@@ -614,6 +681,7 @@ static void tcp_conn_sa_syn_sent(tcp_conn_t *conn, tcp_segment_t *seg)
 
 	conn->rcv_nxt = seg->seq + 1;
 	conn->irs = seg->seq;
+	tcp_conn_syn_opts(conn, seg);
 
 	if ((seg->ctrl & CTL_ACK) != 0) {
 		conn->snd_una = seg->ack;
@@ -684,6 +752,14 @@ static void tcp_conn_sa_queue(tcp_conn_t *conn, tcp_segment_t *seg)
 	 */
 	while (tcp_iqueue_get_ready_seg(&conn->incoming, &pseg) == EOK)
 		tcp_conn_seg_process(conn, pseg);
+
+	/*
+	 * Acknowledge out-of-order data immediately. The duplicate ACKs
+	 * allow the sender to detect the loss quickly (RFC 5681, section 4.2).
+	 */
+	if (!list_empty(&conn->incoming.list) && conn->cstate != st_closed &&
+	    tcp_conn_got_syn(conn))
+		tcp_tqueue_ctrl_seg(conn, CTL_ACK);
 }
 
 /** Process segment RST field.
@@ -802,6 +878,19 @@ static cproc_t tcp_conn_seg_proc_ack_sr(tcp_conn_t *conn, tcp_segment_t *seg)
 	return cp_continue;
 }
 
+/** Determine whether segment is a duplicate ACK in the sense of RFC 5681.
+ *
+ * @param conn		Connection
+ * @param seg		Segment
+ * @return		@c true if the segment is a duplicate ACK
+ */
+static bool tcp_conn_seg_is_dup_ack(tcp_conn_t *conn, tcp_segment_t *seg)
+{
+	return seg->ack == conn->snd_una && seg->len == 0 &&
+	    conn->snd_una != conn->snd_nxt &&
+	    ((uint32_t) seg->wnd << conn->snd_wscale) == conn->snd_wnd;
+}
+
 /** Process segment ACK field in Established state.
  *
  * @param conn		Connection
@@ -811,6 +900,9 @@ static cproc_t tcp_conn_seg_proc_ack_sr(tcp_conn_t *conn, tcp_segment_t *seg)
  */
 static cproc_t tcp_conn_seg_proc_ack_est(tcp_conn_t *conn, tcp_segment_t *seg)
 {
+	uint32_t acked;
+	bool dup_ack = false;
+
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "tcp_conn_seg_proc_ack_est(%p, %p)", conn, seg);
 
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "SEG.ACK=%u, SND.UNA=%u, SND.NXT=%u",
@@ -827,15 +919,28 @@ static cproc_t tcp_conn_seg_proc_ack_est(tcp_conn_t *conn, tcp_segment_t *seg)
 			tcp_segment_delete(seg);
 			return cp_done;
 		} else {
-			log_msg(LOG_DEFAULT, LVL_DEBUG, "Ignoring duplicate ACK.");
+			dup_ack = tcp_conn_seg_is_dup_ack(conn, seg);
+			log_msg(LOG_DEFAULT, LVL_DEBUG, "Duplicate ACK (%s).",
+			    dup_ack ? "counted" : "ignored");
 		}
 	} else {
 		/* Update SND.UNA */
+		acked = seg->ack - conn->snd_una;
 		conn->snd_una = seg->ack;
+
+		/* Update congestion and loss recovery state */
+		tcp_tqueue_new_ack(conn, acked);
 	}
 
+	if (conn->sack_ok && seg->sack_cnt > 0)
+		tcp_tqueue_sack_received(conn, seg);
+
+	if (dup_ack)
+		tcp_tqueue_dup_ack(conn);
+
 	if (seq_no_new_wnd_update(conn, seg)) {
-		conn->snd_wnd = seg->wnd;
+		/* Window in segments other than SYN is scaled */
+		conn->snd_wnd = (uint32_t) seg->wnd << conn->snd_wscale;
 		conn->snd_wl1 = seg->seq;
 		conn->snd_wl2 = seg->ack;
 
@@ -1079,6 +1184,14 @@ static cproc_t tcp_conn_seg_proc_text(tcp_conn_t *conn, tcp_segment_t *seg)
 	/* Update receive window. XXX Not an efficient strategy. */
 	conn->rcv_wnd -= xfer_size;
 
+	/*
+	 * If the sender has filled most of the window, the buffer is what
+	 * limits throughput. Let the receive side know it may grow it.
+	 */
+	if (conn->rcv_buf_size < conn->rcv_buf_max &&
+	    conn->rcv_wnd < conn->rcv_buf_size / 4)
+		conn->rcv_wnd_limited = true;
+
 	/* Send ACK */
 	if (xfer_size > 0)
 		tcp_tqueue_ctrl_seg(conn, CTL_ACK);
@@ -1409,11 +1522,20 @@ static void tcp_transmit_segment(inet_ep2_t *epp, tcp_segment_t *seg)
 
 	tcp_segment_dump(seg);
 
+	if (tcp_conn_lb == tcp_lb_ncsim) {
+		/* Loop back segment through network condition simulator */
+		dseg = tcp_segment_dup(seg);
+		if (dseg == NULL) {
+			log_msg(LOG_DEFAULT, LVL_WARN, "Not enough memory. Segment dropped.");
+			return;
+		}
+
+		tcp_ncsim_bounce_seg(epp, dseg);
+		return;
+	}
+
 	if (tcp_conn_lb == tcp_lb_segment) {
 		/* Loop back segment */
-#if 0
-		tcp_ncsim_bounce_seg(sp, seg);
-#endif
 
 		/* Reverse the identification */
 		tcp_ep2_flipped(epp, &rident);
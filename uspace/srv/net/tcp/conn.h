@@ -39,6 +39,9 @@
 #include <stdbool.h>
 #include "tcp_type.h"
 
+/** Maximum segment size we announce and send */
+#define TCP_MSS_LOCAL 1460
+
 extern errno_t tcp_conns_init(void);
 extern void tcp_conns_fini(void);
 extern tcp_conn_t *tcp_conn_new(inet_ep2_t *);
@@ -59,6 +62,9 @@ extern void tcp_unexpected_segment(inet_ep2_t *, tcp_segment_t *);
 extern void tcp_ep2_flipped(inet_ep2_t *, inet_ep2_t *);
 
 extern tcp_lb_t tcp_conn_lb;
+extern size_t tcp_conn_rcv_buf_size;
+extern size_t tcp_conn_rcv_buf_max;
+extern size_t tcp_conn_snd_buf_size;
 
 #endif
 
@@ -186,6 +186,49 @@ errno_t tcp_iqueue_get_ready_seg(tcp_iqueue_t *iqueue, tcp_segment_t **seg)
 	return EOK;
 }
 
+/** Describe queued out-of-order data as SACK blocks.
+ *
+ * Contiguous and overlapping segments are merged into a single block.
+ * Blocks are listed in sequence order.
+ *
+ * @param iqueue	Incoming queue
+ * @param blocks	Array to fill in
+ * @param max		Maximum number of blocks
+ * @return		Number of blocks filled in
+ */
+unsigned tcp_iqueue_sack_blocks(tcp_iqueue_t *iqueue, tcp_sack_block_t *blocks,
+    unsigned max)
+{
+	uint32_t rcv_nxt = iqueue->conn->rcv_nxt;
+	uint32_t start, end;
+	unsigned cnt = 0;
+
+	list_foreach(iqueue->list, link, tcp_iqueue_entry_t, iqe) {
+		start = iqe->seg->seq;
+		end = iqe->seg->seq + iqe->seg->len;
+
+		/* Only data above RCV.NXT is of interest */
+		if (iqe->seg->len == 0 || !seq_no_gteq(start, rcv_nxt + 1))
+			continue;
+
+		if (cnt > 0 && seq_no_gteq(blocks[cnt - 1].end, start)) {
+			/* Extend previous block */
+			if (seq_no_gteq(end, blocks[cnt - 1].end))
+				blocks[cnt - 1].end = end;
+			continue;
+		}
+
+		if (cnt >= max)
+			break;
+
+		blocks[cnt].start = start;
+		blocks[cnt].end = end;
+		++cnt;
+	}
+
+	return cnt;
+}
+
 /**
  * @}
  */
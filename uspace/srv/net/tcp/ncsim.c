@@ -45,6 +45,8 @@
 #include <io/log.h>
 #include <stdlib.h>
 #include <fibril.h>
+#include <macros.h>
+#include <time.h>
 #include "conn.h"
 #include "ncsim.h"
 #include "rqueue.h"
@@ -54,19 +56,65 @@
 static list_t sim_queue;
 static fibril_mutex_t sim_queue_lock;
 static fibril_condvar_t sim_queue_cv;
+static bool sim_active;
+static bool sim_stop;
+static tcp_ncsim_conf_t sim_conf;
 
-/** Initialize segment receive queue. */
+/** Initialize network condition simulator. */
 void tcp_ncsim_init(void)
 {
 	list_initialize(&sim_queue);
 	fibril_mutex_initialize(&sim_queue_lock);
 	fibril_condvar_initialize(&sim_queue_cv);
+	sim_active = false;
+	sim_stop = false;
+	sim_conf.delay_min = 0;
+	sim_conf.delay_max = 0;
+	sim_conf.drop_pct = 0;
+}
+
+/** Finalize network condition simulator.
+ *
+ * Stops the handler fibril and discards any segments still in flight.
+ */
+void tcp_ncsim_fini(void)
+{
+	tcp_squeue_entry_t *sqe;
+	link_t *link;
+
+	fibril_mutex_lock(&sim_queue_lock);
+	sim_stop = true;
+	fibril_condvar_broadcast(&sim_queue_cv);
+	while (sim_active)
+		fibril_condvar_wait(&sim_queue_cv, &sim_queue_lock);
+
+	while ((link = list_first(&sim_queue)) != NULL) {
+		sqe = list_get_instance(link, tcp_squeue_entry_t, link);
+		list_remove(link);
+		tcp_segment_delete(sqe->seg);
+		free(sqe);
+	}
+
+	fibril_mutex_unlock(&sim_queue_lock);
+}
+
+/** Configure simulated network conditions.
+ *
+ * @param conf	Configuration (copied)
+ */
+void tcp_ncsim_configure(tcp_ncsim_conf_t *conf)
+{
+	fibril_mutex_lock(&sim_queue_lock);
+	sim_conf = *conf;
+	if (sim_conf.delay_max < sim_conf.delay_min)
+		sim_conf.delay_max = sim_conf.delay_min;
+	fibril_mutex_unlock(&sim_queue_lock);
 }
 
 /** Bounce segment through simulator into receive queue.
  *
  * @param epp	Endpoint pair, oriented for transmission
- * @param seg	Segment
+ * @param seg	Segment (ownership transferred to simulator)
  */
 void tcp_ncsim_bounce_seg(inet_ep2_t *epp, tcp_segment_t *seg)
 {
@@ -74,48 +122,61 @@ void tcp_ncsim_bounce_seg(inet_ep2_t *epp, tcp_segment_t *seg)
 	tcp_squeue_entry_t *old_qe;
 	inet_ep2_t rident;
 	link_t *link;
+	usec_t delay;
 
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "tcp_ncsim_bounce_seg()");
-	tcp_ep2_flipped(epp, &rident);
-	tcp_rqueue_insert_seg(&rident, seg);
-	return;
 
-	if (0 /*rand() % 4 == 3*/) {
+	fibril_mutex_lock(&sim_queue_lock);
+
+	if (sim_conf.drop_pct > 0 &&
+	    (unsigned) (rand() % 100) < sim_conf.drop_pct) {
 		/* Drop segment */
-		log_msg(LOG_DEFAULT, LVL_ERROR, "NCSim dropping segment");
+		fibril_mutex_unlock(&sim_queue_lock);
+		log_msg(LOG_DEFAULT, LVL_DEBUG, "NCSim dropping segment");
 		tcp_segment_delete(seg);
 		return;
 	}
 
+	delay = sim_conf.delay_min;
+	if (sim_conf.delay_max > sim_conf.delay_min) {
+		delay += (usec_t) rand() %
+		    (sim_conf.delay_max - sim_conf.delay_min + 1);
+	}
+
+	if (delay == 0 || !sim_active) {
+		/* Deliver immediately */
+		fibril_mutex_unlock(&sim_queue_lock);
+		tcp_ep2_flipped(epp, &rident);
+		tcp_rqueue_insert_seg(&rident, seg);
+		return;
+	}
+
 	sqe = calloc(1, sizeof(tcp_squeue_entry_t));
 	if (sqe == NULL) {
+		fibril_mutex_unlock(&sim_queue_lock);
 		log_msg(LOG_DEFAULT, LVL_ERROR, "Failed allocating SQE.");
+		tcp_segment_delete(seg);
 		return;
 	}
 
-	sqe->delay = rand() % (1000 * 1000);
+	getuptime(&sqe->due);
+	ts_add_diff(&sqe->due, USEC2NSEC(delay));
 	sqe->epp = *epp;
 	sqe->seg = seg;
 
-	fibril_mutex_lock(&sim_queue_lock);
-
-	link = list_first(&sim_queue);
-	while (link != NULL && sqe->delay > 0) {
+	/* Keep the queue sorted by due time */
+	link = list_last(&sim_queue);
+	while (link != NULL) {
 		old_qe = list_get_instance(link, tcp_squeue_entry_t, link);
-		if (sqe->delay < old_qe->delay)
+		if (ts_gteq(&sqe->due, &old_qe->due))
 			break;
-
-		sqe->delay -= old_qe->delay;
-
-		link = link->next;
-		if (link == &sim_queue.head)
-			link = NULL;
+		link = list_prev(link, &sim_queue);
 	}
 
 	if (link != NULL)
 		list_insert_after(&sqe->link, link);
 	else
-		list_append(&sqe->link, &sim_queue);
+		list_prepend(&sqe->link, &sim_queue);
 
 	fibril_condvar_broadcast(&sim_queue_cv);
 	fibril_mutex_unlock(&sim_queue_lock);
@@ -127,35 +188,47 @@ static errno_t tcp_ncsim_fibril(void *arg)
 	link_t *link;
 	tcp_squeue_entry_t *sqe;
 	inet_ep2_t rident;
-	errno_t rc;
+	struct timespec now;
+	nsec_t wait;
 
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "tcp_ncsim_fibril()");
 
-	while (true) {
-		fibril_mutex_lock(&sim_queue_lock);
+	fibril_mutex_lock(&sim_queue_lock);
 
-		while (list_empty(&sim_queue))
+	while (!sim_stop) {
+		link = list_first(&sim_queue);
+		if (link == NULL) {
 			fibril_condvar_wait(&sim_queue_cv, &sim_queue_lock);
+			continue;
+		}
 
-		do {
-			link = list_first(&sim_queue);
-			sqe = list_get_instance(link, tcp_squeue_entry_t, link);
+		sqe = list_get_instance(link, tcp_squeue_entry_t, link);
 
-			log_msg(LOG_DEFAULT, LVL_DEBUG, "NCSim - Sleep");
-			rc = fibril_condvar_wait_timeout(&sim_queue_cv,
-			    &sim_queue_lock, sqe->delay);
-		} while (rc != ETIMEOUT);
+		getuptime(&now);
+		if (ts_gt(&sqe->due, &now)) {
+			/* Sleep until the segment is due or the queue changes */
+			wait = ts_sub_diff(&sqe->due, &now);
+			(void) fibril_condvar_wait_timeout(&sim_queue_cv,
+			    &sim_queue_lock, max(NSEC2USEC(wait), 1));
+			continue;
+		}
 
 		list_remove(link);
 		fibril_mutex_unlock(&sim_queue_lock);
 
-		log_msg(LOG_DEFAULT, LVL_DEBUG, "NCSim - End Sleep");
 		tcp_ep2_flipped(&sqe->epp, &rident);
 		tcp_rqueue_insert_seg(&rident, sqe->seg);
 		free(sqe);
+
+		fibril_mutex_lock(&sim_queue_lock);
 	}
 
-	/* Not reached */
+	log_msg(LOG_DEFAULT, LVL_DEBUG2, "tcp_ncsim_fibril() exiting");
+
+	sim_active = false;
+	fibril_condvar_broadcast(&sim_queue_cv);
+	fibril_mutex_unlock(&sim_queue_lock);
+
 	return 0;
 }
 
@@ -172,6 +245,11 @@ void tcp_ncsim_fibril_start(void)
 		return;
 	}
 
+	fibril_mutex_lock(&sim_queue_lock);
+	sim_active = true;
+	sim_stop = false;
+	fibril_mutex_unlock(&sim_queue_lock);
+
 	fibril_add_ready(fid);
 }
 
@@ -39,6 +39,8 @@
 #include "tcp_type.h"
 
 extern void tcp_ncsim_init(void);
+extern void tcp_ncsim_fini(void);
+extern void tcp_ncsim_configure(tcp_ncsim_conf_t *);
 extern void tcp_ncsim_bounce_seg(inet_ep2_t *, tcp_segment_t *);
 extern void tcp_ncsim_fibril_start(void);
 
@@ -34,10 +34,12 @@
  * @file TCP header encoding and decoding
  */
 
+#include <align.h>
 #include <bitops.h>
 #include <byteorder.h>
 #include <errno.h>
 #include <inet/endpoint.h>
+#include <macros.h>
 #include <mem.h>
 #include <stdlib.h>
 #include "pdu.h"
@@ -125,7 +127,162 @@ static void tcp_header_encode_flags(tcp_control_t ctl, uint16_t doff_flags0,
 	*rdoff_flags = doff_flags;
 }
 
-static void tcp_header_setup(inet_ep2_t *epp, tcp_segment_t *seg, tcp_header_t *hdr)
+/** Compute size of options that need to be encoded with a segment.
+ *
+ * @param seg	Segment
+ * @return	Size of encoded options in bytes (multiple of four)
+ */
+static size_t tcp_header_opts_size(tcp_segment_t *seg)
+{
+	size_t size = 0;
+
+	if (seg->mss != 0)
+		size += OPT_MAX_SEG_SIZE_LEN;
+	if (seg->wscale_present)
+		size += 1 + OPT_WINDOW_SCALE_LEN; /* preceded by NOP */
+	if (seg->sack_permitted)
+		size += 2 + OPT_SACK_PERMITTED_LEN; /* preceded by 2 NOPs */
+	if (seg->sack_cnt > 0) {
+		/* preceded by 2 NOPs */
+		size += 2 + OPT_SACK_LEN + seg->sack_cnt * OPT_SACK_BLOCK_LEN;
+	}
+
+	return ROUND_UP(size, sizeof(uint32_t));
+}
+
+/** Encode 32-bit option field in network byte order. */
+static void tcp_opt_encode_uint32(uint32_t val, uint8_t *buf)
+{
+	buf[0] = val >> 24;
+	buf[1] = (val >> 16) & 0xff;
+	buf[2] = (val >> 8) & 0xff;
+	buf[3] = val & 0xff;
+}
+
+/** Decode 32-bit option field in network byte order. */
+static uint32_t tcp_opt_decode_uint32(uint8_t *buf)
+{
+	return ((uint32_t) buf[0] << 24) | ((uint32_t) buf[1] << 16) |
+	    ((uint32_t) buf[2] << 8) | buf[3];
+}
+
+/** Encode segment options.
+ *
+ * @param seg	Segment
+ * @param opts	Buffer of tcp_header_opts_size() bytes to fill in
+ */
+static void tcp_header_opts_encode(tcp_segment_t *seg, uint8_t *opts)
+{
+	size_t i = 0;
+	unsigned j;
+
+	if (seg->mss != 0) {
+		opts[i++] = OPT_MAX_SEG_SIZE;
+		opts[i++] = OPT_MAX_SEG_SIZE_LEN;
+		opts[i++] = seg->mss >> 8;
+		opts[i++] = seg->mss & 0xff;
+	}
+
+	if (seg->wscale_present) {
+		opts[i++] = OPT_NOP;
+		opts[i++] = OPT_WINDOW_SCALE;
+		opts[i++] = OPT_WINDOW_SCALE_LEN;
+		opts[i++] = seg->wscale;
+	}
+
+	if (seg->sack_permitted) {
+		opts[i++] = OPT_NOP;
+		opts[i++] = OPT_NOP;
+		opts[i++] = OPT_SACK_PERMITTED;
+		opts[i++] = OPT_SACK_PERMITTED_LEN;
+	}
+
+	if (seg->sack_cnt > 0) {
+		opts[i++] = OPT_NOP;
+		opts[i++] = OPT_NOP;
+		opts[i++] = OPT_SACK;
+		opts[i++] = OPT_SACK_LEN + seg->sack_cnt * OPT_SACK_BLOCK_LEN;
+		for (j = 0; j < seg->sack_cnt; j++) {
+			tcp_opt_encode_uint32(seg->sack[j].start, opts + i);
+			tcp_opt_encode_uint32(seg->sack[j].end, opts + i + 4);
+			i += OPT_SACK_BLOCK_LEN;
+		}
+	}
+
+	while (i % sizeof(uint32_t) != 0)
+		opts[i++] = OPT_END_LIST;
+}
+
+/** Decode segment options.
+ *
+ * Unknown options are skipped, malformed option list is ignored from
+ * the first malformed option on.
+ *
+ * @param opts	Encoded options
+ * @param size	Size of encoded options in bytes
+ * @param seg	Segment where to store decoded options
+ */
+static void tcp_header_opts_decode(uint8_t *opts, size_t size,
+    tcp_segment_t *seg)
+{
+	size_t i = 0;
+	uint8_t olen;
+	uint8_t *blk;
+	unsigned cnt, j;
+
+	while (i < size) {
+		if (opts[i] == OPT_END_LIST)
+			break;
+		if (opts[i] == OPT_NOP) {
+			i++;
+			continue;
+		}
+
+		if (i + 1 >= size)
+			break;
+		olen = opts[i + 1];
+		if (olen < 2 || i + olen > size)
+			break;
+
+		switch (opts[i]) {
+		case OPT_MAX_SEG_SIZE:
+			if (olen == OPT_MAX_SEG_SIZE_LEN)
+				seg->mss = ((uint16_t) opts[i + 2] << 8) |
+				    opts[i + 3];
+			break;
+		case OPT_WINDOW_SCALE:
+			if (olen == OPT_WINDOW_SCALE_LEN) {
+				seg->wscale_present = true;
+				seg->wscale = min(opts[i + 2], TCP_WSCALE_MAX);
+			}
+			break;
+		case OPT_SACK_PERMITTED:
+			if (olen == OPT_SACK_PERMITTED_LEN)
+				seg->sack_permitted = true;
+			break;
+		case OPT_SACK:
+			if ((olen - OPT_SACK_LEN) % OPT_SACK_BLOCK_LEN != 0)
+				break;
+			cnt = min((olen - OPT_SACK_LEN) / OPT_SACK_BLOCK_LEN,
+			    TCP_SACK_BLOCKS_MAX);
+			for (j = 0; j < cnt; j++) {
+				blk = opts + i + OPT_SACK_LEN +
+				    j * OPT_SACK_BLOCK_LEN;
+				seg->sack[j].start = tcp_opt_decode_uint32(blk);
+				seg->sack[j].end = tcp_opt_decode_uint32(blk + 4);
+			}
+			seg->sack_cnt = cnt;
+			break;
+		default:
+			break;
+		}
+
+		i += olen;
+	}
+}
+
+static void tcp_header_setup(inet_ep2_t *epp, tcp_segment_t *seg,
+    tcp_header_t *hdr, size_t hdr_size)
 {
 	uint16_t doff_flags;
 	uint16_t doff;
@@ -135,7 +292,7 @@ static void tcp_header_setup(inet_ep2_t *epp, tcp_segment_t *seg, tcp_header_t *
 	hdr->seq = host2uint32_t_be(seg->seq);
 	hdr->ack = host2uint32_t_be(seg->ack);
 
-	doff = (sizeof(tcp_header_t) / sizeof(uint32_t)) << DF_DATA_OFFSET_l;
+	doff = (hdr_size / sizeof(uint32_t)) << DF_DATA_OFFSET_l;
 	tcp_header_encode_flags(seg->ctrl, doff, &doff_flags);
 
 	hdr->doff_flags = host2uint16_t_be(doff_flags);
@@ -194,14 +351,18 @@ static errno_t tcp_header_encode(inet_ep2_t *epp, tcp_segment_t *seg,
     void **header, size_t *size)
 {
 	tcp_header_t *hdr;
+	size_t hdr_size;
+
+	hdr_size = sizeof(tcp_header_t) + tcp_header_opts_size(seg);
 
-	hdr = calloc(1, sizeof(tcp_header_t));
+	hdr = calloc(1, hdr_size);
 	if (hdr == NULL)
 		return ENOMEM;
 
-	tcp_header_setup(epp, seg, hdr);
+	tcp_header_setup(epp, seg, hdr, hdr_size);
+	tcp_header_opts_encode(seg, (uint8_t *) (hdr + 1));
 	*header = hdr;
-	*size = sizeof(tcp_header_t);
+	*size = hdr_size;
 
 	return EOK;
 }
@@ -308,6 +469,11 @@ errno_t tcp_pdu_decode(tcp_pdu_t *pdu, inet_ep2_t *epp, tcp_segment_t **seg)
 
 	hdr = (tcp_header_t *)pdu->header;
 
+	if (pdu->header_size > sizeof(tcp_header_t)) {
+		tcp_header_opts_decode((uint8_t *) (hdr + 1),
+		    pdu->header_size - sizeof(tcp_header_t), nseg);
+	}
+
 	epp->local.port = uint16_t_be2host(hdr->dest_port);
 	epp->local.addr = pdu->dest;
 	epp->remote.port = uint16_t_be2host(hdr->src_port);
@@ -74,6 +74,12 @@ tcp_segment_t *tcp_segment_dup(tcp_segment_t *seg)
 	scopy->len = seg->len;
 	scopy->wnd = seg->wnd;
 	scopy->up = seg->up;
+	scopy->mss = seg->mss;
+	scopy->wscale_present = seg->wscale_present;
+	scopy->wscale = seg->wscale;
+	scopy->sack_permitted = seg->sack_permitted;
+	scopy->sack_cnt = seg->sack_cnt;
+	memcpy(scopy->sack, seg->sack, sizeof(seg->sack));
 
 	tsize = tcp_segment_text_size(seg);
 	scopy->data = calloc(tsize, 1);
@@ -247,6 +253,8 @@ size_t tcp_segment_text_size(tcp_segment_t *seg)
  */
 void tcp_segment_dump(tcp_segment_t *seg)
 {
+	unsigned i;
+
 	log_msg(LOG_DEFAULT, LVL_DEBUG2, "Segment dump:");
 	log_msg(LOG_DEFAULT, LVL_DEBUG2, " - ctrl = %u", (unsigned)seg->ctrl);
 	log_msg(LOG_DEFAULT, LVL_DEBUG2, " - seq = %" PRIu32, seg->seq);
@@ -254,6 +262,16 @@ void tcp_segment_dump(tcp_segment_t *seg)
 	log_msg(LOG_DEFAULT, LVL_DEBUG2, " - len = %" PRIu32, seg->len);
 	log_msg(LOG_DEFAULT, LVL_DEBUG2, " - wnd = %" PRIu32, seg->wnd);
 	log_msg(LOG_DEFAULT, LVL_DEBUG2, " - up = %" PRIu32, seg->up);
+	if (seg->mss != 0)
+		log_msg(LOG_DEFAULT, LVL_DEBUG2, " - mss = %u", seg->mss);
+	if (seg->wscale_present)
+		log_msg(LOG_DEFAULT, LVL_DEBUG2, " - wscale = %u", seg->wscale);
+	if (seg->sack_permitted)
+		log_msg(LOG_DEFAULT, LVL_DEBUG2, " - sack permitted");
+	for (i = 0; i < seg->sack_cnt; i++) {
+		log_msg(LOG_DEFAULT, LVL_DEBUG2, " - sack %" PRIu32 "-%" PRIu32,
+		    seg->sack[i].start, seg->sack[i].end);
+	}
 }
 
 /**
@@ -249,6 +249,33 @@ void seq_no_seg_trim_calc(tcp_conn_t *conn, tcp_segment_t *seg,
 	}
 }
 
+/** Determine whether segment is fully covered by a SACK block.
+ *
+ * @param seg	Segment
+ * @param blk	SACK block
+ * @return	@c true if the whole segment lies within the block
+ */
+bool seq_no_segment_sacked(tcp_segment_t *seg, tcp_sack_block_t *blk)
+{
+	assert(seg->len > 0);
+	return seq_no_le_lt(blk->start, seg->seq, blk->end) &&
+	    seq_no_lt_le(blk->start, seg->seq + seg->len, blk->end);
+}
+
+/** Determine whether sequence number is later or equal to another.
+ *
+ * Like seq_no_ack_duplicate() this is based on the difference of the
+ * two numbers, with [0, 2^31) meaning greater than or equal.
+ *
+ * @param a	Sequence number
+ * @param b	Sequence number
+ * @return	@c true if @a a >= @a b
+ */
+bool seq_no_gteq(uint32_t a, uint32_t b)
+{
+	return ((a - b) & (UINT32_C(1) << 31)) == 0;
+}
+
 /** Segment order comparison.
  *
  * Compare sequence order of two acceptable segments.
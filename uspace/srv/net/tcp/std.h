@@ -109,9 +109,35 @@ enum opt_kind {
 	/** No-operation */
 	OPT_NOP			= 1,
 	/** Maximum segment size */
-	OPT_MAX_SEG_SIZE	= 2
+	OPT_MAX_SEG_SIZE	= 2,
+	/** Window scale */
+	OPT_WINDOW_SCALE	= 3,
+	/** SACK permitted */
+	OPT_SACK_PERMITTED	= 4,
+	/** SACK */
+	OPT_SACK		= 5
 };
 
+/** Option lengths (including kind and length bytes) */
+enum opt_len {
+	OPT_MAX_SEG_SIZE_LEN	= 4,
+	OPT_WINDOW_SCALE_LEN	= 3,
+	OPT_SACK_PERMITTED_LEN	= 2,
+	/** SACK option length without blocks */
+	OPT_SACK_LEN		= 2,
+	/** Length of one SACK block */
+	OPT_SACK_BLOCK_LEN	= 8
+};
+
+/** Maximum window scale shift count (RFC 7323) */
+#define TCP_WSCALE_MAX	14
+
+/** MSS assumed when the peer does not announce one */
+#define TCP_MSS_DEFAULT	536
+
+/** Maximum size of TCP header including options */
+#define TCP_HEADER_MAX_SIZE	60
+
 #endif
 
 /** @}
@@ -38,8 +38,10 @@
 #include <errno.h>
 #include <io/log.h>
 #include <stdio.h>
+#include <str.h>
 #include <task.h>
 
+#include "cc.h"
 #include "conn.h"
 #include "inet.h"
 #include "ncsim.h"
@@ -54,6 +56,73 @@ static tcp_rqueue_cb_t tcp_rqueue_cb = {
 	.seg_received = tcp_as_segment_arrived
 };
 
+static void usage(void)
+{
+	printf("Usage: " NAME " [<options>]\n");
+	printf("Options:\n");
+	printf("  --rcvbuf <bytes>      Initial receive buffer size\n");
+	printf("  --rcvbuf-max <bytes>  Maximum (auto-tuned) receive buffer size\n");
+	printf("  --sndbuf <bytes>      Send buffer size\n");
+	printf("  --cc <name>           Congestion control algorithm\n");
+}
+
+/** Parse a buffer size argument.
+ *
+ * @param arg	Argument string
+ * @param rsize	Place to store size
+ * @return	EOK on success, EINVAL if the argument is not a valid size
+ */
+static errno_t tcp_parse_size(const char *arg, size_t *rsize)
+{
+	size_t size;
+	errno_t rc;
+
+	rc = str_size_t(arg, NULL, 10, true, &size);
+	if (rc != EOK || size == 0)
+		return EINVAL;
+
+	*rsize = size;
+	return EOK;
+}
+
+/** Parse command-line options.
+ *
+ * @param argc	Number of arguments
+ * @param argv	Arguments
+ * @return	EOK on success, EINVAL on invalid syntax
+ */
+static errno_t tcp_parse_args(int argc, char **argv)
+{
+	errno_t rc;
+	int i;
+
+	for (i = 1; i < argc; i++) {
+		if (i + 1 >= argc)
+			return EINVAL;
+
+		if (str_cmp(argv[i], "--rcvbuf") == 0) {
+			rc = tcp_parse_size(argv[++i], &tcp_conn_rcv_buf_size);
+		} else if (str_cmp(argv[i], "--rcvbuf-max") == 0) {
+			rc = tcp_parse_size(argv[++i], &tcp_conn_rcv_buf_max);
+		} else if (str_cmp(argv[i], "--sndbuf") == 0) {
+			rc = tcp_parse_size(argv[++i], &tcp_conn_snd_buf_size);
+		} else if (str_cmp(argv[i], "--cc") == 0) {
+			rc = tcp_cc_set_default(argv[++i]);
+			if (rc != EOK) {
+				printf(NAME ": Unknown congestion control "
+				    "algorithm '%s'.\n", argv[i]);
+			}
+		} else {
+			rc = EINVAL;
+		}
+
+		if (rc != EOK)
+			return EINVAL;
+	}
+
+	return EOK;
+}
+
 static errno_t tcp_init(void)
 {
 	errno_t rc;
@@ -101,6 +170,12 @@ int main(int argc, char **argv)
 		return 1;
 	}
 
+	rc = tcp_parse_args(argc, argv);
+	if (rc != EOK) {
+		usage();
+		return 1;
+	}
+
 	rc = tcp_init();
 	if (rc != EOK)
 		return 1;
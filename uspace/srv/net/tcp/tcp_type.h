@@ -45,6 +45,7 @@
 #include <stdint.h>
 #include <inet/addr.h>
 #include <inet/endpoint.h>
+#include <time.h>
 
 struct tcp_conn;
 
@@ -120,6 +121,17 @@ typedef enum {
 	CTL_ACK		= 0x8
 } tcp_control_t;
 
+/** Maximum number of SACK blocks in a segment */
+#define TCP_SACK_BLOCKS_MAX 3
+
+/** SACK block (RFC 2018) */
+typedef struct {
+	/** First sequence number of the block */
+	uint32_t start;
+	/** Sequence number immediately following the block */
+	uint32_t end;
+} tcp_sack_block_t;
+
 /** Connection incoming segments queue */
 typedef struct {
 	struct tcp_conn *conn;
@@ -169,6 +181,19 @@ typedef struct {
 	/** Segment urgent pointer */
 	uint32_t up;
 
+	/** Maximum segment size option value, zero if not present */
+	uint16_t mss;
+	/** Window scale option is present */
+	bool wscale_present;
+	/** Window scale option shift count */
+	uint8_t wscale;
+	/** SACK-permitted option is present */
+	bool sack_permitted;
+	/** Number of SACK blocks */
+	unsigned sack_cnt;
+	/** SACK blocks */
+	tcp_sack_block_t sack[TCP_SACK_BLOCKS_MAX];
+
 	/** Segment data, may be moved when trimming segment */
 	void *data;
 	/** Segment data, original pointer used to free data */
@@ -191,7 +216,8 @@ typedef struct {
 /** NCSim queue entry */
 typedef struct {
 	link_t link;
-	usec_t delay;
+	/** Time when the segment should be delivered */
+	struct timespec due;
 	inet_ep2_t epp;
 	tcp_segment_t *seg;
 } tcp_squeue_entry_t;
@@ -207,6 +233,14 @@ typedef struct {
 	link_t link;
 	tcp_conn_t *conn;
 	tcp_segment_t *seg;
+	/** Time when the segment was last transmitted */
+	struct timespec sent;
+	/** Segment has been retransmitted (not usable for RTT sampling) */
+	bool retransmitted;
+	/** Segment has been retransmitted during current loss recovery */
+	bool recovery_rexmit;
+	/** Segment has been selectively acknowledged by the peer */
+	bool sacked;
 } tcp_tqueue_entry_t;
 
 /** Retransmission queue callbacks */
@@ -225,8 +259,59 @@ typedef struct {
 
 	/** Callbacks */
 	tcp_tqueue_cb_t *cb;
+
+	/** We have at least one RTT measurement */
+	bool rtt_valid;
+	/** Smoothed round-trip time */
+	usec_t srtt;
+	/** Round-trip time variation */
+	usec_t rttvar;
+	/** Retransmission timeout */
+	usec_t rto;
+
+	/** Number of consecutive duplicate ACKs */
+	unsigned dupacks;
+	/** In fast recovery (RFC 6582) */
+	bool in_recovery;
+	/** Recovering from retransmission timeout */
+	bool rto_recovery;
+	/** Highest sequence number sent when loss recovery started */
+	uint32_t recover;
+	/** Retransmit first unacknowledged segment after pruning the queue */
+	bool rexmit_head;
+	/** @c sack_high is valid */
+	bool sack_high_valid;
+	/** Highest sequence number selectively acknowledged by the peer */
+	uint32_t sack_high;
 } tcp_tqueue_t;
 
+/** Congestion control algorithm.
+ *
+ * The algorithm maintains the congestion window @c cwnd and the slow start
+ * threshold @c ssthresh of the connection. Any additional state can be
+ * kept in @c cc_data.
+ */
+typedef struct {
+	/** Algorithm name */
+	const char *name;
+	/** Set up initial congestion state of a connection */
+	void (*init)(tcp_conn_t *);
+	/** Release algorithm-specific state of a connection */
+	void (*fini)(tcp_conn_t *);
+	/** New data has been acknowledged (number of bytes acked) */
+	void (*ack_received)(tcp_conn_t *, uint32_t);
+	/** Retransmission timer has expired */
+	void (*timeout)(tcp_conn_t *);
+	/** Third duplicate ACK received, entering fast recovery */
+	void (*fast_retransmit)(tcp_conn_t *);
+	/** Additional duplicate ACK received during fast recovery */
+	void (*dup_ack)(tcp_conn_t *);
+	/** ACK of part of outstanding data during fast recovery */
+	void (*partial_ack)(tcp_conn_t *, uint32_t);
+	/** All data outstanding at start of fast recovery has been acked */
+	void (*recovery_exit)(tcp_conn_t *);
+} tcp_cc_ops_t;
+
 /** Connection */
 struct tcp_conn {
 	char *name;
@@ -275,6 +360,10 @@ struct tcp_conn {
 	uint8_t *rcv_buf;
 	/** Receive buffer size */
 	size_t rcv_buf_size;
+	/** Size up to which the receive buffer can grow */
+	size_t rcv_buf_max;
+	/** Receive window was nearly exhausted since the buffer last grew */
+	bool rcv_wnd_limited;
 	/** Receive buffer number of bytes used */
 	size_t rcv_buf_used;
 	/** Receive buffer contains FIN */
@@ -307,6 +396,21 @@ struct tcp_conn {
 	uint32_t snd_wl2;
 	/** Initial send sequence number */
 	uint32_t iss;
+	/** Maximum segment size for sending */
+	uint32_t snd_mss;
+	/** Send window scale (shift count applied to SEG.WND) */
+	uint8_t snd_wscale;
+
+	/** Congestion control algorithm */
+	tcp_cc_ops_t *cc;
+	/** Congestion-control algorithm specific data */
+	void *cc_data;
+	/** Congestion window */
+	uint32_t cwnd;
+	/** Slow start threshold */
+	uint32_t ssthresh;
+	/** Bytes acknowledged in congestion avoidance not yet added to cwnd */
+	uint32_t cwnd_acked;
 
 	/** Receive next */
 	uint32_t rcv_nxt;
@@ -316,6 +420,12 @@ struct tcp_conn {
 	uint32_t rcv_up;
 	/** Initial receive sequence number */
 	uint32_t irs;
+	/** Receive window scale (shift count applied to advertised RCV.WND) */
+	uint8_t rcv_wscale;
+	/** Use window scaling (offered by us, cleared if peer does not agree) */
+	bool wscale_ok;
+	/** Use selective acknowledgements (cleared if peer does not agree) */
+	bool sack_ok;
 };
 
 /** Continuation of processing.
@@ -386,9 +496,21 @@ typedef enum {
 	/** Segment loopback */
 	tcp_lb_segment,
 	/** PDU loopback */
-	tcp_lb_pdu
+	tcp_lb_pdu,
+	/** Segment loopback through the network condition simulator */
+	tcp_lb_ncsim
 } tcp_lb_t;
 
+/** Network condition simulator configuration */
+typedef struct {
+	/** Minimum delay of a segment */
+	usec_t delay_min;
+	/** Maximum delay of a segment */
+	usec_t delay_max;
+	/** Percentage of segments to drop */
+	unsigned drop_pct;
+} tcp_ncsim_conf_t;
+
 #endif
 
 /** @}
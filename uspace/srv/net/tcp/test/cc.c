@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <errno.h>
+#include <io/log.h>
+#include <mem.h>
+#include <pcut/pcut.h>
+#include <stdint.h>
+
+#include "../cc.h"
+#include "../tcp_type.h"
+
+PCUT_INIT;
+
+PCUT_TEST_SUITE(cc);
+
+PCUT_TEST_BEFORE
+{
+	errno_t rc;
+
+	/* We will be calling functions that perform logging */
+	rc = log_init("test-tcp");
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+}
+
+/** Set up a bare connection structure for congestion control tests */
+static void cc_test_conn_init(tcp_conn_t *conn, uint32_t mss)
+{
+	memset(conn, 0, sizeof(tcp_conn_t));
+	conn->name = (char *) "test";
+	conn->snd_mss = mss;
+	conn->snd_una = 1000;
+	conn->snd_nxt = 1000;
+	tcp_cc_init(conn);
+}
+
+/** Algorithms can be found by name */
+PCUT_TEST(find)
+{
+	PCUT_ASSERT_EQUALS(&tcp_cc_newreno, tcp_cc_find("newreno"));
+	PCUT_ASSERT_NULL(tcp_cc_find("nonexistent"));
+	PCUT_ASSERT_ERRNO_VAL(ENOENT, tcp_cc_set_default("nonexistent"));
+	PCUT_ASSERT_ERRNO_VAL(EOK, tcp_cc_set_default("newreno"));
+}
+
+/** Initial window follows RFC 5681 */
+PCUT_TEST(initial_window)
+{
+	tcp_conn_t conn;
+
+	cc_test_conn_init(&conn, 536);
+	PCUT_ASSERT_INT_EQUALS(4 * 536, conn.cwnd);
+	tcp_cc_fini(&conn);
+
+	cc_test_conn_init(&conn, 1460);
+	PCUT_ASSERT_INT_EQUALS(3 * 1460, conn.cwnd);
+	tcp_cc_fini(&conn);
+
+	cc_test_conn_init(&conn, 4000);
+	PCUT_ASSERT_INT_EQUALS(2 * 4000, conn.cwnd);
+	tcp_cc_fini(&conn);
+}
+
+/** Slow start grows window by at most one MSS per ACK */
+PCUT_TEST(slow_start)
+{
+	tcp_conn_t conn;
+	uint32_t cwnd;
+
+	cc_test_conn_init(&conn, 1000);
+	cwnd = conn.cwnd;
+
+	tcp_cc_ack_received(&conn, 500);
+	PCUT_ASSERT_INT_EQUALS(cwnd + 500, conn.cwnd);
+
+	tcp_cc_ack_received(&conn, 3000);
+	PCUT_ASSERT_INT_EQUALS(cwnd + 1500, conn.cwnd);
+
+	tcp_cc_fini(&conn);
+}
+
+/** Congestion avoidance grows window by one MSS per window acked */
+PCUT_TEST(cong_avoid)
+{
+	tcp_conn_t conn;
+	int i;
+
+	cc_test_conn_init(&conn, 1000);
+	conn.cwnd = 10000;
+	conn.ssthresh = 5000;
+
+	for (i = 0; i < 9; i++)
+		tcp_cc_ack_received(&conn, 1000);
+	PCUT_ASSERT_INT_EQUALS(10000, conn.cwnd);
+
+	tcp_cc_ack_received(&conn, 1000);
+	PCUT_ASSERT_INT_EQUALS(11000, conn.cwnd);
+
+	tcp_cc_fini(&conn);
+}
+
+/** Retransmission timeout collapses the window */
+PCUT_TEST(timeout)
+{
+	tcp_conn_t conn;
+
+	cc_test_conn_init(&conn, 1000);
+	conn.cwnd = 20000;
+	conn.snd_nxt = conn.snd_una + 16000;
+
+	tcp_cc_timeout(&conn);
+	PCUT_ASSERT_INT_EQUALS(1000, conn.cwnd);
+	PCUT_ASSERT_INT_EQUALS(8000, conn.ssthresh);
+
+	/* ssthresh is at least two segments */
+	conn.snd_nxt = conn.snd_una + 1000;
+	tcp_cc_timeout(&conn);
+	PCUT_ASSERT_INT_EQUALS(2000, conn.ssthresh);
+
+	tcp_cc_fini(&conn);
+}
+
+/** Fast recovery inflates and deflates the window */
+PCUT_TEST(fast_recovery)
+{
+	tcp_conn_t conn;
+
+	cc_test_conn_init(&conn, 1000);
+	conn.cwnd = 20000;
+	conn.snd_nxt = conn.snd_una + 20000;
+
+	tcp_cc_fast_retransmit(&conn);
+	PCUT_ASSERT_INT_EQUALS(10000, conn.ssthresh);
+	PCUT_ASSERT_INT_EQUALS(13000, conn.cwnd);
+
+	tcp_cc_dup_ack(&conn);
+	PCUT_ASSERT_INT_EQUALS(14000, conn.cwnd);
+
+	/* Partial ACK of three segments */
+	conn.snd_una += 3000;
+	tcp_cc_partial_ack(&conn, 3000);
+	PCUT_ASSERT_INT_EQUALS(12000, conn.cwnd);
+
+	/* Everything acked */
+	conn.snd_una = conn.snd_nxt;
+	tcp_cc_recovery_exit(&conn);
+	PCUT_ASSERT_INT_EQUALS(2000, conn.cwnd);
+
+	tcp_cc_fini(&conn);
+}
+
+PCUT_EXPORT(cc);
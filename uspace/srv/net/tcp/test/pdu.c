@@ -35,6 +35,7 @@
 #include "main.h"
 #include "../pdu.h"
 #include "../segment.h"
+#include "../std.h"
 
 PCUT_INIT;
 
@@ -108,4 +109,76 @@ PCUT_TEST(encdec_data)
 	free(data);
 }
 
+/** Test encode/decode round trip for SYN PDU with options */
+PCUT_TEST(encdec_syn_opts)
+{
+	tcp_segment_t *seg, *dseg;
+	tcp_pdu_t *pdu;
+	inet_ep2_t epp, depp;
+	errno_t rc;
+
+	inet_ep2_init(&epp);
+	inet_addr(&epp.local.addr, 1, 2, 3, 4);
+	inet_addr(&epp.remote.addr, 5, 6, 7, 8);
+
+	seg = tcp_segment_make_ctrl(CTL_SYN);
+	PCUT_ASSERT_NOT_NULL(seg);
+
+	seg->seq = 20;
+	seg->wnd = 0xffff;
+	seg->mss = 1460;
+	seg->wscale_present = true;
+	seg->wscale = 5;
+	seg->sack_permitted = true;
+
+	rc = tcp_pdu_encode(&epp, seg, &pdu);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	PCUT_ASSERT_INT_EQUALS(sizeof(tcp_header_t) + 12, pdu->header_size);
+
+	rc = tcp_pdu_decode(pdu, &depp, &dseg);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+
+	test_seg_same(seg, dseg);
+	tcp_segment_delete(seg);
+	tcp_segment_delete(dseg);
+	tcp_pdu_delete(pdu);
+}
+
+/** Test encode/decode round trip for ACK PDU with SACK blocks */
+PCUT_TEST(encdec_sack)
+{
+	tcp_segment_t *seg, *dseg;
+	tcp_pdu_t *pdu;
+	inet_ep2_t epp, depp;
+	errno_t rc;
+
+	inet_ep2_init(&epp);
+	inet_addr(&epp.local.addr, 1, 2, 3, 4);
+	inet_addr(&epp.remote.addr, 5, 6, 7, 8);
+
+	seg = tcp_segment_make_ctrl(CTL_ACK);
+	PCUT_ASSERT_NOT_NULL(seg);
+
+	seg->seq = 20;
+	seg->ack = 1000;
+	seg->wnd = 100;
+	seg->sack_cnt = TCP_SACK_BLOCKS_MAX;
+	seg->sack[0].start = 2000;
+	seg->sack[0].end = 3000;
+	seg->sack[1].start = 4000;
+	seg->sack[1].end = 5000;
+	seg->sack[2].start = 0xfffffff0;
+	seg->sack[2].end = 0x10;
+
+	rc = tcp_pdu_encode(&epp, seg, &pdu);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+	rc = tcp_pdu_decode(pdu, &depp, &dseg);
+	PCUT_ASSERT_ERRNO_VAL(EOK, rc);
+
+	test_seg_same(seg, dseg);
+	tcp_segment_delete(seg);
+	tcp_segment_delete(dseg);
+	tcp_pdu_delete(pdu);
+}
+
 PCUT_EXPORT(pdu);
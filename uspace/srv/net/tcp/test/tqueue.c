@@ -257,6 +257,116 @@ PCUT_TEST(ack_received)
 	tcp_conn_delete(conn);
 }
 
+/** Test fast retransmit after three duplicate ACKs */
+PCUT_TEST(dup_ack_fast_rexmit)
+{
+	tcp_conn_t *conn;
+	inet_ep2_t epp;
+	int i, j;
+
+	/* XXX tqueue can only be created via tcp_conn_new */
+	inet_ep2_init(&epp);
+	conn = tcp_conn_new(&epp);
+	PCUT_ASSERT_NOT_NULL(conn);
+
+	conn->cstate = st_established;
+	conn->snd_una = 10;
+	conn->snd_nxt = 10;
+	conn->snd_wnd = 1024;
+	conn->snd_mss = 10;
+	conn->cwnd = 100;
+
+	/* Redirect segment transmission */
+	conn->retransmit.cb = &tqueue_test_cb;
+	seg_cnt = 0;
+
+	tcp_conn_lock(conn);
+
+	/* Send four data segments */
+	for (i = 0; i < 4; i++) {
+		conn->snd_buf_used = 10;
+		for (j = 0; j < 10; j++)
+			conn->snd_buf[j] = i;
+		tcp_tqueue_new_data(conn);
+	}
+
+	PCUT_ASSERT_EQUALS(50, conn->snd_nxt);
+	PCUT_ASSERT_EQUALS(4, seg_cnt);
+
+	/* Two duplicate ACKs do not trigger retransmission */
+	tcp_tqueue_dup_ack(conn);
+	tcp_tqueue_dup_ack(conn);
+	PCUT_ASSERT_EQUALS(4, seg_cnt);
+	PCUT_ASSERT_FALSE(conn->retransmit.in_recovery);
+
+	/* Third one does */
+	tcp_tqueue_dup_ack(conn);
+	PCUT_ASSERT_EQUALS(5, seg_cnt);
+	PCUT_ASSERT_EQUALS(10, trans_seg[4]->seq);
+	PCUT_ASSERT_TRUE((trans_seg[4]->ctrl & CTL_ACK) != 0);
+	PCUT_ASSERT_TRUE(conn->retransmit.in_recovery);
+	PCUT_ASSERT_EQUALS(50, conn->retransmit.recover);
+	PCUT_ASSERT_EQUALS(20, conn->ssthresh);
+	PCUT_ASSERT_EQUALS(50, conn->cwnd);
+
+	/* Partial ACK retransmits the next segment */
+	conn->snd_una = 20;
+	tcp_tqueue_new_ack(conn, 10);
+	tcp_tqueue_ack_received(conn);
+	PCUT_ASSERT_EQUALS(6, seg_cnt);
+	PCUT_ASSERT_EQUALS(20, trans_seg[5]->seq);
+	PCUT_ASSERT_TRUE(conn->retransmit.in_recovery);
+
+	/* Full ACK ends fast recovery */
+	conn->snd_una = 50;
+	tcp_tqueue_new_ack(conn, 30);
+	tcp_tqueue_ack_received(conn);
+	PCUT_ASSERT_FALSE(conn->retransmit.in_recovery);
+	PCUT_ASSERT_EQUALS(20, conn->cwnd);
+	PCUT_ASSERT_INT_EQUALS(0, list_count(&conn->retransmit.list));
+
+	tcp_conn_reset(conn);
+	tcp_conn_unlock(conn);
+	tcp_conn_delete(conn);
+
+	for (i = 0; i < seg_cnt; i++)
+		tcp_segment_delete(trans_seg[i]);
+}
+
+/** Test retransmission timeout computation */
+PCUT_TEST(rtt_sample)
+{
+	tcp_conn_t *conn;
+	inet_ep2_t epp;
+
+	/* XXX tqueue can only be created via tcp_conn_new */
+	inet_ep2_init(&epp);
+	conn = tcp_conn_new(&epp);
+	PCUT_ASSERT_NOT_NULL(conn);
+
+	/* First measurement */
+	tcp_tqueue_rtt_sample(&conn->retransmit, 400 * 1000);
+	PCUT_ASSERT_INT_EQUALS(400 * 1000, conn->retransmit.srtt);
+	PCUT_ASSERT_INT_EQUALS(200 * 1000, conn->retransmit.rttvar);
+	PCUT_ASSERT_INT_EQUALS(1200 * 1000, conn->retransmit.rto);
+
+	/* Subsequent measurement */
+	tcp_tqueue_rtt_sample(&conn->retransmit, 800 * 1000);
+	PCUT_ASSERT_INT_EQUALS(450 * 1000, conn->retransmit.srtt);
+	PCUT_ASSERT_INT_EQUALS(250 * 1000, conn->retransmit.rttvar);
+	PCUT_ASSERT_INT_EQUALS(1450 * 1000, conn->retransmit.rto);
+
+	/* Timeout does not drop below the minimum on a fast link */
+	tcp_tqueue_rtt_sample(&conn->retransmit, 100);
+	tcp_tqueue_rtt_sample(&conn->retransmit, 100);
+	PCUT_ASSERT_TRUE(conn->retransmit.rto >= 200 * 1000);
+
+	tcp_conn_lock(conn);
+	tcp_conn_reset(conn);
+	tcp_conn_unlock(conn);
+	tcp_conn_delete(conn);
+}
+
 static void tqueue_test_transmit_seg(inet_ep2_t *epp, tcp_segment_t *seg)
 {
 	trans_seg[seg_cnt++] = tcp_segment_dup(seg);
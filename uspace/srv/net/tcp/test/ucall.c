@@ -29,9 +29,12 @@
 #include <errno.h>
 #include <inet/endpoint.h>
 #include <io/log.h>
+#include <mem.h>
 #include <pcut/pcut.h>
+#include <stdlib.h>
 
 #include "../conn.h"
+#include "../ncsim.h"
 #include "../rqueue.h"
 #include "../ucall.h"
 
@@ -42,6 +45,12 @@ PCUT_TEST_SUITE(ucall);
 static void test_cstate_change(tcp_conn_t *, void *, tcp_cstate_t);
 static void test_conns_establish(tcp_conn_t **, tcp_conn_t **);
 static void test_conns_tear_down(tcp_conn_t *, tcp_conn_t *);
+static void test_conns_transfer(tcp_conn_t *, tcp_conn_t *, size_t);
+
+enum {
+	/** Amount of data to transfer in data transfer tests */
+	test_xfer_size = 48 * 1024
+};
 
 static tcp_rqueue_cb_t test_rqueue_cb = {
 	.seg_received = tcp_as_segment_arrived
@@ -235,6 +244,74 @@ PCUT_TEST(conn_est_close_simult)
 	test_conns_tear_down(cconn, sconn);
 }
 
+/** Test window scale negotiation and transferring data */
+PCUT_TEST(conn_data)
+{
+	tcp_conn_t *cconn, *sconn;
+
+	test_conns_establish(&cconn, &sconn);
+
+	PCUT_ASSERT_TRUE(cconn->wscale_ok);
+	PCUT_ASSERT_TRUE(sconn->wscale_ok);
+	PCUT_ASSERT_INT_EQUALS(sconn->rcv_wscale, cconn->snd_wscale);
+	PCUT_ASSERT_INT_EQUALS(cconn->rcv_wscale, sconn->snd_wscale);
+	PCUT_ASSERT_INT_EQUALS(TCP_MSS_LOCAL, cconn->snd_mss);
+	PCUT_ASSERT_TRUE(cconn->sack_ok);
+	PCUT_ASSERT_TRUE(sconn->sack_ok);
+
+	test_conns_transfer(cconn, sconn, test_xfer_size);
+	test_conns_tear_down(cconn, sconn);
+}
+
+/** Test transferring data over a link with variable latency */
+PCUT_TEST(conn_data_delay)
+{
+	tcp_conn_t *cconn, *sconn;
+	tcp_ncsim_conf_t conf;
+
+	tcp_ncsim_init();
+	conf.delay_min = 1000;
+	conf.delay_max = 5000;
+	conf.drop_pct = 0;
+	tcp_ncsim_configure(&conf);
+	tcp_ncsim_fibril_start();
+	tcp_conn_lb = tcp_lb_ncsim;
+
+	test_conns_establish(&cconn, &sconn);
+	test_conns_transfer(cconn, sconn, test_xfer_size);
+	test_conns_tear_down(cconn, sconn);
+
+	tcp_conn_lb = tcp_lb_segment;
+	tcp_ncsim_fini();
+}
+
+/** Test transferring data over a lossy link with variable latency.
+ *
+ * Lost segments are mostly recovered by fast retransmit, so this
+ * should complete well within the time a fixed multi-second
+ * retransmission timeout would take.
+ */
+PCUT_TEST(conn_data_loss)
+{
+	tcp_conn_t *cconn, *sconn;
+	tcp_ncsim_conf_t conf;
+
+	tcp_ncsim_init();
+	conf.delay_min = 1000;
+	conf.delay_max = 3000;
+	conf.drop_pct = 5;
+	tcp_ncsim_configure(&conf);
+	tcp_ncsim_fibril_start();
+	tcp_conn_lb = tcp_lb_ncsim;
+
+	test_conns_establish(&cconn, &sconn);
+	test_conns_transfer(cconn, sconn, test_xfer_size);
+	test_conns_tear_down(cconn, sconn);
+
+	tcp_conn_lb = tcp_lb_segment;
+	tcp_ncsim_fini();
+}
+
 static void test_cstate_change(tcp_conn_t *conn, void *arg,
     tcp_cstate_t old_state)
 {
@@ -314,4 +391,49 @@ static void test_conns_tear_down(tcp_conn_t *cconn, tcp_conn_t *sconn)
 	tcp_uc_delete(sconn);
 }
 
+/** Send data from client to server and verify it arrives intact. */
+static void test_conns_transfer(tcp_conn_t *cconn, tcp_conn_t *sconn,
+    size_t size)
+{
+	uint8_t *sbuf, *rbuf;
+	size_t total, rcvd, i;
+	xflags_t xflags;
+	tcp_error_t trc;
+
+	sbuf = malloc(size);
+	PCUT_ASSERT_NOT_NULL(sbuf);
+	rbuf = calloc(1, size);
+	PCUT_ASSERT_NOT_NULL(rbuf);
+
+	for (i = 0; i < size; i++)
+		sbuf[i] = (uint8_t) (i * 7 + i / 256);
+
+	trc = tcp_uc_send(cconn, sbuf, size, 0);
+	PCUT_ASSERT_INT_EQUALS(TCP_EOK, trc);
+
+	total = 0;
+	while (total < size) {
+		trc = tcp_uc_receive(sconn, rbuf + total, size - total,
+		    &rcvd, &xflags);
+		if (trc == TCP_EAGAIN) {
+			/* Wait for more data */
+			tcp_conn_lock(sconn);
+			while (sconn->rcv_buf_used == 0 && !sconn->reset) {
+				fibril_condvar_wait(&sconn->rcv_buf_cv,
+				    &sconn->lock);
+			}
+			tcp_conn_unlock(sconn);
+			continue;
+		}
+
+		PCUT_ASSERT_INT_EQUALS(TCP_EOK, trc);
+		total += rcvd;
+	}
+
+	PCUT_ASSERT_INT_EQUALS(0, memcmp(sbuf, rbuf, size));
+
+	free(sbuf);
+	free(rbuf);
+}
+
 PCUT_EXPORT(ucall);
@@ -42,17 +42,31 @@
 #include <macros.h>
 #include <mem.h>
 #include <stdlib.h>
+#include <time.h>
 
+#include "cc.h"
 #include "conn.h"
 #include "inet.h"
+#include "iqueue.h"
 #include "ncsim.h"
 #include "rqueue.h"
 #include "segment.h"
 #include "seq_no.h"
+#include "std.h"
 #include "tqueue.h"
 #include "tcp_type.h"
 
-#define RETRANSMIT_TIMEOUT	(2*1000*1000)
+/** Retransmission timeout before the first RTT measurement (RFC 6298) */
+#define RTO_INITIAL		(1000 * 1000)
+/** Lower bound on retransmission timeout */
+#define RTO_MIN			(200 * 1000)
+/** Upper bound on retransmission timeout */
+#define RTO_MAX			(60 * 1000 * 1000)
+/** Clock granularity assumed in RTO computation */
+#define RTO_GRANULARITY		1000
+
+/** Number of duplicate ACKs that triggers fast retransmit */
+#define DUPACK_THRESHOLD	3
 
 static void retransmit_timeout_func(void *);
 static void tcp_tqueue_timer_set(tcp_conn_t *);
@@ -61,6 +75,7 @@ static void tcp_tqueue_seg(tcp_conn_t *, tcp_segment_t *);
 static void tcp_conn_transmit_segment(tcp_conn_t *, tcp_segment_t *);
 static void tcp_prepare_transmit_segment(tcp_conn_t *, tcp_segment_t *);
 static void tcp_tqueue_send_immed(tcp_conn_t *, tcp_segment_t *);
+static void tcp_tqueue_rexmit(tcp_conn_t *, tcp_tqueue_entry_t *);
 
 errno_t tcp_tqueue_init(tcp_tqueue_t *tqueue, tcp_conn_t *conn,
     tcp_tqueue_cb_t *cb)
@@ -73,6 +88,17 @@ errno_t tcp_tqueue_init(tcp_tqueue_t *tqueue, tcp_conn_t *conn,
 
 	list_initialize(&tqueue->list);
 
+	tqueue->rtt_valid = false;
+	tqueue->srtt = 0;
+	tqueue->rttvar = 0;
+	tqueue->rto = RTO_INITIAL;
+	tqueue->dupacks = 0;
+	tqueue->in_recovery = false;
+	tqueue->rto_recovery = false;
+	tqueue->recover = 0;
+	tqueue->rexmit_head = false;
+	tqueue->sack_high_valid = false;
+
 	return EOK;
 }
 
@@ -146,6 +172,7 @@ static void tcp_tqueue_seg(tcp_conn_t *conn, tcp_segment_t *seg)
 		tqe->conn = conn;
 		tqe->seg = rt_seg;
 		rt_seg->seq = conn->snd_nxt;
+		getuptime(&tqe->sent);
 
 		list_append(&tqe->link, &conn->retransmit.list);
 
@@ -173,14 +200,17 @@ static void tcp_prepare_transmit_segment(tcp_conn_t *conn, tcp_segment_t *seg)
 }
 
 /** Transmit data from the send buffer.
+ *
+ * Sends as many segments of at most SND.MSS bytes as both the peer's
+ * receive window and the congestion window allow.
  *
  * @param conn	Connection
  */
 void tcp_tqueue_new_data(tcp_conn_t *conn)
 {
+	uint32_t flight;
+	size_t wnd;
 	size_t avail_wnd;
-	size_t xfer_seqlen;
-	size_t snd_buf_seqlen;
 	size_t data_size;
 	tcp_control_t ctrl;
 	bool send_fin;
@@ -189,52 +219,58 @@ void tcp_tqueue_new_data(tcp_conn_t *conn)
 
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "%s: tcp_tqueue_new_data()", conn->name);
 
-	/* Number of free sequence numbers in send window */
-	avail_wnd = (conn->snd_una + conn->snd_wnd) - conn->snd_nxt;
-	snd_buf_seqlen = conn->snd_buf_used + (conn->snd_buf_fin ? 1 : 0);
+	while (true) {
+		/* Number of free sequence numbers in send window */
+		flight = tcp_cc_flight_size(conn);
+		wnd = min(conn->snd_wnd, conn->cwnd);
+		avail_wnd = wnd > flight ? wnd - flight : 0;
 
-	xfer_seqlen = min(snd_buf_seqlen, avail_wnd);
-	log_msg(LOG_DEFAULT, LVL_DEBUG, "%s: snd_buf_seqlen = %zu, SND.WND = %" PRIu32 ", "
-	    "xfer_seqlen = %zu", conn->name, snd_buf_seqlen, conn->snd_wnd,
-	    xfer_seqlen);
+		data_size = min(min(conn->snd_buf_used, avail_wnd),
+		    conn->snd_mss);
+		send_fin = conn->snd_buf_fin &&
+		    data_size == conn->snd_buf_used && avail_wnd > data_size;
 
-	if (xfer_seqlen == 0)
-		return;
+		log_msg(LOG_DEFAULT, LVL_DEBUG, "%s: snd_buf_used = %zu, "
+		    "SND.WND = %" PRIu32 ", cwnd = %" PRIu32 ", "
+		    "data_size = %zu", conn->name, conn->snd_buf_used,
+		    conn->snd_wnd, conn->cwnd, data_size);
 
-	/* XXX Do not always send immediately */
+		if (data_size == 0 && !send_fin)
+			return;
 
-	send_fin = conn->snd_buf_fin && xfer_seqlen == snd_buf_seqlen;
-	data_size = xfer_seqlen - (send_fin ? 1 : 0);
+		/* XXX Do not always send immediately */
 
-	if (send_fin) {
-		log_msg(LOG_DEFAULT, LVL_DEBUG, "%s: Sending out FIN.", conn->name);
-		/* We are sending out FIN */
-		ctrl = CTL_FIN;
-	} else {
-		ctrl = 0;
-	}
+		if (send_fin) {
+			log_msg(LOG_DEFAULT, LVL_DEBUG, "%s: Sending out FIN.",
+			    conn->name);
+			/* We are sending out FIN */
+			ctrl = CTL_FIN;
+		} else {
+			ctrl = 0;
+		}
 
-	seg = tcp_segment_make_data(ctrl, conn->snd_buf, data_size);
-	if (seg == NULL) {
-		log_msg(LOG_DEFAULT, LVL_ERROR, "Memory allocation failure.");
-		return;
-	}
+		seg = tcp_segment_make_data(ctrl, conn->snd_buf, data_size);
+		if (seg == NULL) {
+			log_msg(LOG_DEFAULT, LVL_ERROR, "Memory allocation failure.");
+			return;
+		}
 
-	/* Remove data from send buffer */
-	memmove(conn->snd_buf, conn->snd_buf + data_size,
-	    conn->snd_buf_used - data_size);
-	conn->snd_buf_used -= data_size;
+		/* Remove data from send buffer */
+		memmove(conn->snd_buf, conn->snd_buf + data_size,
+		    conn->snd_buf_used - data_size);
+		conn->snd_buf_used -= data_size;
 
-	if (send_fin)
-		conn->snd_buf_fin = false;
+		if (send_fin)
+			conn->snd_buf_fin = false;
 
-	fibril_condvar_broadcast(&conn->snd_buf_cv);
+		fibril_condvar_broadcast(&conn->snd_buf_cv);
 
-	if (send_fin)
-		tcp_conn_fin_sent(conn);
+		if (send_fin)
+			tcp_conn_fin_sent(conn);
 
-	tcp_tqueue_seg(conn, seg);
-	tcp_segment_delete(seg);
+		tcp_tqueue_seg(conn, seg);
+		tcp_segment_delete(seg);
+	}
 }
 
 /** Remove ACKed segments from retransmission queue and possibly transmit
@@ -244,11 +280,19 @@ void tcp_tqueue_new_data(tcp_conn_t *conn)
  */
 void tcp_tqueue_ack_received(tcp_conn_t *conn)
 {
+	tcp_tqueue_t *tqueue = &conn->retransmit;
 	link_t *cur, *next;
+	link_t *link;
+	tcp_tqueue_entry_t *head;
+	struct timespec now;
+	usec_t rtt = 0;
+	bool have_rtt = false;
 
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "%s: tcp_tqueue_ack_received(%p)", conn->name,
 	    conn);
 
+	getuptime(&now);
+
 	cur = conn->retransmit.list.head.next;
 
 	while (cur != &conn->retransmit.list.head) {
@@ -270,6 +314,16 @@ void tcp_tqueue_ack_received(tcp_conn_t *conn)
 				conn->fin_is_acked = true;
 			}
 
+			/*
+			 * Karn's algorithm: only segments that were not
+			 * retransmitted give unambiguous RTT samples. The
+			 * last one acked is the most recent one.
+			 */
+			if (!tqe->retransmitted) {
+				rtt = NSEC2USEC(ts_sub_diff(&now, &tqe->sent));
+				have_rtt = true;
+			}
+
 			tcp_segment_delete(tqe->seg);
 			free(tqe);
 
@@ -280,6 +334,25 @@ void tcp_tqueue_ack_received(tcp_conn_t *conn)
 		cur = next;
 	}
 
+	if (have_rtt)
+		tcp_tqueue_rtt_sample(tqueue, rtt);
+
+	if (tqueue->sack_high_valid &&
+	    seq_no_gteq(conn->snd_una, tqueue->sack_high))
+		tqueue->sack_high_valid = false;
+
+	/* Retransmit next hole during loss recovery */
+	if (tqueue->rexmit_head) {
+		tqueue->rexmit_head = false;
+		link = list_first(&tqueue->list);
+		if (link != NULL) {
+			head = list_get_instance(link, tcp_tqueue_entry_t,
+			    link);
+			if (!head->recovery_rexmit)
+				tcp_tqueue_rexmit(conn, head);
+		}
+	}
+
 	/* Clear retransmission timer if the queue is empty. */
 	if (list_empty(&conn->retransmit.list))
 		tcp_tqueue_timer_clear(conn);
@@ -288,12 +361,212 @@ void tcp_tqueue_ack_received(tcp_conn_t *conn)
 	tcp_tqueue_new_data(conn);
 }
 
+/** New data has been acknowledged.
+ *
+ * Drives the congestion control and loss recovery state. This should be
+ * called after SND.UNA has been advanced and before
+ * tcp_tqueue_ack_received().
+ *
+ * @param conn	Connection
+ * @param acked	Number of newly acknowledged sequence numbers
+ */
+void tcp_tqueue_new_ack(tcp_conn_t *conn, uint32_t acked)
+{
+	tcp_tqueue_t *tqueue = &conn->retransmit;
+
+	assert(fibril_mutex_is_locked(&conn->lock));
+
+	tqueue->dupacks = 0;
+
+	if (tqueue->in_recovery) {
+		if (seq_no_gteq(conn->snd_una, tqueue->recover)) {
+			/* Full acknowledgement */
+			tqueue->in_recovery = false;
+			tcp_cc_recovery_exit(conn);
+		} else {
+			/* Partial acknowledgement, next segment was lost too */
+			tcp_cc_partial_ack(conn, acked);
+			tqueue->rexmit_head = true;
+		}
+
+		return;
+	}
+
+	tcp_cc_ack_received(conn, acked);
+
+	if (tqueue->rto_recovery) {
+		/*
+		 * Segments sent before the timeout are most likely lost
+		 * as well, resend them as they reach the head of the queue.
+		 */
+		if (seq_no_gteq(conn->snd_una, tqueue->recover))
+			tqueue->rto_recovery = false;
+		else
+			tqueue->rexmit_head = true;
+	}
+}
+
+/** Duplicate ACK has been received.
+ *
+ * The third duplicate ACK triggers fast retransmit and puts the connection
+ * into fast recovery (RFC 5681, RFC 6582).
+ *
+ * @param conn	Connection
+ */
+void tcp_tqueue_dup_ack(tcp_conn_t *conn)
+{
+	tcp_tqueue_t *tqueue = &conn->retransmit;
+	link_t *link;
+
+	assert(fibril_mutex_is_locked(&conn->lock));
+
+	link = list_first(&tqueue->list);
+	if (link == NULL)
+		return;
+
+	if (tqueue->in_recovery) {
+		tcp_cc_dup_ack(conn);
+		if (conn->sack_ok)
+			tcp_tqueue_rexmit_hole(conn);
+		return;
+	}
+
+	/* Do not start fast recovery while recovering from a timeout */
+	if (tqueue->rto_recovery)
+		return;
+
+	if (++tqueue->dupacks < DUPACK_THRESHOLD)
+		return;
+
+	log_msg(LOG_DEFAULT, LVL_DEBUG, "%s: fast retransmit", conn->name);
+
+	tqueue->in_recovery = true;
+	tqueue->recover = conn->snd_nxt;
+
+	list_foreach(tqueue->list, link, tcp_tqueue_entry_t, tqe)
+		tqe->recovery_rexmit = false;
+
+	tcp_cc_fast_retransmit(conn);
+	tcp_tqueue_rexmit(conn, list_get_instance(link, tcp_tqueue_entry_t,
+	    link));
+}
+
+/** Process SACK blocks from an incoming segment.
+ *
+ * Mark segments covered by the blocks so that they are not retransmitted.
+ *
+ * @param conn	Connection
+ * @param seg	Incoming segment
+ */
+void tcp_tqueue_sack_received(tcp_conn_t *conn, tcp_segment_t *seg)
+{
+	tcp_tqueue_t *tqueue = &conn->retransmit;
+	tcp_sack_block_t *blk;
+	unsigned i;
+
+	assert(fibril_mutex_is_locked(&conn->lock));
+
+	for (i = 0; i < seg->sack_cnt; i++) {
+		blk = &seg->sack[i];
+
+		/* Ignore blocks outside of outstanding data */
+		if (!seq_no_gteq(blk->start, conn->snd_una) ||
+		    !seq_no_gteq(conn->snd_nxt, blk->end) ||
+		    !seq_no_gteq(blk->end, blk->start + 1))
+			continue;
+
+		list_foreach(tqueue->list, link, tcp_tqueue_entry_t, tqe) {
+			if (!tqe->sacked && seq_no_segment_sacked(tqe->seg, blk))
+				tqe->sacked = true;
+		}
+
+		if (!tqueue->sack_high_valid ||
+		    seq_no_gteq(blk->end, tqueue->sack_high)) {
+			tqueue->sack_high = blk->end;
+			tqueue->sack_high_valid = true;
+		}
+	}
+}
+
+/** Retransmit next segment presumed lost according to SACK information.
+ *
+ * A segment is presumed lost if it has not been selectively acknowledged
+ * while some later data has (a simplified form of RFC 6675).
+ *
+ * @param conn	Connection
+ */
+void tcp_tqueue_rexmit_hole(tcp_conn_t *conn)
+{
+	tcp_tqueue_t *tqueue = &conn->retransmit;
+	tcp_segment_t *seg;
+
+	if (!tqueue->sack_high_valid)
+		return;
+
+	list_foreach(tqueue->list, link, tcp_tqueue_entry_t, tqe) {
+		seg = tqe->seg;
+		if (!seq_no_gteq(tqueue->sack_high, seg->seq + seg->len))
+			break;
+
+		if (!tqe->sacked && !tqe->recovery_rexmit) {
+			tcp_tqueue_rexmit(conn, tqe);
+			return;
+		}
+	}
+}
+
+/** Update RTT estimate with a new measurement (RFC 6298).
+ *
+ * @param tqueue	Retransmission queue
+ * @param rtt		Measured round-trip time
+ */
+void tcp_tqueue_rtt_sample(tcp_tqueue_t *tqueue, usec_t rtt)
+{
+	usec_t delta;
+
+	if (!tqueue->rtt_valid) {
+		tqueue->srtt = rtt;
+		tqueue->rttvar = rtt / 2;
+		tqueue->rtt_valid = true;
+	} else {
+		delta = tqueue->srtt > rtt ? tqueue->srtt - rtt :
+		    rtt - tqueue->srtt;
+		tqueue->rttvar = (3 * tqueue->rttvar + delta) / 4;
+		tqueue->srtt = (7 * tqueue->srtt + rtt) / 8;
+	}
+
+	tqueue->rto = tqueue->srtt + max(RTO_GRANULARITY, 4 * tqueue->rttvar);
+	tqueue->rto = max(tqueue->rto, RTO_MIN);
+	tqueue->rto = min(tqueue->rto, RTO_MAX);
+
+	log_msg(LOG_DEFAULT, LVL_DEBUG2, "RTT=%lld SRTT=%lld RTTVAR=%lld "
+	    "RTO=%lld", rtt, tqueue->srtt, tqueue->rttvar, tqueue->rto);
+}
+
 static void tcp_conn_transmit_segment(tcp_conn_t *conn, tcp_segment_t *seg)
 {
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "%s: tcp_conn_transmit_segment(%p, %p)",
 	    conn->name, conn, seg);
 
-	seg->wnd = conn->rcv_wnd;
+	if ((seg->ctrl & CTL_SYN) != 0) {
+		/* Window in SYN segments is never scaled (RFC 7323) */
+		seg->wnd = min(conn->rcv_wnd, 0xffff);
+		seg->mss = TCP_MSS_LOCAL;
+		if (conn->wscale_ok) {
+			seg->wscale_present = true;
+			seg->wscale = conn->rcv_wscale;
+		}
+		seg->sack_permitted = conn->sack_ok;
+	} else {
+		seg->wnd = min(conn->rcv_wnd >> conn->rcv_wscale, 0xffff);
+	}
+
+	/* Tell the peer about out-of-order data we are holding */
+	seg->sack_cnt = 0;
+	if (conn->sack_ok && (seg->ctrl & (CTL_ACK | CTL_SYN)) == CTL_ACK) {
+		seg->sack_cnt = tcp_iqueue_sack_blocks(&conn->incoming,
+		    seg->sack, TCP_SACK_BLOCKS_MAX);
+	}
 
 	if ((seg->ctrl & CTL_ACK) != 0)
 		seg->ack = conn->rcv_nxt;
@@ -317,11 +590,42 @@ void tcp_tqueue_send_immed(tcp_conn_t *conn, tcp_segment_t *seg)
 	conn->retransmit.cb->transmit_seg(&conn->ident, seg);
 }
 
+/** Retransmit segment from retransmission queue.
+ *
+ * @param conn	Connection
+ * @param tqe	Retransmission queue entry
+ */
+static void tcp_tqueue_rexmit(tcp_conn_t *conn, tcp_tqueue_entry_t *tqe)
+{
+	tcp_segment_t *rt_seg;
+
+	rt_seg = tcp_segment_dup(tqe->seg);
+	if (rt_seg == NULL) {
+		log_msg(LOG_DEFAULT, LVL_ERROR, "Memory allocation failed.");
+		/* XXX Handle properly */
+		return;
+	}
+
+	log_msg(LOG_DEFAULT, LVL_DEBUG, "%s: retransmitting SEG.SEQ=%" PRIu32
+	    ", SEG.LEN=%" PRIu32, conn->name, rt_seg->seq, rt_seg->len);
+
+	/* Queued copy was made before the ACK flag was added */
+	if (tcp_conn_got_syn(conn) && (rt_seg->ctrl & CTL_RST) == 0)
+		rt_seg->ctrl |= CTL_ACK;
+
+	tqe->retransmitted = true;
+	tqe->recovery_rexmit = true;
+	getuptime(&tqe->sent);
+
+	tcp_conn_transmit_segment(conn, rt_seg);
+	tcp_segment_delete(rt_seg);
+}
+
 static void retransmit_timeout_func(void *arg)
 {
 	tcp_conn_t *conn = (tcp_conn_t *) arg;
+	tcp_tqueue_t *tqueue = &conn->retransmit;
 	tcp_tqueue_entry_t *tqe;
-	tcp_segment_t *rt_seg;
 	link_t *link;
 
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "### %s: retransmit_timeout_func(%p)", conn->name, conn);
@@ -335,7 +639,7 @@ static void retransmit_timeout_func(void *arg)
 		return;
 	}
 
-	link = list_first(&conn->retransmit.list);
+	link = list_first(&tqueue->list);
 	if (link == NULL) {
 		log_msg(LOG_DEFAULT, LVL_DEBUG, "Nothing to retransmit");
 		tcp_conn_unlock(conn);
@@ -345,20 +649,33 @@ static void retransmit_timeout_func(void *arg)
 
 	tqe = list_get_instance(link, tcp_tqueue_entry_t, link);
 
-	rt_seg = tcp_segment_dup(tqe->seg);
-	if (rt_seg == NULL) {
-		log_msg(LOG_DEFAULT, LVL_ERROR, "Memory allocation failed.");
-		tcp_conn_unlock(conn);
-		tcp_conn_delref(conn);
-		/* XXX Handle properly */
-		return;
+	/* Back off the timer (RFC 6298, section 5.5) */
+	tqueue->rto = min(2 * tqueue->rto, RTO_MAX);
+
+	/* Loss is taken as a sign of congestion */
+	tcp_cc_timeout(conn);
+
+	/*
+	 * Leave fast recovery and forget SACK information, the peer
+	 * may have discarded the data (RFC 2018, section 8).
+	 */
+	tqueue->in_recovery = false;
+	tqueue->dupacks = 0;
+	tqueue->rto_recovery = true;
+	tqueue->recover = conn->snd_nxt;
+	tqueue->rexmit_head = false;
+	tqueue->sack_high_valid = false;
+
+	list_foreach(tqueue->list, link, tcp_tqueue_entry_t, qe) {
+		qe->sacked = false;
+		qe->recovery_rexmit = false;
 	}
 
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "### %s: retransmitting segment", conn->name);
-	tcp_conn_transmit_segment(tqe->conn, rt_seg);
+	tcp_tqueue_rexmit(conn, tqe);
 
 	/* Reset retransmission timer */
-	fibril_timer_set_locked(conn->retransmit.timer, RETRANSMIT_TIMEOUT,
+	fibril_timer_set_locked(tqueue->timer, tqueue->rto,
 	    retransmit_timeout_func, (void *) conn);
 
 	tcp_conn_unlock(conn);
@@ -377,7 +694,7 @@ static void tcp_tqueue_timer_set(tcp_conn_t *conn)
 	tcp_tqueue_timer_clear(conn);
 
 	tcp_conn_addref(conn);
-	fibril_timer_set_locked(conn->retransmit.timer, RETRANSMIT_TIMEOUT,
+	fibril_timer_set_locked(conn->retransmit.timer, conn->retransmit.rto,
 	    retransmit_timeout_func, (void *) conn);
 
 	log_msg(LOG_DEFAULT, LVL_DEBUG, "### %s: tcp_tqueue_timer_set() end", conn->name);
@@ -39,6 +39,7 @@
 #include <io/log.h>
 #include <macros.h>
 #include <mem.h>
+#include <stdlib.h>
 #include "conn.h"
 #include "tcp_type.h"
 #include "tqueue.h"
@@ -176,6 +177,37 @@ tcp_error_t tcp_uc_send(tcp_conn_t *conn, void *data, size_t size,
 	return TCP_EOK;
 }
 
+/** Grow receive buffer.
+ *
+ * Receive buffer auto-tuning: when the peer has been filling the receive
+ * window faster than the user drains it, double the buffer (up to
+ * the configured maximum) and open the window accordingly.
+ *
+ * @param conn	Connection
+ */
+static void tcp_uc_rcv_buf_grow(tcp_conn_t *conn)
+{
+	size_t nsize;
+	uint8_t *nbuf;
+
+	conn->rcv_wnd_limited = false;
+
+	nsize = min(2 * conn->rcv_buf_size, conn->rcv_buf_max);
+	if (nsize <= conn->rcv_buf_size)
+		return;
+
+	nbuf = realloc(conn->rcv_buf, nsize);
+	if (nbuf == NULL)
+		return;
+
+	log_msg(LOG_DEFAULT, LVL_DEBUG, "%s: growing receive buffer to %zu bytes",
+	    conn->name, nsize);
+
+	conn->rcv_wnd += nsize - conn->rcv_buf_size;
+	conn->rcv_buf = nbuf;
+	conn->rcv_buf_size = nsize;
+}
+
 /** RECEIVE user call */
 tcp_error_t tcp_uc_receive(tcp_conn_t *conn, void *buf, size_t size,
     size_t *rcvd, xflags_t *xflags)
@@ -226,6 +258,10 @@ tcp_error_t tcp_uc_receive(tcp_conn_t *conn, void *buf, size_t size,
 	conn->rcv_buf_used -= xfer_size;
 	conn->rcv_wnd += xfer_size;
 
+	/* Grow receive buffer if it has been limiting the sender */
+	if (conn->rcv_wnd_limited)
+		tcp_uc_rcv_buf_grow(conn);
+
 	/* TODO */
 	*xflags = 0;
 
@@ -99,6 +99,22 @@ int main(int argc, char **argv)
 		return ENOMEM;
 	}
 
+	/*
+	 * Initialize the page cache.
+	 */
+	if (!vfs_cache_init()) {
+		printf("%s: Failed to initialize page cache\n", NAME);
+		return ENOMEM;
+	}
+
+	/*
+	 * Initialize the name cache.
+	 */
+	if (!vfs_dcache_init()) {
+		printf("%s: Failed to initialize name cache\n", NAME);
+		return ENOMEM;
+	}
+
 	/*
 	 * Allocate and initialize the Path Lookup Buffer.
 	 */
@@ -123,9 +123,31 @@ typedef struct _vfs_node {
 	 */
 	fibril_rwlock_t contents_rwlock;
 
+	/** Pages of the node's contents in the page cache. */
+	list_t pages;
+
 	struct _vfs_node *mount;
 } vfs_node_t;
 
+/** Page of a file's contents cached by VFS. */
+typedef struct {
+	ht_link_t link;		/**< Page cache hash table link. */
+	link_t node_link;	/**< Link in the node's list of pages. */
+	link_t lru_link;	/**< Link in the LRU list of pages. */
+
+	vfs_node_t *node;
+	aoff64_t offset;	/**< Offset of the page within the file. */
+	size_t size;		/**< Number of bytes of the file in the page. */
+	void *data;
+
+	unsigned busy;		/**< Number of users of the page. */
+	bool cached;		/**< The page is in the page cache. */
+	/** The page was mapped by a client which may write to it. */
+	bool shared_rw;
+	/** Last walk over the node's pages which visited the page. */
+	unsigned pass;
+} vfs_page_t;
+
 /**
  * Instances of this type represent an open file. If the file is opened by more
  * than one task, there will be a separate structure allocated for each task.
@@ -214,6 +236,7 @@ extern errno_t vfs_op_mtab_get(void);
 extern errno_t vfs_op_open(int fd, int flags);
 extern errno_t vfs_op_put(int fd);
 extern errno_t vfs_op_read(int fd, aoff64_t, size_t *out_bytes);
+extern errno_t vfs_op_readdir(int fd, aoff64_t *, unsigned int, size_t *);
 extern errno_t vfs_op_rename(int basefd, char *old, char *new);
 extern errno_t vfs_op_resize(int fd, int64_t size);
 extern errno_t vfs_op_stat(int fd);
@@ -229,6 +252,29 @@ extern void vfs_register(ipc_call_t *);
 
 extern void vfs_page_in(ipc_call_t *);
 
+extern bool vfs_cache_init(void);
+extern bool vfs_cache_enabled(vfs_node_t *);
+extern errno_t vfs_cache_get(vfs_node_t *, async_exch_t *, aoff64_t,
+    vfs_page_t **);
+extern void vfs_cache_put(vfs_page_t *);
+extern void vfs_cache_share_rw(vfs_page_t *);
+extern void vfs_cache_invalidate(vfs_node_t *, async_exch_t *, aoff64_t,
+    aoff64_t);
+extern errno_t vfs_cache_sync(vfs_node_t *, async_exch_t *);
+extern void vfs_cache_release(vfs_node_t *);
+
+extern bool vfs_dcache_init(void);
+extern bool vfs_dcache_enabled(fs_handle_t);
+extern bool vfs_dcache_lookup(const vfs_triplet_t *, const char *,
+    vfs_lookup_res_t *, bool *);
+extern unsigned long vfs_dcache_generation(void);
+extern void vfs_dcache_insert(unsigned long, const vfs_triplet_t *,
+    const char *, const vfs_lookup_res_t *);
+extern void vfs_dcache_invalidate(const vfs_triplet_t *, const char *);
+extern void vfs_dcache_invalidate_dir(const vfs_triplet_t *);
+extern void vfs_dcache_invalidate_fs(fs_handle_t, service_id_t);
+extern void vfs_dcache_node_released(vfs_node_t *);
+
 typedef struct {
 	void *buffer;
 	size_t size;
@@ -0,0 +1,662 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup vfs
+ * @{
+ */
+
+/**
+ * @file	vfs_cache.c
+ * @brief	Cache of file contents shared by read() and the pager.
+ *
+ * Pages of regular files are kept in an LRU-ordered cache keyed by the
+ * identity of the node and the offset of the page. Each page is backed by its
+ * own address space area, so that its frame can be handed out to page-in
+ * requests and outlive the cached copy after eviction. Pages handed out to
+ * clients which have the file open for writing may be modified through their
+ * mappings. They are written back on sync, before the file is modified through
+ * VFS and when the node is released. Clients which have the file open only for
+ * reading may share the frames only with read-only mappings.
+ */
+
+#include "vfs.h"
+#include <adt/hash.h>
+#include <adt/hash_table.h>
+#include <adt/list.h>
+#include <as.h>
+#include <assert.h>
+#include <async.h>
+#include <errno.h>
+#include <fibril_synch.h>
+#include <macros.h>
+#include <mem.h>
+#include <stdlib.h>
+
+/** Maximum number of pages kept in the cache. */
+#define VFS_CACHE_PAGES  1024
+
+typedef struct {
+	vfs_triplet_t triplet;
+	aoff64_t offset;
+} page_key_t;
+
+/** Mutex protecting the page cache. */
+static FIBRIL_MUTEX_INITIALIZE(cache_mutex);
+
+/** Cached pages hashed by node identity and offset. */
+static hash_table_t pages;
+
+/** Cached pages, the least recently used one is the last. */
+static LIST_INITIALIZE(lru_list);
+
+/** Number of cached pages. */
+static size_t pages_count = 0;
+
+/** Counter identifying walks over the pages of a node. */
+static unsigned pages_pass = 0;
+
+static size_t pages_key_hash(const void *key)
+{
+	const page_key_t *k = key;
+	size_t hash = hash_combine(k->triplet.fs_handle, k->triplet.index);
+	hash = hash_combine(hash, k->triplet.service_id);
+	return hash_combine(hash, k->offset / PAGE_SIZE);
+}
+
+static inline page_key_t page_key(vfs_node_t *node, aoff64_t offset)
+{
+	page_key_t key = {
+		.triplet = {
+			.fs_handle = node->fs_handle,
+			.service_id = node->service_id,
+			.index = node->index
+		},
+		.offset = offset
+	};
+
+	return key;
+}
+
+static size_t pages_hash(const ht_link_t *item)
+{
+	vfs_page_t *page = hash_table_get_inst(item, vfs_page_t, link);
+	page_key_t key = page_key(page->node, page->offset);
+	return pages_key_hash(&key);
+}
+
+static bool pages_key_equal(const void *key, const ht_link_t *item)
+{
+	const page_key_t *k = key;
+	vfs_page_t *page = hash_table_get_inst(item, vfs_page_t, link);
+	return page->node->fs_handle == k->triplet.fs_handle &&
+	    page->node->service_id == k->triplet.service_id &&
+	    page->node->index == k->triplet.index &&
+	    page->offset == k->offset;
+}
+
+/** Page cache hash table operations. */
+static hash_table_ops_t pages_ops = {
+	.hash = pages_hash,
+	.key_hash = pages_key_hash,
+	.key_equal = pages_key_equal,
+	.equal = NULL,
+	.remove_callback = NULL,
+};
+
+/** Initialize the page cache.
+ *
+ * @return		Return true on success, false on failure.
+ */
+bool vfs_cache_init(void)
+{
+	return hash_table_create(&pages, 0, 0, &pages_ops);
+}
+
+/** Check whether contents of a node may be cached.
+ *
+ * Only regular files of file systems which declared that their contents
+ * change only through VFS are cached.
+ *
+ * @param node		VFS node.
+ *
+ * @return		True if the node's contents may be cached.
+ */
+bool vfs_cache_enabled(vfs_node_t *node)
+{
+	if (node->type != VFS_NODE_FILE)
+		return false;
+
+	vfs_info_t *info = fs_handle_to_info(node->fs_handle);
+	return (info != NULL) && info->page_cache;
+}
+
+static void vfs_page_destroy(vfs_page_t *page)
+{
+	as_area_destroy(page->data);
+	free(page);
+}
+
+/** Remove a page from the cache. Must be called with cache_mutex held. */
+static void vfs_cache_unlink(vfs_page_t *page)
+{
+	assert(page->cached);
+
+	hash_table_remove_item(&pages, &page->link);
+	list_remove(&page->node_link);
+	list_remove(&page->lru_link);
+	page->cached = false;
+	pages_count--;
+}
+
+/** Evict least recently used pages while the cache is over its limit.
+ *
+ * Pages in use and pages that may have been modified through a client's
+ * mapping are skipped, the latter are reclaimed by vfs_cache_reclaim(). Must
+ * be called with cache_mutex held.
+ */
+static void vfs_cache_evict(void)
+{
+	link_t *link = list_last(&lru_list);
+
+	while ((pages_count > VFS_CACHE_PAGES) && (link != NULL)) {
+		vfs_page_t *page = list_get_instance(link, vfs_page_t,
+		    lru_link);
+		link = list_prev(link, &lru_list);
+
+		if ((page->busy > 0) || page->shared_rw)
+			continue;
+
+		vfs_cache_unlink(page);
+		vfs_page_destroy(page);
+	}
+}
+
+/** Read a page from the endpoint file system.
+ *
+ * The part of the page past the end of the file is zeroed, which also makes
+ * sure the page is backed by a frame.
+ */
+static errno_t vfs_cache_fill(vfs_page_t *page, async_exch_t *exch)
+{
+	vfs_node_t *node = page->node;
+	size_t total = 0;
+	errno_t rc = EOK;
+
+	while (total < PAGE_SIZE) {
+		aoff64_t pos = page->offset + total;
+
+		ipc_call_t answer;
+		aid_t msg = async_send_4(exch, VFS_OUT_READ, node->service_id,
+		    node->index, LOWER32(pos), UPPER32(pos), &answer);
+		if (msg == 0) {
+			rc = EINVAL;
+			break;
+		}
+
+		rc = async_data_read_start(exch, page->data + total,
+		    PAGE_SIZE - total);
+		if (rc != EOK) {
+			async_forget(msg);
+			break;
+		}
+
+		async_wait_for(msg, &rc);
+		if (rc != EOK)
+			break;
+
+		size_t bytes = ipc_get_arg1(&answer);
+		if (bytes == 0)
+			break;
+
+		total += bytes;
+	}
+
+	memset(page->data + total, 0, PAGE_SIZE - total);
+	page->size = total;
+	return rc;
+}
+
+/** Write the valid part of a page back to the endpoint file system. */
+static errno_t vfs_cache_write_back(vfs_page_t *page, async_exch_t *exch)
+{
+	vfs_node_t *node = page->node;
+	size_t total = 0;
+
+	while (total < page->size) {
+		aoff64_t pos = page->offset + total;
+
+		ipc_call_t answer;
+		aid_t msg = async_send_4(exch, VFS_OUT_WRITE, node->service_id,
+		    node->index, LOWER32(pos), UPPER32(pos), &answer);
+		if (msg == 0)
+			return EINVAL;
+
+		errno_t rc = async_data_write_start(exch, page->data + total,
+		    page->size - total);
+		if (rc != EOK) {
+			async_forget(msg);
+			return rc;
+		}
+
+		async_wait_for(msg, &rc);
+		if (rc != EOK)
+			return rc;
+
+		size_t bytes = ipc_get_arg1(&answer);
+		if (bytes == 0)
+			return EIO;
+
+		total += bytes;
+	}
+
+	return EOK;
+}
+
+/** Write back and evict pages of a node which clients may have modified.
+ *
+ * vfs_cache_evict() cannot reclaim such pages, so they are reclaimed here,
+ * least recently used first, while the cache is over its limit. Only pages of
+ * the given node are considered, since writing back requires the node's
+ * contents_rwlock. Clients which have the page mapped keep their copy, but
+ * their further modifications are no longer written back.
+ *
+ * @param node		VFS node whose contents_rwlock is held by the caller.
+ * @param exch		Exchange with the endpoint FS.
+ */
+static void vfs_cache_reclaim(vfs_node_t *node, async_exch_t *exch)
+{
+	while (true) {
+		vfs_page_t *victim = NULL;
+
+		fibril_mutex_lock(&cache_mutex);
+		if (pages_count > VFS_CACHE_PAGES) {
+			list_foreach_rev(lru_list, lru_link, vfs_page_t, page) {
+				if ((page->node == node) && page->shared_rw &&
+				    (page->busy == 0)) {
+					victim = page;
+					victim->busy++;
+					break;
+				}
+			}
+		}
+		fibril_mutex_unlock(&cache_mutex);
+
+		if (victim == NULL)
+			return;
+
+		errno_t rc = vfs_cache_write_back(victim, exch);
+
+		fibril_mutex_lock(&cache_mutex);
+		victim->busy--;
+		if ((victim->busy == 0) && victim->cached && (rc == EOK))
+			vfs_cache_unlink(victim);
+		bool destroy = (victim->busy == 0) && !victim->cached;
+		fibril_mutex_unlock(&cache_mutex);
+
+		if (destroy)
+			vfs_page_destroy(victim);
+
+		if (rc != EOK)
+			return;
+	}
+}
+
+/** Get a cached page of a node, reading it if necessary.
+ *
+ * The caller must hold the node's contents_rwlock and must return the page
+ * using vfs_cache_put().
+ *
+ * @param node		VFS node.
+ * @param exch		Exchange with the endpoint FS or NULL to begin a new
+ *			one.
+ * @param offset	Page-aligned offset within the file.
+ * @param out_page	Place to store the page.
+ *
+ * @return		EOK on success or an error code from errno.h.
+ */
+errno_t vfs_cache_get(vfs_node_t *node, async_exch_t *exch, aoff64_t offset,
+    vfs_page_t **out_page)
+{
+	assert((offset % PAGE_SIZE) == 0);
+
+	page_key_t key = page_key(node, offset);
+	vfs_page_t *page;
+
+	fibril_mutex_lock(&cache_mutex);
+	ht_link_t *link = hash_table_find(&pages, &key);
+	if (link) {
+		page = hash_table_get_inst(link, vfs_page_t, link);
+		page->busy++;
+		list_remove(&page->lru_link);
+		list_prepend(&page->lru_link, &lru_list);
+		fibril_mutex_unlock(&cache_mutex);
+
+		*out_page = page;
+		return EOK;
+	}
+	fibril_mutex_unlock(&cache_mutex);
+
+	page = calloc(1, sizeof(vfs_page_t));
+	if (!page)
+		return ENOMEM;
+
+	page->data = as_area_create(AS_AREA_ANY, PAGE_SIZE,
+	    AS_AREA_READ | AS_AREA_WRITE | AS_AREA_CACHEABLE, AS_AREA_UNPAGED);
+	if (page->data == AS_MAP_FAILED) {
+		free(page);
+		return ENOMEM;
+	}
+
+	link_initialize(&page->node_link);
+	link_initialize(&page->lru_link);
+	page->node = node;
+	page->offset = offset;
+
+	bool own_exch = (exch == NULL);
+	if (own_exch)
+		exch = vfs_exchange_grab(node->fs_handle);
+
+	errno_t rc = vfs_cache_fill(page, exch);
+
+	if (own_exch)
+		vfs_exchange_release(exch);
+
+	if (rc != EOK) {
+		vfs_page_destroy(page);
+		return rc;
+	}
+
+	bool reclaim = false;
+
+	fibril_mutex_lock(&cache_mutex);
+	link = hash_table_find(&pages, &key);
+	if (link) {
+		/* Somebody else has read the page in the meantime. */
+		vfs_page_destroy(page);
+		page = hash_table_get_inst(link, vfs_page_t, link);
+		list_remove(&page->lru_link);
+		list_prepend(&page->lru_link, &lru_list);
+		page->busy++;
+	} else {
+		hash_table_insert(&pages, &page->link);
+		list_append(&page->node_link, &node->pages);
+		list_prepend(&page->lru_link, &lru_list);
+		page->cached = true;
+		page->busy++;
+		pages_count++;
+
+		vfs_cache_evict();
+		reclaim = (pages_count > VFS_CACHE_PAGES);
+	}
+	fibril_mutex_unlock(&cache_mutex);
+
+	if (reclaim) {
+		if (own_exch)
+			exch = vfs_exchange_grab(node->fs_handle);
+		vfs_cache_reclaim(node, exch);
+		if (own_exch)
+			vfs_exchange_release(exch);
+	}
+
+	*out_page = page;
+	return EOK;
+}
+
+/** Return a page obtained by vfs_cache_get().
+ *
+ * @param page		Cached page.
+ */
+void vfs_cache_put(vfs_page_t *page)
+{
+	fibril_mutex_lock(&cache_mutex);
+	assert(page->busy > 0);
+	page->busy--;
+	bool destroy = (page->busy == 0) && !page->cached;
+	fibril_mutex_unlock(&cache_mutex);
+
+	if (destroy)
+		vfs_page_destroy(page);
+}
+
+/** Note that a page was mapped by a client which may modify it.
+ *
+ * Such a page is written back before it is dropped from the cache.
+ *
+ * @param page		Page obtained by vfs_cache_get().
+ */
+void vfs_cache_share_rw(vfs_page_t *page)
+{
+	fibril_mutex_lock(&cache_mutex);
+	page->shared_rw = true;
+	fibril_mutex_unlock(&cache_mutex);
+}
+
+/** Find out whether a page is affected by a modification of a range. */
+static bool vfs_page_affected(vfs_page_t *page, aoff64_t start, aoff64_t end)
+{
+	bool overlaps = (page->offset < end) &&
+	    (page->offset + PAGE_SIZE > start);
+	return overlaps || (page->size != PAGE_SIZE);
+}
+
+/** Hold the next page of a node which clients may have modified.
+ *
+ * The walk continues after the previously held page if it is still cached and
+ * starts over otherwise. Every page is returned at most once in a pass, so no
+ * memory needs to be allocated to remember the pages. Must be called with
+ * cache_mutex held.
+ *
+ * @param node		VFS node.
+ * @param prev		Page returned by the previous call or NULL.
+ * @param pass		Pass number obtained from pages_pass.
+ * @param start		Start of the range of interest.
+ * @param end		End of the range of interest.
+ *
+ * @return		Held page to be returned using vfs_cache_put() or NULL
+ *			if there are no more pages.
+ */
+static vfs_page_t *vfs_cache_next_shared(vfs_node_t *node, vfs_page_t *prev,
+    unsigned pass, aoff64_t start, aoff64_t end)
+{
+	link_t *link = ((prev != NULL) && prev->cached) ?
+	    list_next(&prev->node_link, &node->pages) :
+	    list_first(&node->pages);
+
+	while (link != NULL) {
+		vfs_page_t *page = list_get_instance(link, vfs_page_t,
+		    node_link);
+
+		if (page->shared_rw && (page->pass != pass) &&
+		    vfs_page_affected(page, start, end)) {
+			page->pass = pass;
+			page->busy++;
+			return page;
+		}
+
+		link = list_next(link, &node->pages);
+	}
+
+	return NULL;
+}
+
+/** Update cached pages of a node after a modification.
+ *
+ * Besides the pages overlapping the modified range, the pages that end the
+ * file are affected as well, since the file size might have changed. These
+ * pages are dropped, except for pages which may be mapped by clients with
+ * write access. Those are read again in place so that the clients see the
+ * modification. Their previous contents must have been written back using
+ * vfs_cache_sync() before the modification.
+ *
+ * @param node		VFS node.
+ * @param exch		Exchange with the endpoint FS or NULL to begin a new
+ *			one.
+ * @param start		Start of the modified range.
+ * @param end		End of the modified range.
+ */
+void vfs_cache_invalidate(vfs_node_t *node, async_exch_t *exch,
+    aoff64_t start, aoff64_t end)
+{
+	list_t destroy;
+	list_initialize(&destroy);
+
+	fibril_mutex_lock(&cache_mutex);
+
+	unsigned pass = ++pages_pass;
+	bool shared = false;
+
+	list_foreach_safe(node->pages, cur, next) {
+		vfs_page_t *page = list_get_instance(cur, vfs_page_t,
+		    node_link);
+
+		if (!vfs_page_affected(page, start, end))
+			continue;
+
+		if (page->shared_rw) {
+			shared = true;
+			continue;
+		}
+
+		vfs_cache_unlink(page);
+		if (page->busy == 0)
+			list_append(&page->node_link, &destroy);
+	}
+
+	fibril_mutex_unlock(&cache_mutex);
+
+	list_foreach_safe(destroy, cur, next) {
+		vfs_page_t *page = list_get_instance(cur, vfs_page_t,
+		    node_link);
+		list_remove(cur);
+		vfs_page_destroy(page);
+	}
+
+	if (!shared)
+		return;
+
+	bool own_exch = (exch == NULL);
+	if (own_exch)
+		exch = vfs_exchange_grab(node->fs_handle);
+
+	vfs_page_t *page = NULL;
+	while (true) {
+		fibril_mutex_lock(&cache_mutex);
+		vfs_page_t *next = vfs_cache_next_shared(node, page, pass,
+		    start, end);
+		fibril_mutex_unlock(&cache_mutex);
+
+		if (page != NULL)
+			vfs_cache_put(page);
+		if (next == NULL)
+			break;
+
+		(void) vfs_cache_fill(next, exch);
+		page = next;
+	}
+
+	if (own_exch)
+		vfs_exchange_release(exch);
+}
+
+/** Write back pages of a node which clients may have modified.
+ *
+ * The caller must hold the node's contents_rwlock or hold the last reference
+ * to the node.
+ *
+ * @param node		VFS node.
+ * @param exch		Exchange with the endpoint FS or NULL to begin a new
+ *			one.
+ *
+ * @return		EOK on success or an error code from errno.h.
+ */
+errno_t vfs_cache_sync(vfs_node_t *node, async_exch_t *exch)
+{
+	fibril_mutex_lock(&cache_mutex);
+	unsigned pass = ++pages_pass;
+	fibril_mutex_unlock(&cache_mutex);
+
+	bool own_exch = false;
+	errno_t rc = EOK;
+
+	vfs_page_t *page = NULL;
+	while (true) {
+		fibril_mutex_lock(&cache_mutex);
+		vfs_page_t *next = vfs_cache_next_shared(node, page, pass, 0,
+		    UINT64_MAX);
+		fibril_mutex_unlock(&cache_mutex);
+
+		if (page != NULL)
+			vfs_cache_put(page);
+		if (next == NULL)
+			break;
+
+		if (exch == NULL) {
+			exch = vfs_exchange_grab(node->fs_handle);
+			own_exch = true;
+		}
+
+		errno_t rc_page = vfs_cache_write_back(next, exch);
+		if (rc_page != EOK)
+			rc = rc_page;
+		page = next;
+	}
+
+	if (own_exch)
+		vfs_exchange_release(exch);
+
+	return rc;
+}
+
+/** Write back and drop all cached pages of a node which is going away.
+ *
+ * @param node		VFS node with no more references.
+ */
+void vfs_cache_release(vfs_node_t *node)
+{
+	if (list_empty(&node->pages))
+		return;
+
+	(void) vfs_cache_sync(node, NULL);
+
+	fibril_mutex_lock(&cache_mutex);
+
+	list_foreach_safe(node->pages, cur, next) {
+		vfs_page_t *page = list_get_instance(cur, vfs_page_t,
+		    node_link);
+
+		assert(page->busy == 0);
+		vfs_cache_unlink(page);
+		vfs_page_destroy(page);
+	}
+
+	fibril_mutex_unlock(&cache_mutex);
+}
+
+/**
+ * @}
+ */
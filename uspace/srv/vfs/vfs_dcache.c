@@ -0,0 +1,411 @@
+/*
+ * Copyright (c) 2026 HelenOS developers
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright
+ *   notice, this list of conditions and the following disclaimer in the
+ *   documentation and/or other materials provided with the distribution.
+ * - The name of the author may not be used to endorse or promote products
+ *   derived from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE AUTHOR ``AS IS'' AND ANY EXPRESS OR
+ * IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED.
+ * IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT
+ * NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF
+ * THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** @addtogroup vfs
+ * @{
+ */
+
+/**
+ * @file	vfs_dcache.c
+ * @brief	Cache of path name components.
+ *
+ * The cache maps a directory triplet and a name of a directory entry to the
+ * lookup result of the entry, or remembers that the entry does not exist.
+ * It lets VFS resolve hot paths without asking the endpoint file systems.
+ * Entries are dropped whenever a name is linked or unlinked and when a file
+ * system is unmounted. Only file systems whose directories change only through
+ * VFS are cached.
+ */
+
+#include "vfs.h"
+#include <adt/hash.h>
+#include <adt/hash_table.h>
+#include <adt/list.h>
+#include <assert.h>
+#include <fibril_synch.h>
+#include <stdlib.h>
+#include <str.h>
+
+/** Maximum number of cached directory entries. */
+#define DCACHE_ENTRIES  512
+
+/** Cached directory entry. */
+typedef struct {
+	ht_link_t link;		/**< Name cache hash table link. */
+	ht_link_t child_link;	/**< Link in the children hash table. */
+	link_t lru_link;	/**< Link in the LRU list of entries. */
+
+	vfs_triplet_t parent;
+	char name[NAME_MAX + 1];
+
+	/** The entry is known not to exist. */
+	bool negative;
+	/** Lookup result of the entry, unless negative. */
+	vfs_lookup_res_t child;
+} dentry_t;
+
+typedef struct {
+	const vfs_triplet_t *parent;
+	const char *name;
+} dentry_key_t;
+
+/** Mutex protecting the name cache. */
+static FIBRIL_MUTEX_INITIALIZE(dcache_mutex);
+
+/** Cached entries hashed by the parent triplet and name. */
+static hash_table_t dentries;
+
+/** Positive cached entries hashed by the child triplet. */
+static hash_table_t children;
+
+/** Cached entries, the least recently used one is the last. */
+static LIST_INITIALIZE(lru_list);
+
+/** Number of cached entries. */
+static size_t dentries_count = 0;
+
+/** Incremented on every invalidation, see vfs_dcache_insert(). */
+static unsigned long dcache_gen = 0;
+
+static size_t triplet_hash(const vfs_triplet_t *triplet)
+{
+	size_t hash = hash_combine(triplet->fs_handle, triplet->index);
+	return hash_combine(hash, triplet->service_id);
+}
+
+static size_t dentry_hash(const vfs_triplet_t *parent, const char *name)
+{
+	size_t hash = triplet_hash(parent);
+
+	for (const char *c = name; *c != '\0'; c++)
+		hash = hash_combine(hash, (uint8_t) *c);
+
+	return hash;
+}
+
+static size_t dentries_key_hash(const void *key)
+{
+	const dentry_key_t *k = key;
+	return dentry_hash(k->parent, k->name);
+}
+
+static size_t dentries_hash(const ht_link_t *item)
+{
+	dentry_t *dentry = hash_table_get_inst(item, dentry_t, link);
+	return dentry_hash(&dentry->parent, dentry->name);
+}
+
+static inline bool triplet_equal(const vfs_triplet_t *a,
+    const vfs_triplet_t *b)
+{
+	return a->fs_handle == b->fs_handle &&
+	    a->service_id == b->service_id && a->index == b->index;
+}
+
+static bool dentries_key_equal(const void *key, const ht_link_t *item)
+{
+	const dentry_key_t *k = key;
+	dentry_t *dentry = hash_table_get_inst(item, dentry_t, link);
+	return triplet_equal(&dentry->parent, k->parent) &&
+	    str_cmp(dentry->name, k->name) == 0;
+}
+
+static size_t children_key_hash(const void *key)
+{
+	return triplet_hash(key);
+}
+
+static size_t children_hash(const ht_link_t *item)
+{
+	dentry_t *dentry = hash_table_get_inst(item, dentry_t, child_link);
+	return triplet_hash(&dentry->child.triplet);
+}
+
+static bool children_key_equal(const void *key, const ht_link_t *item)
+{
+	dentry_t *dentry = hash_table_get_inst(item, dentry_t, child_link);
+	return triplet_equal(&dentry->child.triplet, key);
+}
+
+static bool children_equal(const ht_link_t *item1, const ht_link_t *item2)
+{
+	dentry_t *dentry1 = hash_table_get_inst(item1, dentry_t, child_link);
+	dentry_t *dentry2 = hash_table_get_inst(item2, dentry_t, child_link);
+	return triplet_equal(&dentry1->child.triplet, &dentry2->child.triplet);
+}
+
+/** Children hash table operations. */
+static hash_table_ops_t children_ops = {
+	.hash = children_hash,
+	.key_hash = children_key_hash,
+	.key_equal = children_key_equal,
+	.equal = children_equal,
+	.remove_callback = NULL,
+};
+
+/** Name cache hash table operations. */
+static hash_table_ops_t dentries_ops = {
+	.hash = dentries_hash,
+	.key_hash = dentries_key_hash,
+	.key_equal = dentries_key_equal,
+	.equal = NULL,
+	.remove_callback = NULL,
+};
+
+/** Initialize the name cache.
+ *
+ * @return		Return true on success, false on failure.
+ */
+bool vfs_dcache_init(void)
+{
+	return hash_table_create(&dentries, 0, 0, &dentries_ops) &&
+	    hash_table_create(&children, 0, 0, &children_ops);
+}
+
+/** Check whether directory entries of a file system may be cached.
+ *
+ * @param fs_handle	File system handle.
+ *
+ * @return		True if the entries may be cached.
+ */
+bool vfs_dcache_enabled(fs_handle_t fs_handle)
+{
+	vfs_info_t *info = fs_handle_to_info(fs_handle);
+	return (info != NULL) && info->name_cache;
+}
+
+/** Remove and free an entry. Must be called with dcache_mutex held. */
+static void dentry_destroy(dentry_t *dentry)
+{
+	hash_table_remove_item(&dentries, &dentry->link);
+	if (!dentry->negative)
+		hash_table_remove_item(&children, &dentry->child_link);
+	list_remove(&dentry->lru_link);
+	dentries_count--;
+	free(dentry);
+}
+
+static dentry_t *dentry_find(const vfs_triplet_t *parent, const char *name)
+{
+	dentry_key_t key = {
+		.parent = parent,
+		.name = name
+	};
+
+	ht_link_t *link = hash_table_find(&dentries, &key);
+	return link ? hash_table_get_inst(link, dentry_t, link) : NULL;
+}
+
+/** Look up a directory entry in the name cache.
+ *
+ * @param parent	Triplet of the directory.
+ * @param name		Name of the entry.
+ * @param res		Place to store the lookup result of the entry.
+ * @param negative	Place to store whether the entry is known not to
+ *			exist.
+ *
+ * @return		True if the entry was found in the cache.
+ */
+bool vfs_dcache_lookup(const vfs_triplet_t *parent, const char *name,
+    vfs_lookup_res_t *res, bool *negative)
+{
+	fibril_mutex_lock(&dcache_mutex);
+
+	dentry_t *dentry = dentry_find(parent, name);
+	if (!dentry) {
+		fibril_mutex_unlock(&dcache_mutex);
+		return false;
+	}
+
+	list_remove(&dentry->lru_link);
+	list_prepend(&dentry->lru_link, &lru_list);
+
+	*negative = dentry->negative;
+	if (!dentry->negative)
+		*res = dentry->child;
+
+	fibril_mutex_unlock(&dcache_mutex);
+	return true;
+}
+
+/** Get the current generation of the name cache.
+ *
+ * The generation is to be obtained before asking the endpoint file system
+ * and passed to vfs_dcache_insert() along with the answer.
+ *
+ * @return		Current generation.
+ */
+unsigned long vfs_dcache_generation(void)
+{
+	fibril_mutex_lock(&dcache_mutex);
+	unsigned long gen = dcache_gen;
+	fibril_mutex_unlock(&dcache_mutex);
+
+	return gen;
+}
+
+/** Insert a directory entry into the name cache.
+ *
+ * Nothing is inserted if the cache was invalidated since @a gen was obtained,
+ * because the answer of the endpoint file system might be stale already.
+ *
+ * @param gen		Generation obtained before the lookup.
+ * @param parent	Triplet of the directory.
+ * @param name		Name of the entry.
+ * @param res		Lookup result of the entry or NULL if the entry does
+ *			not exist.
+ */
+void vfs_dcache_insert(unsigned long gen, const vfs_triplet_t *parent,
+    const char *name, const vfs_lookup_res_t *res)
+{
+	if (str_size(name) > NAME_MAX)
+		return;
+
+	dentry_t *dentry = malloc(sizeof(dentry_t));
+	if (!dentry)
+		return;
+
+	dentry->parent = *parent;
+	str_cpy(dentry->name, sizeof(dentry->name), name);
+	dentry->negative = (res == NULL);
+	if (res)
+		dentry->child = *res;
+	link_initialize(&dentry->lru_link);
+
+	fibril_mutex_lock(&dcache_mutex);
+
+	if ((gen != dcache_gen) || (dentry_find(parent, name) != NULL)) {
+		fibril_mutex_unlock(&dcache_mutex);
+		free(dentry);
+		return;
+	}
+
+	hash_table_insert(&dentries, &dentry->link);
+	if (!dentry->negative)
+		hash_table_insert(&children, &dentry->child_link);
+	list_prepend(&dentry->lru_link, &lru_list);
+	dentries_count++;
+
+	while (dentries_count > DCACHE_ENTRIES) {
+		dentry_destroy(list_get_instance(list_last(&lru_list),
+		    dentry_t, lru_link));
+	}
+
+	fibril_mutex_unlock(&dcache_mutex);
+}
+
+/** Drop a directory entry which was linked or unlinked.
+ *
+ * @param parent	Triplet of the directory.
+ * @param name		Name of the entry.
+ */
+void vfs_dcache_invalidate(const vfs_triplet_t *parent, const char *name)
+{
+	fibril_mutex_lock(&dcache_mutex);
+
+	dcache_gen++;
+
+	dentry_t *dentry = dentry_find(parent, name);
+	if (dentry)
+		dentry_destroy(dentry);
+
+	fibril_mutex_unlock(&dcache_mutex);
+}
+
+/** Drop all entries of a directory which was unlinked.
+ *
+ * @param dir		Triplet of the directory.
+ */
+void vfs_dcache_invalidate_dir(const vfs_triplet_t *dir)
+{
+	fibril_mutex_lock(&dcache_mutex);
+
+	dcache_gen++;
+
+	list_foreach_safe(lru_list, cur, next) {
+		dentry_t *dentry = list_get_instance(cur, dentry_t, lru_link);
+		if (triplet_equal(&dentry->parent, dir))
+			dentry_destroy(dentry);
+	}
+
+	fibril_mutex_unlock(&dcache_mutex);
+}
+
+/** Drop all entries of a file system instance which is being unmounted.
+ *
+ * @param fs_handle	File system handle.
+ * @param service_id	Service ID of the file system instance.
+ */
+void vfs_dcache_invalidate_fs(fs_handle_t fs_handle, service_id_t service_id)
+{
+	fibril_mutex_lock(&dcache_mutex);
+
+	dcache_gen++;
+
+	list_foreach_safe(lru_list, cur, next) {
+		dentry_t *dentry = list_get_instance(cur, dentry_t, lru_link);
+		if ((dentry->parent.fs_handle == fs_handle) &&
+		    (dentry->parent.service_id == service_id))
+			dentry_destroy(dentry);
+	}
+
+	fibril_mutex_unlock(&dcache_mutex);
+}
+
+/** Update cached entries of a node which is going away.
+ *
+ * While a node is in use, its size is tracked by the VFS node. Once the node
+ * is released, the size is remembered in the entries pointing to it, so that
+ * a node created from a cached lookup result gets the right size.
+ *
+ * @param node		VFS node with no more references.
+ */
+void vfs_dcache_node_released(vfs_node_t *node)
+{
+	vfs_triplet_t triplet = {
+		.fs_handle = node->fs_handle,
+		.service_id = node->service_id,
+		.index = node->index
+	};
+
+	fibril_mutex_lock(&dcache_mutex);
+
+	ht_link_t *first = hash_table_find(&children, &triplet);
+	for (ht_link_t *cur = first; cur != NULL;
+	    cur = hash_table_find_next(&children, first, cur)) {
+		dentry_t *dentry = hash_table_get_inst(cur, dentry_t,
+		    child_link);
+		dentry->child.size = node->size;
+	}
+
+	fibril_mutex_unlock(&dcache_mutex);
+}
+
+/**
+ * @}
+ */
@@ -183,6 +183,18 @@ static void vfs_in_read(ipc_call_t *req)
 	async_answer_1(req, rc, bytes);
 }
 
+static void vfs_in_readdir(ipc_call_t *req)
+{
+	int fd = ipc_get_arg1(req);
+	aoff64_t pos = MERGE_LOUP32(ipc_get_arg2(req),
+	    ipc_get_arg3(req));
+	unsigned int flags = ipc_get_arg4(req);
+
+	size_t bytes = 0;
+	errno_t rc = vfs_op_readdir(fd, &pos, flags, &bytes);
+	async_answer_3(req, rc, bytes, LOWER32(pos), UPPER32(pos));
+}
+
 static void vfs_in_rename(ipc_call_t *req)
 {
 	/* The common base directory. */
@@ -356,6 +368,9 @@ void vfs_connection(ipc_call_t *icall, void *arg)
 		case VFS_IN_READ:
 			vfs_in_read(&call);
 			break;
+		case VFS_IN_READDIR:
+			vfs_in_readdir(&call);
+			break;
 		case VFS_IN_REGISTER:
 			vfs_register(&call);
 			cont = false;
@@ -202,6 +202,8 @@ errno_t vfs_link_internal(vfs_node_t *base, char *path, vfs_triplet_t *child)
 	if (orig_rc != EOK)
 		rc = orig_rc;
 
+	vfs_dcache_invalidate(triplet, component);
+
 out:
 	return rc;
 }
@@ -237,6 +239,123 @@ static errno_t out_lookup(vfs_triplet_t *base, size_t *pfirst, size_t *plen,
 	return EOK;
 }
 
+static vfs_triplet_t cross_mounts(vfs_triplet_t *triplet, int lflag,
+    errno_t *rc)
+{
+	vfs_lookup_res_t res = {
+		.triplet = *triplet
+	};
+
+	vfs_node_t *node = vfs_node_peek(&res);
+	if (!node)
+		return *triplet;
+
+	vfs_node_t *mp = node;
+	while (mp->mount)
+		mp = mp->mount;
+
+	if ((mp != node) && (lflag & L_DISABLE_MOUNTS))
+		*rc = EXDEV;
+
+	vfs_triplet_t crossed = *((vfs_triplet_t *) mp);
+	vfs_node_put(node);
+	return crossed;
+}
+
+/** Resolve a path one component at a time using the name cache.
+ *
+ * Components missing from the cache are looked up by the endpoint file
+ * system one by one and the results are added to the cache.
+ *
+ * @param base    The node from which to perform the lookup.
+ * @param path    Path to be resolved, it is also stored in PLB at @a first.
+ * @param len     Length of the path.
+ * @param first   Index of the path in PLB.
+ * @param lflag   Flags to be used during lookup.
+ * @param result  Place to store the lookup result.
+ *
+ * @return EOK on success or an error code from errno.h.
+ *
+ */
+static errno_t lookup_components(vfs_node_t *base, char *path, size_t len,
+    size_t first, int lflag, vfs_lookup_res_t *result)
+{
+	char component[NAME_MAX + 1];
+	vfs_lookup_res_t res;
+	errno_t rc = EOK;
+
+	while (base->mount) {
+		if (lflag & L_DISABLE_MOUNTS)
+			return EXDEV;
+
+		base = base->mount;
+	}
+
+	vfs_triplet_t dir = *((vfs_triplet_t *) base);
+	size_t pos = 0;
+
+	while (pos < len) {
+		assert(path[pos] == '/');
+
+		size_t end = pos + 1;
+		while ((end < len) && (path[end] != '/'))
+			end++;
+
+		size_t clen = end - pos - 1;
+		if (clen > NAME_MAX)
+			return ENAMETOOLONG;
+
+		memcpy(component, &path[pos + 1], clen);
+		component[clen] = 0;
+
+		bool cache = vfs_dcache_enabled(dir.fs_handle);
+		bool negative;
+		if (!cache ||
+		    !vfs_dcache_lookup(&dir, component, &res, &negative)) {
+			unsigned long gen = vfs_dcache_generation();
+
+			size_t next = first + pos;
+			size_t nlen = end - pos;
+			rc = out_lookup(&dir, &next, &nlen, L_NONE, &res);
+			if (rc != EOK)
+				return rc;
+
+			/*
+			 * The file system stops in front of a component
+			 * which does not exist.
+			 */
+			negative = (nlen > 0);
+			if (cache) {
+				vfs_dcache_insert(gen, &dir, component,
+				    negative ? NULL : &res);
+			}
+		}
+
+		if (negative)
+			return ENOENT;
+
+		pos = end;
+
+		if (pos < len) {
+			if (res.type != VFS_NODE_DIRECTORY)
+				return ENOTDIR;
+
+			dir = cross_mounts(&res.triplet, lflag, &rc);
+			if (rc != EOK)
+				return rc;
+		}
+	}
+
+	if ((lflag & L_FILE) && (res.type == VFS_NODE_DIRECTORY))
+		return EISDIR;
+
+	if ((lflag & L_DIRECTORY) && (res.type == VFS_NODE_FILE))
+		return ENOTDIR;
+
+	*result = res;
+	return EOK;
+}
+
 static errno_t _vfs_lookup_internal(vfs_node_t *base, char *path, int lflag,
     vfs_lookup_res_t *result, size_t len)
 {
@@ -253,6 +372,18 @@ static errno_t _vfs_lookup_internal(vfs_node_t *base, char *path, int lflag,
 
 	vfs_lookup_res_t res;
 
+	/*
+	 * Lookups which do not modify the namespace are resolved through the
+	 * name cache.
+	 */
+	if (!(lflag & (L_CREATE | L_UNLINK)) && (len > 1)) {
+		rc = lookup_components(base, path, len, first, lflag, &res);
+		if (rc != EOK)
+			goto out;
+
+		nlen = 0;
+	}
+
 	/* Resolve path as long as there are mount points to cross. */
 	while (nlen > 0) {
 		while (base->mount) {
@@ -266,6 +397,23 @@ static errno_t _vfs_lookup_internal(vfs_node_t *base, char *path, int lflag,
 
 		rc = out_lookup((vfs_triplet_t *) base, &next, &nlen, lflag,
 		    &res);
+
+		if (lflag & (L_CREATE | L_UNLINK)) {
+			/*
+			 * The path is a single component in this case, see
+			 * vfs_lookup_internal().
+			 */
+			char component[NAME_MAX + 1];
+			size_t clen = min(len - 1, NAME_MAX);
+			memcpy(component, path + 1, clen);
+			component[clen] = 0;
+
+			vfs_dcache_invalidate((vfs_triplet_t *) base,
+			    component);
+			if ((rc == EOK) && (lflag & L_UNLINK))
+				vfs_dcache_invalidate_dir(&res.triplet);
+		}
+
 		if (rc != EOK)
 			goto out;
 
@@ -36,7 +36,10 @@
  */
 
 #include "vfs.h"
+#include <align.h>
+#include <as.h>
 #include <macros.h>
+#include <mem.h>
 #include <stdint.h>
 #include <async.h>
 #include <errno.h>
@@ -351,12 +354,85 @@ errno_t vfs_op_open(int fd, int mode)
 typedef errno_t (*rdwr_ipc_cb_t)(async_exch_t *, vfs_file_t *, aoff64_t,
     ipc_call_t *, bool, void *);
 
+/** Maximum number of cached pages copied to a client in one read. */
+#define RDWR_CACHE_PAGES  16
+
+/** Answer the client's IPC_M_DATA_READ from the page cache. */
+static errno_t rdwr_cache_client(async_exch_t *exch, vfs_file_t *file,
+    aoff64_t pos, size_t *bytes)
+{
+	ipc_call_t call;
+	size_t size;
+
+	*bytes = 0;
+
+	if (!async_data_read_receive(&call, &size)) {
+		async_answer_0(&call, EINVAL);
+		return EINVAL;
+	}
+
+	vfs_page_t *page;
+	aoff64_t offset = ALIGN_DOWN(pos, PAGE_SIZE);
+	errno_t rc = vfs_cache_get(file->node, exch, offset, &page);
+	if (rc != EOK) {
+		async_answer_0(&call, rc);
+		return rc;
+	}
+
+	size_t skip = pos - offset;
+	size_t avail = (skip < page->size) ? page->size - skip : 0;
+
+	if ((size <= avail) || (page->size < PAGE_SIZE)) {
+		/* The whole read is served by a single page. */
+		*bytes = min(size, avail);
+		rc = async_data_read_finalize(&call, page->data + skip, *bytes);
+		vfs_cache_put(page);
+		return rc;
+	}
+
+	/* Gather the data from consecutive pages. */
+	size = min(size, RDWR_CACHE_PAGES * PAGE_SIZE - skip);
+	uint8_t *buf = malloc(size);
+	if (!buf) {
+		vfs_cache_put(page);
+		async_answer_0(&call, ENOMEM);
+		return ENOMEM;
+	}
+
+	size_t done = 0;
+	while (true) {
+		size_t n = min(size - done, avail);
+		memcpy(buf + done, page->data + skip, n);
+		done += n;
+
+		bool last = (done == size) || (page->size < PAGE_SIZE);
+		vfs_cache_put(page);
+		if (last)
+			break;
+
+		offset += PAGE_SIZE;
+		if (vfs_cache_get(file->node, exch, offset, &page) != EOK)
+			break;
+
+		skip = 0;
+		avail = page->size;
+	}
+
+	*bytes = done;
+	rc = async_data_read_finalize(&call, buf, done);
+	free(buf);
+	return rc;
+}
+
 static errno_t rdwr_ipc_client(async_exch_t *exch, vfs_file_t *file, aoff64_t pos,
     ipc_call_t *answer, bool read, void *data)
 {
 	size_t *bytes = (size_t *) data;
 	errno_t rc;
 
+	if (read && vfs_cache_enabled(file->node))
+		return rdwr_cache_client(exch, file, pos, bytes);
+
 	/*
 	 * Make a VFS_READ/VFS_WRITE request at the destination FS server
 	 * and forward the IPC_M_DATA_READ/IPC_M_DATA_WRITE request to the
@@ -370,12 +446,23 @@ static errno_t rdwr_ipc_client(async_exch_t *exch, vfs_file_t *file, aoff64_t po
 		    file->node->service_id, file->node->index,
 		    LOWER32(pos), UPPER32(pos), answer);
 	} else {
+		/*
+		 * Modifications made through clients' mappings must reach
+		 * the file before the cached pages are read again.
+		 */
+		if (vfs_cache_enabled(file->node))
+			(void) vfs_cache_sync(file->node, exch);
+
 		rc = async_data_write_forward_4_1(exch, VFS_OUT_WRITE,
 		    file->node->service_id, file->node->index,
 		    LOWER32(pos), UPPER32(pos), answer);
 	}
 
 	*bytes = ipc_get_arg1(answer);
+
+	if (!read && (rc == EOK) && vfs_cache_enabled(file->node))
+		vfs_cache_invalidate(file->node, exch, pos, pos + *bytes);
+
 	return rc;
 }
 
@@ -510,6 +597,77 @@ errno_t vfs_op_read(int fd, aoff64_t pos, size_t *out_bytes)
 	return vfs_rdwr(fd, pos, true, rdwr_ipc_client, out_bytes);
 }
 
+errno_t vfs_op_readdir(int fd, aoff64_t *pos, unsigned int flags,
+    size_t *out_bytes)
+{
+	ipc_call_t call;
+	size_t size;
+	if (!async_data_read_receive(&call, &size)) {
+		async_answer_0(&call, EINVAL);
+		return EINVAL;
+	}
+
+	vfs_file_t *file = vfs_file_get(fd);
+	if (!file) {
+		async_answer_0(&call, EBADF);
+		return EBADF;
+	}
+
+	if (!file->open_read || file->node->type != VFS_NODE_DIRECTORY) {
+		vfs_file_put(file);
+		async_answer_0(&call, EINVAL);
+		return EINVAL;
+	}
+
+	/*
+	 * The flags do not fit into a forwarded IPC_M_DATA_READ, so the
+	 * entries are read into a buffer of our own and passed on.
+	 */
+	if (size > DATA_XFER_LIMIT)
+		size = DATA_XFER_LIMIT;
+
+	void *buf = malloc(size);
+	if (!buf) {
+		vfs_file_put(file);
+		async_answer_0(&call, ENOMEM);
+		return ENOMEM;
+	}
+
+	fibril_rwlock_read_lock(&file->node->contents_rwlock);
+	fibril_rwlock_read_lock(&namespace_rwlock);
+
+	async_exch_t *exch = vfs_exchange_grab(file->node->fs_handle);
+
+	ipc_call_t answer;
+	aid_t msg = async_send_5(exch, VFS_OUT_READDIR, file->node->service_id,
+	    file->node->index, LOWER32(*pos), UPPER32(*pos), flags, &answer);
+	errno_t rc = async_data_read_start(exch, buf, size);
+
+	vfs_exchange_release(exch);
+
+	if (rc == EOK)
+		async_wait_for(msg, &rc);
+	else
+		async_forget(msg);
+
+	fibril_rwlock_read_unlock(&namespace_rwlock);
+	fibril_rwlock_read_unlock(&file->node->contents_rwlock);
+	vfs_file_put(file);
+
+	if (rc != EOK) {
+		free(buf);
+		async_answer_0(&call, rc);
+		return rc;
+	}
+
+	*out_bytes = min(ipc_get_arg1(&answer), size);
+	*pos = MERGE_LOUP32(ipc_get_arg2(&answer), ipc_get_arg3(&answer));
+
+	rc = async_data_read_finalize(&call, buf, *out_bytes);
+	free(buf);
+	return rc;
+}
+
 errno_t vfs_op_rename(int basefd, char *old, char *new)
 {
 	vfs_file_t *base_file = vfs_file_get(basefd);
@@ -624,10 +782,16 @@ errno_t vfs_op_resize(int fd, int64_t size)
 
 	fibril_rwlock_write_lock(&file->node->contents_rwlock);
 
+	if (vfs_cache_enabled(file->node))
+		(void) vfs_cache_sync(file->node, NULL);
+
 	errno_t rc = vfs_truncate_internal(file->node->fs_handle,
 	    file->node->service_id, file->node->index, size);
-	if (rc == EOK)
+	if (rc == EOK) {
+		vfs_cache_invalidate(file->node, NULL, min(file->node->size,
+		    (aoff64_t) size), UINT64_MAX);
 		file->node->size = size;
+	}
 
 	fibril_rwlock_write_unlock(&file->node->contents_rwlock);
 	vfs_file_put(file);
@@ -674,6 +838,10 @@ errno_t vfs_op_sync(int fd)
 	if (!file)
 		return EBADF;
 
+	fibril_rwlock_write_lock(&file->node->contents_rwlock);
+	errno_t rc_cache = vfs_cache_sync(file->node, NULL);
+	fibril_rwlock_write_unlock(&file->node->contents_rwlock);
+
 	async_exch_t *fs_exch = vfs_exchange_grab(file->node->fs_handle);
 
 	aid_t msg;
@@ -687,7 +855,7 @@ errno_t vfs_op_sync(int fd)
 	async_wait_for(msg, &rc);
 
 	vfs_file_put(file);
-	return rc;
+	return (rc == EOK) ? rc_cache : rc;
 
 }
 
@@ -822,6 +990,8 @@ errno_t vfs_op_unmount(int mpfd)
 		return rc;
 	}
 
+	vfs_dcache_invalidate_fs(mp->node->mount->fs_handle,
+	    mp->node->mount->service_id);
 	vfs_node_forget(mp->node->mount);
 	vfs_node_put(mp->node);
 	mp->node->mount = NULL;
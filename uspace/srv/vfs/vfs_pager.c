@@ -41,6 +41,37 @@
 #include <errno.h>
 #include <as.h>
 
+/** Answer a page-in request with a page from the page cache.
+ *
+ * The frame of the cached page is shared with the client. Unless the client
+ * has the file open for writing, in which case its modifications are written
+ * back, the frame may only be shared with read-only mappings and the kernel
+ * gives writable mappings a private copy.
+ */
+static void vfs_page_in_cached(ipc_call_t *req, vfs_file_t *file,
+    aoff64_t offset)
+{
+	vfs_page_t *page;
+
+	fibril_rwlock_read_lock(&file->node->contents_rwlock);
+	errno_t rc = vfs_cache_get(file->node, NULL, offset, &page);
+	fibril_rwlock_read_unlock(&file->node->contents_rwlock);
+
+	if (rc != EOK) {
+		async_answer_0(req, rc);
+		return;
+	}
+
+	unsigned int share_flags = 0;
+	if (file->open_write)
+		vfs_cache_share_rw(page);
+	else
+		share_flags = AS_AREA_READ | AS_AREA_EXEC | AS_AREA_CACHEABLE;
+
+	async_answer_2(req, EOK, (sysarg_t) page->data, share_flags);
+	vfs_cache_put(page);
+}
+
 void vfs_page_in(ipc_call_t *req)
 {
 	aoff64_t offset = ipc_get_arg1(req);
@@ -49,6 +80,21 @@ void vfs_page_in(ipc_call_t *req)
 	void *page;
 	errno_t rc;
 
+	vfs_file_t *file = vfs_file_get(fd);
+	if (!file) {
+		async_answer_0(req, EBADF);
+		return;
+	}
+
+	if ((page_size == PAGE_SIZE) && file->open_read &&
+	    vfs_cache_enabled(file->node)) {
+		vfs_page_in_cached(req, file, offset);
+		vfs_file_put(file);
+		return;
+	}
+
+	vfs_file_put(file);
+
 	page = as_area_create(AS_AREA_ANY, page_size,
 	    AS_AREA_READ | AS_AREA_WRITE | AS_AREA_CACHEABLE,
 	    AS_AREA_UNPAGED);
@@ -80,10 +126,8 @@ void vfs_page_in(ipc_call_t *req)
 	async_answer_1(req, rc, (sysarg_t) page);
 
 	/*
-	 * FIXME:
-	 * This is just for now until we implement proper page cache
-	 * management.  Not keeping the pages around in a cache results in
-	 * inherently non-coherent private mappings.
+	 * Files which cannot be cached are read into a temporary page, which
+	 * results in inherently non-coherent private mappings.
 	 */
 	as_area_destroy(page);
 }